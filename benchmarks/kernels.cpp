@@ -0,0 +1,371 @@
+/*
+ * Micro-benchmarks for the Z-order kernels in library.h.
+ *
+ * Every kernel is run over a precomputed set of inputs for each combination of
+ * dimension count, bits per dimension and key distribution, until the run takes
+ * at least --min-time milliseconds. Allocations are counted by replacing the
+ * global operator new.
+ *
+ *   zkd_index_bench [--filter <substring>] [--dims 1,2,4] [--bits 8,32]
+ *                   [--dist uniform,clustered,skewed] [--min-time <ms>] [--csv]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "library.h"
+#include "quantizing-codec.h"
+#include "schema.h"
+
+namespace {
+std::atomic<std::size_t> allocations{0};
+std::atomic<std::size_t> allocatedBytes{0};
+}  // namespace
+
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  if (auto* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+using namespace zkd;
+
+namespace {
+
+template<typename T>
+void doNotOptimize(T const& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+enum class Distribution {
+  UNIFORM,
+  CLUSTERED,
+  SKEWED
+};
+
+auto to_string(Distribution dist) -> char const* {
+  switch (dist) {
+    case Distribution::UNIFORM:
+      return "uniform";
+    case Distribution::CLUSTERED:
+      return "clustered";
+    case Distribution::SKEWED:
+      return "skewed";
+  }
+  return "?";
+}
+
+auto parseDistribution(std::string const& name) -> Distribution {
+  if (name == "uniform") {
+    return Distribution::UNIFORM;
+  } else if (name == "clustered") {
+    return Distribution::CLUSTERED;
+  } else if (name == "skewed") {
+    return Distribution::SKEWED;
+  }
+  throw std::invalid_argument("unknown distribution " + name);
+}
+
+struct Config {
+  std::size_t dims;
+  unsigned bits;
+  Distribution dist;
+};
+
+// coordinates with `bits` bits, stored big endian in bits / 8 bytes
+auto coordinate(uint64_t v, unsigned bits) -> byte_string {
+  byte_string result;
+  for (unsigned i = bits / 8; i > 0; --i) {
+    result.push_back(std::byte(v >> (8 * (i - 1))));
+  }
+  return result;
+}
+
+struct Inputs {
+  std::vector<std::vector<byte_string>> points;
+  std::vector<byte_string> keys;
+  std::vector<uint64_t> integers;
+  std::vector<byte_string> encodedIntegers;
+  std::vector<double> doubles;
+  std::vector<byte_string> encodedDoubles;
+  byte_string min;
+  byte_string max;
+};
+
+constexpr std::size_t numInputs = 1024;
+
+auto makeInputs(Config const& config) -> Inputs {
+  std::mt19937_64 rng{config.dims * 131 + config.bits * 7 + static_cast<unsigned>(config.dist)};
+  auto const range = config.bits == 64 ? std::numeric_limits<uint64_t>::max()
+                                       : (uint64_t{1} << config.bits) - 1;
+  auto const scale = static_cast<double>(range);
+
+  std::vector<double> centers;
+  std::uniform_real_distribution<double> unit{0.0, 1.0};
+  for (std::size_t i = 0; i < 8 * config.dims; ++i) {
+    centers.push_back(unit(rng));
+  }
+  std::normal_distribution<double> spread{0.0, 0.02};
+  std::exponential_distribution<double> decay{8.0};
+
+  auto draw = [&](std::size_t dim, std::size_t cluster) -> double {
+    double v = 0;
+    switch (config.dist) {
+      case Distribution::UNIFORM:
+        v = unit(rng);
+        break;
+      case Distribution::CLUSTERED:
+        v = centers[cluster * config.dims + dim] + spread(rng);
+        break;
+      case Distribution::SKEWED:
+        v = decay(rng);
+        break;
+    }
+    return std::clamp(v, 0.0, 1.0);
+  };
+  // scale rounds up to 2^bits for more than 53 bits, so 1.0 saturates instead of overflowing the cast
+  auto toCoordinate = [&](double v) { return v * scale >= scale ? range : static_cast<uint64_t>(v * scale); };
+
+  Inputs inputs;
+  std::uniform_int_distribution<std::size_t> clusters{0, 7};
+  for (std::size_t i = 0; i < numInputs; ++i) {
+    auto cluster = clusters(rng);
+    std::vector<byte_string> point;
+    for (std::size_t d = 0; d < config.dims; ++d) {
+      point.push_back(coordinate(toCoordinate(draw(d, cluster)), config.bits));
+    }
+    inputs.keys.push_back(interleave(point));
+    inputs.points.push_back(std::move(point));
+    inputs.integers.push_back(toCoordinate(draw(0, cluster)));
+    inputs.encodedIntegers.push_back(to_byte_string_fixed_length(inputs.integers.back()));
+    inputs.doubles.push_back((draw(0, cluster) - 0.5) * 1e6);
+    inputs.encodedDoubles.push_back(to_byte_string_fixed_length(inputs.doubles.back()));
+  }
+
+  // the middle quarter of every dimension
+  std::vector<byte_string> min, max;
+  for (std::size_t d = 0; d < config.dims; ++d) {
+    min.push_back(coordinate(toCoordinate(0.375), config.bits));
+    max.push_back(coordinate(toCoordinate(0.625), config.bits));
+  }
+  inputs.min = interleave(min);
+  inputs.max = interleave(max);
+  return inputs;
+}
+
+struct Measurement {
+  double nsPerOp;
+  double allocsPerOp;
+  double bytesPerOp;
+};
+
+// runs `op(i)` for i in [0, numInputs) until at least minTime has passed
+auto measure(std::function<void(std::size_t)> const& op, std::chrono::milliseconds minTime) -> Measurement {
+  for (std::size_t i = 0; i < numInputs; ++i) {
+    op(i);  // warm up
+  }
+
+  std::size_t rounds = 1;
+  while (true) {
+    auto allocsBefore = allocations.load(std::memory_order_relaxed);
+    auto bytesBefore = allocatedBytes.load(std::memory_order_relaxed);
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t r = 0; r < rounds; ++r) {
+      for (std::size_t i = 0; i < numInputs; ++i) {
+        op(i);
+      }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    if (elapsed >= minTime || rounds >= (std::size_t{1} << 20)) {
+      auto ops = static_cast<double>(rounds * numInputs);
+      return Measurement{
+          std::chrono::duration<double, std::nano>(elapsed).count() / ops,
+          static_cast<double>(allocations.load(std::memory_order_relaxed) - allocsBefore) / ops,
+          static_cast<double>(allocatedBytes.load(std::memory_order_relaxed) - bytesBefore) / ops};
+    }
+    rounds *= 2;
+  }
+}
+
+struct Kernel {
+  char const* name;
+  bool onKeys;  // codecs don't depend on the key shape and run once per distribution
+  std::function<void(Inputs const&, std::size_t, std::size_t)> run;  // (inputs, index, dims)
+};
+
+auto kernels() -> std::vector<Kernel> {
+  return {
+      {"interleave", true,
+       [](Inputs const& in, std::size_t i, std::size_t) { doNotOptimize(interleave(in.points[i])); }},
+      {"transpose", true,
+       [](Inputs const& in, std::size_t i, std::size_t dims) { doNotOptimize(transpose(in.keys[i], dims)); }},
+      {"compareWithBox", true,
+       [](Inputs const& in, std::size_t i, std::size_t dims) {
+         doNotOptimize(compareWithBox(in.keys[i], in.min, in.max, dims));
+       }},
+      {"testInBox", true,
+       [](Inputs const& in, std::size_t i, std::size_t dims) {
+         doNotOptimize(testInBox(in.keys[i], in.min, in.max, dims));
+       }},
+      // getNextZValue consumes the comparison, so both are measured together
+      {"compareWithBox+getNextZValue", true,
+       [](Inputs const& in, std::size_t i, std::size_t dims) {
+         auto cmp = compareWithBox(in.keys[i], in.min, in.max, dims);
+         bool inBox = std::all_of(cmp.begin(), cmp.end(), [](auto const& r) { return r.flag == 0; });
+         if (!inBox) {
+           doNotOptimize(getNextZValue(in.keys[i], in.min, in.max, cmp));
+         }
+       }},
+      {"to_byte_string<uint64_t>", false,
+       [](Inputs const& in, std::size_t i, std::size_t) {
+         doNotOptimize(to_byte_string_fixed_length(in.integers[i]));
+       }},
+      {"from_byte_string<uint64_t>", false,
+       [](Inputs const& in, std::size_t i, std::size_t) {
+         doNotOptimize(from_byte_string_fixed_length<uint64_t>(in.encodedIntegers[i]));
+       }},
+      {"to_byte_string<double>", false,
+       [](Inputs const& in, std::size_t i, std::size_t) {
+         doNotOptimize(to_byte_string_fixed_length(in.doubles[i]));
+       }},
+      {"from_byte_string<double>", false,
+       [](Inputs const& in, std::size_t i, std::size_t) {
+         doNotOptimize(from_byte_string_fixed_length<double>(in.encodedDoubles[i]));
+       }},
+      // four dimensions, compare with four to_byte_string<double> and interleave
+      {"Schema<Double x4>::encode", false,
+       [](Inputs const& in, std::size_t i, std::size_t) {
+         auto const v = in.doubles[i];
+         doNotOptimize(Schema<Double, Double, Double, Double>::encode({v, -v, v, -v}));
+       }},
+      // the doubles are spread over about [-5e5, 5e5]
+      {"QuantizingCodec::encodeKey", false,
+       [](Inputs const& in, std::size_t i, std::size_t) {
+         static QuantizingCodec const codec({{-5e5, 5e5, 20}});
+         doNotOptimize(codec.encodeKey({in.doubles[i]}));
+       }},
+  };
+}
+
+auto parseList(char const* str) -> std::vector<std::string> {
+  std::vector<std::string> result;
+  std::stringstream ss(str);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    result.push_back(item);
+  }
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<std::size_t> dims = {1, 2, 3, 4, 8, 16};
+  std::vector<unsigned> bits = {8, 16, 32, 64};
+  std::vector<Distribution> dists = {Distribution::UNIFORM, Distribution::CLUSTERED, Distribution::SKEWED};
+  std::string filter;
+  auto minTime = std::chrono::milliseconds{50};
+  bool csv = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto value = [&]() -> char const* {
+      if (i + 1 >= argc) {
+        std::cerr << "missing value for " << arg << std::endl;
+        std::exit(EXIT_FAILURE);
+      }
+      return argv[++i];
+    };
+    if (arg == "--filter") {
+      filter = value();
+    } else if (arg == "--dims") {
+      dims.clear();
+      for (auto const& d : parseList(value())) {
+        dims.push_back(std::stoul(d));
+      }
+    } else if (arg == "--bits") {
+      bits.clear();
+      for (auto const& b : parseList(value())) {
+        auto n = std::stoul(b);
+        if (n == 0 || n > 64 || n % 8 != 0) {
+          std::cerr << "bits must be a multiple of 8 in [8, 64]" << std::endl;
+          return EXIT_FAILURE;
+        }
+        bits.push_back(n);
+      }
+    } else if (arg == "--dist") {
+      dists.clear();
+      for (auto const& d : parseList(value())) {
+        dists.push_back(parseDistribution(d));
+      }
+    } else if (arg == "--min-time") {
+      minTime = std::chrono::milliseconds{std::stoul(value())};
+    } else if (arg == "--csv") {
+      csv = true;
+    } else {
+      std::cerr << "usage: " << argv[0]
+                << " [--filter <substring>] [--dims 1,2,4] [--bits 8,32] [--dist uniform,clustered,skewed]"
+                   " [--min-time <ms>] [--csv]"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (csv) {
+    std::cout << "kernel,dims,bits,distribution,ns_per_op,allocs_per_op,bytes_per_op" << std::endl;
+  } else {
+    std::cout << std::left << std::setw(30) << "kernel" << std::right << std::setw(5) << "dims" << std::setw(5)
+              << "bits" << std::setw(11) << "dist" << std::setw(12) << "ns/op" << std::setw(12) << "allocs/op"
+              << std::setw(12) << "bytes/op" << std::endl;
+  }
+
+  auto const all = kernels();
+  for (auto dist : dists) {
+    for (auto b : bits) {
+      for (auto d : dims) {
+        auto config = Config{d, b, dist};
+        auto inputs = makeInputs(config);
+        for (auto const& kernel : all) {
+          if (!filter.empty() && std::string_view{kernel.name}.find(filter) == std::string_view::npos) {
+            continue;
+          }
+          if (!kernel.onKeys && (d != dims.front() || b != bits.front())) {
+            continue;
+          }
+          auto m = measure([&](std::size_t i) { kernel.run(inputs, i, d); }, minTime);
+          if (csv) {
+            std::cout << kernel.name << ',' << d << ',' << b << ',' << to_string(dist) << ',' << m.nsPerOp << ','
+                      << m.allocsPerOp << ',' << m.bytesPerOp << std::endl;
+          } else {
+            std::cout << std::left << std::setw(30) << kernel.name << std::right << std::setw(5) << d
+                      << std::setw(5) << b << std::setw(11) << to_string(dist) << std::fixed << std::setprecision(1)
+                      << std::setw(12) << m.nsPerOp << std::setprecision(2) << std::setw(12) << m.allocsPerOp
+                      << std::setprecision(1) << std::setw(12) << m.bytesPerOp << std::endl;
+          }
+        }
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+#include "box-cursor.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace zkd;
+
+namespace {
+constexpr auto version = std::byte{1};
+
+void putVarint(byte_string& out, std::size_t v) {
+  while (v >= 0x80) {
+    out.push_back(std::byte(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(std::byte(v));
+}
+
+class token_reader {
+ public:
+  explicit token_reader(byte_string_view token) : _token(token) {}
+
+  auto varint() -> std::size_t {
+    std::size_t v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      auto const b = std::to_integer<std::size_t>(byte());
+      v |= (b & 0x7f) << shift;
+      if (b < 0x80) {
+        return v;
+      }
+    }
+    throw std::invalid_argument("malformed box cursor");
+  }
+
+  auto byte() -> std::byte {
+    if (_offset >= _token.size()) {
+      throw std::invalid_argument("truncated box cursor");
+    }
+    return _token[_offset++];
+  }
+
+  auto bytes() -> byte_string {
+    auto const size = varint();
+    if (size > _token.size() - _offset) {
+      throw std::invalid_argument("truncated box cursor");
+    }
+    auto result = byte_string{_token.substr(_offset, size)};
+    _offset += size;
+    return result;
+  }
+
+  auto done() const noexcept -> bool { return _offset == _token.size(); }
+
+ private:
+  byte_string_view _token;
+  std::size_t _offset = 0;
+};
+} // namespace
+
+auto zkd::serializeBoxCursor(BoxCursor const& cursor) -> byte_string {
+  byte_string token;
+  token.push_back(version);
+  putVarint(token, cursor.box.dimensions());
+  // bounded min and max, two bits per dimension
+  for (std::size_t d = 0; d < cursor.box.dimensions(); d += 4) {
+    unsigned bits = 0;
+    for (std::size_t i = d; i < std::min(d + 4, cursor.box.dimensions()); ++i) {
+      bits |= (cursor.box.mask[i].min ? 2u : 0u) << (2 * (i - d));
+      bits |= (cursor.box.mask[i].max ? 1u : 0u) << (2 * (i - d));
+    }
+    token.push_back(std::byte(bits));
+  }
+  for (auto const* part : {&cursor.box.min, &cursor.box.max, &cursor.last}) {
+    putVarint(token, part->size());
+    token.append(*part);
+  }
+  return token;
+}
+
+auto zkd::parseBoxCursor(byte_string_view token) -> BoxCursor {
+  token_reader reader(token);
+  if (reader.byte() != version) {
+    throw std::invalid_argument("unknown box cursor version");
+  }
+  BoxCursor cursor;
+  auto const dimensions = reader.varint();
+  if (dimensions == 0 || dimensions > token.size() * 4) {
+    throw std::invalid_argument("malformed box cursor");
+  }
+  cursor.box.mask.resize(dimensions);
+  for (std::size_t d = 0; d < dimensions; d += 4) {
+    auto const bits = std::to_integer<unsigned>(reader.byte());
+    for (std::size_t i = d; i < std::min(d + 4, dimensions); ++i) {
+      cursor.box.mask[i].min = (bits >> (2 * (i - d))) & 2u;
+      cursor.box.mask[i].max = (bits >> (2 * (i - d))) & 1u;
+    }
+  }
+  cursor.box.min = reader.bytes();
+  cursor.box.max = reader.bytes();
+  cursor.last = reader.bytes();
+  if (!reader.done()) {
+    throw std::invalid_argument("malformed box cursor");
+  }
+  return cursor;
+}
+
+auto zkd::keySuccessor(byte_string_view key) -> std::optional<byte_string> {
+  auto result = byte_string{key};
+  for (auto i = result.size(); i-- > 0;) {
+    if (result[i] != std::byte{0xff}) {
+      result[i] = std::byte(std::to_integer<unsigned>(result[i]) + 1);
+      return result;
+    }
+    result[i] = std::byte{0};
+  }
+  return std::nullopt;
+}
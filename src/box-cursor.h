@@ -0,0 +1,33 @@
+#ifndef ZKD_TREE_BOX_CURSOR_H
+#define ZKD_TREE_BOX_CURSOR_H
+
+#include <optional>
+
+#include "library.h"
+
+namespace zkd {
+
+/*
+ * Where a paged box query stopped: the box and the last key returned. The
+ * next page starts at the first key of the box after `last`.
+ */
+struct BoxCursor {
+  Box box;
+  byte_string last;
+};
+
+/*
+ * A compact, self-contained token for the cursor, to be handed to a client
+ * and back. It holds no handle state, so it is only meaningful for the handle
+ * (or a copy of its data) the query ran on.
+ */
+auto serializeBoxCursor(BoxCursor const& cursor) -> byte_string;
+// throws std::invalid_argument for malformed tokens
+auto parseBoxCursor(byte_string_view token) -> BoxCursor;
+
+// the smallest key of the same length greater than `key`, std::nullopt if it is all ones
+auto keySuccessor(byte_string_view key) -> std::optional<byte_string>;
+
+} // namespace zkd
+
+#endif //ZKD_TREE_BOX_CURSOR_H
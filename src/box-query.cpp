@@ -0,0 +1,790 @@
+#include "box-query.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+#include <rocksdb/iostats_context.h>
+#include <rocksdb/perf_context.h>
+#include <rocksdb/perf_level.h>
+#include <rocksdb/version.h>
+
+#include "delta-buffer.h"
+
+using namespace zkd;
+
+namespace {
+constexpr auto no_limit = std::numeric_limits<std::size_t>::max();
+
+auto sliceFromString(byte_string_view str) -> rocksdb::Slice {
+  return rocksdb::Slice(reinterpret_cast<char const*>(str.data()), str.size());
+}
+
+auto viewFromSlice(rocksdb::Slice slice) -> byte_string_view {
+  return byte_string_view{reinterpret_cast<std::byte const*>(slice.data()), slice.size()};
+}
+
+// for the iterators that seek through a box, see RocksDBOptions
+auto scanReadOptions(RocksDBHandle const& rocks) -> rocksdb::ReadOptions {
+  rocksdb::ReadOptions options;
+  options.readahead_size = rocks.readaheadSize;
+#if ROCKSDB_MAJOR > 7 || (ROCKSDB_MAJOR == 7 && ROCKSDB_MINOR >= 1)
+  options.async_io = rocks.asyncIo;
+#endif
+  return options;
+}
+
+/*
+ * a box with an optional mask of unbounded dimensions, over Z-order keys unless
+ * `hilbert` is set. With a schedule the mask is not used, the filled corners of
+ * makeBox give the same result. A scan resumed `after` a key starts behind it.
+ */
+struct box_view {
+  byte_string_view min;
+  byte_string_view max;
+  std::size_t dimensions;
+  BoxMask const* mask = nullptr;
+  HilbertBox const* hilbert = nullptr;
+  InterleaveSchedule const* schedule = nullptr;
+  std::optional<byte_string_view> after;
+
+  auto compare(byte_string_view cur) const -> std::vector<CompareResult> {
+    if (schedule != nullptr) {
+      return compareWithBox(cur, min, max, *schedule);
+    }
+    return mask != nullptr ? compareWithBox(cur, min, max, *mask) : compareWithBox(cur, min, max, dimensions);
+  }
+
+  auto contains(byte_string_view cur) const -> bool {
+    if (hilbert != nullptr) {
+      return hilbert->contains(cur);
+    }
+    if (schedule != nullptr) {
+      return testInBox(cur, min, max, *schedule);
+    }
+    return mask != nullptr ? testInBox(cur, min, max, *mask) : testInBox(cur, min, max, dimensions);
+  }
+
+  // the smallest key in the box, or after `after`
+  auto start() const -> std::optional<byte_string> {
+    if (after.has_value()) {
+      auto cur = keySuccessor(*after);
+      if (!cur || contains(*cur)) {
+        return cur;
+      }
+      return next(*cur);
+    }
+    if (hilbert != nullptr) {
+      return hilbert->first();
+    }
+    return byte_string{min};
+  }
+
+  // the next key in the box after `cur`, which must be outside of it
+  auto next(byte_string_view cur, std::optional<std::size_t>* limiting = nullptr) const
+    -> std::optional<byte_string> {
+    if (hilbert != nullptr) {
+      if (limiting != nullptr) {
+        limiting->reset();
+      }
+      return hilbert->next(cur);
+    }
+    auto cmp = compare(cur);
+    if (limiting != nullptr) {
+      *limiting = schedule != nullptr ? limitingDimension(cmp, *schedule) : limitingDimension(cmp);
+    }
+    return schedule != nullptr ? getNextZValue(cur, min, max, cmp, *schedule) : getNextZValue(cur, min, max, cmp);
+  }
+};
+
+// the box over the keys of the handle's curve, `storage` keeps the HilbertBox alive
+auto forCurve(RocksDBHandle const& rocks, box_view box, std::optional<HilbertBox>& storage) -> box_view {
+  if (rocks.curve == Curve::HILBERT) {
+    storage.emplace(box.min, box.max, box.dimensions);
+    box.hilbert = &storage.value();
+  }
+  if (rocks.schedule != nullptr) {
+    if (rocks.schedule->dimensions() != box.dimensions) {
+      throw std::invalid_argument("box does not match the interleave schedule of the handle");
+    }
+    box.schedule = rocks.schedule.get();
+  }
+  return box;
+}
+
+// runs f and adds its duration to `phase`, if profiling
+template<bool profile, typename F>
+auto timed(std::chrono::nanoseconds& phase, F&& f) -> decltype(f()) {
+  if constexpr (profile) {
+    auto const start = std::chrono::steady_clock::now();
+    struct stop_watch {
+      std::chrono::nanoseconds& phase;
+      std::chrono::steady_clock::time_point start;
+      ~stop_watch() { phase += std::chrono::steady_clock::now() - start; }
+    } watch{phase, start};
+    return f();
+  } else {
+    return f();
+  }
+}
+
+// Enables RocksDB's perf counters of this thread and reports their change.
+class StorageProfile {
+ public:
+  StorageProfile() : _level(rocksdb::GetPerfLevel()) {
+    rocksdb::SetPerfLevel(rocksdb::PerfLevel::kEnableTimeExceptForMutex);
+    _perf = *rocksdb::get_perf_context();
+    _bytesRead = rocksdb::get_iostats_context()->bytes_read;
+  }
+  ~StorageProfile() { rocksdb::SetPerfLevel(_level); }
+
+  StorageProfile(StorageProfile const&) = delete;
+  StorageProfile& operator=(StorageProfile const&) = delete;
+
+  auto delta() const -> StorageStats {
+    auto const& perf = *rocksdb::get_perf_context();
+    StorageStats stats;
+    stats.blockReads = perf.block_read_count - _perf.block_read_count;
+    stats.blockReadBytes = perf.block_read_byte - _perf.block_read_byte;
+    stats.blockCacheHits = perf.block_cache_hit_count - _perf.block_cache_hit_count;
+    stats.internalKeysSkipped = perf.internal_key_skipped_count - _perf.internal_key_skipped_count;
+    stats.internalDeletesSkipped = perf.internal_delete_skipped_count - _perf.internal_delete_skipped_count;
+    stats.bytesRead = rocksdb::get_iostats_context()->bytes_read - _bytesRead;
+    stats.blockReadTime = std::chrono::nanoseconds(perf.block_read_time - _perf.block_read_time);
+    return stats;
+  }
+
+ private:
+  rocksdb::PerfLevel _level;
+  rocksdb::PerfContext _perf;
+  std::uint64_t _bytesRead;
+};
+
+/*
+ * `epoch` of the cache must have been read before the iterator was created, see
+ * EmptyIntervalCache. Stops after `limit` keys were returned.
+ */
+template<bool profile>
+auto scanIterator(rocksdb::Iterator* iter, EmptyIntervalCache* cache, std::uint64_t epoch, box_view const& box,
+                  BoxQueryCallback const& callback, QueryStats& stats, QueryTrace* trace,
+                  std::size_t limit = no_limit) -> std::size_t {
+  std::size_t num_seeks = 0;
+  // counted locally and published once, the loop is hot
+  std::size_t nexts = 0, examined = 0, returned = 0;
+  QueryPhaseTimes phases;
+  // how the next seek target was found, for the trace
+  std::optional<std::size_t> limiting;
+  std::size_t cacheSkips = 0;
+  std::size_t returnedBeforeSeek = 0;
+  auto const endRun = [&] {
+    if (trace != nullptr && !trace->steps.empty()) {
+      trace->steps.back().run = returned - returnedBeforeSeek;
+    }
+  };
+  auto const publish = [&] {
+    endRun();
+    stats.seeks += num_seeks;
+    stats.nexts += nexts;
+    stats.keysExamined += examined;
+    stats.keysReturned += returned;
+    stats.phases += phases;
+    return num_seeks;
+  };
+  auto const contains = [&](byte_string_view key) {
+    return timed<profile>(phases.compare, [&] { return box.contains(key); });
+  };
+  auto const nextKey = [&](byte_string_view key) {
+    return timed<profile>(phases.nextZValue, [&] { return box.next(key, trace != nullptr ? &limiting : nullptr); });
+  };
+
+  if (limit == 0) {
+    return publish();
+  }
+  auto start = timed<profile>(phases.nextZValue, [&] { return box.start(); });
+  if (!start) {
+    return publish();
+  }
+  byte_string cur = std::move(start.value());
+
+  while (true) {
+    if (cache != nullptr) {
+      // jump over known empty intervals without touching the storage
+      while (auto interval = timed<profile>(phases.cacheLookup, [&] { return cache->lookup(cur); })) {
+        cacheSkips += 1;
+        if (!interval->end.has_value()) {
+          return publish();
+        }
+        cur = std::move(interval->end.value());
+        limiting.reset();
+        if (contains(cur)) {
+          break;
+        }
+        auto next = nextKey(cur);
+        if (!next) {
+          return publish();
+        }
+        cur = std::move(next.value());
+      }
+    }
+
+    if (trace != nullptr) {
+      endRun();
+      trace->steps.push_back(TraceStep{cur, std::nullopt, 0, limiting, cacheSkips});
+      returnedBeforeSeek = returned;
+      cacheSkips = 0;
+    }
+    timed<profile>(phases.seek, [&] { iter->Seek(sliceFromString(cur)); });
+    num_seeks += 1;
+    auto s = iter->status();
+    if (!s.ok()) {
+      throw std::runtime_error(s.ToString());
+    }
+    if (trace != nullptr && iter->Valid()) {
+      trace->steps.back().landed = byte_string{viewFromSlice(iter->key())};
+    }
+    if (!iter->Valid()) {
+      if (cache != nullptr) {
+        cache->insert(cur, std::nullopt, epoch);
+      }
+      break;
+    }
+
+    auto key = viewFromSlice(iter->key());
+    examined += 1;
+    if (!contains(key)) {
+      // the seek was wasted, remember the gap for the next query
+      if (cache != nullptr) {
+        cache->insert(cur, key, epoch);
+      }
+    } else {
+      while (true) {
+        timed<profile>(phases.callback, [&] { callback(key, viewFromSlice(iter->value())); });
+        returned += 1;
+        if (returned >= limit) {
+          return publish();
+        }
+        timed<profile>(phases.next, [&] { iter->Next(); });
+        nexts += 1;
+        if (!iter->Valid()) {
+          s = iter->status();
+          if (!s.ok()) {
+            throw std::runtime_error(s.ToString());
+          }
+          return publish();
+        }
+        key = viewFromSlice(iter->key());
+        examined += 1;
+        if (!contains(key)) {
+          break;
+        }
+      }
+    }
+
+    cur = key;
+    auto next = nextKey(cur);
+    if (!next) {
+      break;
+    }
+
+    cur = std::move(next.value());
+  }
+
+  return publish();
+}
+
+template<bool profile>
+auto scanBox(RocksDBHandle& rocks, box_view const& box, BoxQueryCallback const& callback, QueryStats& stats,
+             QueryTrace* trace, std::size_t limit = no_limit) -> std::size_t {
+  auto* const cache = rocks.emptyIntervals.get();
+  auto const epoch = cache != nullptr ? cache->epoch() : 0;
+  auto iter = newMergedIterator(rocks, scanReadOptions(rocks));
+  return scanIterator<profile>(iter.get(), cache, epoch, box, callback, stats, trace, limit);
+}
+
+auto scanBox(RocksDBHandle& rocks, box_view const& box, BoxQueryCallback const& callback, QueryStats& stats,
+             bool profile, std::size_t limit) -> std::size_t {
+  return profile ? scanBox<true>(rocks, box, callback, stats, nullptr, limit)
+                 : scanBox<false>(rocks, box, callback, stats, nullptr, limit);
+}
+
+auto traceBoxQueryImpl(RocksDBHandle& rocks, box_view box, BoxQueryCallback const& callback) -> QueryTrace {
+  std::optional<HilbertBox> hilbert;
+  box = forCurve(rocks, box, hilbert);
+
+  QueryTrace trace;
+  trace.min = byte_string{box.min};
+  trace.max = byte_string{box.max};
+  trace.dimensions = box.dimensions;
+  trace.stats.queries = 1;
+  scanBox<false>(rocks, box, callback, trace.stats, &trace);
+  return trace;
+}
+
+// a result cut short by `limit` is not cached, nor is one resumed after a key
+auto findCachedInBox(RocksDBHandle& rocks, box_view const& box, BoxQueryCallback const& callback, QueryStats& stats,
+                     bool profile, std::size_t limit) -> std::size_t {
+  auto* const resultCache = rocks.resultCache.get();
+  // buffered writes don't change the sequence number, but flushing them does
+  bool const buffered = rocks.deltaBuffer != nullptr && !rocks.deltaBuffer->empty();
+  if (resultCache == nullptr || box.after.has_value() || buffered) {
+    return scanBox(rocks, box, callback, stats, profile, limit);
+  }
+
+  // read before the iterator is created, so the cached result is never newer than its sequence number
+  auto const sequence = rocks.db->GetLatestSequenceNumber();
+  if (auto hit = resultCache->lookup(box.min, box.max, box.dimensions, sequence)) {
+    auto const count = std::min(hit->size(), limit);
+    for (std::size_t i = 0; i < count; ++i) {
+      callback((*hit)[i].first, (*hit)[i].second);
+    }
+    stats.keysReturned += count;
+    return 0;
+  }
+
+  BoxResultCache::results results;
+  std::size_t bytes = 0;
+  std::size_t returned = 0;
+  bool cacheable = true;
+  auto num_seeks = scanBox(rocks, box, [&](byte_string_view key, byte_string_view value) {
+    callback(key, value);
+    returned += 1;
+    if (cacheable) {
+      bytes += BoxResultCache::memoryUsage(key, value);
+      if (bytes > resultCache->capacity()) {
+        // will not fit anyway, stop collecting
+        cacheable = false;
+        results = {};
+      } else {
+        results.emplace_back(key, value);
+      }
+    }
+  }, stats, profile, limit);
+  // the scan may have stopped short of the end of the box
+  if (cacheable && returned < limit) {
+    resultCache->insert(box.min, box.max, box.dimensions, sequence, std::move(results));
+  }
+  return num_seeks;
+}
+
+auto findAllInBoxImpl(RocksDBHandle& rocks, box_view box, BoxQueryCallback const& callback, QueryStats& stats,
+                      std::size_t limit = no_limit) -> std::size_t {
+  std::optional<HilbertBox> hilbert;
+  box = forCurve(rocks, box, hilbert);
+
+  auto* const sampler = rocks.queryStats.get();
+  if (sampler == nullptr) {
+    stats.queries += 1;
+    return findCachedInBox(rocks, box, callback, stats, false, limit);
+  }
+
+  QueryStats local;
+  local.queries = 1;
+  std::size_t num_seeks;
+  if (sampler->sample()) {
+    StorageProfile profile;
+    num_seeks = findCachedInBox(rocks, box, callback, local, true, limit);
+    local.profiledQueries = 1;
+    local.storage = profile.delta();
+  } else {
+    num_seeks = findCachedInBox(rocks, box, callback, local, false, limit);
+  }
+  sampler->record(local);
+  stats += local;
+  return num_seeks;
+}
+
+auto findPageImpl(RocksDBHandle& rocks, Box const& box, std::optional<byte_string_view> after, std::size_t pageSize,
+                  BoxQueryCallback const& callback, QueryStats& stats) -> std::optional<BoxCursor> {
+  if (pageSize == 0) {
+    throw std::invalid_argument("pages must hold at least one key");
+  }
+  box_view view{box.min, box.max, box.dimensions(), &box.mask};
+  view.after = after;
+  std::size_t returned = 0;
+  byte_string last;
+  findAllInBoxImpl(rocks, view, [&](byte_string_view key, byte_string_view value) {
+    callback(key, value);
+    returned += 1;
+    if (returned == pageSize) {
+      last = key;
+    }
+  }, stats, pageSize);
+  if (returned < pageSize) {
+    return std::nullopt;
+  }
+  return BoxCursor{box, std::move(last)};
+}
+
+void findAllInBoxSlowImpl(RocksDBHandle& rocks, box_view box, BoxQueryCallback const& callback) {
+  std::optional<HilbertBox> hilbert;
+  box = forCurve(rocks, box, hilbert);
+
+  auto iter = newMergedIterator(rocks, rocksdb::ReadOptions{});
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    auto key = viewFromSlice(iter->key());
+    if (box.contains(key)) {
+      callback(key, viewFromSlice(iter->value()));
+    }
+  }
+  auto s = iter->status();
+  if (!s.ok()) {
+    throw std::runtime_error(s.ToString());
+  }
+}
+} // namespace
+
+auto zkd::findAllInBox(RocksDBHandle& rocks, byte_string_view min, byte_string_view max, std::size_t dimensions,
+                       BoxQueryCallback const& callback) -> std::size_t {
+  QueryStats stats;
+  return findAllInBoxImpl(rocks, box_view{min, max, dimensions}, callback, stats);
+}
+
+auto zkd::findAllInBox(RocksDBHandle& rocks, Box const& box, BoxQueryCallback const& callback) -> std::size_t {
+  QueryStats stats;
+  return findAllInBox(rocks, box, callback, stats);
+}
+
+auto zkd::findAllInBox(RocksDBHandle& rocks, byte_string_view min, byte_string_view max, std::size_t dimensions,
+                       BoxQueryCallback const& callback, QueryStats& stats) -> std::size_t {
+  return findAllInBoxImpl(rocks, box_view{min, max, dimensions}, callback, stats);
+}
+
+auto zkd::findAllInBox(RocksDBHandle& rocks, Box const& box, BoxQueryCallback const& callback, QueryStats& stats)
+  -> std::size_t {
+  return findAllInBoxImpl(rocks, box_view{box.min, box.max, box.dimensions(), &box.mask}, callback, stats);
+}
+
+auto zkd::findAllInBox(RocksDBHandle& rocks, QuantizedBox const& box, BoxQueryCallback const& callback) -> std::size_t {
+  QueryStats stats;
+  return findAllInBox(rocks, box, callback, stats);
+}
+
+auto zkd::findAllInBox(RocksDBHandle& rocks, QuantizedBox const& box, BoxQueryCallback const& callback,
+                       QueryStats& stats) -> std::size_t {
+  return findAllInBox(rocks, box.box, [&](byte_string_view key, byte_string_view value) {
+    if (box.matches(key, value)) {
+      callback(key, value);
+    }
+  }, stats);
+}
+
+auto zkd::findFirstInBox(RocksDBHandle& rocks, Box const& box, std::size_t limit, BoxQueryCallback const& callback)
+  -> std::size_t {
+  QueryStats stats;
+  return findFirstInBox(rocks, box, limit, callback, stats);
+}
+
+auto zkd::findFirstInBox(RocksDBHandle& rocks, Box const& box, std::size_t limit, BoxQueryCallback const& callback,
+                         QueryStats& stats) -> std::size_t {
+  return findAllInBoxImpl(rocks, box_view{box.min, box.max, box.dimensions(), &box.mask}, callback, stats, limit);
+}
+
+auto zkd::findPageInBox(RocksDBHandle& rocks, Box const& box, std::size_t pageSize, BoxQueryCallback const& callback)
+  -> std::optional<BoxCursor> {
+  QueryStats stats;
+  return findPageInBox(rocks, box, pageSize, callback, stats);
+}
+
+auto zkd::findPageInBox(RocksDBHandle& rocks, Box const& box, std::size_t pageSize, BoxQueryCallback const& callback,
+                        QueryStats& stats) -> std::optional<BoxCursor> {
+  return findPageImpl(rocks, box, std::nullopt, pageSize, callback, stats);
+}
+
+auto zkd::findPageInBox(RocksDBHandle& rocks, BoxCursor const& cursor, std::size_t pageSize,
+                        BoxQueryCallback const& callback) -> std::optional<BoxCursor> {
+  QueryStats stats;
+  return findPageInBox(rocks, cursor, pageSize, callback, stats);
+}
+
+auto zkd::findPageInBox(RocksDBHandle& rocks, BoxCursor const& cursor, std::size_t pageSize,
+                        BoxQueryCallback const& callback, QueryStats& stats) -> std::optional<BoxCursor> {
+  return findPageImpl(rocks, cursor.box, cursor.last, pageSize, callback, stats);
+}
+
+auto zkd::sampleInBox(RocksDBHandle& rocks, Box const& box, std::size_t count, BoxQueryCallback const& callback)
+  -> std::size_t {
+  QueryStats stats;
+  return sampleInBox(rocks, box, count, callback, stats);
+}
+
+auto zkd::sampleInBox(RocksDBHandle& rocks, Box const& box, std::size_t count, BoxQueryCallback const& callback,
+                      QueryStats& stats) -> std::size_t {
+  if (rocks.curve != Curve::Z_ORDER || rocks.schedule != nullptr) {
+    throw std::invalid_argument("sampling requires round robin Z-order keys");
+  }
+  stats.queries += 1;
+  auto const length = std::max(box.min.size(), box.max.size());
+  auto const cover = coverBox(box.min, box.max, box.dimensions(), unsigned(8 * length),
+                              std::max<std::size_t>(count, 16));
+  if (count == 0 || cover.intervals.empty()) {
+    return 0;
+  }
+
+  // volumes in units of the leading 64 bits of the keys
+  auto const leadingWord = [](byte_string_view key, std::byte fill) {
+    std::uint64_t word = 0;
+    for (std::size_t i = 0; i < 8; ++i) {
+      word = (word << 8) | std::to_integer<std::uint64_t>(i < key.size() ? key[i] : fill);
+    }
+    return word;
+  };
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> words;
+  long double total = 0;
+  for (auto const& interval : cover.intervals) {
+    auto const lo = leadingWord(interval.lo, std::byte{0});
+    auto const hi = leadingWord(interval.hi, std::byte{0xff});
+    words.emplace_back(lo, hi);
+    total += static_cast<long double>(hi - lo) + 1;
+  }
+
+  // probe points at the start of the strata, in key order, so every key of the box is in one
+  std::vector<byte_string> probes;
+  probes.reserve(count);
+  std::size_t interval = 0;
+  long double before = 0; // volume of the intervals before `interval`
+  for (std::size_t k = 0; k < count; ++k) {
+    auto const position = static_cast<long double>(k) * total / static_cast<long double>(count);
+    while (interval + 1 < words.size() &&
+           position >= before + static_cast<long double>(words[interval].second - words[interval].first) + 1) {
+      before += static_cast<long double>(words[interval].second - words[interval].first) + 1;
+      interval += 1;
+    }
+    auto const [lo, hi] = words[interval];
+    auto const offset = static_cast<std::uint64_t>(std::max<long double>(position - before, 0));
+    auto const word = offset > hi - lo ? hi : lo + offset;
+    auto probe = to_byte_string_fixed_length<std::uint64_t>(word);
+    probe.resize(length, std::byte{0});
+    probes.push_back(std::max(std::move(probe), cover.intervals[interval].lo));
+  }
+
+  box_view const view{box.min, box.max, box.dimensions(), &box.mask};
+  auto iter = newMergedIterator(rocks, scanReadOptions(rocks));
+  std::size_t num_seeks = 0, examined = 0;
+
+  struct Stratum {
+    std::vector<std::pair<byte_string, byte_string>> keys;
+    bool exhausted = false;
+  };
+  std::vector<Stratum> strata(count);
+  auto lastStratum = count; // strata from here on have no keys after the ones they already have
+
+  // adds keys of stratum k, continuing after the ones it already has, until it has `quota` of them
+  auto const scan = [&](std::size_t k, std::size_t quota) {
+    auto& stratum = strata[k];
+    if (k >= lastStratum) {
+      stratum.exhausted = true;
+    }
+    if (stratum.exhausted || stratum.keys.size() >= quota) {
+      return;
+    }
+    auto const* const end = k + 1 < count ? &probes[k + 1] : nullptr;
+    std::optional<byte_string> target = probes[k];
+    if (!stratum.keys.empty()) {
+      target = keySuccessor(stratum.keys.back().first);
+      if (target && !view.contains(*target)) {
+        target = view.next(*target);
+      }
+    }
+    while (true) {
+      if (!target || (end != nullptr && byte_string_view{*target} >= byte_string_view{*end})) {
+        stratum.exhausted = true;
+        return;
+      }
+      iter->Seek(sliceFromString(*target));
+      num_seeks += 1;
+      for (; iter->Valid() && stratum.keys.size() < quota; iter->Next()) {
+        auto const key = viewFromSlice(iter->key());
+        examined += 1;
+        if (end != nullptr && key >= byte_string_view{*end}) {
+          stratum.exhausted = true;
+          return;
+        }
+        if (!view.contains(key)) {
+          break;
+        }
+        stratum.keys.emplace_back(key, viewFromSlice(iter->value()));
+      }
+      if (stratum.keys.size() >= quota) {
+        return;
+      }
+      if (!iter->Valid()) {
+        auto s = iter->status();
+        if (!s.ok()) {
+          throw std::runtime_error(s.ToString());
+        }
+        stratum.exhausted = true;
+        lastStratum = std::min(lastStratum, k);
+        return;
+      }
+      target = view.next(viewFromSlice(iter->key()));
+    }
+  };
+
+  // each stratum takes one key, the share of strata that come up short moves on to the next ones
+  std::size_t taken = 0;
+  for (std::size_t k = 0; k < count; ++k) {
+    scan(k, k + 1 - taken);
+    taken += strata[k].keys.size();
+  }
+  // the share left by the last strata goes to the earlier ones, so a box with
+  // fewer than `count` keys returns all of them
+  for (std::size_t k = 0; k < count && taken < count; ++k) {
+    auto const before = strata[k].keys.size();
+    scan(k, before + count - taken);
+    taken += strata[k].keys.size() - before;
+  }
+
+  std::size_t returned = 0;
+  for (auto const& stratum : strata) {
+    for (auto const& [key, value] : stratum.keys) {
+      callback(key, value);
+      returned += 1;
+    }
+  }
+  stats.seeks += num_seeks;
+  stats.keysExamined += examined;
+  stats.keysReturned += returned;
+  return num_seeks;
+}
+
+auto zkd::findAllInRegion(RocksDBHandle& rocks, Region const& region, std::size_t keySize, std::size_t maxIntervals,
+                          BoxQueryCallback const& callback) -> std::size_t {
+  QueryStats stats;
+  return findAllInRegion(rocks, region, keySize, maxIntervals, callback, stats);
+}
+
+auto zkd::findAllInRegion(RocksDBHandle& rocks, Region const& region, std::size_t keySize, std::size_t maxIntervals,
+                          BoxQueryCallback const& callback, QueryStats& stats) -> std::size_t {
+  if (rocks.curve != Curve::Z_ORDER) {
+    throw std::invalid_argument("region queries require Z-order keys");
+  }
+  auto const* const schedule = rocks.schedule.get();
+  auto const intervals = coverRegion(region, keySize, schedule, maxIntervals);
+  stats.queries += 1;
+
+  auto iter = newMergedIterator(rocks, scanReadOptions(rocks));
+  std::size_t num_seeks = 0, nexts = 0, examined = 0, returned = 0;
+  for (auto const& [interval, exact] : intervals) {
+    // the previous interval may have ended on a key of this one
+    if (!iter->Valid() || viewFromSlice(iter->key()) < byte_string_view{interval.lo}) {
+      iter->Seek(sliceFromString(interval.lo));
+      num_seeks += 1;
+    }
+    for (; iter->Valid(); iter->Next(), nexts += 1) {
+      auto const key = viewFromSlice(iter->key());
+      if (key > byte_string_view{interval.hi}) {
+        break;
+      }
+      examined += 1;
+      if (exact || region.contains(regionCoordinates(key, region.dimensions(), schedule))) {
+        callback(key, viewFromSlice(iter->value()));
+        returned += 1;
+      }
+    }
+    auto s = iter->status();
+    if (!s.ok()) {
+      throw std::runtime_error(s.ToString());
+    }
+    if (!iter->Valid()) {
+      break;
+    }
+  }
+  stats.seeks += num_seeks;
+  stats.nexts += nexts;
+  stats.keysExamined += examined;
+  stats.keysReturned += returned;
+  return num_seeks;
+}
+
+auto zkd::findAllInBoxBatched(RocksDBHandle& rocks, Box const& box, std::size_t batchSize,
+                              BatchCallback const& callback) -> std::size_t {
+  QueryStats stats;
+  return findAllInBoxBatched(rocks, box, batchSize, callback, stats);
+}
+
+auto zkd::findAllInBoxBatched(RocksDBHandle& rocks, Box const& box, std::size_t batchSize,
+                              BatchCallback const& callback, QueryStats& stats) -> std::size_t {
+  if (rocks.curve != Curve::Z_ORDER) {
+    throw std::invalid_argument("columnar results require Z-order keys");
+  }
+  ResultBatch batch(box.dimensions(), batchSize, rocks.schedule.get());
+  auto num_seeks = findAllInBox(rocks, box, [&](byte_string_view key, byte_string_view value) {
+    batch.add(key, value);
+    if (batch.full()) {
+      callback(batch);
+      batch.clear();
+    }
+  }, stats);
+  if (!batch.empty()) {
+    callback(batch);
+  }
+  return num_seeks;
+}
+
+auto zkd::findAllInBox(rocksdb::Iterator& iter, Box const& box, InterleaveSchedule const* schedule,
+                       BoxQueryCallback const& callback, QueryStats& stats) -> std::size_t {
+  box_view view{box.min, box.max, box.dimensions(), &box.mask};
+  if (schedule != nullptr) {
+    if (schedule->dimensions() != view.dimensions) {
+      throw std::invalid_argument("box does not match the interleave schedule");
+    }
+    view.schedule = schedule;
+  }
+  stats.queries += 1;
+  return scanIterator<false>(&iter, nullptr, 0, view, callback, stats, nullptr);
+}
+
+auto zkd::findAllInIntervals(RocksDBHandle& rocks, std::vector<ZInterval> const& intervals, byte_string_view min,
+                             byte_string_view max, std::size_t dimensions, BoxQueryCallback const& callback) -> std::size_t {
+  if (rocks.curve != Curve::Z_ORDER || rocks.schedule != nullptr) {
+    throw std::invalid_argument("interval scans require round robin Z-order keys");
+  }
+  auto iter = newMergedIterator(rocks, scanReadOptions(rocks));
+  std::size_t num_seeks = 0;
+
+  for (auto const& interval : intervals) {
+    // the previous scan may already have stopped at or behind the start of this interval
+    if (!iter->Valid() || viewFromSlice(iter->key()) < interval.lo) {
+      iter->Seek(sliceFromString(interval.lo));
+      num_seeks += 1;
+    }
+    for (; iter->Valid(); iter->Next()) {
+      auto key = viewFromSlice(iter->key());
+      if (interval.hi < key) {
+        break;
+      }
+      if (testInBox(key, min, max, dimensions)) {
+        callback(key, viewFromSlice(iter->value()));
+      }
+    }
+    auto s = iter->status();
+    if (!s.ok()) {
+      throw std::runtime_error(s.ToString());
+    }
+    if (!iter->Valid()) {
+      break;
+    }
+  }
+
+  return num_seeks;
+}
+
+auto zkd::traceBoxQuery(RocksDBHandle& rocks, byte_string_view min, byte_string_view max, std::size_t dimensions,
+                        BoxQueryCallback const& callback) -> QueryTrace {
+  return traceBoxQueryImpl(rocks, box_view{min, max, dimensions}, callback);
+}
+
+auto zkd::traceBoxQuery(RocksDBHandle& rocks, Box const& box, BoxQueryCallback const& callback) -> QueryTrace {
+  return traceBoxQueryImpl(rocks, box_view{box.min, box.max, box.dimensions(), &box.mask}, callback);
+}
+
+void zkd::findAllInBoxSlow(RocksDBHandle& rocks, byte_string_view min, byte_string_view max, std::size_t dimensions,
+                           BoxQueryCallback const& callback) {
+  findAllInBoxSlowImpl(rocks, box_view{min, max, dimensions}, callback);
+}
+
+void zkd::findAllInBoxSlow(RocksDBHandle& rocks, Box const& box, BoxQueryCallback const& callback) {
+  findAllInBoxSlowImpl(rocks, box_view{box.min, box.max, box.dimensions(), &box.mask}, callback);
+}
@@ -0,0 +1,160 @@
+#ifndef ZKD_TREE_BOX_QUERY_H
+#define ZKD_TREE_BOX_QUERY_H
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "box-cursor.h"
+#include "library.h"
+#include "quantizing-codec.h"
+#include "query-stats.h"
+#include "query-trace.h"
+#include "region.h"
+#include "result-batch.h"
+#include "rocksdb-handle.h"
+
+namespace zkd {
+
+using BoxQueryCallback = std::function<void(byte_string_view key, byte_string_view value)>;
+
+/*
+ * Calls `callback` for every key in the box [min, max], in key order. `min` and
+ * `max` are the interleaved corners of the box, also if the handle's keys are
+ * encoded with the Hilbert curve. If the handle has an InterleaveSchedule, they
+ * must be interleaved with it. Returns the number of seeks.
+ *
+ * If the handle has a BoxResultCache, a result that is still valid for the
+ * latest sequence number is replayed from it without accessing the database,
+ * and 0 seeks are reported.
+ *
+ * If the handle has an EmptyIntervalCache, it is consulted before each seek and
+ * learns the intervals skipped by seeks that landed outside of the box.
+ *
+ * If the handle has a DeltaBuffer, its keys are merged into the scan, and the
+ * BoxResultCache is bypassed while it holds any.
+ *
+ * If the handle has a QueryStatsSampler, the QueryStats of the query are recorded in it.
+ */
+auto findAllInBox(RocksDBHandle& rocks, byte_string_view min, byte_string_view max, std::size_t dimensions,
+                  BoxQueryCallback const& callback) -> std::size_t;
+// Same for a box that may be unbounded in some dimensions, see makeBox.
+auto findAllInBox(RocksDBHandle& rocks, Box const& box, BoxQueryCallback const& callback) -> std::size_t;
+/*
+ * Same, and adds the work done by the query to `stats`. Phase times and storage
+ * counters are only filled if the handle's QueryStatsSampler picked the query.
+ */
+auto findAllInBox(RocksDBHandle& rocks, byte_string_view min, byte_string_view max, std::size_t dimensions,
+                  BoxQueryCallback const& callback, QueryStats& stats) -> std::size_t;
+auto findAllInBox(RocksDBHandle& rocks, Box const& box, BoxQueryCallback const& callback, QueryStats& stats)
+  -> std::size_t;
+
+/*
+ * Same for a box of a QuantizingCodec; the handle must use the codec's
+ * schedule. Keys in the border cells of the box are only passed to `callback`
+ * if their fine cells are inside of it, see QuantizedBox::matches. The
+ * keys returned in `stats` include those that failed this check.
+ */
+auto findAllInBox(RocksDBHandle& rocks, QuantizedBox const& box, BoxQueryCallback const& callback) -> std::size_t;
+auto findAllInBox(RocksDBHandle& rocks, QuantizedBox const& box, BoxQueryCallback const& callback, QueryStats& stats)
+  -> std::size_t;
+
+/*
+ * findAllInBox that stops as soon as `limit` keys were passed to `callback`,
+ * i.e. returns the first `limit` keys of the box in key order. A result cut
+ * short is not put into the handle's BoxResultCache.
+ */
+auto findFirstInBox(RocksDBHandle& rocks, Box const& box, std::size_t limit, BoxQueryCallback const& callback)
+  -> std::size_t;
+auto findFirstInBox(RocksDBHandle& rocks, Box const& box, std::size_t limit, BoxQueryCallback const& callback,
+                    QueryStats& stats) -> std::size_t;
+
+/*
+ * Pagination without server side state: returns the first `pageSize` keys of
+ * the box, and a cursor to pass in for the next page, see serializeBoxCursor.
+ * Resuming seeks right behind the last key of the cursor, so every page costs
+ * about the same. Returns std::nullopt after the last page; a cursor is
+ * returned for a page that happens to end the box exactly, its next page is
+ * empty. Pages are read at different times, so they may see different
+ * versions of the data. Results of resumed queries are not cached.
+ */
+auto findPageInBox(RocksDBHandle& rocks, Box const& box, std::size_t pageSize, BoxQueryCallback const& callback)
+  -> std::optional<BoxCursor>;
+auto findPageInBox(RocksDBHandle& rocks, Box const& box, std::size_t pageSize, BoxQueryCallback const& callback,
+                   QueryStats& stats) -> std::optional<BoxCursor>;
+auto findPageInBox(RocksDBHandle& rocks, BoxCursor const& cursor, std::size_t pageSize, BoxQueryCallback const& callback)
+  -> std::optional<BoxCursor>;
+auto findPageInBox(RocksDBHandle& rocks, BoxCursor const& cursor, std::size_t pageSize, BoxQueryCallback const& callback,
+                   QueryStats& stats) -> std::optional<BoxCursor>;
+
+/*
+ * Calls `callback` for up to `count` keys spread over the box, in key order.
+ * The box is covered with Z-intervals (see coverBox), which are cut into
+ * `count` strata of equal volume; each stratum contributes its first key in
+ * the box. The share of strata with fewer keys is taken by the following
+ * strata, and what is left at the end by the earlier ones, so fewer than
+ * `count` keys are only returned if the box has no more. The sample is
+ * collected before `callback` is called. The cost depends on `count`, not on
+ * the number of keys in the box. Requires round robin Z-order keys; no caches
+ * are used. Returns the number of seeks.
+ */
+auto sampleInBox(RocksDBHandle& rocks, Box const& box, std::size_t count, BoxQueryCallback const& callback)
+  -> std::size_t;
+auto sampleInBox(RocksDBHandle& rocks, Box const& box, std::size_t count, BoxQueryCallback const& callback,
+                 QueryStats& stats) -> std::size_t;
+
+/*
+ * Calls `callback` for every key inside of the region, in key order. Instead
+ * of the bounding box, only the intervals of coverRegion with up to
+ * `maxIntervals` intervals are scanned, and keys in intervals on the border of
+ * the region are checked with Region::contains. `keySize` is the length of the
+ * keys in bytes. Requires Z-order keys; no caches are used. Returns the number
+ * of seeks.
+ */
+auto findAllInRegion(RocksDBHandle& rocks, Region const& region, std::size_t keySize, std::size_t maxIntervals,
+                     BoxQueryCallback const& callback) -> std::size_t;
+auto findAllInRegion(RocksDBHandle& rocks, Region const& region, std::size_t keySize, std::size_t maxIntervals,
+                     BoxQueryCallback const& callback, QueryStats& stats) -> std::size_t;
+
+/*
+ * Same, with the results in columnar batches of up to `batchSize` rows, see
+ * ResultBatch. The batch is reused for the whole query, so it is only valid
+ * until `callback` returns. Requires Z-order keys.
+ */
+auto findAllInBoxBatched(RocksDBHandle& rocks, Box const& box, std::size_t batchSize, BatchCallback const& callback)
+  -> std::size_t;
+auto findAllInBoxBatched(RocksDBHandle& rocks, Box const& box, std::size_t batchSize, BatchCallback const& callback,
+                         QueryStats& stats) -> std::size_t;
+
+/*
+ * Runs the box query over any iterator of Z-order keys, interleaved with
+ * `schedule` if it is set, e.g. over a SnapshotIterator. No caches are used.
+ */
+auto findAllInBox(rocksdb::Iterator& iter, Box const& box, InterleaveSchedule const* schedule,
+                  BoxQueryCallback const& callback, QueryStats& stats) -> std::size_t;
+
+/*
+ * Scans the given sorted, disjoint intervals (e.g. from coverBox) and calls
+ * `callback` for every key in them that is inside of the box [min, max].
+ * Returns the number of seeks. Requires Z-order keys.
+ */
+auto findAllInIntervals(RocksDBHandle& rocks, std::vector<ZInterval> const& intervals, byte_string_view min,
+                        byte_string_view max, std::size_t dimensions, BoxQueryCallback const& callback) -> std::size_t;
+
+/*
+ * Runs the box query like findAllInBox and records every seek, see QueryTrace.
+ * The BoxResultCache is bypassed, an EmptyIntervalCache is used as usual.
+ */
+auto traceBoxQuery(RocksDBHandle& rocks, byte_string_view min, byte_string_view max, std::size_t dimensions,
+                   BoxQueryCallback const& callback) -> QueryTrace;
+auto traceBoxQuery(RocksDBHandle& rocks, Box const& box, BoxQueryCallback const& callback) -> QueryTrace;
+
+// Reference implementation: scans all keys and filters them with testInBox.
+void findAllInBoxSlow(RocksDBHandle& rocks, byte_string_view min, byte_string_view max, std::size_t dimensions,
+                      BoxQueryCallback const& callback);
+void findAllInBoxSlow(RocksDBHandle& rocks, Box const& box, BoxQueryCallback const& callback);
+
+} // namespace zkd
+
+#endif //ZKD_TREE_BOX_QUERY_H
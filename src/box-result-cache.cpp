@@ -0,0 +1,117 @@
+#include "box-result-cache.h"
+
+#include <iostream>
+#include <string_view>
+
+using namespace zkd;
+
+zkd::BoxResultCache::BoxResultCache(std::size_t capacity) : _capacity(capacity) {}
+
+auto zkd::BoxResultCache::view_hash::operator()(byte_string_view v) const noexcept -> std::size_t {
+  return std::hash<std::string_view>()(std::string_view{reinterpret_cast<char const*>(v.data()), v.size()});
+}
+
+auto zkd::BoxResultCache::memoryUsage(byte_string_view key, byte_string_view value) -> std::size_t {
+  return key.size() + value.size() + sizeof(results::value_type);
+}
+
+auto zkd::BoxResultCache::makeKey(byte_string_view min, byte_string_view max, std::size_t dimensions) -> byte_string {
+  // min and max are not necessarily of the same length, so store the length of min
+  byte_string key;
+  key.reserve(2 * sizeof(std::uint32_t) + min.size() + max.size());
+  for (auto v : {std::uint32_t(dimensions), std::uint32_t(min.size())}) {
+    for (std::size_t i = 0; i < sizeof(v); i++) {
+      key.push_back(std::byte(v >> (8 * i)));
+    }
+  }
+  key += min;
+  key += max;
+  return key;
+}
+
+auto zkd::BoxResultCache::lookup(byte_string_view min, byte_string_view max, std::size_t dimensions, std::uint64_t sequence)
+  -> std::shared_ptr<results const> {
+  auto const key = makeKey(min, max, dimensions);
+
+  std::unique_lock guard(_mutex);
+  auto it = _index.find(key);
+  if (it == _index.end()) {
+    _stats.misses += 1;
+    return nullptr;
+  }
+  if (it->second->sequence != sequence) {
+    _stats.stale += 1;
+    _stats.misses += 1;
+    erase(it->second);
+    return nullptr;
+  }
+
+  _stats.hits += 1;
+  _lru.splice(_lru.begin(), _lru, it->second);
+  return it->second->values;
+}
+
+void zkd::BoxResultCache::insert(byte_string_view min, byte_string_view max, std::size_t dimensions, std::uint64_t sequence,
+                                 results&& values) {
+  auto key = makeKey(min, max, dimensions);
+  auto bytes = key.size() + sizeof(entry);
+  for (auto const& [k, v] : values) {
+    bytes += memoryUsage(k, v);
+  }
+
+  std::unique_lock guard(_mutex);
+  if (bytes > _capacity) {
+    _stats.rejected += 1;
+    return;
+  }
+  if (auto it = _index.find(key); it != _index.end()) {
+    if (it->second->sequence >= sequence) {
+      // a concurrent query already stored a result that is at least as new
+      return;
+    }
+    erase(it->second);
+  }
+
+  while (_stats.bytes + bytes > _capacity) {
+    erase(std::prev(_lru.end()));
+    _stats.evictions += 1;
+  }
+
+  _lru.push_front(entry{std::move(key), sequence, bytes, std::make_shared<results const>(std::move(values))});
+  _index.emplace(_lru.front().key, _lru.begin());
+  _stats.bytes += bytes;
+  _stats.entries += 1;
+}
+
+void zkd::BoxResultCache::erase(lru_list::iterator it) {
+  _stats.bytes -= it->bytes;
+  _stats.entries -= 1;
+  _index.erase(it->key);
+  _lru.erase(it);
+}
+
+void zkd::BoxResultCache::clear() {
+  std::unique_lock guard(_mutex);
+  _index.clear();
+  _lru.clear();
+  _stats.entries = 0;
+  _stats.bytes = 0;
+}
+
+auto zkd::BoxResultCache::stats() const -> BoxResultCacheStats {
+  std::unique_lock guard(_mutex);
+  return _stats;
+}
+
+std::ostream& zkd::operator<<(std::ostream& ostream, BoxResultCacheStats const& stats) {
+  ostream << "BoxResultCacheStats{";
+  ostream << "hits=" << stats.hits;
+  ostream << ", misses=" << stats.misses;
+  ostream << ", stale=" << stats.stale;
+  ostream << ", evictions=" << stats.evictions;
+  ostream << ", rejected=" << stats.rejected;
+  ostream << ", entries=" << stats.entries;
+  ostream << ", bytes=" << stats.bytes;
+  ostream << "}";
+  return ostream;
+}
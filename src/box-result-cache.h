@@ -0,0 +1,77 @@
+#ifndef ZKD_TREE_BOX_RESULT_CACHE_H
+#define ZKD_TREE_BOX_RESULT_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "library.h"
+
+namespace zkd {
+
+struct BoxResultCacheStats {
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+  std::uint64_t stale = 0;     // entries dropped because the database changed
+  std::uint64_t evictions = 0; // entries dropped to stay within the memory budget
+  std::uint64_t rejected = 0;  // results too large to be cached
+  std::size_t entries = 0;
+  std::size_t bytes = 0;
+};
+
+std::ostream& operator<<(std::ostream& ostream, BoxResultCacheStats const& stats);
+
+/*
+ * LRU cache of complete box query results, keyed by the interleaved bounds of
+ * the box. Every entry remembers the sequence number of the database it was
+ * computed from, and is only returned while that is still the latest one.
+ * Memory usage is bounded by `capacity` bytes of keys and values.
+ */
+class BoxResultCache {
+ public:
+  using results = std::vector<std::pair<byte_string, byte_string>>;
+
+  explicit BoxResultCache(std::size_t capacity);
+
+  auto lookup(byte_string_view min, byte_string_view max, std::size_t dimensions, std::uint64_t sequence)
+    -> std::shared_ptr<results const>;
+  void insert(byte_string_view min, byte_string_view max, std::size_t dimensions, std::uint64_t sequence,
+              results&& values);
+  void clear();
+
+  auto stats() const -> BoxResultCacheStats;
+  auto capacity() const noexcept -> std::size_t { return _capacity; }
+
+  static auto memoryUsage(byte_string_view key, byte_string_view value) -> std::size_t;
+
+ private:
+  struct entry {
+    byte_string key;
+    std::uint64_t sequence;
+    std::size_t bytes;
+    std::shared_ptr<results const> values;
+  };
+  using lru_list = std::list<entry>;
+  struct view_hash {
+    auto operator()(byte_string_view v) const noexcept -> std::size_t;
+  };
+
+  static auto makeKey(byte_string_view min, byte_string_view max, std::size_t dimensions) -> byte_string;
+  void erase(lru_list::iterator it);
+
+  mutable std::mutex _mutex;
+  lru_list _lru; // most recently used first
+  std::unordered_map<byte_string_view, lru_list::iterator, view_hash> _index;
+  BoxResultCacheStats _stats;
+  std::size_t const _capacity;
+};
+
+} // namespace zkd
+
+#endif //ZKD_TREE_BOX_RESULT_CACHE_H
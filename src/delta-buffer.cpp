@@ -0,0 +1,325 @@
+#include "delta-buffer.h"
+
+#include <stdexcept>
+#include <utility>
+
+#include <rocksdb/write_batch.h>
+
+using namespace zkd;
+
+namespace {
+auto viewFromSlice(rocksdb::Slice slice) -> byte_string_view {
+  return byte_string_view{reinterpret_cast<std::byte const*>(slice.data()), slice.size()};
+}
+
+auto sliceFromView(byte_string_view view) -> rocksdb::Slice {
+  return rocksdb::Slice(reinterpret_cast<char const*>(view.data()), view.size());
+}
+
+/*
+ * Merges a run of the delta buffer into an iterator over the database and the
+ * older runs.
+ * Both sides are positioned at or after (before, when moving backwards) the
+ * current key; turning around seeks both sides again.
+ */
+class merged_iterator final : public rocksdb::Iterator {
+ public:
+  merged_iterator(std::unique_ptr<rocksdb::Iterator> base, std::shared_ptr<DeltaBuffer::entries const> delta)
+      : _base(std::move(base)), _delta(std::move(delta)), _pos(_delta->end()) {}
+
+  bool Valid() const override { return _current != side::none; }
+
+  void SeekToFirst() override {
+    _base->SeekToFirst();
+    _pos = _delta->begin();
+    _forward = true;
+    resolve();
+  }
+
+  void SeekToLast() override {
+    _base->SeekToLast();
+    _pos = _delta->empty() ? _delta->end() : std::prev(_delta->end());
+    _forward = false;
+    resolve();
+  }
+
+  void Seek(rocksdb::Slice const& target) override {
+    _base->Seek(target);
+    _pos = _delta->lower_bound(viewFromSlice(target));
+    _forward = true;
+    resolve();
+  }
+
+  void SeekForPrev(rocksdb::Slice const& target) override {
+    _base->SeekForPrev(target);
+    _pos = _delta->upper_bound(viewFromSlice(target));
+    _pos = _pos == _delta->begin() ? _delta->end() : std::prev(_pos);
+    _forward = false;
+    resolve();
+  }
+
+  void Next() override {
+    if (!_forward) {
+      // both sides are before the current key, move them to the first one after it
+      auto const current = byte_string{viewFromSlice(key())};
+      _base->Seek(sliceFromView(current));
+      _pos = _delta->lower_bound(current);
+      _forward = true;
+    }
+    advance();
+    resolve();
+  }
+
+  void Prev() override {
+    if (_forward) {
+      auto const current = byte_string{viewFromSlice(key())};
+      _base->SeekForPrev(sliceFromView(current));
+      _pos = _delta->upper_bound(current);
+      _pos = _pos == _delta->begin() ? _delta->end() : std::prev(_pos);
+      _forward = false;
+    }
+    advance();
+    resolve();
+  }
+
+  rocksdb::Slice key() const override {
+    return _current == side::base ? _base->key() : sliceFromView(_pos->first);
+  }
+
+  rocksdb::Slice value() const override {
+    return _current == side::base ? _base->value() : sliceFromView(*_pos->second);
+  }
+
+  rocksdb::Status status() const override { return _base->status(); }
+
+ private:
+  enum class side { none, base, delta };
+
+  auto deltaValid() const -> bool { return _pos != _delta->end(); }
+
+  void stepBase() {
+    _forward ? _base->Next() : _base->Prev();
+  }
+
+  void stepDelta() {
+    if (_forward) {
+      ++_pos;
+    } else {
+      _pos = _pos == _delta->begin() ? _delta->end() : std::prev(_pos);
+    }
+  }
+
+  // moves the sides that are at the current key
+  void advance() {
+    auto const current = byte_string{viewFromSlice(key())};
+    if (_base->Valid() && viewFromSlice(_base->key()) == byte_string_view{current}) {
+      stepBase();
+    }
+    if (deltaValid() && _pos->first == current) {
+      stepDelta();
+    }
+  }
+
+  // picks the side with the next key, skipping tombstones and the keys they hide
+  void resolve() {
+    while (true) {
+      bool const base = _base->Valid();
+      if (!base && !deltaValid()) {
+        _current = side::none;
+        return;
+      }
+      if (!deltaValid()) {
+        _current = side::base;
+        return;
+      }
+      if (base) {
+        auto const cmp = viewFromSlice(_base->key()).compare(_pos->first);
+        if (cmp != 0 && (cmp < 0) == _forward) {
+          _current = side::base;
+          return;
+        }
+        if (cmp == 0 && !_pos->second) {
+          stepBase();
+        }
+      }
+      if (_pos->second) {
+        _current = side::delta;
+        return;
+      }
+      stepDelta();
+    }
+  }
+
+  std::unique_ptr<rocksdb::Iterator> _base;
+  std::shared_ptr<DeltaBuffer::entries const> _delta;
+  DeltaBuffer::entries::const_iterator _pos;
+  bool _forward = true;
+  side _current = side::none;
+};
+
+auto bufferOf(RocksDBHandle& rocks) -> DeltaBuffer& {
+  if (rocks.deltaBuffer == nullptr) {
+    throw std::logic_error("handle has no delta buffer");
+  }
+  return *rocks.deltaBuffer;
+}
+} // namespace
+
+zkd::DeltaBuffer::DeltaBuffer(DeltaBufferOptions options) : _options(options) {}
+
+void zkd::DeltaBuffer::put(byte_string_view key, byte_string_view value) {
+  std::unique_lock guard(_mutex);
+  _active.insert_or_assign(byte_string{key}, byte_string{value});
+}
+
+void zkd::DeltaBuffer::remove(byte_string_view key) {
+  std::unique_lock guard(_mutex);
+  _active.insert_or_assign(byte_string{key}, std::nullopt);
+}
+
+auto zkd::DeltaBuffer::size() const -> std::size_t {
+  std::shared_lock guard(_mutex);
+  auto size = _active.size();
+  for (auto const& run : _frozen) {
+    size += run->size();
+  }
+  return size;
+}
+
+auto zkd::DeltaBuffer::empty() const -> bool {
+  std::shared_lock guard(_mutex);
+  return _active.empty() && _frozen.empty();
+}
+
+auto zkd::DeltaBuffer::needsFlush() const -> bool {
+  std::shared_lock guard(_mutex);
+  return _options.flushThreshold != 0 && unflushed() >= _options.flushThreshold;
+}
+
+auto zkd::DeltaBuffer::unflushed() const -> std::size_t {
+  auto size = _active.size();
+  for (auto i = _flushing; i < _frozen.size(); ++i) {
+    size += _frozen[i]->size();
+  }
+  return size;
+}
+
+void zkd::DeltaBuffer::freeze() {
+  if (_active.empty()) {
+    return;
+  }
+  auto run = std::make_shared<entries>(std::move(_active));
+  _active = entries{};
+  // runs being flushed are left alone, flush drops them afterwards
+  while (_frozen.size() > _flushing && _frozen.back()->size() <= 2 * run->size()) {
+    // keeps the newer entries
+    run->insert(_frozen.back()->begin(), _frozen.back()->end());
+    _frozen.pop_back();
+  }
+  _frozen.push_back(std::move(run));
+}
+
+auto zkd::DeltaBuffer::snapshot() -> runs {
+  {
+    std::shared_lock guard(_mutex);
+    if (_active.empty()) {
+      return _frozen;
+    }
+  }
+  std::unique_lock guard(_mutex);
+  freeze();
+  return _frozen;
+}
+
+auto zkd::DeltaBuffer::flush(RocksDBHandle& rocks) -> rocksdb::Status {
+  std::unique_lock flushGuard(_flushMutex);
+  runs batch;
+  {
+    std::unique_lock guard(_mutex);
+    freeze();
+    if (_frozen.empty()) {
+      return rocksdb::Status::OK();
+    }
+    // stay visible to snapshots until they are written
+    _flushing = _frozen.size();
+    batch = _frozen;
+  }
+
+  // oldest run first, so the later writes of a key win
+  rocksdb::Status s;
+  if (rocks.summaries != nullptr || rocks.histograms != nullptr) {
+    for (auto const& run : batch) {
+      for (auto const& [key, value] : *run) {
+        s = value ? PutKey(rocks, key, *value) : DeleteKey(rocks, key);
+        if (!s.ok()) {
+          break;
+        }
+      }
+      if (!s.ok()) {
+        break;
+      }
+    }
+  } else {
+    rocksdb::WriteBatch writes;
+    for (auto const& run : batch) {
+      for (auto const& [key, value] : *run) {
+        if (value) {
+          writes.Put(rocks.default_.get(), sliceFromView(key), sliceFromView(*value));
+        } else {
+          writes.Delete(rocks.default_.get(), sliceFromView(key));
+        }
+      }
+    }
+    s = rocks.db->Write({}, &writes);
+  }
+
+  std::unique_lock guard(_mutex);
+  if (s.ok()) {
+    _frozen.erase(_frozen.begin(), _frozen.begin() + std::ptrdiff_t(_flushing));
+  }
+  // on failure the runs stay, keys written since are in later runs and take precedence
+  _flushing = 0;
+  return s;
+}
+
+auto zkd::putBuffered(RocksDBHandle& rocks, byte_string_view key, byte_string_view value) -> rocksdb::Status {
+  auto& buffer = bufferOf(rocks);
+  buffer.put(key, value);
+  if (rocks.emptyIntervals != nullptr) {
+    // only after the write is visible, see EmptyIntervalCache
+    rocks.emptyIntervals->invalidate(key);
+  }
+  return buffer.needsFlush() ? buffer.flush(rocks) : rocksdb::Status::OK();
+}
+
+auto zkd::deleteBuffered(RocksDBHandle& rocks, byte_string_view key) -> rocksdb::Status {
+  auto& buffer = bufferOf(rocks);
+  buffer.remove(key);
+  return buffer.needsFlush() ? buffer.flush(rocks) : rocksdb::Status::OK();
+}
+
+auto zkd::flushDeltaBuffer(RocksDBHandle& rocks) -> rocksdb::Status {
+  return rocks.deltaBuffer != nullptr ? rocks.deltaBuffer->flush(rocks) : rocksdb::Status::OK();
+}
+
+auto zkd::snapshotDeltaBuffer(RocksDBHandle& rocks) -> DeltaBuffer::runs {
+  return rocks.deltaBuffer != nullptr ? rocks.deltaBuffer->snapshot() : DeltaBuffer::runs{};
+}
+
+auto zkd::newMergedIterator(RocksDBHandle& rocks, rocksdb::ReadOptions const& options)
+  -> std::unique_ptr<rocksdb::Iterator> {
+  // the snapshot is taken first: keys flushed after it are already in the database when the iterator is created
+  return newMergedIterator(rocks, options, snapshotDeltaBuffer(rocks));
+}
+
+auto zkd::newMergedIterator(RocksDBHandle& rocks, rocksdb::ReadOptions const& options,
+                            DeltaBuffer::runs const& buffered) -> std::unique_ptr<rocksdb::Iterator> {
+  auto iter = std::unique_ptr<rocksdb::Iterator>{rocks.db->NewIterator(options, rocks.default_.get())};
+  // every run is merged over the older ones, its tombstones hide their keys
+  for (auto const& run : buffered) {
+    if (!run->empty()) {
+      iter = std::make_unique<merged_iterator>(std::move(iter), run);
+    }
+  }
+  return iter;
+}
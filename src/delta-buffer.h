@@ -0,0 +1,111 @@
+#ifndef ZKD_TREE_DELTA_BUFFER_H
+#define ZKD_TREE_DELTA_BUFFER_H
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <vector>
+
+#include <rocksdb/iterator.h>
+#include <rocksdb/options.h>
+#include <rocksdb/status.h>
+
+#include "library.h"
+#include "rocksdb-handle.h"
+
+namespace zkd {
+
+struct DeltaBufferOptions {
+  // putBuffered and deleteBuffered flush once the buffer holds this many keys; 0 only flushes explicitly
+  std::size_t flushThreshold = 4096;
+};
+
+/*
+ * Sorted in-memory buffer of recent writes, see RocksDBHandle::deltaBuffer.
+ * Puts and deletes only update the buffer; flush writes all of them to the
+ * default column family in a single sorted WriteBatch. Box queries merge the
+ * buffer into their scan, so they see buffered writes at once.
+ *
+ * Readers get the buffer as a list of immutable runs. A reader after a write
+ * freezes the written keys into a new run instead of copying them; a new run
+ * absorbs the runs before it that are at most twice its size, so there are
+ * O(log n) runs and every key is copied O(log n) times until it is flushed.
+ * Runs being flushed stay visible until the batch is written.
+ */
+class DeltaBuffer {
+ public:
+  // a tombstone has no value
+  using entries = std::map<byte_string, std::optional<byte_string>, std::less<>>;
+  // oldest first, later runs win
+  using runs = std::vector<std::shared_ptr<entries const>>;
+
+  explicit DeltaBuffer(DeltaBufferOptions options = {});
+
+  void put(byte_string_view key, byte_string_view value);
+  void remove(byte_string_view key);
+
+  // keys written since the last flush, tombstones and keys written again in a later run included
+  auto size() const -> std::size_t;
+  auto empty() const -> bool;
+  auto needsFlush() const -> bool;
+
+  auto snapshot() -> runs;
+
+  /*
+   * Writes the buffered keys to the handle's default column family. Through
+   * PutKey and DeleteKey if the handle has summaries or histograms, which need
+   * to know whether a key exists. On failure, the keys are kept in the buffer
+   * unless they were written again in the meantime.
+   */
+  auto flush(RocksDBHandle& rocks) -> rocksdb::Status;
+
+ private:
+  // moves _active into a new run, with the lock held
+  void freeze();
+  auto unflushed() const -> std::size_t;
+
+  DeltaBufferOptions const _options;
+  std::mutex _flushMutex; // one flush at a time
+  mutable std::shared_mutex _mutex;
+  entries _active;
+  runs _frozen;
+  std::size_t _flushing = 0; // the first runs of _frozen, which are being written
+};
+
+/*
+ * Write through the handle's delta buffer, and flush it when it is full.
+ * Throws std::logic_error if the handle has no delta buffer. Keys written
+ * directly with PutKey or DeleteKey are shadowed by buffered writes of the
+ * same keys until the next flush.
+ */
+auto putBuffered(RocksDBHandle& rocks, byte_string_view key, byte_string_view value) -> rocksdb::Status;
+auto deleteBuffered(RocksDBHandle& rocks, byte_string_view key) -> rocksdb::Status;
+// no-op without a delta buffer
+auto flushDeltaBuffer(RocksDBHandle& rocks) -> rocksdb::Status;
+
+// the handle's delta buffer as of now, no runs without one
+auto snapshotDeltaBuffer(RocksDBHandle& rocks) -> DeltaBuffer::runs;
+
+/*
+ * An iterator over the default column family with the keys of the handle's
+ * delta buffer merged in; the buffered value wins and tombstones hide keys.
+ * Without a delta buffer, or with an empty one, this is the plain iterator.
+ *
+ * Readers that take a RocksDB snapshot for `options` pass a buffer snapshot
+ * taken before it, so keys flushed in between are seen in the database. All
+ * box queries, exportSnapshot, buildKeyBlocks and the spatial join of two
+ * handles read through it. countInBox flushes the buffer first if the handle
+ * has summaries, which only count written keys. rebuildSummaries and
+ * rebuildHistograms only count written keys as well; the flush adds the others.
+ */
+auto newMergedIterator(RocksDBHandle& rocks, rocksdb::ReadOptions const& options) -> std::unique_ptr<rocksdb::Iterator>;
+auto newMergedIterator(RocksDBHandle& rocks, rocksdb::ReadOptions const& options,
+                       DeltaBuffer::runs const& buffered) -> std::unique_ptr<rocksdb::Iterator>;
+
+} // namespace zkd
+
+#endif //ZKD_TREE_DELTA_BUFFER_H
@@ -0,0 +1,98 @@
+#include "dimension-histograms.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+using namespace zkd;
+
+namespace {
+// partial buckets at the edges of a box are weighted with this many bits of precision
+constexpr unsigned fractionBits = 8;
+
+// the number of buckets, validated before anything is allocated
+auto checkedBucketCount(std::size_t dimensions, unsigned bucketBits) -> std::size_t {
+  if (dimensions == 0 || bucketBits == 0 || bucketBits > 24) {
+    throw std::invalid_argument{"DimensionHistograms needs at least one dimension and between 1 and 24 bucket bits"};
+  }
+  if (dimensions > (std::numeric_limits<std::size_t>::max() >> bucketBits)) {
+    throw std::invalid_argument{"DimensionHistograms has too many dimensions"};
+  }
+  return dimensions << bucketBits;
+}
+} // namespace
+
+zkd::DimensionHistograms::DimensionHistograms(std::size_t dimensions, unsigned bucketBits)
+    : _dimensions(dimensions), _bucketBits(bucketBits), _buckets(checkedBucketCount(dimensions, bucketBits)) {}
+
+auto zkd::DimensionHistograms::readCoordinateBits(byte_string_view key, std::size_t dim, std::size_t dimensions, unsigned bits,
+                                                  Bit pad) -> std::uint64_t {
+  RandomBitReader reader(key);
+  std::uint64_t result = 0;
+  for (unsigned i = 0; i < bits; ++i) {
+    auto const index = i * dimensions + dim;
+    result <<= 1;
+    if ((index < 8 * key.size() ? reader.getBit(index) : pad) == Bit::ONE) {
+      result |= 1;
+    }
+  }
+  return result;
+}
+
+void zkd::DimensionHistograms::add(byte_string_view key, std::int64_t delta) {
+  for (std::size_t dim = 0; dim < _dimensions; ++dim) {
+    auto index = readCoordinateBits(key, dim, _dimensions, _bucketBits);
+    _buckets[(dim << _bucketBits) + index].fetch_add(delta, std::memory_order_relaxed);
+  }
+  _total.fetch_add(delta, std::memory_order_relaxed);
+}
+
+void zkd::DimensionHistograms::clear() {
+  for (auto& b : _buckets) {
+    b.store(0, std::memory_order_relaxed);
+  }
+  _total.store(0, std::memory_order_relaxed);
+}
+
+auto zkd::DimensionHistograms::total() const noexcept -> std::uint64_t {
+  auto total = _total.load(std::memory_order_relaxed);
+  return total > 0 ? total : 0;
+}
+
+auto zkd::DimensionHistograms::bucket(std::size_t dim, std::uint64_t index) const -> std::int64_t {
+  return _buckets[(dim << _bucketBits) + index].load(std::memory_order_relaxed);
+}
+
+auto zkd::DimensionHistograms::selectivity(byte_string_view min, byte_string_view max) const -> double {
+  auto const total = this->total();
+  if (total == 0) {
+    return 0.0;
+  }
+
+  constexpr double scale = 1u << fractionBits;
+  constexpr std::uint64_t mask = (1u << fractionBits) - 1;
+
+  double result = 1.0;
+  for (std::size_t dim = 0; dim < _dimensions; ++dim) {
+    auto const lo = readCoordinateBits(min, dim, _dimensions, _bucketBits + fractionBits);
+    auto const hi = readCoordinateBits(max, dim, _dimensions, _bucketBits + fractionBits, Bit::ONE);
+    if (hi < lo) {
+      return 0.0;
+    }
+    auto const loBucket = lo >> fractionBits;
+    auto const hiBucket = hi >> fractionBits;
+
+    double count;
+    if (loBucket == hiBucket) {
+      count = bucket(dim, loBucket) * double((hi & mask) - (lo & mask) + 1) / scale;
+    } else {
+      count = bucket(dim, loBucket) * double(scale - (lo & mask)) / scale;
+      for (auto b = loBucket + 1; b < hiBucket; ++b) {
+        count += bucket(dim, b);
+      }
+      count += bucket(dim, hiBucket) * double((hi & mask) + 1) / scale;
+    }
+    result *= std::max(0.0, std::min(1.0, count / total));
+  }
+  return result;
+}
@@ -0,0 +1,51 @@
+#ifndef ZKD_TREE_DIMENSION_HISTOGRAMS_H
+#define ZKD_TREE_DIMENSION_HISTOGRAMS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "library.h"
+
+namespace zkd {
+
+/*
+ * Equi-width histogram per dimension over the first `bucketBits` bits of each
+ * coordinate, taken directly from the interleaved keys. Thread-safe, meant to
+ * be updated on every insert and delete.
+ *
+ * With the double encoding the first 12 bits are sign and exponent, so the
+ * default of 16 bits splits every binade into 16 buckets.
+ */
+class DimensionHistograms {
+ public:
+  explicit DimensionHistograms(std::size_t dimensions, unsigned bucketBits = 16);
+
+  void add(byte_string_view key, std::int64_t delta = 1);
+  void clear();
+
+  // estimated fraction of all keys that lie in the box, assuming independent dimensions
+  auto selectivity(byte_string_view min, byte_string_view max) const -> double;
+  auto total() const noexcept -> std::uint64_t;
+
+  auto dimensions() const noexcept -> std::size_t { return _dimensions; }
+  auto bucketBits() const noexcept -> unsigned { return _bucketBits; }
+
+  // the first `bits` bits of the coordinate in dimension `dim` of an interleaved key,
+  // bits beyond the end of the key are read as `pad`
+  static auto readCoordinateBits(byte_string_view key, std::size_t dim, std::size_t dimensions, unsigned bits,
+                                 Bit pad = Bit::ZERO) -> std::uint64_t;
+
+ private:
+  auto bucket(std::size_t dim, std::uint64_t index) const -> std::int64_t;
+
+  std::size_t const _dimensions;
+  unsigned const _bucketBits;
+  std::vector<std::atomic<std::int64_t>> _buckets;
+  std::atomic<std::int64_t> _total{0};
+};
+
+} // namespace zkd
+
+#endif //ZKD_TREE_DIMENSION_HISTOGRAMS_H
@@ -0,0 +1,113 @@
+#include "empty-interval-cache.h"
+
+#include <iterator>
+#include <mutex>
+
+using namespace zkd;
+
+zkd::EmptyIntervalCache::EmptyIntervalCache(std::size_t capacity) : _capacity(capacity) {}
+
+auto zkd::EmptyIntervalCache::epoch() const noexcept -> std::uint64_t {
+  return _epoch.load(std::memory_order_acquire);
+}
+
+auto zkd::EmptyIntervalCache::findContaining(byte_string_view key) const -> interval_map::const_iterator {
+  auto it = _intervals.upper_bound(key);
+  if (it == _intervals.begin()) {
+    return _intervals.end();
+  }
+  --it;
+  if (!it->second.has_value() || key < it->second.value()) {
+    return it;
+  }
+  return _intervals.end();
+}
+
+void zkd::EmptyIntervalCache::insert(byte_string_view begin, std::optional<byte_string_view> end, std::uint64_t epoch) {
+  if (end.has_value() && !(begin < end.value())) {
+    return;
+  }
+
+  std::unique_lock guard(_mutex);
+  if (epoch != _epoch.load(std::memory_order_relaxed) || _capacity == 0) {
+    // a write happened after the caller's iterator was created
+    return;
+  }
+
+  // intervals are kept disjoint: merge everything that overlaps or touches [begin, end)
+  auto newBegin = byte_string{begin};
+  auto newEnd = end.has_value() ? std::optional<byte_string>{end.value()} : std::nullopt;
+
+  auto it = _intervals.upper_bound(begin);
+  if (it != _intervals.begin()) {
+    auto prev = std::prev(it);
+    if (!prev->second.has_value() || !(prev->second.value() < begin)) {
+      it = prev;
+    }
+  }
+  while (it != _intervals.end() && (!newEnd.has_value() || !(newEnd.value() < it->first))) {
+    if (it->first < newBegin) {
+      newBegin = it->first;
+    }
+    if (!it->second.has_value()) {
+      newEnd.reset();
+    } else if (newEnd.has_value() && newEnd.value() < it->second.value()) {
+      newEnd = it->second;
+    }
+    it = _intervals.erase(it);
+  }
+
+  _insertionOrder.push_back(newBegin);
+  _intervals.emplace(std::move(newBegin), std::move(newEnd));
+  evict();
+}
+
+void zkd::EmptyIntervalCache::evict() {
+  while (_intervals.size() > _capacity && !_insertionOrder.empty()) {
+    // entries of merged or invalidated intervals may be stale, erasing them is a no-op
+    _intervals.erase(_insertionOrder.front());
+    _insertionOrder.pop_front();
+  }
+
+  if (_insertionOrder.size() > 2 * _capacity) {
+    _insertionOrder.clear();
+    for (auto const& it : _intervals) {
+      _insertionOrder.push_back(it.first);
+    }
+  }
+}
+
+auto zkd::EmptyIntervalCache::lookup(byte_string_view key) const -> std::optional<EmptyInterval> {
+  std::shared_lock guard(_mutex);
+  auto it = findContaining(key);
+  if (it == _intervals.end()) {
+    return std::nullopt;
+  }
+  return EmptyInterval{it->first, it->second};
+}
+
+void zkd::EmptyIntervalCache::invalidate(byte_string_view key) {
+  std::unique_lock guard(_mutex);
+  auto it = findContaining(key);
+  if (it != _intervals.end()) {
+    if (it->first == key) {
+      _intervals.erase(it);
+    } else {
+      // [begin, key) is still empty, and key is now its next occupied key
+      _intervals.insert_or_assign(it->first, byte_string{key});
+    }
+  }
+  _epoch.fetch_add(1, std::memory_order_release);
+}
+
+void zkd::EmptyIntervalCache::clear() {
+  std::unique_lock guard(_mutex);
+  _intervals.clear();
+  _insertionOrder.clear();
+  _epoch.fetch_add(1, std::memory_order_release);
+}
+
+auto zkd::EmptyIntervalCache::size() const -> std::size_t {
+  std::shared_lock guard(_mutex);
+  return _intervals.size();
+}
@@ -0,0 +1,60 @@
+#ifndef ZKD_TREE_EMPTY_INTERVAL_CACHE_H
+#define ZKD_TREE_EMPTY_INTERVAL_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <optional>
+#include <shared_mutex>
+
+#include "library.h"
+
+namespace zkd {
+
+// [begin, end) contains no keys. end == nullopt means "up to the end of the keyspace".
+struct EmptyInterval {
+  byte_string begin;
+  std::optional<byte_string> end;
+};
+
+/*
+ * Bounded, thread-safe cache of Z-intervals that are known to be empty. The
+ * intervals are learned from seeks that landed beyond their target, and are
+ * trimmed by `invalidate` whenever a key is written into them.
+ *
+ * To avoid learning stale intervals from an iterator that was created before a
+ * concurrent write, read `epoch()` before creating the iterator and pass it to
+ * `insert`. `invalidate` has to be called after the write is visible.
+ */
+class EmptyIntervalCache {
+ public:
+  explicit EmptyIntervalCache(std::size_t capacity);
+
+  auto epoch() const noexcept -> std::uint64_t;
+
+  void insert(byte_string_view begin, std::optional<byte_string_view> end, std::uint64_t epoch);
+  auto lookup(byte_string_view key) const -> std::optional<EmptyInterval>;
+  void invalidate(byte_string_view key);
+  void clear();
+
+  auto size() const -> std::size_t;
+  auto capacity() const noexcept -> std::size_t { return _capacity; }
+
+ private:
+  using interval_map = std::map<byte_string, std::optional<byte_string>, std::less<>>;
+
+  auto findContaining(byte_string_view key) const -> interval_map::const_iterator;
+  void evict();
+
+  mutable std::shared_mutex _mutex;
+  interval_map _intervals;
+  std::deque<byte_string> _insertionOrder;
+  std::atomic<std::uint64_t> _epoch{0};
+  std::size_t const _capacity;
+};
+
+} // namespace zkd
+
+#endif //ZKD_TREE_EMPTY_INTERVAL_CACHE_H
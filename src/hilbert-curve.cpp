@@ -0,0 +1,313 @@
+#include "hilbert-curve.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace zkd;
+
+/*
+ * The Hilbert curve is computed top-down with the state machine of
+ * C. Hamilton, "Compact Hilbert Indices" (2006): every level of the index
+ * holds one digit of `dimensions` bits, and the cell of a digit is found by
+ * transforming its gray code with the entry point `e` and direction `d` of the
+ * parent cell.
+ */
+namespace {
+auto lowMask(unsigned bits) -> std::uint64_t {
+  return bits >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << bits) - 1;
+}
+
+struct hilbert_state {
+  std::size_t n;
+  std::uint64_t mask;
+
+  explicit hilbert_state(std::size_t dimensions) : n(dimensions), mask(lowMask(unsigned(dimensions))) {}
+
+  auto rotl(std::uint64_t x, std::size_t r) const -> std::uint64_t {
+    r %= n;
+    return r == 0 ? x : ((x << r) | (x >> (n - r))) & mask;
+  }
+  auto rotr(std::uint64_t x, std::size_t r) const -> std::uint64_t {
+    r %= n;
+    return r == 0 ? x : ((x >> r) | (x << (n - r))) & mask;
+  }
+
+  static auto gray(std::uint64_t i) -> std::uint64_t { return i ^ (i >> 1); }
+  static auto grayInverse(std::uint64_t g) -> std::uint64_t {
+    for (unsigned shift = 1; shift < 64; shift <<= 1) {
+      g ^= g >> shift;
+    }
+    return g;
+  }
+  static auto trailingOnes(std::uint64_t i) -> std::size_t {
+    std::size_t k = 0;
+    while (i & 1) {
+      i >>= 1;
+      ++k;
+    }
+    return k;
+  }
+
+  static auto entry(std::uint64_t w) -> std::uint64_t { return w == 0 ? 0 : gray(2 * ((w - 1) / 2)); }
+  auto direction(std::uint64_t w) const -> std::size_t {
+    if (w == 0) {
+      return 0;
+    }
+    return (w % 2 == 0 ? trailingOnes(w - 1) : trailingOnes(w)) % n;
+  }
+
+  // coordinate bits of the child cell with digit w
+  auto cell(std::uint64_t e, std::size_t d, std::uint64_t w) const -> std::uint64_t {
+    return rotl(gray(w), d + 1) ^ e;
+  }
+  // digit of the child cell with coordinate bits l
+  auto digit(std::uint64_t e, std::size_t d, std::uint64_t l) const -> std::uint64_t {
+    return grayInverse(rotr(l ^ e, d + 1));
+  }
+
+  void descend(std::uint64_t& e, std::size_t& d, std::uint64_t w) const {
+    e ^= rotl(entry(w), d + 1);
+    d = (d + direction(w) + 1) % n;
+  }
+};
+
+void checkDimensions(std::size_t dimensions) {
+  if (dimensions == 0 || dimensions > 32) {
+    throw std::invalid_argument("Hilbert keys need between 1 and 32 dimensions");
+  }
+}
+
+// HilbertBox::next enumerates the 2^dimensions children of a cell
+constexpr std::size_t maxBoxDimensions = 16;
+
+auto toWord(byte_string_view bytes) -> std::uint64_t {
+  std::uint64_t v = 0;
+  for (auto b : bytes) {
+    v = (v << 8) | std::to_integer<std::uint64_t>(b);
+  }
+  return v;
+}
+
+auto fromWord(std::uint64_t v, unsigned bits) -> byte_string {
+  byte_string bytes;
+  for (unsigned i = bits / 8; i > 0; --i) {
+    bytes.push_back(std::byte(v >> (8 * (i - 1))));
+  }
+  return bytes;
+}
+
+auto encodeWords(std::vector<std::uint64_t> const& point, unsigned bits) -> byte_string {
+  hilbert_state const h(point.size());
+  std::uint64_t e = 0;
+  std::size_t d = 0;
+
+  BitWriter writer;
+  writer.reserve(point.size() * bits / 8);
+  for (unsigned level = 0; level < bits; ++level) {
+    auto const bit = bits - 1 - level;
+    std::uint64_t l = 0;
+    for (std::size_t j = 0; j < point.size(); ++j) {
+      l |= ((point[j] >> bit) & 1) << j;
+    }
+    auto const w = h.digit(e, d, l);
+    writer.write_big_endian_bits(w, unsigned(point.size()));
+    h.descend(e, d, w);
+  }
+  return std::move(writer).str();
+}
+
+auto decodeWords(byte_string_view key, std::size_t dimensions) -> std::vector<std::uint64_t> {
+  hilbert_state const h(dimensions);
+  std::uint64_t e = 0;
+  std::size_t d = 0;
+
+  auto const bits = unsigned(8 * key.size() / dimensions);
+  std::vector<std::uint64_t> point(dimensions, 0);
+  BitReader reader(key);
+  for (unsigned level = 0; level < bits; ++level) {
+    auto const bit = bits - 1 - level;
+    auto const w = reader.read_big_endian_bits(unsigned(dimensions));
+    auto const l = h.cell(e, d, w);
+    for (std::size_t j = 0; j < dimensions; ++j) {
+      point[j] |= ((l >> j) & 1) << bit;
+    }
+    h.descend(e, d, w);
+  }
+  return point;
+}
+
+auto coordinateBits(std::vector<byte_string> const& coords) -> unsigned {
+  checkDimensions(coords.size());
+  auto const size = coords.front().size();
+  if (size > 8) {
+    throw std::invalid_argument("Hilbert keys support coordinates of up to 8 bytes");
+  }
+  for (auto const& c : coords) {
+    if (c.size() != size) {
+      throw std::invalid_argument("Hilbert keys need coordinates of equal length");
+    }
+  }
+  return unsigned(8 * size);
+}
+} // namespace
+
+std::ostream& zkd::operator<<(std::ostream& ostream, Curve curve) {
+  switch (curve) {
+    case Curve::Z_ORDER:
+      return ostream << "z-order";
+    case Curve::HILBERT:
+      return ostream << "hilbert";
+  }
+  return ostream;
+}
+
+auto zkd::hilbertEncode(std::vector<byte_string> const& coords) -> byte_string {
+  auto const bits = coordinateBits(coords);
+  std::vector<std::uint64_t> point;
+  point.reserve(coords.size());
+  for (auto const& c : coords) {
+    point.push_back(toWord(c));
+  }
+  return encodeWords(point, bits);
+}
+
+auto zkd::hilbertDecode(byte_string_view key, std::size_t dimensions) -> std::vector<byte_string> {
+  checkDimensions(dimensions);
+  auto const bits = unsigned(8 * key.size() / dimensions);
+  std::vector<byte_string> coords;
+  for (auto v : decodeWords(key, dimensions)) {
+    coords.push_back(fromWord(v, bits));
+  }
+  return coords;
+}
+
+auto zkd::encodeKey(Curve curve, std::vector<byte_string> const& coords) -> byte_string {
+  return curve == Curve::HILBERT ? hilbertEncode(coords) : interleave(coords);
+}
+
+auto zkd::decodeKey(Curve curve, byte_string_view key, std::size_t dimensions) -> std::vector<byte_string> {
+  return curve == Curve::HILBERT ? hilbertDecode(key, dimensions) : transpose(key, dimensions);
+}
+
+zkd::HilbertBox::HilbertBox(byte_string_view min, byte_string_view max, std::size_t dimensions)
+    : _dimensions(dimensions) {
+  checkDimensions(dimensions);
+  if (dimensions > maxBoxDimensions) {
+    throw std::invalid_argument("Hilbert boxes need at most " + std::to_string(maxBoxDimensions) + " dimensions");
+  }
+  auto const minCoords = transpose(min, dimensions);
+  auto const maxCoords = transpose(max, dimensions);
+  _bits = coordinateBits(minCoords);
+  if (coordinateBits(maxCoords) != _bits) {
+    throw std::invalid_argument("Hilbert box corners need coordinates of equal length");
+  }
+  for (std::size_t j = 0; j < dimensions; ++j) {
+    _min.push_back(toWord(minCoords[j]));
+    _max.push_back(toWord(maxCoords[j]));
+  }
+}
+
+auto zkd::HilbertBox::contains(byte_string_view key) const -> bool {
+  auto const point = decodeWords(key, _dimensions);
+  for (std::size_t j = 0; j < _dimensions; ++j) {
+    if (point[j] < _min[j] || _max[j] < point[j]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct zkd::HilbertBox::search {
+  enum class result { NONE, CELL, KEY };
+
+  HilbertBox const& box;
+  hilbert_state h;
+  std::vector<std::uint64_t> keyDigits;
+  std::vector<std::uint64_t> path; // digits of the current cell
+  std::vector<std::uint64_t> lo;   // smallest point of the current cell
+
+  // relation of the cell with `lo` and `level` digits to the box, as (intersects, contained)
+  auto relate(unsigned level) const -> std::pair<bool, bool> {
+    auto const side = lowMask(box._bits - level);
+    bool contained = true;
+    for (std::size_t j = 0; j < box._dimensions; ++j) {
+      auto const hi = lo[j] | side;
+      if (hi < box._min[j] || box._max[j] < lo[j]) {
+        return {false, false};
+      }
+      contained = contained && box._min[j] <= lo[j] && hi <= box._max[j];
+    }
+    return {true, contained};
+  }
+
+  /*
+   * Precondition: the cell intersects the box and, if `tight`, contains the
+   * key. Finds the first cell in it, not before the key, that is completely
+   * inside of the box, and leaves its digits in `path`.
+   */
+  auto descend(unsigned level, std::uint64_t e, std::size_t d, bool tight) -> result {
+    if (level == box._bits || relate(level).second) {
+      return tight ? result::KEY : result::CELL;
+    }
+
+    auto const bit = box._bits - 1 - level;
+    auto const first = tight ? keyDigits[level] : 0;
+    for (std::uint64_t w = first; w <= h.mask; ++w) {
+      auto const l = h.cell(e, d, w);
+      for (std::size_t j = 0; j < box._dimensions; ++j) {
+        lo[j] = (lo[j] & ~(std::uint64_t{1} << bit)) | (((l >> j) & 1) << bit);
+      }
+      if (!relate(level + 1).first) {
+        continue;
+      }
+      path.push_back(w);
+      auto childE = e;
+      auto childD = d;
+      h.descend(childE, childD, w);
+      if (auto r = descend(level + 1, childE, childD, tight && w == first); r != result::NONE) {
+        return r;
+      }
+      path.pop_back();
+    }
+    for (std::size_t j = 0; j < box._dimensions; ++j) {
+      lo[j] &= ~(std::uint64_t{1} << bit);
+    }
+    return result::NONE;
+  }
+};
+
+auto zkd::HilbertBox::next(byte_string_view key) const -> std::optional<byte_string> {
+  if (8 * key.size() != _dimensions * _bits) {
+    throw std::invalid_argument("Hilbert key does not match the box");
+  }
+
+  search s{*this, hilbert_state(_dimensions), {}, {}, std::vector<std::uint64_t>(_dimensions, 0)};
+  BitReader reader(key);
+  for (unsigned level = 0; level < _bits; ++level) {
+    s.keyDigits.push_back(reader.read_big_endian_bits(unsigned(_dimensions)));
+  }
+
+  if (!s.relate(0).first) {
+    return std::nullopt; // empty box
+  }
+  switch (s.descend(0, 0, 0, true)) {
+    case search::result::NONE:
+      return std::nullopt;
+    case search::result::KEY:
+      return byte_string{key};
+    case search::result::CELL:
+      break;
+  }
+
+  BitWriter writer;
+  writer.reserve(key.size());
+  for (unsigned level = 0; level < _bits; ++level) {
+    writer.write_big_endian_bits(level < s.path.size() ? s.path[level] : 0, unsigned(_dimensions));
+  }
+  return std::move(writer).str();
+}
+
+auto zkd::HilbertBox::first() const -> std::optional<byte_string> {
+  return next(byte_string(_dimensions * _bits / 8, std::byte{0}));
+}
@@ -0,0 +1,71 @@
+#ifndef ZKD_TREE_HILBERT_CURVE_H
+#define ZKD_TREE_HILBERT_CURVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <vector>
+
+#include "library.h"
+
+namespace zkd {
+
+// The space filling curve that maps points to keys.
+enum class Curve {
+  Z_ORDER, // interleave
+  HILBERT  // hilbertEncode
+};
+
+std::ostream& operator<<(std::ostream& ostream, Curve curve);
+
+/*
+ * Hilbert index of a point. All coordinates must have the same length of at
+ * most 8 bytes, and there may be at most 32 dimensions. Like with interleave,
+ * the key has one bit per dimension and coordinate bit, but consecutive keys
+ * are always neighbours in space, which avoids the jumps of Z-order at the
+ * boundaries of its quadrants.
+ */
+auto hilbertEncode(std::vector<byte_string> const& coords) -> byte_string;
+auto hilbertDecode(byte_string_view key, std::size_t dimensions) -> std::vector<byte_string>;
+
+auto encodeKey(Curve curve, std::vector<byte_string> const& coords) -> byte_string;
+auto decodeKey(Curve curve, byte_string_view key, std::size_t dimensions) -> std::vector<byte_string>;
+
+/*
+ * A box for Hilbert keys. The box is given by its interleaved corners like
+ * for Z-order (see makeBox), but keys can't be compared with them bitwise, so
+ * they are decoded. next tries up to 2^dimensions child cells per level, so
+ * boxes allow at most 16 dimensions, which box queries over Hilbert keys
+ * inherit; the constructor throws std::invalid_argument beyond that.
+ */
+class HilbertBox {
+ public:
+  HilbertBox(byte_string_view min, byte_string_view max, std::size_t dimensions);
+
+  auto contains(byte_string_view key) const -> bool;
+
+  /*
+   * Smallest key not less than `key` that is inside of the box. Descends the
+   * Hilbert cells of `key`'s prefixes, backtracking to the next cell
+   * intersecting the box, until a cell is completely inside of the box.
+   */
+  auto next(byte_string_view key) const -> std::optional<byte_string>;
+
+  // smallest key inside of the box
+  auto first() const -> std::optional<byte_string>;
+
+  auto dimensions() const noexcept -> std::size_t { return _dimensions; }
+
+ private:
+  struct search;
+
+  std::size_t _dimensions;
+  unsigned _bits; // per dimension
+  std::vector<std::uint64_t> _min;
+  std::vector<std::uint64_t> _max;
+};
+
+} // namespace zkd
+
+#endif //ZKD_TREE_HILBERT_CURVE_H
@@ -0,0 +1,84 @@
+#include "interleave-schedule.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace zkd;
+
+zkd::InterleaveSchedule::InterleaveSchedule(std::vector<std::uint16_t> order) : _order(std::move(order)) {
+  if (_order.empty()) {
+    throw std::invalid_argument("interleave schedule must not be empty");
+  }
+  _steps.reserve(_order.size());
+  for (std::size_t bit = 0; bit < _order.size(); ++bit) {
+    auto const dim = _order[bit];
+    if (dim >= _positions.size()) {
+      _positions.resize(dim + 1);
+    }
+    _steps.push_back(unsigned(_positions[dim].size()));
+    _positions[dim].push_back(bit);
+  }
+  for (std::size_t dim = 0; dim < _positions.size(); ++dim) {
+    if (_positions[dim].empty()) {
+      throw std::invalid_argument("interleave schedule has no bits of dimension " + std::to_string(dim));
+    }
+  }
+}
+
+auto zkd::InterleaveSchedule::roundRobin(std::size_t dimensions, unsigned bitsPerDimension) -> InterleaveSchedule {
+  std::vector<std::uint16_t> order;
+  order.reserve(dimensions * bitsPerDimension);
+  for (unsigned step = 0; step < bitsPerDimension; ++step) {
+    for (std::size_t dim = 0; dim < dimensions; ++dim) {
+      order.push_back(std::uint16_t(dim));
+    }
+  }
+  return InterleaveSchedule(std::move(order));
+}
+
+auto zkd::InterleaveSchedule::roundRobin(std::vector<unsigned> const& budgets) -> InterleaveSchedule {
+  if (std::find(budgets.begin(), budgets.end(), 0u) != budgets.end()) {
+    throw std::invalid_argument("every dimension needs at least one bit");
+  }
+  std::vector<std::uint16_t> order;
+  auto const rounds = budgets.empty() ? 0 : *std::max_element(budgets.begin(), budgets.end());
+  for (unsigned step = 0; step < rounds; ++step) {
+    for (std::size_t dim = 0; dim < budgets.size(); ++dim) {
+      if (step < budgets[dim]) {
+        order.push_back(std::uint16_t(dim));
+      }
+    }
+  }
+  return InterleaveSchedule(std::move(order));
+}
+
+std::ostream& zkd::operator<<(std::ostream& ostream, InterleaveSchedule const& schedule) {
+  bool first = true;
+  for (auto dim : schedule.order()) {
+    if (!first) {
+      ostream << " ";
+    }
+    first = false;
+    ostream << dim;
+  }
+  return ostream;
+}
+
+auto zkd::parseInterleaveSchedule(std::string_view str) -> InterleaveSchedule {
+  std::vector<std::uint16_t> order;
+  std::stringstream ss{std::string{str}};
+  unsigned dim;
+  while (ss >> dim) {
+    if (dim > std::numeric_limits<std::uint16_t>::max()) {
+      throw std::invalid_argument("dimension out of range in interleave schedule");
+    }
+    order.push_back(std::uint16_t(dim));
+  }
+  if (!ss.eof()) {
+    throw std::invalid_argument("malformed interleave schedule");
+  }
+  return InterleaveSchedule(std::move(order));
+}
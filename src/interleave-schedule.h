@@ -0,0 +1,60 @@
+#ifndef ZKD_TREE_INTERLEAVE_SCHEDULE_H
+#define ZKD_TREE_INTERLEAVE_SCHEDULE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+namespace zkd {
+
+/*
+ * Order in which the bits of the coordinates are interleaved into a key.
+ * Every key bit, from the most significant one, is taken from the next
+ * unused bit of one dimension, starting at the dimension's most significant
+ * bit. interleave's round robin order is one schedule; others can put more
+ * bits of one dimension first, or take fewer bits of a dimension, dropping its
+ * least significant ones.
+ */
+class InterleaveSchedule {
+ public:
+  static constexpr auto npos = std::numeric_limits<std::size_t>::max();
+
+  // `order[i]` is the dimension of the i-th key bit, every dimension must occur
+  explicit InterleaveSchedule(std::vector<std::uint16_t> order);
+
+  static auto roundRobin(std::size_t dimensions, unsigned bitsPerDimension) -> InterleaveSchedule;
+  // round robin over the dimensions that have bits left, one bit per dimension and round
+  static auto roundRobin(std::vector<unsigned> const& budgets) -> InterleaveSchedule;
+
+  auto dimensions() const noexcept -> std::size_t { return _positions.size(); }
+  auto bits() const noexcept -> std::size_t { return _order.size(); }
+  auto order() const noexcept -> std::vector<std::uint16_t> const& { return _order; }
+
+  // number of bits of the dimension in the key
+  auto budget(std::size_t dim) const -> unsigned { return unsigned(_positions[dim].size()); }
+  auto dimension(std::size_t bit) const -> std::size_t { return _order[bit]; }
+  // index of the key bit within its dimension
+  auto step(std::size_t bit) const -> unsigned { return _steps[bit]; }
+  // key bit of the step-th bit of the dimension, npos if it is not part of the key
+  auto position(std::size_t dim, std::size_t step) const -> std::size_t {
+    return step < _positions[dim].size() ? _positions[dim][step] : npos;
+  }
+
+  auto operator==(InterleaveSchedule const& other) const noexcept -> bool { return _order == other._order; }
+
+ private:
+  std::vector<std::uint16_t> _order;
+  std::vector<unsigned> _steps;
+  std::vector<std::vector<std::size_t>> _positions;
+};
+
+// space separated dimension of every key bit
+std::ostream& operator<<(std::ostream& ostream, InterleaveSchedule const& schedule);
+auto parseInterleaveSchedule(std::string_view str) -> InterleaveSchedule;
+
+} // namespace zkd
+
+#endif //ZKD_TREE_INTERLEAVE_SCHEDULE_H
@@ -0,0 +1,274 @@
+#include "key-blocks.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "delta-buffer.h"
+
+using namespace zkd;
+
+namespace {
+auto viewFromSlice(rocksdb::Slice slice) -> byte_string_view {
+  return byte_string_view{reinterpret_cast<std::byte const*>(slice.data()), slice.size()};
+}
+
+auto sliceFromView(byte_string_view view) -> rocksdb::Slice {
+  return rocksdb::Slice(reinterpret_cast<char const*>(view.data()), view.size());
+}
+
+void putVarint(byte_string& out, std::size_t v) {
+  while (v >= 0x80) {
+    out.push_back(std::byte(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(std::byte(v));
+}
+
+// the blocks are written by the builder, so they are known to be well formed
+auto getVarint(byte_string_view data, std::size_t& offset) noexcept -> std::size_t {
+  std::size_t v = 0;
+  for (unsigned shift = 0;; shift += 7) {
+    auto const b = std::to_integer<std::size_t>(data[offset++]);
+    v |= (b & 0x7f) << shift;
+    if (b < 0x80) {
+      return v;
+    }
+  }
+}
+
+class key_block_iterator final : public rocksdb::Iterator {
+ public:
+  key_block_iterator(KeyBlockRun const& run, std::size_t* blocksDecoded)
+      : _run(run), _blocksDecoded(blocksDecoded), _block(run.blocks()) {}
+
+  bool Valid() const override { return _block < _run.blocks(); }
+
+  void SeekToFirst() override {
+    if (_run.blocks() == 0) {
+      return invalidate();
+    }
+    load(0);
+  }
+
+  void SeekToLast() override {
+    if (_run.blocks() == 0) {
+      return invalidate();
+    }
+    load(_run.blocks() - 1);
+    while (_next < _entries.size()) {
+      read();
+    }
+  }
+
+  void Seek(rocksdb::Slice const& target) override {
+    if (_run.blocks() == 0) {
+      return invalidate();
+    }
+    auto const t = viewFromSlice(target);
+    load(_run.findBlock(t));
+    while (Valid() && byte_string_view{_key} < t) {
+      Next();
+    }
+  }
+
+  void SeekForPrev(rocksdb::Slice const& target) override {
+    Seek(target);
+    if (!Valid()) {
+      SeekToLast();
+    } else if (byte_string_view{_key} != viewFromSlice(target)) {
+      Prev();
+    }
+  }
+
+  void Next() override {
+    if (_next < _entries.size()) {
+      read();
+    } else if (_block + 1 < _run.blocks()) {
+      load(_block + 1);
+    } else {
+      invalidate();
+    }
+  }
+
+  void Prev() override {
+    if (_index == 0) {
+      if (_block == 0) {
+        return invalidate();
+      }
+      load(_block - 1);
+      while (_next < _entries.size()) {
+        read();
+      }
+      return;
+    }
+    // entries can only be decoded forwards
+    auto const target = _index - 1;
+    load(_block);
+    while (_index < target) {
+      read();
+    }
+  }
+
+  rocksdb::Slice key() const override { return sliceFromView(_key); }
+  rocksdb::Slice value() const override { return sliceFromView(_value); }
+  rocksdb::Status status() const override { return rocksdb::Status::OK(); }
+
+ private:
+  void invalidate() noexcept { _block = _run.blocks(); }
+
+  // positions on the first entry of the block
+  void load(std::size_t block) {
+    _block = block;
+    _entries = _run.block(block);
+    _next = 0;
+    _index = 0;
+    _key.clear();
+    if (_blocksDecoded != nullptr) {
+      *_blocksDecoded += 1;
+    }
+    decode();
+  }
+
+  void read() {
+    ++_index;
+    decode();
+  }
+
+  void decode() {
+    auto const shared = getVarint(_entries, _next);
+    auto const nonShared = getVarint(_entries, _next);
+    auto const valueSize = getVarint(_entries, _next);
+    _key.resize(shared);
+    _key.append(_entries.substr(_next, nonShared));
+    _value = _entries.substr(_next + nonShared, valueSize);
+    _next += nonShared + valueSize;
+  }
+
+  KeyBlockRun const& _run;
+  std::size_t* _blocksDecoded;
+  std::size_t _block;
+  byte_string_view _entries;
+  std::size_t _next = 0;  // offset of the following entry in _entries
+  std::size_t _index = 0; // of the current entry in its block
+  byte_string _key;
+  byte_string_view _value;
+};
+} // namespace
+
+zkd::KeyBlockRun::Builder::Builder(KeyBlockOptions const& options) : _keysPerBlock(options.keysPerBlock) {
+  if (_keysPerBlock == 0) {
+    throw std::invalid_argument("key blocks must hold at least one key");
+  }
+}
+
+void zkd::KeyBlockRun::Builder::add(byte_string_view key, byte_string_view value) {
+  if (_count > 0 && key <= byte_string_view{_last}) {
+    throw std::invalid_argument("keys of a key block run must be strictly increasing");
+  }
+  std::size_t shared = 0;
+  if (_count % _keysPerBlock == 0) {
+    _blocks.push_back(_data.size());
+  } else {
+    auto const limit = std::min(key.size(), _last.size());
+    while (shared < limit && key[shared] == _last[shared]) {
+      ++shared;
+    }
+  }
+  putVarint(_data, shared);
+  putVarint(_data, key.size() - shared);
+  putVarint(_data, value.size());
+  _data.append(key.substr(shared));
+  _data.append(value);
+
+  _last.resize(shared);
+  _last.append(key.substr(shared));
+  _count += 1;
+  _rawSize += key.size() + value.size();
+}
+
+auto zkd::KeyBlockRun::Builder::finish(InterleaveSchedule const* schedule) && -> KeyBlockRun {
+  KeyBlockRun run;
+  _data.shrink_to_fit();
+  _blocks.shrink_to_fit();
+  run._data = std::move(_data);
+  run._blocks = std::move(_blocks);
+  run._count = _count;
+  run._rawSize = _rawSize;
+  if (schedule != nullptr) {
+    run._schedule = std::make_shared<InterleaveSchedule const>(*schedule);
+  }
+  return run;
+}
+
+auto zkd::KeyBlockRun::memoryUsage() const noexcept -> std::size_t {
+  return _data.capacity() + _blocks.capacity() * sizeof(std::size_t);
+}
+
+auto zkd::KeyBlockRun::block(std::size_t block) const noexcept -> byte_string_view {
+  auto const end = block + 1 < _blocks.size() ? _blocks[block + 1] : _data.size();
+  return byte_string_view{_data}.substr(_blocks[block], end - _blocks[block]);
+}
+
+auto zkd::KeyBlockRun::firstKey(std::size_t block) const noexcept -> byte_string_view {
+  auto const entries = this->block(block);
+  std::size_t offset = 0;
+  getVarint(entries, offset); // shared, always 0
+  auto const size = getVarint(entries, offset);
+  getVarint(entries, offset);
+  return entries.substr(offset, size);
+}
+
+auto zkd::KeyBlockRun::findBlock(byte_string_view target) const noexcept -> std::size_t {
+  // first block whose first key is greater than the target
+  std::size_t lo = 0, hi = _blocks.size();
+  while (lo < hi) {
+    auto const mid = lo + (hi - lo) / 2;
+    if (firstKey(mid) <= target) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo == 0 ? 0 : lo - 1;
+}
+
+auto zkd::KeyBlockRun::newIterator(std::size_t* blocksDecoded) const -> std::unique_ptr<rocksdb::Iterator> {
+  return std::make_unique<key_block_iterator>(*this, blocksDecoded);
+}
+
+auto zkd::buildKeyBlocks(RocksDBHandle& rocks, KeyBlockOptions const& options) -> KeyBlockRun {
+  if (rocks.curve != Curve::Z_ORDER) {
+    throw std::invalid_argument("key blocks require Z-order keys");
+  }
+  KeyBlockRun::Builder builder(options);
+  auto buffered = snapshotDeltaBuffer(rocks);
+  auto const snapshot = rocks.db->GetSnapshot();
+  rocksdb::ReadOptions readOptions;
+  readOptions.snapshot = snapshot;
+  readOptions.fill_cache = false;
+  auto iter = newMergedIterator(rocks, readOptions, buffered);
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    builder.add(viewFromSlice(iter->key()), viewFromSlice(iter->value()));
+  }
+  auto s = iter->status();
+  iter.reset();
+  rocks.db->ReleaseSnapshot(snapshot);
+  if (!s.ok()) {
+    throw std::runtime_error(s.ToString());
+  }
+  return std::move(builder).finish(rocks.schedule.get());
+}
+
+auto zkd::findAllInBox(KeyBlockRun const& run, Box const& box, BoxQueryCallback const& callback) -> std::size_t {
+  QueryStats stats;
+  return findAllInBox(run, box, callback, stats);
+}
+
+auto zkd::findAllInBox(KeyBlockRun const& run, Box const& box, BoxQueryCallback const& callback, QueryStats& stats)
+  -> std::size_t {
+  std::size_t blocksDecoded = 0;
+  auto iter = run.newIterator(&blocksDecoded);
+  auto num_seeks = findAllInBox(*iter, box, run.schedule(), callback, stats);
+  stats.storage.blockReads += blocksDecoded;
+  return num_seeks;
+}
@@ -0,0 +1,101 @@
+#ifndef ZKD_TREE_KEY_BLOCKS_H
+#define ZKD_TREE_KEY_BLOCKS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <rocksdb/iterator.h>
+
+#include "box-query.h"
+#include "interleave-schedule.h"
+#include "library.h"
+#include "query-stats.h"
+#include "rocksdb-handle.h"
+
+namespace zkd {
+
+struct KeyBlockOptions {
+  // keys per block; larger blocks compress better, but a seek decodes more
+  std::size_t keysPerBlock = 16;
+};
+
+/*
+ * A sorted run of key/value pairs held in memory, in blocks of front coded
+ * keys. Every entry stores the length of the prefix it shares with the
+ * previous key, the rest of its key and its value:
+ *
+ *   varint shared | varint non-shared | varint value size | key suffix | value
+ *
+ * The first entry of a block shares nothing, so its key doubles as the skip
+ * pointer: a seek binary searches the first keys and decodes a single block.
+ * Z-keys of neighbouring points share their high bits, so most keys shrink to
+ * a few bytes.
+ */
+class KeyBlockRun {
+ public:
+  class Builder {
+   public:
+    explicit Builder(KeyBlockOptions const& options = {});
+
+    // keys must be strictly increasing, throws std::invalid_argument otherwise
+    void add(byte_string_view key, byte_string_view value);
+    auto finish(InterleaveSchedule const* schedule = nullptr) && -> KeyBlockRun;
+
+   private:
+    std::size_t _keysPerBlock;
+    byte_string _data;
+    std::vector<std::size_t> _blocks;
+    byte_string _last;
+    std::size_t _count = 0;
+    std::size_t _rawSize = 0;
+  };
+
+  KeyBlockRun() = default;
+
+  auto size() const noexcept -> std::size_t { return _count; }
+  auto blocks() const noexcept -> std::size_t { return _blocks.size(); }
+  // bytes held by the blocks and skip pointers
+  auto memoryUsage() const noexcept -> std::size_t;
+  // bytes of all keys and values stored in full
+  auto rawSize() const noexcept -> std::size_t { return _rawSize; }
+  // nullptr for round robin
+  auto schedule() const noexcept -> InterleaveSchedule const* { return _schedule.get(); }
+
+  // the encoded entries of a block
+  auto block(std::size_t block) const noexcept -> byte_string_view;
+  auto firstKey(std::size_t block) const noexcept -> byte_string_view;
+  // index of the last block whose first key is not greater than `target`, 0 if there is none
+  auto findBlock(byte_string_view target) const noexcept -> std::size_t;
+
+  /*
+   * Iterates over the pairs like a RocksDB iterator, so box queries run
+   * unchanged. Keys are reassembled into a buffer of the iterator and stay
+   * valid until it moves. Decoded blocks are counted in `blocksDecoded`, if
+   * given.
+   */
+  auto newIterator(std::size_t* blocksDecoded = nullptr) const -> std::unique_ptr<rocksdb::Iterator>;
+
+ private:
+  byte_string _data;
+  std::vector<std::size_t> _blocks; // offsets of the blocks in _data
+  std::size_t _count = 0;
+  std::size_t _rawSize = 0;
+  std::shared_ptr<InterleaveSchedule const> _schedule;
+};
+
+// all pairs of the handle, as of one RocksDB snapshot with the delta buffer merged in, with its interleave schedule; Z-order only
+auto buildKeyBlocks(RocksDBHandle& rocks, KeyBlockOptions const& options = {}) -> KeyBlockRun;
+
+/*
+ * findAllInBox over the run, with its interleave schedule. Decoded blocks are
+ * counted as block reads of the stats.
+ */
+auto findAllInBox(KeyBlockRun const& run, Box const& box, BoxQueryCallback const& callback) -> std::size_t;
+auto findAllInBox(KeyBlockRun const& run, Box const& box, BoxQueryCallback const& callback, QueryStats& stats)
+  -> std::size_t;
+
+} // namespace zkd
+
+#endif //ZKD_TREE_KEY_BLOCKS_H
@@ -228,12 +228,71 @@ fuckoff_cxx:
   return result;
 }
 
-auto zkd::compareWithBox(byte_string_view cur, byte_string_view min, byte_string_view max, std::size_t dimensions)
-  -> std::vector<CompareResult> {
+auto zkd::interleave(std::vector<byte_string> const& vec, InterleaveSchedule const& schedule) -> byte_string {
+  if (vec.size() != schedule.dimensions()) {
+    throw std::invalid_argument{"number of coordinates does not match the interleave schedule"};
+  }
+  BitWriter bitWriter;
+  bitWriter.reserve((schedule.bits() + 7) / 8);
+  for (std::size_t bit = 0; bit < schedule.bits(); ++bit) {
+    auto const& coord = vec[schedule.dimension(bit)];
+    auto const step = schedule.step(bit);
+    bitWriter.append(step < 8 * coord.size() ? RandomBitReader(coord).getBit(step) : Bit::ZERO);
+  }
+  return std::move(bitWriter).str();
+}
+
+auto zkd::transpose(byte_string_view bs, InterleaveSchedule const& schedule) -> std::vector<byte_string> {
+  std::vector<BitWriter> writer;
+  writer.resize(schedule.dimensions());
+  BitReader reader(bs);
+  for (std::size_t bit = 0; bit < schedule.bits(); ++bit) {
+    writer[schedule.dimension(bit)].append(reader.next_or_zero());
+  }
+
+  std::vector<zkd::byte_string> result;
+  std::transform(writer.begin(), writer.end(), std::back_inserter(result), [](auto& bs) {
+    return std::move(bs).str();
+  });
+  return result;
+}
+
+namespace {
+/*
+ * Where the bits of the dimensions are in a key. The kernels below are written
+ * against this interface, so the round robin order of interleave doesn't pay
+ * for the table lookups of an InterleaveSchedule.
+ */
+struct round_robin {
+  std::size_t dims;
+
+  auto dimensions() const noexcept -> std::size_t { return dims; }
+  auto bits() const noexcept -> std::size_t { return InterleaveSchedule::npos; }
+  auto dimension(std::size_t bit) const noexcept -> std::size_t { return bit % dims; }
+  auto step(std::size_t bit) const noexcept -> unsigned { return unsigned(bit / dims); }
+  auto position(std::size_t dim, std::size_t step) const noexcept -> std::size_t { return dims * step + dim; }
+  auto interleave(std::vector<byte_string> const& coords) const -> byte_string { return zkd::interleave(coords); }
+  auto transpose(byte_string_view key) const -> std::vector<byte_string> { return zkd::transpose(key, dims); }
+};
+
+struct scheduled {
+  InterleaveSchedule const& schedule;
+
+  auto dimensions() const noexcept -> std::size_t { return schedule.dimensions(); }
+  auto bits() const noexcept -> std::size_t { return schedule.bits(); }
+  auto dimension(std::size_t bit) const -> std::size_t { return schedule.dimension(bit); }
+  auto step(std::size_t bit) const -> unsigned { return schedule.step(bit); }
+  auto position(std::size_t dim, std::size_t step) const -> std::size_t { return schedule.position(dim, step); }
+  auto interleave(std::vector<byte_string> const& coords) const -> byte_string { return zkd::interleave(coords, schedule); }
+  auto transpose(byte_string_view key) const -> std::vector<byte_string> { return zkd::transpose(key, schedule); }
+};
+
+template<typename Layout>
+auto compareWithBoxImpl(byte_string_view cur, byte_string_view min, byte_string_view max, Layout const& layout,
+                        DimensionBounds const* bounds) -> std::vector<CompareResult> {
+  auto const dimensions = layout.dimensions();
   if (dimensions == 0) {
-    auto msg = std::string{"dimensions argument to "};
-    msg += __func__;
-    msg += " must be greater than zero.";
+    auto msg = std::string{"dimensions argument to compareWithBox must be greater than zero."};
     throw std::invalid_argument{msg};
   }
   std::vector<CompareResult> result;
@@ -250,15 +309,35 @@ auto zkd::compareWithBox(byte_string_view cur, byte_string_view min, byte_string
   isLargerThanMin.resize(dimensions);
   isLowerThanMax.resize(dimensions);
 
-  for (std::size_t i = 0; i < 8 * max_size; i++) {
-    unsigned step = i / dimensions;
-    unsigned dim = i % dimensions;
+  // dimensions that are neither outside nor known to be inside on both sides
+  std::size_t undecided = dimensions;
+  if (bounds != nullptr) {
+    for (std::size_t dim = 0; dim < dimensions; ++dim) {
+      // an unbounded side is passed right away
+      if (!bounds[dim].min) {
+        isLargerThanMin[dim] = true;
+        result[dim].saveMin = 0;
+      }
+      if (!bounds[dim].max) {
+        isLowerThanMax[dim] = true;
+        result[dim].saveMax = 0;
+      }
+      if (isLargerThanMin[dim] && isLowerThanMax[dim]) {
+        --undecided;
+      }
+    }
+  }
+
+  auto const bits = std::min(8 * max_size, layout.bits());
+  for (std::size_t i = 0; i < bits && undecided > 0; i++) {
+    unsigned step = layout.step(i);
+    auto dim = layout.dimension(i);
 
     auto cur_bit = cur_reader.next().value_or(Bit::ZERO);
     auto min_bit = min_reader.next().value_or(Bit::ZERO);
     auto max_bit = max_reader.next().value_or(Bit::ZERO);
 
-    if (result[dim].flag != 0) {
+    if (result[dim].flag != 0 || (isLargerThanMin[dim] && isLowerThanMax[dim])) {
       continue;
     }
 
@@ -281,10 +360,63 @@ auto zkd::compareWithBox(byte_string_view cur, byte_string_view min, byte_string
         result[dim].saveMax = step;
       }
     }
+
+    if (result[dim].flag != 0 || (isLargerThanMin[dim] && isLowerThanMax[dim])) {
+      --undecided;
+    }
   }
 
   return result;
 }
+} // namespace
+
+namespace {
+template<typename Layout>
+auto makeBoxImpl(std::vector<std::optional<byte_string>> const& min, std::vector<std::optional<byte_string>> const& max,
+                 std::size_t coordinateSize, Layout const& layout) -> Box {
+  if (min.size() != max.size() || min.empty()) {
+    throw std::invalid_argument{"makeBox needs the same, non-zero number of lower and upper bounds"};
+  }
+
+  std::vector<byte_string> lower, upper;
+  Box box;
+  box.mask.resize(min.size());
+  for (std::size_t dim = 0; dim < min.size(); ++dim) {
+    box.mask[dim].min = min[dim].has_value();
+    box.mask[dim].max = max[dim].has_value();
+    lower.push_back(min[dim].value_or(byte_string(coordinateSize, 0_b)));
+    upper.push_back(max[dim].value_or(byte_string(coordinateSize, 0xff_b)));
+  }
+  box.min = layout.interleave(lower);
+  box.max = layout.interleave(upper);
+  return box;
+}
+} // namespace
+
+auto zkd::makeBox(std::vector<std::optional<byte_string>> const& min, std::vector<std::optional<byte_string>> const& max,
+                  std::size_t coordinateSize) -> Box {
+  return makeBoxImpl(min, max, coordinateSize, round_robin{min.size()});
+}
+
+auto zkd::makeBox(std::vector<std::optional<byte_string>> const& min, std::vector<std::optional<byte_string>> const& max,
+                  std::size_t coordinateSize, InterleaveSchedule const& schedule) -> Box {
+  return makeBoxImpl(min, max, coordinateSize, scheduled{schedule});
+}
+
+auto zkd::compareWithBox(byte_string_view cur, byte_string_view min, byte_string_view max, std::size_t dimensions)
+  -> std::vector<CompareResult> {
+  return compareWithBoxImpl(cur, min, max, round_robin{dimensions}, nullptr);
+}
+
+auto zkd::compareWithBox(byte_string_view cur, byte_string_view min, byte_string_view max, BoxMask const& mask)
+  -> std::vector<CompareResult> {
+  return compareWithBoxImpl(cur, min, max, round_robin{mask.size()}, mask.data());
+}
+
+auto zkd::compareWithBox(byte_string_view cur, byte_string_view min, byte_string_view max, InterleaveSchedule const& schedule)
+  -> std::vector<CompareResult> {
+  return compareWithBoxImpl(cur, min, max, scheduled{schedule}, nullptr);
+}
 
 auto zkd::testInBox(byte_string_view cur, byte_string_view min, byte_string_view max, std::size_t dimensions)
   -> bool {
@@ -295,13 +427,27 @@ auto zkd::testInBox(byte_string_view cur, byte_string_view min, byte_string_view
   });
 }
 
-auto zkd::getNextZValue(byte_string_view cur, byte_string_view min, byte_string_view max, std::vector<CompareResult>& cmpResult)
-  -> std::optional<byte_string> {
+auto zkd::testInBox(byte_string_view cur, byte_string_view min, byte_string_view max, BoxMask const& mask)
+  -> bool {
+  auto cmp = compareWithBox(cur, min, max, mask);
 
-  auto result = byte_string{cur};
+  return std::all_of(cmp.begin(), cmp.end(), [](auto const& r) {
+    return r.flag == 0;
+  });
+}
 
-  auto const dims = cmpResult.size();
+auto zkd::testInBox(byte_string_view cur, byte_string_view min, byte_string_view max, InterleaveSchedule const& schedule)
+  -> bool {
+  auto cmp = compareWithBox(cur, min, max, schedule);
 
+  return std::all_of(cmp.begin(), cmp.end(), [](auto const& r) {
+    return r.flag == 0;
+  });
+}
+
+namespace {
+template<typename Layout>
+auto limitingDimensionImpl(std::vector<CompareResult> const& cmpResult, Layout const& layout) -> std::size_t {
   auto minOutstepIter = std::min_element(cmpResult.begin(), cmpResult.end(), [&](auto const& a, auto const& b) {
     if (a.flag == 0) {
       return false;
@@ -309,21 +455,43 @@ auto zkd::getNextZValue(byte_string_view cur, byte_string_view min, byte_string_
     if (b.flag == 0) {
       return true;
     }
-    return a.outStep < b.outStep;
+    return layout.position(&a - cmpResult.data(), a.outStep) < layout.position(&b - cmpResult.data(), b.outStep);
   });
   assert(minOutstepIter->flag != 0);
-  auto const d = std::distance(cmpResult.begin(), minOutstepIter);
+  return std::distance(cmpResult.begin(), minOutstepIter);
+}
+} // namespace
+
+auto zkd::limitingDimension(std::vector<CompareResult> const& cmpResult) -> std::size_t {
+  return limitingDimensionImpl(cmpResult, round_robin{cmpResult.size()});
+}
+
+auto zkd::limitingDimension(std::vector<CompareResult> const& cmpResult, InterleaveSchedule const& schedule) -> std::size_t {
+  return limitingDimensionImpl(cmpResult, scheduled{schedule});
+}
+
+namespace {
+template<typename Layout>
+auto getNextZValueImpl(byte_string_view cur, byte_string_view min, byte_string_view max,
+                       std::vector<CompareResult>& cmpResult, Layout const& layout) -> std::optional<byte_string> {
+
+  auto result = byte_string{cur};
+
+  auto const dims = cmpResult.size();
+
+  auto const d = limitingDimensionImpl(cmpResult, layout);
+  auto const minOutstepIter = cmpResult.begin() + d;
 
   RandomBitReader nisp(cur);
 
-  std::size_t changeBP = dims * minOutstepIter->outStep + d;
+  std::size_t changeBP = layout.position(d, minOutstepIter->outStep);
 
   if (minOutstepIter->flag > 0) {
     while (changeBP != 0) {
       --changeBP;
       if (nisp.getBit(changeBP) == Bit::ZERO) {
-        auto dim = changeBP % dims;
-        auto step = changeBP / dims;
+        auto dim = layout.dimension(changeBP);
+        auto step = layout.step(changeBP);
         if (cmpResult[dim].saveMax <= step) {
           cmpResult[dim].saveMin = step;
           cmpResult[dim].flag = 0;
@@ -341,20 +509,20 @@ update_dims:
   rbm.setBit(changeBP, Bit::ONE);
   assert(rbm.getBit(changeBP) == Bit::ONE);
 
-  auto min_trans = transpose(min, dims);
-  auto next_v = transpose(result, dims);
+  auto min_trans = layout.transpose(min);
+  auto next_v = layout.transpose(result);
 
   for (unsigned dim = 0; dim < dims; dim++) {
     auto& cmpRes = cmpResult[dim];
     if (cmpRes.flag >= 0) {
-      auto bp = dims * cmpRes.saveMin + dim;
+      auto bp = layout.position(dim, cmpRes.saveMin);
       if (changeBP >= bp) {
         // “set all bits of dim with bit positions > changeBP to 0”
         BitReader br(next_v[dim]);
         BitWriter bw;
         size_t i = 0;
         while (auto bit = br.next()) {
-          if (i * dims + dim > changeBP) {
+          if (layout.position(dim, i) > changeBP) {
             break;
           }
           bw.append(bit.value());
@@ -367,7 +535,7 @@ update_dims:
         BitWriter bw;
         size_t i = 0;
         while (auto bit = br.next()) {
-          if (i * dims + dim > changeBP) {
+          if (layout.position(dim, i) > changeBP) {
             break;
           }
           bw.append(bit.value());
@@ -388,7 +556,142 @@ update_dims:
     }
   }
 
-  return interleave(next_v);
+  return layout.interleave(next_v);
+}
+} // namespace
+
+auto zkd::getNextZValue(byte_string_view cur, byte_string_view min, byte_string_view max, std::vector<CompareResult>& cmpResult)
+  -> std::optional<byte_string> {
+  return getNextZValueImpl(cur, min, max, cmpResult, round_robin{cmpResult.size()});
+}
+
+auto zkd::getNextZValue(byte_string_view cur, byte_string_view min, byte_string_view max, std::vector<CompareResult>& cmpResult,
+                        InterleaveSchedule const& schedule) -> std::optional<byte_string> {
+  if (cmpResult.size() != schedule.dimensions()) {
+    throw std::invalid_argument{"comparison result does not match the interleave schedule"};
+  }
+  return getNextZValueImpl(cur, min, max, cmpResult, scheduled{schedule});
+}
+
+auto zkd::cellUpperBound(byte_string_view lo, unsigned bits) -> byte_string {
+  auto hi = byte_string{lo};
+  for (std::size_t i = bits / 8; i < hi.size(); ++i) {
+    if (i == bits / 8 && bits % 8 != 0) {
+      hi[i] |= std::byte(0xffu >> (bits % 8));
+    } else {
+      hi[i] = 0xff_b;
+    }
+  }
+  return hi;
+}
+
+auto zkd::relateCellToBox(byte_string_view lo, unsigned bits, byte_string_view min, byte_string_view max, std::size_t dimensions)
+  -> CellRelation {
+  auto const hi = cellUpperBound(lo, bits);
+  auto const loCmp = compareWithBox(lo, min, max, dimensions);
+  auto const hiCmp = compareWithBox(hi, min, max, dimensions);
+
+  auto result = CellRelation::CONTAINED;
+  for (std::size_t d = 0; d < dimensions; ++d) {
+    if (hiCmp[d].flag < 0 || loCmp[d].flag > 0) {
+      return CellRelation::DISJOINT;
+    }
+    if (loCmp[d].flag != 0 || hiCmp[d].flag != 0) {
+      result = CellRelation::PARTIAL;
+    }
+  }
+  return result;
+}
+
+namespace {
+struct cover_cell {
+  byte_string lo;
+  unsigned bits;
+  bool contained;
+};
+
+// whether b is the key directly following a, both of the same length
+auto isSuccessor(byte_string_view a, byte_string_view b) -> bool {
+  auto next = byte_string{a};
+  for (auto it = next.rbegin(); it != next.rend(); ++it) {
+    *it = std::byte(std::to_integer<unsigned>(*it) + 1);
+    if (*it != 0_b) {
+      return next == b;
+    }
+  }
+  return false;
+}
+
+auto countRuns(std::vector<cover_cell> const& cells) -> std::size_t {
+  std::size_t runs = 0;
+  for (std::size_t i = 0; i < cells.size(); ++i) {
+    if (i == 0 || !isSuccessor(cellUpperBound(cells[i - 1].lo, cells[i - 1].bits), cells[i].lo)) {
+      runs += 1;
+    }
+  }
+  return runs;
+}
+} // namespace
+
+auto zkd::coverBox(byte_string_view min, byte_string_view max, std::size_t dimensions, unsigned maxBits, std::size_t maxIntervals)
+  -> BoxCover {
+  auto const length = std::max(min.size(), max.size());
+  maxBits = std::min<unsigned>(maxBits, 8 * length);
+
+  unsigned bits = 0;
+  std::vector<cover_cell> cells;
+  {
+    auto root = byte_string(length, 0_b);
+    auto relation = relateCellToBox(root, 0, min, max, dimensions);
+    if (relation != CellRelation::DISJOINT) {
+      cells.push_back({std::move(root), 0, relation == CellRelation::CONTAINED});
+    }
+  }
+
+  // refine the boundary cells one bit at a time
+  while (bits < maxBits) {
+    bool const done = std::all_of(cells.begin(), cells.end(), [](auto const& c) { return c.contained; });
+    if (done) {
+      break;
+    }
+
+    std::vector<cover_cell> refined;
+    for (auto const& cell : cells) {
+      if (cell.contained) {
+        refined.push_back(cell);
+        continue;
+      }
+      for (auto bit : {Bit::ZERO, Bit::ONE}) {
+        auto child = cell.lo;
+        RandomBitManipulator(child).setBit(bits, bit);
+        auto relation = relateCellToBox(child, bits + 1, min, max, dimensions);
+        if (relation != CellRelation::DISJOINT) {
+          refined.push_back({std::move(child), bits + 1, relation == CellRelation::CONTAINED});
+        }
+      }
+    }
+
+    if (countRuns(refined) > maxIntervals && bits > 0) {
+      break;
+    }
+    cells = std::move(refined);
+    bits += 1;
+  }
+
+  // cells are sorted, so adjacent cells merge into a single interval
+  BoxCover cover;
+  cover.bits = bits;
+  cover.partialCells = std::count_if(cells.begin(), cells.end(), [](auto const& c) { return !c.contained; });
+  cover.exact = cover.partialCells == 0;
+  for (auto const& cell : cells) {
+    auto hi = cellUpperBound(cell.lo, cell.bits);
+    if (!cover.intervals.empty() && isSuccessor(cover.intervals.back().hi, cell.lo)) {
+      cover.intervals.back().hi = std::move(hi);
+    } else {
+      cover.intervals.push_back({cell.lo, std::move(hi)});
+    }
+  }
+  return cover;
 }
 
 template<typename T>
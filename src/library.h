@@ -7,6 +7,8 @@
 #include <string>
 #include <vector>
 
+#include "interleave-schedule.h"
+
 namespace zkd {
 
 static std::byte operator"" _b(unsigned long long b) {
@@ -28,6 +30,15 @@ std::ostream& operator<<(std::ostream& ostream, byte_string_view string);
 auto interleave(std::vector<byte_string> const& vec) -> byte_string;
 auto transpose(byte_string_view bs, std::size_t dimensions) -> std::vector<byte_string>;
 
+/*
+ * Interleaving with a schedule takes the first `schedule.budget(dim)` bits of
+ * every coordinate, missing bits being zero, and produces keys of
+ * `schedule.bits()` bits, padded with zeros to whole bytes. transpose returns
+ * coordinates of `schedule.budget(dim)` bits, padded likewise.
+ */
+auto interleave(std::vector<byte_string> const& vec, InterleaveSchedule const& schedule) -> byte_string;
+auto transpose(byte_string_view bs, InterleaveSchedule const& schedule) -> std::vector<byte_string>;
+
 struct CompareResult {
   static constexpr auto max = std::numeric_limits<unsigned>::max();
 
@@ -39,14 +50,107 @@ struct CompareResult {
 
 std::ostream& operator<<(std::ostream& ostream, CompareResult const& string);
 
+/*
+ * Which bounds of a dimension are set. A dimension without a lower (upper)
+ * bound is unbounded below (above) and excluded from the comparison, so its bits
+ * in the interleaved min (max) are never looked at.
+ */
+struct DimensionBounds {
+  bool min = true;
+  bool max = true;
+};
+
+using BoxMask = std::vector<DimensionBounds>;
+
+// A box with interleaved corners, possibly unbounded in some dimensions.
+struct Box {
+  byte_string min;
+  byte_string max;
+  BoxMask mask;
+
+  auto dimensions() const noexcept -> std::size_t { return mask.size(); }
+};
+
+/*
+ * Builds a box from per-dimension bounds, std::nullopt meaning unbounded. Missing
+ * bounds are filled with the smallest or largest coordinate of `coordinateSize`
+ * bytes, so the corners are valid for unmasked comparisons, too.
+ */
+auto makeBox(std::vector<std::optional<byte_string>> const& min, std::vector<std::optional<byte_string>> const& max,
+             std::size_t coordinateSize) -> Box;
+// Same with corners interleaved with the schedule.
+auto makeBox(std::vector<std::optional<byte_string>> const& min, std::vector<std::optional<byte_string>> const& max,
+             std::size_t coordinateSize, InterleaveSchedule const& schedule) -> Box;
+
 auto compareWithBox(byte_string_view cur, byte_string_view min, byte_string_view max, std::size_t dimensions)
   -> std::vector<CompareResult>;
+auto compareWithBox(byte_string_view cur, byte_string_view min, byte_string_view max, BoxMask const& mask)
+  -> std::vector<CompareResult>;
 auto testInBox(byte_string_view cur, byte_string_view min, byte_string_view max, std::size_t dimensions)
   -> bool;
+auto testInBox(byte_string_view cur, byte_string_view min, byte_string_view max, BoxMask const& mask)
+  -> bool;
 
 auto getNextZValue(byte_string_view cur, byte_string_view min, byte_string_view max, std::vector<CompareResult>& cmpResult)
   -> std::optional<byte_string>;
 
+/*
+ * The same for keys interleaved with a schedule; the steps in the
+ * CompareResults count the bits of each dimension, so they are only
+ * meaningful together with the schedule.
+ */
+auto compareWithBox(byte_string_view cur, byte_string_view min, byte_string_view max, InterleaveSchedule const& schedule)
+  -> std::vector<CompareResult>;
+auto testInBox(byte_string_view cur, byte_string_view min, byte_string_view max, InterleaveSchedule const& schedule)
+  -> bool;
+auto getNextZValue(byte_string_view cur, byte_string_view min, byte_string_view max, std::vector<CompareResult>& cmpResult,
+                   InterleaveSchedule const& schedule) -> std::optional<byte_string>;
+
+/*
+ * The dimension getNextZValue increments the key in: the one leaving the box at
+ * the most significant bit. `cmpResult` must not be inside of the box.
+ */
+auto limitingDimension(std::vector<CompareResult> const& cmpResult) -> std::size_t;
+auto limitingDimension(std::vector<CompareResult> const& cmpResult, InterleaveSchedule const& schedule) -> std::size_t;
+
+/*
+ * A Z-prefix cell is the set of all keys sharing their first `bits` bits with
+ * `lo`, which must have all following bits cleared. Because the box is a product
+ * of intervals, so is the cell, and comparing its smallest and largest key with
+ * the box tells how they relate.
+ */
+enum class CellRelation {
+  DISJOINT,
+  PARTIAL,
+  CONTAINED
+};
+
+auto cellUpperBound(byte_string_view lo, unsigned bits) -> byte_string;
+auto relateCellToBox(byte_string_view lo, unsigned bits, byte_string_view min, byte_string_view max, std::size_t dimensions)
+  -> CellRelation;
+
+// closed interval [lo, hi] of keys
+struct ZInterval {
+  byte_string lo;
+  byte_string hi;
+};
+
+struct BoxCover {
+  std::vector<ZInterval> intervals;
+  unsigned bits = 0;  // prefix length of the cells the intervals were built from
+  std::size_t partialCells = 0; // cells on the boundary, only partially inside of the box
+  bool exact = false;            // whether the intervals contain only keys inside of the box
+};
+
+/*
+ * Covers the box with disjoint Z-intervals, in Z-order. The box is split into
+ * Z-prefix cells of up to `maxBits` bits, cells on the boundary of the box are
+ * covered completely. The prefix length is increased as long as the cover
+ * needs no more than `maxIntervals` intervals.
+ */
+auto coverBox(byte_string_view min, byte_string_view max, std::size_t dimensions, unsigned maxBits, std::size_t maxIntervals)
+  -> BoxCover;
+
 template<typename T>
 auto to_byte_string_fixed_length(T) -> zkd::byte_string;
 template<typename T>
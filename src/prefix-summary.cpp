@@ -0,0 +1,248 @@
+#include "prefix-summary.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+#include "box-query.h"
+#include "delta-buffer.h"
+
+using namespace zkd;
+
+namespace {
+auto sliceFromString(byte_string_view str) -> rocksdb::Slice {
+  return rocksdb::Slice(reinterpret_cast<char const*>(str.data()), str.size());
+}
+
+auto viewFromSlice(rocksdb::Slice slice) -> byte_string_view {
+  return byte_string_view{reinterpret_cast<std::byte const*>(slice.data()), slice.size()};
+}
+
+// counts are stored as 8 byte big endian two's complement, so deltas can be negative
+auto encodeCount(std::uint64_t count) -> byte_string {
+  return to_byte_string_fixed_length<std::uint64_t>(count);
+}
+
+auto decodeCount(rocksdb::Slice slice) -> std::uint64_t {
+  if (slice.size() != sizeof(std::uint64_t)) {
+    throw std::runtime_error{"invalid prefix summary value of size " + std::to_string(slice.size())};
+  }
+  return from_byte_string_fixed_length<std::uint64_t>(viewFromSlice(slice));
+}
+
+class CountMergeOperator final : public rocksdb::AssociativeMergeOperator {
+ public:
+  bool Merge(const rocksdb::Slice& key, const rocksdb::Slice* existing_value, const rocksdb::Slice& value,
+             std::string* new_value, rocksdb::Logger* logger) const override {
+    if (value.size() != sizeof(std::uint64_t) || (existing_value != nullptr && existing_value->size() != sizeof(std::uint64_t))) {
+      return false;
+    }
+    auto sum = decodeCount(value);
+    if (existing_value != nullptr) {
+      sum += decodeCount(*existing_value);
+    }
+    auto const bs = encodeCount(sum);
+    new_value->assign(reinterpret_cast<char const*>(bs.data()), bs.size());
+    return true;
+  }
+
+  const char* Name() const override { return "zkd.CountMergeOperator"; }
+};
+
+struct CellCounter {
+  CellCounter(RocksDBHandle& rocks, byte_string_view min, byte_string_view max, std::size_t dimensions)
+      : rocks(rocks), min(min), max(max), dimensions(dimensions),
+        keys(rocks.db->NewIterator(readOptions(), rocks.default_.get())),
+        summaries(rocks.db->NewIterator(readOptions(), rocks.summaries.get())) {}
+
+  ~CellCounter() {
+    keys.reset();
+    summaries.reset();
+    rocks.db->ReleaseSnapshot(snapshot);
+  }
+
+  void visit(byte_string& lo, unsigned bits) {
+    auto const relation = relateCellToBox(lo, bits, min, max, dimensions);
+    if (relation == CellRelation::DISJOINT) {
+      return;
+    }
+    auto const hi = cellUpperBound(lo, bits);
+    if (relation == CellRelation::CONTAINED) {
+      result.count += sumCells(lo, hi, bits);
+      return;
+    }
+    if (bits >= finest() || bits >= 8 * lo.size()) {
+      scanKeys(lo, hi);
+      return;
+    }
+    auto const& levels = rocks.summaryPrefixBits;
+    if (std::binary_search(levels.begin(), levels.end(), bits) && sumCells(lo, hi, bits) == 0) {
+      return;
+    }
+
+    visit(lo, bits + 1);
+    RandomBitManipulator rbm(lo);
+    rbm.setBit(bits, Bit::ONE);
+    visit(lo, bits + 1);
+    rbm.setBit(bits, Bit::ZERO);
+  }
+
+  // sums the cells of the next summary level that lie within [lo, hi]
+  auto sumCells(byte_string_view lo, byte_string_view hi, unsigned bits) -> std::uint64_t {
+    auto const& levels = rocks.summaryPrefixBits;
+    auto const level = *std::lower_bound(levels.begin(), levels.end(), bits);
+    auto const from = summaryKey(lo, level);
+    auto const to = summaryKey(hi, level);
+
+    std::uint64_t sum = 0;
+    for (summaries->Seek(sliceFromString(from)); summaries->Valid(); summaries->Next()) {
+      if (to < viewFromSlice(summaries->key())) {
+        break;
+      }
+      sum += decodeCount(summaries->value());
+      result.summaryCells += 1;
+    }
+    checkStatus(*summaries);
+    return sum;
+  }
+
+  void scanKeys(byte_string_view lo, byte_string_view hi) {
+    for (keys->Seek(sliceFromString(lo)); keys->Valid(); keys->Next()) {
+      auto const key = viewFromSlice(keys->key());
+      if (hi < key) {
+        break;
+      }
+      result.keysScanned += 1;
+      if (testInBox(key, min, max, dimensions)) {
+        result.count += 1;
+      }
+    }
+    checkStatus(*keys);
+  }
+
+  auto finest() const -> unsigned {
+    return rocks.summaryPrefixBits.back();
+  }
+
+  static void checkStatus(rocksdb::Iterator& iter) {
+    auto s = iter.status();
+    if (!s.ok()) {
+      throw std::runtime_error(s.ToString());
+    }
+  }
+
+  // keys and summaries have to be read from the same snapshot to be consistent
+  auto readOptions() -> rocksdb::ReadOptions {
+    rocksdb::ReadOptions options;
+    if (snapshot == nullptr) {
+      snapshot = rocks.db->GetSnapshot();
+    }
+    options.snapshot = snapshot;
+    return options;
+  }
+
+  RocksDBHandle& rocks;
+  byte_string_view min;
+  byte_string_view max;
+  std::size_t dimensions;
+  rocksdb::Snapshot const* snapshot = nullptr;
+  std::unique_ptr<rocksdb::Iterator> keys;
+  std::unique_ptr<rocksdb::Iterator> summaries;
+  BoxCount result;
+};
+} // namespace
+
+auto zkd::summaryKey(byte_string_view key, unsigned bits) -> byte_string {
+  byte_string result;
+  auto const bytes = (bits + 7) / 8;
+  result.reserve(2 + bytes);
+  result.push_back(std::byte(bits >> 8));
+  result.push_back(std::byte(bits & 0xffu));
+  result += key.substr(0, bytes);
+  result.resize(2 + bytes, 0_b);
+  if (bits % 8 != 0) {
+    result.back() &= ~std::byte(0xffu >> (bits % 8));
+  }
+  return result;
+}
+
+void zkd::updateSummaries(RocksDBHandle& rocks, rocksdb::WriteBatch& batch, byte_string_view key, std::int64_t delta) {
+  auto const value = encodeCount(static_cast<std::uint64_t>(delta));
+  for (auto bits : rocks.summaryPrefixBits) {
+    auto s = batch.Merge(rocks.summaries.get(), sliceFromString(summaryKey(key, bits)), sliceFromString(value));
+    if (!s.ok()) {
+      throw std::runtime_error(s.ToString());
+    }
+  }
+}
+
+void zkd::rebuildSummaries(RocksDBHandle& rocks) {
+  if (rocks.summaries == nullptr) {
+    throw std::logic_error{"prefix summaries are not enabled"};
+  }
+  std::unique_lock guard(rocks.writeMutex);
+
+  rocksdb::WriteBatch batch;
+  {
+    auto iter = std::unique_ptr<rocksdb::Iterator>{rocks.db->NewIterator({}, rocks.summaries.get())};
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      batch.Delete(rocks.summaries.get(), iter->key());
+    }
+    CellCounter::checkStatus(*iter);
+  }
+
+  std::map<byte_string, std::uint64_t> counts;
+  {
+    auto iter = std::unique_ptr<rocksdb::Iterator>{rocks.db->NewIterator({}, rocks.default_.get())};
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      for (auto bits : rocks.summaryPrefixBits) {
+        counts[summaryKey(viewFromSlice(iter->key()), bits)] += 1;
+      }
+    }
+    CellCounter::checkStatus(*iter);
+  }
+  for (auto const& [key, count] : counts) {
+    batch.Put(rocks.summaries.get(), sliceFromString(key), sliceFromString(encodeCount(count)));
+  }
+
+  auto s = rocks.db->Write({}, &batch);
+  if (!s.ok()) {
+    throw std::runtime_error(s.ToString());
+  }
+}
+
+auto zkd::makeCountMergeOperator() -> std::shared_ptr<rocksdb::MergeOperator> {
+  return std::make_shared<CountMergeOperator>();
+}
+
+auto zkd::countInBox(RocksDBHandle& rocks, byte_string_view min, byte_string_view max, std::size_t dimensions) -> BoxCount {
+  if (rocks.summaries == nullptr) {
+    BoxCount result;
+    findAllInBox(rocks, min, max, dimensions, [&](byte_string_view, byte_string_view) {
+      result.count += 1;
+    });
+    result.keysScanned = result.count;
+    return result;
+  }
+
+  // summaries only count written keys
+  auto s = flushDeltaBuffer(rocks);
+  if (!s.ok()) {
+    throw std::runtime_error(s.ToString());
+  }
+  CellCounter counter(rocks, min, max, dimensions);
+  auto lo = byte_string(std::max(min.size(), max.size()), 0_b);
+  counter.visit(lo, 0);
+  return counter.result;
+}
+
+std::ostream& zkd::operator<<(std::ostream& ostream, BoxCount const& count) {
+  ostream << "BoxCount{";
+  ostream << "count=" << count.count;
+  ostream << ", summaryCells=" << count.summaryCells;
+  ostream << ", keysScanned=" << count.keysScanned;
+  ostream << "}";
+  return ostream;
+}
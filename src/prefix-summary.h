@@ -0,0 +1,56 @@
+#ifndef ZKD_TREE_PREFIX_SUMMARY_H
+#define ZKD_TREE_PREFIX_SUMMARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+
+#include <rocksdb/merge_operator.h>
+#include <rocksdb/write_batch.h>
+
+#include "library.h"
+#include "rocksdb-handle.h"
+
+namespace zkd {
+
+/*
+ * Prefix summaries store the number of keys per Z-prefix cell, i.e. per set of
+ * keys sharing the first `bits` bits, for each of the configured prefix lengths
+ * (RocksDBOptions::summaryPrefixBits). They live in their own column family and
+ * are maintained by PutKey and DeleteKey through a counting merge operator.
+ *
+ * A summary key is the prefix length as two bytes, followed by the prefix with
+ * its trailing bits cleared. So all cells of one prefix length that share a
+ * shorter prefix are adjacent.
+ */
+auto summaryKey(byte_string_view key, unsigned bits) -> byte_string;
+
+// Adds `delta` to the summaries of all cells containing `key`.
+void updateSummaries(RocksDBHandle& rocks, rocksdb::WriteBatch& batch, byte_string_view key, std::int64_t delta);
+
+// Recomputes all summaries from the keys in the default column family.
+void rebuildSummaries(RocksDBHandle& rocks);
+
+auto makeCountMergeOperator() -> std::shared_ptr<rocksdb::MergeOperator>;
+
+struct BoxCount {
+  std::uint64_t count = 0;
+  std::size_t summaryCells = 0; // cells fully inside of the box, taken from the summaries
+  std::size_t keysScanned = 0;  // keys of boundary cells that had to be tested individually
+};
+
+std::ostream& operator<<(std::ostream& ostream, BoxCount const& count);
+
+/*
+ * Counts the keys in the box [min, max] by splitting the box along the Z-prefix
+ * cells. Cells fully inside of the box are added up from the summaries, only the
+ * cells on the boundary of the box at the finest summary level are scanned.
+ * Without summaries, this falls back to scanning the whole box. With
+ * summaries, the handle's delta buffer is flushed first.
+ */
+auto countInBox(RocksDBHandle& rocks, byte_string_view min, byte_string_view max, std::size_t dimensions) -> BoxCount;
+
+} // namespace zkd
+
+#endif //ZKD_TREE_PREFIX_SUMMARY_H
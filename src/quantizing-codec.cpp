@@ -0,0 +1,234 @@
+#include "quantizing-codec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "schema.h"
+
+using namespace zkd;
+
+namespace {
+auto budgets(std::vector<QuantizedDimension> const& dimensions) -> std::vector<unsigned> {
+  if (dimensions.empty()) {
+    throw std::invalid_argument("quantizing codec needs at least one dimension");
+  }
+  std::vector<unsigned> result;
+  for (auto const& d : dimensions) {
+    if (d.bits == 0 || d.bits > 64) {
+      throw std::invalid_argument("quantized dimensions need between 1 and 64 bits");
+    }
+    if (!(d.min < d.max) || !std::isfinite(d.min) || !std::isfinite(d.max)) {
+      throw std::invalid_argument("quantized dimensions need a finite range with min < max");
+    }
+    result.push_back(d.bits);
+  }
+  return result;
+}
+
+// clamps the residual bits, so that a fine cell fits into 64 bits; exact dimensions have none
+auto normalized(std::vector<QuantizedDimension> dimensions) -> std::vector<QuantizedDimension> {
+  for (auto& d : dimensions) {
+    d.residualBits = d.bits < 64 && !d.exact ? std::min(d.residualBits, 64 - d.bits) : 0;
+  }
+  return dimensions;
+}
+
+// bits of a dimension at the start of the value
+auto valueBits(QuantizedDimension const& d) -> unsigned {
+  return d.exact ? 64 : d.residualBits;
+}
+
+auto residualBytes(std::vector<QuantizedDimension> const& dimensions) -> std::size_t {
+  std::size_t bits = 0;
+  for (auto const& d : dimensions) {
+    bits += valueBits(d);
+  }
+  return (bits + 7) / 8;
+}
+
+// -0.0 and 0.0 compare equal, so they get the same bits
+auto exactBits(double value) -> std::uint64_t {
+  return schema_detail::orderedBits<double, std::uint64_t>(value + 0.0);
+}
+
+auto fromExactBits(std::uint64_t bits) -> double {
+  return schema_detail::fromOrderedBits<double, std::uint64_t>(bits);
+}
+} // namespace
+
+auto zkd::QuantizedBox::matches(byte_string_view key, byte_string_view value) const -> bool {
+  auto const cells = codec->checkedCoordinates(key, value);
+  for (std::size_t dim = 0; dim < cells.size(); ++dim) {
+    if ((min[dim] && cells[dim] < *min[dim]) || (max[dim] && *max[dim] < cells[dim])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+zkd::QuantizingCodec::QuantizingCodec(std::vector<QuantizedDimension> dimensions)
+    : _dimensions(normalized(std::move(dimensions))),
+      _schedule(InterleaveSchedule::roundRobin(budgets(_dimensions))),
+      _residualSize(residualBytes(_dimensions)) {}
+
+// the cell of bits + residualBits bits; the cell of the key is its prefix, so both always agree
+auto zkd::QuantizingCodec::fineCell(std::size_t dim, double value) const -> std::uint64_t {
+  if (std::isnan(value)) {
+    throw std::invalid_argument("can't quantize NaN");
+  }
+  auto const& d = _dimensions[dim];
+  auto const bits = d.bits + d.residualBits;
+  auto const cells = std::ldexp(1.0, int(bits));
+  auto const scaled = std::floor((value - d.min) / (d.max - d.min) * cells);
+  if (scaled <= 0.0) {
+    return 0;
+  }
+  if (scaled >= cells) {
+    return bits == 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << bits) - 1;
+  }
+  return std::uint64_t(scaled);
+}
+
+auto zkd::QuantizingCodec::quantize(std::size_t dim, double value) const -> std::uint64_t {
+  return fineCell(dim, value) >> _dimensions[dim].residualBits;
+}
+
+auto zkd::QuantizingCodec::dequantize(std::size_t dim, std::uint64_t cell) const -> double {
+  auto const& d = _dimensions[dim];
+  return d.min + (double(cell) + 0.5) * std::ldexp(d.max - d.min, -int(d.bits));
+}
+
+// the cell as big endian number, left aligned in whole bytes, so its bits come first
+auto zkd::QuantizingCodec::coordinate(std::size_t dim, std::uint64_t cell) const -> byte_string {
+  auto const bits = _dimensions[dim].bits;
+  auto const bytes = (bits + 7) / 8;
+  auto const aligned = bits == 64 ? cell : cell << (64 - bits);
+  byte_string result;
+  for (std::size_t i = 0; i < bytes; ++i) {
+    result.push_back(std::byte(aligned >> (56 - 8 * i)));
+  }
+  return result;
+}
+
+auto zkd::QuantizingCodec::encodeKey(std::vector<double> const& point) const -> byte_string {
+  if (point.size() != dimensions()) {
+    throw std::invalid_argument("point does not match the dimensions of the codec");
+  }
+  std::vector<byte_string> coords;
+  coords.reserve(point.size());
+  for (std::size_t dim = 0; dim < point.size(); ++dim) {
+    coords.push_back(coordinate(dim, quantize(dim, point[dim])));
+  }
+  return interleave(coords, _schedule);
+}
+
+auto zkd::QuantizingCodec::decodeKey(byte_string_view key) const -> std::vector<double> {
+  auto const coords = transpose(key, _schedule);
+  std::vector<double> point;
+  point.reserve(coords.size());
+  for (std::size_t dim = 0; dim < coords.size(); ++dim) {
+    std::uint64_t aligned = 0;
+    for (std::size_t i = 0; i < 8; ++i) {
+      aligned = (aligned << 8) | (i < coords[dim].size() ? std::to_integer<std::uint64_t>(coords[dim][i]) : 0);
+    }
+    auto const bits = _dimensions[dim].bits;
+    point.push_back(dequantize(dim, bits == 64 ? aligned : aligned >> (64 - bits)));
+  }
+  return point;
+}
+
+auto zkd::QuantizingCodec::encodeValue(std::vector<double> const& point, byte_string_view payload) const -> byte_string {
+  if (point.size() != dimensions()) {
+    throw std::invalid_argument("point does not match the dimensions of the codec");
+  }
+  BitWriter writer;
+  writer.reserve(_residualSize + payload.size());
+  for (std::size_t dim = 0; dim < point.size(); ++dim) {
+    auto const& d = _dimensions[dim];
+    // also rejects NaN
+    auto const cell = fineCell(dim, point[dim]);
+    writer.write_big_endian_bits(d.exact ? exactBits(point[dim]) : cell, valueBits(d));
+  }
+  auto value = std::move(writer).str();
+  value.append(payload);
+  return value;
+}
+
+auto zkd::QuantizingCodec::checkedCoordinates(byte_string_view key, byte_string_view value) const
+  -> std::vector<std::uint64_t> {
+  if (value.size() < _residualSize) {
+    throw std::invalid_argument("value is too short for the residual bits");
+  }
+  auto const coords = transpose(key, _schedule);
+  BitReader residuals(value.substr(0, _residualSize));
+  std::vector<std::uint64_t> result;
+  result.reserve(coords.size());
+  for (std::size_t dim = 0; dim < coords.size(); ++dim) {
+    auto const& d = _dimensions[dim];
+    auto const residual = residuals.read_big_endian_bits(valueBits(d));
+    if (d.exact) {
+      result.push_back(residual);
+      continue;
+    }
+    BitReader cell(coords[dim]);
+    auto const prefix = cell.read_big_endian_bits(d.bits);
+    result.push_back(d.residualBits == 0 ? prefix : (prefix << d.residualBits) | residual);
+  }
+  return result;
+}
+
+auto zkd::QuantizingCodec::fineCells(byte_string_view key, byte_string_view value) const -> std::vector<std::uint64_t> {
+  auto cells = checkedCoordinates(key, value);
+  for (std::size_t dim = 0; dim < cells.size(); ++dim) {
+    if (_dimensions[dim].exact) {
+      cells[dim] = fineCell(dim, fromExactBits(cells[dim]));
+    }
+  }
+  return cells;
+}
+
+auto zkd::QuantizingCodec::decodeValue(byte_string_view key, byte_string_view value) const -> std::vector<double> {
+  auto const checked = checkedCoordinates(key, value);
+  std::vector<double> point;
+  point.reserve(checked.size());
+  for (std::size_t dim = 0; dim < checked.size(); ++dim) {
+    auto const& d = _dimensions[dim];
+    point.push_back(d.exact ? fromExactBits(checked[dim])
+                            : d.min + (double(checked[dim]) + 0.5) * std::ldexp(d.max - d.min, -int(d.bits + d.residualBits)));
+  }
+  return point;
+}
+
+auto zkd::QuantizingCodec::payload(byte_string_view value) const -> byte_string_view {
+  if (value.size() < _residualSize) {
+    throw std::invalid_argument("value is too short for the residual bits");
+  }
+  return value.substr(_residualSize);
+}
+
+auto zkd::QuantizingCodec::makeBox(std::vector<std::optional<double>> const& min,
+                                   std::vector<std::optional<double>> const& max) const -> QuantizedBox {
+  if (min.size() != dimensions() || max.size() != dimensions()) {
+    throw std::invalid_argument("box does not match the dimensions of the codec");
+  }
+  std::vector<std::optional<byte_string>> lower, upper;
+  std::vector<std::optional<std::uint64_t>> checkedMin, checkedMax;
+  for (std::size_t dim = 0; dim < dimensions(); ++dim) {
+    auto const& d = _dimensions[dim];
+    auto const checked = [&](std::optional<double> const& bound) -> std::optional<std::uint64_t> {
+      if (!bound) {
+        return std::nullopt;
+      }
+      auto const cell = fineCell(dim, *bound);
+      return d.exact ? exactBits(*bound) : cell;
+    };
+    checkedMin.push_back(checked(min[dim]));
+    checkedMax.push_back(checked(max[dim]));
+    lower.push_back(min[dim] ? std::optional{coordinate(dim, quantize(dim, *min[dim]))} : std::nullopt);
+    upper.push_back(max[dim] ? std::optional{coordinate(dim, quantize(dim, *max[dim]))} : std::nullopt);
+  }
+  // the schedule only takes the leading bits of the filled bounds
+  return QuantizedBox{zkd::makeBox(lower, upper, sizeof(std::uint64_t), _schedule), std::move(checkedMin),
+                      std::move(checkedMax), std::make_shared<QuantizingCodec const>(*this)};
+}
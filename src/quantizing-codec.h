@@ -0,0 +1,114 @@
+#ifndef ZKD_TREE_QUANTIZING_CODEC_H
+#define ZKD_TREE_QUANTIZING_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "interleave-schedule.h"
+#include "library.h"
+
+namespace zkd {
+
+/*
+ * Values of a dimension are expected in [min, max] and stored with `bits` bits
+ * in the key. Another `residualBits` bits of the position within the cell are
+ * kept in the value for the check of box queries; at most 64 - bits of them are
+ * used. An `exact` dimension keeps the original value instead, as 8 bytes of
+ * order-preserving IEEE bits like schema.h's Double, and ignores residualBits.
+ */
+struct QuantizedDimension {
+  double min = 0.0;
+  double max = 1.0;
+  unsigned bits = 20;
+  unsigned residualBits = 12;
+  bool exact = false;
+};
+
+class QuantizingCodec;
+
+/*
+ * A query box of a QuantizingCodec: the box over the quantized keys, which
+ * also contains points that are only in the same cells as the box's border, and
+ * the bounds to check points against, see QuantizingCodec::checkedCoordinates.
+ */
+struct QuantizedBox {
+  Box box;
+  std::vector<std::optional<std::uint64_t>> min;
+  std::vector<std::optional<std::uint64_t>> max;
+  std::shared_ptr<QuantizingCodec const> codec;
+
+  /*
+   * Whether the point, taken from the key and the value written by
+   * encodeValue, is inside of the box. Exact in exact dimensions. In the others,
+   * points in the same fine cell as a bound are inside, so a point may be up to
+   * a fine cell outside, and any value beyond the range matches a bound beyond
+   * it on the same side.
+   */
+  auto matches(byte_string_view key, byte_string_view value) const -> bool;
+};
+
+/*
+ * Maps doubles to unsigned integers of `bits` bits per dimension, splitting
+ * [min, max] into 2^bits equal cells. Values outside of the range are clamped
+ * to the first or last cell. The quantized coordinates are interleaved with
+ * schedule(), so a key takes sum(bits) / 8 bytes instead of 8 per dimension;
+ * the handle has to be opened with that schedule.
+ *
+ * Because cells are coarser than the values, the key alone can't tell whether
+ * a point in a border cell of a query is inside of it. The residual bits of
+ * every dimension are therefore kept at the start of the value, sum(residual
+ * bits) / 8 bytes instead of the original doubles (see encodeValue), and box
+ * queries with a QuantizedBox check the fine cells they add up to. That is
+ * approximate: values outside of the range share the outermost fine cells, so
+ * they can't be told apart by the check. Dimensions that need exact queries
+ * keep their original values instead, see QuantizedDimension::exact.
+ */
+class QuantizingCodec {
+ public:
+  explicit QuantizingCodec(std::vector<QuantizedDimension> dimensions);
+
+  auto dimensions() const noexcept -> std::size_t { return _dimensions.size(); }
+  auto dimension(std::size_t dim) const -> QuantizedDimension const& { return _dimensions[dim]; }
+  auto schedule() const noexcept -> InterleaveSchedule const& { return _schedule; }
+  auto keySize() const noexcept -> std::size_t { return (_schedule.bits() + 7) / 8; }
+
+  // monotonic, throws std::invalid_argument for NaN
+  auto quantize(std::size_t dim, double value) const -> std::uint64_t;
+  // center of the cell
+  auto dequantize(std::size_t dim, std::uint64_t cell) const -> double;
+
+  auto encodeKey(std::vector<double> const& point) const -> byte_string;
+  // the centers of the point's cells
+  auto decodeKey(byte_string_view key) const -> std::vector<double>;
+
+  // the residual bits, or original values of exact dimensions, of the point followed by the payload
+  auto encodeValue(std::vector<double> const& point, byte_string_view payload) const -> byte_string;
+  // the centers of the point's fine cells, and the values of exact dimensions
+  auto decodeValue(byte_string_view key, byte_string_view value) const -> std::vector<double>;
+  auto payload(byte_string_view value) const -> byte_string_view;
+  auto residualSize() const noexcept -> std::size_t { return _residualSize; }
+
+  // the cells of `bits` + `residualBits` bits of the point
+  auto fineCells(byte_string_view key, byte_string_view value) const -> std::vector<std::uint64_t>;
+  // what box queries compare: the fine cells, and the order-preserving bits of the values of exact dimensions
+  auto checkedCoordinates(byte_string_view key, byte_string_view value) const -> std::vector<std::uint64_t>;
+
+  // std::nullopt bounds are unbounded, see makeBox
+  auto makeBox(std::vector<std::optional<double>> const& min, std::vector<std::optional<double>> const& max) const
+    -> QuantizedBox;
+
+ private:
+  auto coordinate(std::size_t dim, std::uint64_t cell) const -> byte_string;
+  auto fineCell(std::size_t dim, double value) const -> std::uint64_t;
+
+  std::vector<QuantizedDimension> _dimensions;
+  InterleaveSchedule _schedule;
+  std::size_t _residualSize;
+};
+
+} // namespace zkd
+
+#endif //ZKD_TREE_QUANTIZING_CODEC_H
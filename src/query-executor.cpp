@@ -0,0 +1,203 @@
+#include "query-executor.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+using namespace zkd;
+
+namespace {
+// key/value pairs copied back to back into one buffer, reused between batches
+struct batch {
+  byte_string data;
+  std::vector<std::pair<std::size_t, std::size_t>> sizes; // of key and value
+
+  void add(byte_string_view key, byte_string_view value) {
+    data.append(key);
+    data.append(value);
+    sizes.emplace_back(key.size(), value.size());
+  }
+
+  void clear() {
+    data.clear();
+    sizes.clear();
+  }
+};
+
+// thrown through findAllInBox to stop the producer once the consumer failed
+struct scan_cancelled {};
+
+// the state shared by the producer on the pool and the consumer
+struct pipeline {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<batch> full;
+  std::vector<batch> free;
+  std::size_t maxBatches;
+  bool done = false;
+  bool cancelled = false;
+
+  explicit pipeline(std::size_t maxBatches) : maxBatches(std::max<std::size_t>(maxBatches, 1)) {}
+
+  // under the mutex
+  auto reuse() -> batch {
+    if (free.empty()) {
+      return batch{};
+    }
+    auto b = std::move(free.back());
+    free.pop_back();
+    b.clear();
+    return b;
+  }
+};
+} // namespace
+
+zkd::QueryExecutor::QueryExecutor(std::size_t threads) {
+  if (threads == 0) {
+    throw std::invalid_argument("query executor needs at least one thread");
+  }
+  _threads.reserve(threads);
+  for (std::size_t i = 0; i < threads; ++i) {
+    _threads.emplace_back([this] { work(); });
+  }
+}
+
+zkd::QueryExecutor::~QueryExecutor() {
+  {
+    std::unique_lock guard(_mutex);
+    _stopping = true;
+  }
+  _cv.notify_all();
+  for (auto& t : _threads) {
+    t.join();
+  }
+}
+
+void zkd::QueryExecutor::post(std::function<void()> task) {
+  {
+    std::unique_lock guard(_mutex);
+    if (_stopping) {
+      throw std::logic_error("query executor is shutting down");
+    }
+    _tasks.push_back(std::move(task));
+  }
+  _cv.notify_one();
+}
+
+void zkd::QueryExecutor::work() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock guard(_mutex);
+      _cv.wait(guard, [&] { return _stopping || !_tasks.empty(); });
+      if (_tasks.empty()) {
+        return;
+      }
+      task = std::move(_tasks.front());
+      _tasks.pop_front();
+    }
+    // packaged tasks keep their exceptions for the future
+    task();
+  }
+}
+
+auto zkd::QueryExecutor::findAllInBox(std::shared_ptr<RocksDBHandle> rocks, Box box, BoxQueryCallback callback)
+  -> std::future<std::size_t> {
+  return submit([rocks = std::move(rocks), box = std::move(box), callback = std::move(callback)] {
+    return zkd::findAllInBox(*rocks, box, callback);
+  });
+}
+
+auto zkd::QueryExecutor::findAllInBoxPipelined(RocksDBHandle& rocks, Box const& box, BoxQueryCallback const& callback,
+                                               PipelineOptions const& options) -> std::size_t {
+  QueryStats stats;
+  return findAllInBoxPipelined(rocks, box, callback, stats, options);
+}
+
+auto zkd::QueryExecutor::findAllInBoxPipelined(RocksDBHandle& rocks, Box const& box, BoxQueryCallback const& callback,
+                                               QueryStats& stats, PipelineOptions const& options) -> std::size_t {
+  pipeline p(options.maxBatches);
+  auto const batchSize = std::max<std::size_t>(options.batchSize, 1);
+  // written by the producer only, read after it finished
+  QueryStats producerStats;
+
+  auto produced = submit([&]() -> std::size_t {
+    struct finish {
+      pipeline& p;
+      ~finish() {
+        {
+          std::unique_lock guard(p.mutex);
+          p.done = true;
+        }
+        p.cv.notify_all();
+      }
+    } finish{p};
+
+    batch current;
+    auto const hand_over = [&] {
+      std::unique_lock guard(p.mutex);
+      p.cv.wait(guard, [&] { return p.cancelled || p.full.size() < p.maxBatches; });
+      if (p.cancelled) {
+        throw scan_cancelled{};
+      }
+      p.full.push_back(std::move(current));
+      current = p.reuse();
+      p.cv.notify_all();
+    };
+
+    try {
+      auto num_seeks = zkd::findAllInBox(rocks, box, [&](byte_string_view key, byte_string_view value) {
+        current.add(key, value);
+        if (current.sizes.size() >= batchSize) {
+          hand_over();
+        }
+      }, producerStats);
+      if (!current.sizes.empty()) {
+        hand_over();
+      }
+      return num_seeks;
+    } catch (scan_cancelled const&) {
+      return 0;
+    }
+  });
+
+  try {
+    while (true) {
+      batch b;
+      {
+        std::unique_lock guard(p.mutex);
+        p.cv.wait(guard, [&] { return p.done || !p.full.empty(); });
+        if (p.full.empty()) {
+          break;
+        }
+        b = std::move(p.full.front());
+        p.full.pop_front();
+      }
+      p.cv.notify_all();
+
+      std::size_t offset = 0;
+      for (auto [keySize, valueSize] : b.sizes) {
+        auto const data = byte_string_view{b.data};
+        callback(data.substr(offset, keySize), data.substr(offset + keySize, valueSize));
+        offset += keySize + valueSize;
+      }
+
+      std::unique_lock guard(p.mutex);
+      p.free.push_back(std::move(b));
+    }
+  } catch (...) {
+    {
+      std::unique_lock guard(p.mutex);
+      p.cancelled = true;
+    }
+    p.cv.notify_all();
+    // the producer refers to this frame
+    produced.wait();
+    throw;
+  }
+
+  // rethrows errors of the scan
+  auto num_seeks = produced.get();
+  stats += producerStats;
+  return num_seeks;
+}
@@ -0,0 +1,86 @@
+#ifndef ZKD_TREE_QUERY_EXECUTOR_H
+#define ZKD_TREE_QUERY_EXECUTOR_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "box-query.h"
+#include "library.h"
+#include "query-stats.h"
+#include "rocksdb-handle.h"
+
+namespace zkd {
+
+struct PipelineOptions {
+  // key/value pairs handed to the consumer at once
+  std::size_t batchSize = 256;
+  // batches the producer may run ahead of the consumer
+  std::size_t maxBatches = 4;
+};
+
+/*
+ * Runs box queries on a fixed pool of threads, so many concurrent queries
+ * share a few threads, each of them blocked on storage at most once at a time.
+ * The destructor runs the queued tasks and joins the threads.
+ */
+class QueryExecutor {
+ public:
+  explicit QueryExecutor(std::size_t threads);
+  ~QueryExecutor();
+
+  QueryExecutor(QueryExecutor const&) = delete;
+  QueryExecutor& operator=(QueryExecutor const&) = delete;
+
+  auto threads() const noexcept -> std::size_t { return _threads.size(); }
+
+  template<typename F>
+  auto submit(F&& f) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+    using result = std::invoke_result_t<std::decay_t<F>>;
+    auto task = std::make_shared<std::packaged_task<result()>>(std::forward<F>(f));
+    auto future = task->get_future();
+    post([task] { (*task)(); });
+    return future;
+  }
+
+  /*
+   * Runs findAllInBox on the pool and returns its number of seeks. The
+   * callback is called from the pool thread; the handle and box are kept alive
+   * until the query is done.
+   */
+  auto findAllInBox(std::shared_ptr<RocksDBHandle> rocks, Box box, BoxQueryCallback callback)
+    -> std::future<std::size_t>;
+
+  /*
+   * Runs findAllInBox on the pool and calls `callback` from the calling
+   * thread, with copies of the keys and values in batches. While the caller
+   * consumes a batch, the pool thread already computes the next seek targets
+   * and waits for storage. If the callback throws, the scan is stopped and the
+   * exception is rethrown once it is. Must not be called from a pool thread.
+   */
+  auto findAllInBoxPipelined(RocksDBHandle& rocks, Box const& box, BoxQueryCallback const& callback,
+                             PipelineOptions const& options = {}) -> std::size_t;
+  auto findAllInBoxPipelined(RocksDBHandle& rocks, Box const& box, BoxQueryCallback const& callback, QueryStats& stats,
+                             PipelineOptions const& options = {}) -> std::size_t;
+
+ private:
+  void post(std::function<void()> task);
+  void work();
+
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::deque<std::function<void()>> _tasks;
+  bool _stopping = false;
+  std::vector<std::thread> _threads;
+};
+
+} // namespace zkd
+
+#endif //ZKD_TREE_QUERY_EXECUTOR_H
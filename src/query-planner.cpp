@@ -0,0 +1,173 @@
+#include "query-planner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+using namespace zkd;
+
+namespace {
+// position of a key in the key space as a fraction in [0, 1)
+auto keyFraction(byte_string_view key) -> double {
+  double result = 0.0;
+  double scale = 1.0 / 256;
+  for (std::size_t i = 0; i < std::min<std::size_t>(key.size(), 8); ++i) {
+    result += std::to_integer<unsigned>(key[i]) * scale;
+    scale /= 256;
+  }
+  return result;
+}
+
+// fraction of the key space covered by the box, assuming uniformly distributed keys
+auto boxVolume(byte_string_view min, byte_string_view max, std::size_t dimensions) -> double {
+  constexpr unsigned bits = 32;
+  double volume = 1.0;
+  for (std::size_t dim = 0; dim < dimensions; ++dim) {
+    auto lo = DimensionHistograms::readCoordinateBits(min, dim, dimensions, bits);
+    auto hi = DimensionHistograms::readCoordinateBits(max, dim, dimensions, bits, Bit::ONE);
+    if (hi < lo) {
+      return 0.0;
+    }
+    volume *= double(hi - lo + 1) / std::ldexp(1.0, bits);
+  }
+  return volume;
+}
+
+auto coverVolume(BoxCover const& cover) -> double {
+  double volume = 0.0;
+  for (auto const& interval : cover.intervals) {
+    auto const width = std::ldexp(1.0, -int(std::min<std::size_t>(interval.hi.size(), 8) * 8));
+    volume += keyFraction(interval.hi) - keyFraction(interval.lo) + width;
+  }
+  return volume;
+}
+
+auto estimateTotalKeys(RocksDBHandle& rocks) -> std::uint64_t {
+  if (rocks.histograms != nullptr) {
+    return rocks.histograms->total();
+  }
+  std::uint64_t keys = 0;
+  if (!rocks.db->GetIntProperty(rocks.default_.get(), "rocksdb.estimate-num-keys", &keys)) {
+    return 0;
+  }
+  return keys;
+}
+} // namespace
+
+auto zkd::planBoxQuery(RocksDBHandle& rocks, byte_string_view min, byte_string_view max, std::size_t dimensions,
+                       QueryPlannerOptions const& options) -> QueryPlan {
+  if (rocks.curve != Curve::Z_ORDER || rocks.schedule != nullptr) {
+    throw std::invalid_argument("query planning requires round robin Z-order keys");
+  }
+  QueryPlan plan;
+  plan.totalKeys = estimateTotalKeys(rocks);
+  auto const total = double(plan.totalKeys);
+
+  auto const volume = boxVolume(min, max, dimensions);
+  if (rocks.histograms != nullptr && rocks.histograms->dimensions() == dimensions) {
+    plan.selectivity = rocks.histograms->selectivity(min, max);
+  } else {
+    plan.selectivity = volume;
+  }
+  plan.estimatedResults = plan.selectivity * total;
+
+  // At this prefix length a cell holds about one key. Every Z-run of the box
+  // costs a seek, and so does about every other cell on the boundary of the
+  // box, whose key is outside of the box.
+  auto const dataBits = unsigned(std::ceil(std::log2(std::max(total, 2.0))));
+  auto const runs = coverBox(min, max, dimensions, dataBits, options.maxRuns);
+  double estimatedRuns = double(runs.intervals.size()) + double(runs.partialCells) / 2;
+  if (runs.bits < dataBits && !runs.exact) {
+    // the number of boundary cells grows with the surface of the box
+    auto const extraSteps = double(dataBits - runs.bits) / dimensions;
+    estimatedRuns *= std::pow(2.0, extraSteps * double(dimensions - 1));
+  }
+  plan.estimatedSeeks = std::min(estimatedRuns, plan.estimatedResults) + 1;
+
+  plan.cover = coverBox(min, max, dimensions, dataBits, options.maxIntervals);
+  if (volume > 0) {
+    plan.coverOverhead = std::max(1.0, coverVolume(plan.cover) / volume);
+  }
+
+  auto const keysInCover = std::min(total, plan.estimatedResults * plan.coverOverhead);
+  plan.zSeekCost = plan.estimatedSeeks * (options.seekCost + 1) + plan.estimatedResults;
+  plan.intervalCost = double(plan.cover.intervals.size()) * options.seekCost + keysInCover;
+  plan.linearCost = options.seekCost + total;
+
+  plan.strategy = BoxQueryStrategy::Z_SEEK_SCAN;
+  auto best = plan.zSeekCost;
+  if (plan.intervalCost < best) {
+    plan.strategy = BoxQueryStrategy::INTERVAL_SCAN;
+    best = plan.intervalCost;
+  }
+  if (plan.linearCost < best) {
+    plan.strategy = BoxQueryStrategy::LINEAR_SCAN;
+  }
+  return plan;
+}
+
+auto zkd::executeBoxQuery(RocksDBHandle& rocks, QueryPlan const& plan, byte_string_view min, byte_string_view max,
+                          std::size_t dimensions, BoxQueryCallback const& callback) -> std::size_t {
+  switch (plan.strategy) {
+    case BoxQueryStrategy::Z_SEEK_SCAN:
+      return findAllInBox(rocks, min, max, dimensions, callback);
+    case BoxQueryStrategy::INTERVAL_SCAN:
+      return findAllInIntervals(rocks, plan.cover.intervals, min, max, dimensions, callback);
+    case BoxQueryStrategy::LINEAR_SCAN:
+      findAllInBoxSlow(rocks, min, max, dimensions, callback);
+      return 1;
+  }
+  throw std::logic_error{"unknown box query strategy"};
+}
+
+void zkd::rebuildHistograms(RocksDBHandle& rocks) {
+  if (rocks.histograms == nullptr) {
+    throw std::logic_error{"histograms are not enabled"};
+  }
+  std::unique_lock guard(rocks.writeMutex);
+  rocks.histograms->clear();
+
+  auto iter = std::unique_ptr<rocksdb::Iterator>{rocks.db->NewIterator({}, rocks.default_.get())};
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    auto key = byte_string_view{reinterpret_cast<std::byte const*>(iter->key().data()), iter->key().size()};
+    if (rocks.schedule != nullptr) {
+      rocks.histograms->add(interleave(transpose(key, *rocks.schedule)));
+    } else if (rocks.curve == Curve::Z_ORDER) {
+      rocks.histograms->add(key);
+    } else {
+      rocks.histograms->add(interleave(decodeKey(rocks.curve, key, rocks.histograms->dimensions())));
+    }
+  }
+  auto s = iter->status();
+  if (!s.ok()) {
+    throw std::runtime_error(s.ToString());
+  }
+}
+
+std::ostream& zkd::operator<<(std::ostream& ostream, BoxQueryStrategy strategy) {
+  switch (strategy) {
+    case BoxQueryStrategy::Z_SEEK_SCAN:
+      return ostream << "z-seek scan";
+    case BoxQueryStrategy::INTERVAL_SCAN:
+      return ostream << "interval scan";
+    case BoxQueryStrategy::LINEAR_SCAN:
+      return ostream << "linear scan";
+  }
+  return ostream << "unknown";
+}
+
+std::ostream& zkd::operator<<(std::ostream& ostream, QueryPlan const& plan) {
+  ostream << "QueryPlan{";
+  ostream << "strategy=" << plan.strategy;
+  ostream << ", totalKeys=" << plan.totalKeys;
+  ostream << ", selectivity=" << plan.selectivity;
+  ostream << ", estimatedResults=" << plan.estimatedResults;
+  ostream << ", estimatedSeeks=" << plan.estimatedSeeks;
+  ostream << ", intervals=" << plan.cover.intervals.size();
+  ostream << ", coverOverhead=" << plan.coverOverhead;
+  ostream << ", cost{zSeek=" << plan.zSeekCost << ", interval=" << plan.intervalCost << ", linear=" << plan.linearCost << "}";
+  ostream << "}";
+  return ostream;
+}
@@ -0,0 +1,68 @@
+#ifndef ZKD_TREE_QUERY_PLANNER_H
+#define ZKD_TREE_QUERY_PLANNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+#include "box-query.h"
+#include "library.h"
+#include "rocksdb-handle.h"
+
+namespace zkd {
+
+enum class BoxQueryStrategy {
+  Z_SEEK_SCAN,   // findAllInBox
+  INTERVAL_SCAN, // findAllInIntervals over a coarse cover of the box
+  LINEAR_SCAN    // findAllInBoxSlow
+};
+
+std::ostream& operator<<(std::ostream& ostream, BoxQueryStrategy strategy);
+
+struct QueryPlannerOptions {
+  // cost of a seek, relative to visiting a single key with Next
+  double seekCost = 16.0;
+  // upper bound for the intervals of an interval scan
+  std::size_t maxIntervals = 1024;
+  // upper bound for the Z-runs enumerated to estimate the seeks of a Z-seek scan
+  std::size_t maxRuns = 4096;
+};
+
+struct QueryPlan {
+  BoxQueryStrategy strategy = BoxQueryStrategy::Z_SEEK_SCAN;
+
+  std::uint64_t totalKeys = 0;
+  double selectivity = 1.0;
+  double estimatedResults = 0.0;
+  double estimatedSeeks = 0.0; // of a Z-seek scan
+
+  BoxCover cover;            // intervals of an interval scan
+  double coverOverhead = 1.0; // volume of the cover relative to the box
+
+  double zSeekCost = 0.0;
+  double intervalCost = 0.0;
+  double linearCost = 0.0;
+};
+
+std::ostream& operator<<(std::ostream& ostream, QueryPlan const& plan);
+
+/*
+ * Estimates the cost of each strategy for the box [min, max] and picks the
+ * cheapest one. The number of results is estimated from the handle's
+ * histograms if present, otherwise from the volume of the box in key space.
+ * The seeks of a Z-seek scan are estimated from the number of Z-runs of the box
+ * at the prefix length where a cell holds about one key. Requires Z-order keys.
+ */
+auto planBoxQuery(RocksDBHandle& rocks, byte_string_view min, byte_string_view max, std::size_t dimensions,
+                  QueryPlannerOptions const& options = {}) -> QueryPlan;
+
+// Runs the box query with the strategy of the plan. Returns the number of seeks.
+auto executeBoxQuery(RocksDBHandle& rocks, QueryPlan const& plan, byte_string_view min, byte_string_view max,
+                     std::size_t dimensions, BoxQueryCallback const& callback) -> std::size_t;
+
+// Recomputes the handle's histograms from all keys.
+void rebuildHistograms(RocksDBHandle& rocks);
+
+} // namespace zkd
+
+#endif //ZKD_TREE_QUERY_PLANNER_H
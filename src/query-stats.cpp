@@ -0,0 +1,103 @@
+#include "query-stats.h"
+
+#include <iostream>
+
+using namespace zkd;
+
+auto zkd::QueryPhaseTimes::operator+=(QueryPhaseTimes const& other) noexcept -> QueryPhaseTimes& {
+  cacheLookup += other.cacheLookup;
+  seek += other.seek;
+  next += other.next;
+  compare += other.compare;
+  nextZValue += other.nextZValue;
+  callback += other.callback;
+  return *this;
+}
+
+auto zkd::StorageStats::operator+=(StorageStats const& other) noexcept -> StorageStats& {
+  blockReads += other.blockReads;
+  blockReadBytes += other.blockReadBytes;
+  blockCacheHits += other.blockCacheHits;
+  internalKeysSkipped += other.internalKeysSkipped;
+  internalDeletesSkipped += other.internalDeletesSkipped;
+  bytesRead += other.bytesRead;
+  blockReadTime += other.blockReadTime;
+  return *this;
+}
+
+auto zkd::QueryStats::operator+=(QueryStats const& other) noexcept -> QueryStats& {
+  queries += other.queries;
+  seeks += other.seeks;
+  nexts += other.nexts;
+  keysExamined += other.keysExamined;
+  keysReturned += other.keysReturned;
+  profiledQueries += other.profiledQueries;
+  phases += other.phases;
+  storage += other.storage;
+  return *this;
+}
+
+zkd::QueryStatsSampler::QueryStatsSampler(std::uint32_t interval) : _interval(interval) {}
+
+auto zkd::QueryStatsSampler::sample() noexcept -> bool {
+  if (_interval == 0) {
+    return false;
+  }
+  return _counter.fetch_add(1, std::memory_order_relaxed) % _interval == 0;
+}
+
+void zkd::QueryStatsSampler::record(QueryStats const& stats) {
+  std::unique_lock guard(_mutex);
+  _totals += stats;
+}
+
+auto zkd::QueryStatsSampler::totals() const -> QueryStats {
+  std::unique_lock guard(_mutex);
+  return _totals;
+}
+
+void zkd::QueryStatsSampler::reset() {
+  std::unique_lock guard(_mutex);
+  _totals = QueryStats{};
+}
+
+std::ostream& zkd::operator<<(std::ostream& ostream, QueryPhaseTimes const& times) {
+  ostream << "QueryPhaseTimes{";
+  ostream << "cacheLookup=" << times.cacheLookup.count() << "ns";
+  ostream << ", seek=" << times.seek.count() << "ns";
+  ostream << ", next=" << times.next.count() << "ns";
+  ostream << ", compare=" << times.compare.count() << "ns";
+  ostream << ", nextZValue=" << times.nextZValue.count() << "ns";
+  ostream << ", callback=" << times.callback.count() << "ns";
+  ostream << "}";
+  return ostream;
+}
+
+std::ostream& zkd::operator<<(std::ostream& ostream, StorageStats const& stats) {
+  ostream << "StorageStats{";
+  ostream << "blockReads=" << stats.blockReads;
+  ostream << ", blockReadBytes=" << stats.blockReadBytes;
+  ostream << ", blockCacheHits=" << stats.blockCacheHits;
+  ostream << ", internalKeysSkipped=" << stats.internalKeysSkipped;
+  ostream << ", internalDeletesSkipped=" << stats.internalDeletesSkipped;
+  ostream << ", bytesRead=" << stats.bytesRead;
+  ostream << ", blockReadTime=" << stats.blockReadTime.count() << "ns";
+  ostream << "}";
+  return ostream;
+}
+
+std::ostream& zkd::operator<<(std::ostream& ostream, QueryStats const& stats) {
+  ostream << "QueryStats{";
+  ostream << "queries=" << stats.queries;
+  ostream << ", seeks=" << stats.seeks;
+  ostream << ", nexts=" << stats.nexts;
+  ostream << ", keysExamined=" << stats.keysExamined;
+  ostream << ", keysReturned=" << stats.keysReturned;
+  if (stats.profiledQueries > 0) {
+    ostream << ", profiledQueries=" << stats.profiledQueries;
+    ostream << ", phases=" << stats.phases;
+    ostream << ", storage=" << stats.storage;
+  }
+  ostream << "}";
+  return ostream;
+}
@@ -0,0 +1,90 @@
+#ifndef ZKD_TREE_QUERY_STATS_H
+#define ZKD_TREE_QUERY_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+
+namespace zkd {
+
+// Time spent in each phase of a box query.
+struct QueryPhaseTimes {
+  std::chrono::nanoseconds cacheLookup{0}; // EmptyIntervalCache
+  std::chrono::nanoseconds seek{0};
+  std::chrono::nanoseconds next{0};
+  std::chrono::nanoseconds compare{0};     // testInBox on the keys read
+  std::chrono::nanoseconds nextZValue{0};  // next seek target, e.g. compareWithBox and getNextZValue
+  std::chrono::nanoseconds callback{0};
+
+  auto operator+=(QueryPhaseTimes const& other) noexcept -> QueryPhaseTimes&;
+};
+
+// Deltas of RocksDB's PerfContext and IOStatsContext of the querying thread.
+struct StorageStats {
+  std::uint64_t blockReads = 0;
+  std::uint64_t blockReadBytes = 0;
+  std::uint64_t blockCacheHits = 0;
+  std::uint64_t internalKeysSkipped = 0;    // e.g. overwritten versions
+  std::uint64_t internalDeletesSkipped = 0; // tombstones
+  std::uint64_t bytesRead = 0;              // from the file system
+  std::chrono::nanoseconds blockReadTime{0};
+
+  auto operator+=(StorageStats const& other) noexcept -> StorageStats&;
+};
+
+// Work done by box queries, accumulated over all queries it is passed to.
+struct QueryStats {
+  std::size_t queries = 0;
+  std::size_t seeks = 0;
+  std::size_t nexts = 0;
+  std::size_t keysExamined = 0; // keys read from the database
+  std::size_t keysReturned = 0; // keys passed to the callback
+
+  // Only filled for profiled queries, which are much more expensive, see QueryStatsSampler.
+  std::size_t profiledQueries = 0;
+  QueryPhaseTimes phases;
+  StorageStats storage;
+
+  // keys read, but outside of the box
+  auto falsePositives() const noexcept -> std::size_t { return keysExamined - keysReturned; }
+
+  auto operator+=(QueryStats const& other) noexcept -> QueryStats&;
+};
+
+std::ostream& operator<<(std::ostream& ostream, QueryPhaseTimes const& times);
+std::ostream& operator<<(std::ostream& ostream, StorageStats const& stats);
+std::ostream& operator<<(std::ostream& ostream, QueryStats const& stats);
+
+/*
+ * Collects the QueryStats of all box queries run on a handle. The counters of
+ * every query are recorded, but only every `interval`-th query is profiled,
+ * i.e. times its phases and reads the RocksDB perf counters. An interval of 0
+ * disables profiling, 1 profiles every query.
+ */
+class QueryStatsSampler {
+ public:
+  explicit QueryStatsSampler(std::uint32_t interval);
+
+  // whether the next query is to be profiled
+  auto sample() noexcept -> bool;
+  void record(QueryStats const& stats);
+
+  auto totals() const -> QueryStats;
+  void reset();
+
+  auto interval() const noexcept -> std::uint32_t { return _interval; }
+
+ private:
+  std::uint32_t const _interval;
+  std::atomic<std::uint64_t> _counter{0};
+
+  mutable std::mutex _mutex;
+  QueryStats _totals;
+};
+
+} // namespace zkd
+
+#endif //ZKD_TREE_QUERY_STATS_H
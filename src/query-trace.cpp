@@ -0,0 +1,191 @@
+#include "query-trace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+
+using namespace zkd;
+
+namespace {
+constexpr char magic[] = {'Z', 'K', 'D', 'T'};
+constexpr std::uint8_t version = 1;
+
+enum StepFlags : std::uint8_t {
+  LANDED = 1,
+  LIMITING_DIMENSION = 2
+};
+
+void writeHex(std::ostream& ostream, byte_string_view key) {
+  constexpr char digits[] = "0123456789abcdef";
+  ostream << '"';
+  for (auto b : key) {
+    auto v = std::to_integer<unsigned>(b);
+    ostream << digits[v >> 4] << digits[v & 0xf];
+  }
+  ostream << '"';
+}
+
+void writeVarint(std::ostream& ostream, std::uint64_t v) {
+  while (v >= 0x80) {
+    ostream.put(char((v & 0x7f) | 0x80));
+    v >>= 7;
+  }
+  ostream.put(char(v));
+}
+
+void writeBytes(std::ostream& ostream, byte_string_view bytes) {
+  writeVarint(ostream, bytes.size());
+  ostream.write(reinterpret_cast<char const*>(bytes.data()), std::streamsize(bytes.size()));
+}
+
+auto readByte(std::istream& istream) -> std::uint8_t {
+  auto c = istream.get();
+  if (c == std::istream::traits_type::eof()) {
+    throw std::invalid_argument("truncated query trace");
+  }
+  return std::uint8_t(c);
+}
+
+auto readVarint(std::istream& istream) -> std::uint64_t {
+  std::uint64_t v = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    auto b = readByte(istream);
+    v |= std::uint64_t(b & 0x7f) << shift;
+    if ((b & 0x80) == 0) {
+      return v;
+    }
+  }
+  throw std::invalid_argument("malformed varint in query trace");
+}
+
+auto readBytes(std::istream& istream, std::size_t size) -> byte_string {
+  byte_string bytes(size, std::byte{0});
+  istream.read(reinterpret_cast<char*>(bytes.data()), std::streamsize(size));
+  if (std::size_t(istream.gcount()) != size) {
+    throw std::invalid_argument("truncated query trace");
+  }
+  return bytes;
+}
+
+auto readBytes(std::istream& istream) -> byte_string {
+  return readBytes(istream, readVarint(istream));
+}
+} // namespace
+
+void zkd::writeJson(std::ostream& ostream, QueryTrace const& trace) {
+  ostream << "{\"dimensions\":" << trace.dimensions << ",\"min\":";
+  writeHex(ostream, trace.min);
+  ostream << ",\"max\":";
+  writeHex(ostream, trace.max);
+  ostream << ",\"seeks\":" << trace.stats.seeks << ",\"nexts\":" << trace.stats.nexts
+          << ",\"keysExamined\":" << trace.stats.keysExamined << ",\"keysReturned\":" << trace.stats.keysReturned;
+  ostream << ",\"steps\":[";
+  for (std::size_t i = 0; i < trace.steps.size(); ++i) {
+    auto const& step = trace.steps[i];
+    if (i > 0) {
+      ostream << ",";
+    }
+    ostream << "{\"target\":";
+    writeHex(ostream, step.target);
+    ostream << ",\"landed\":";
+    if (step.landed) {
+      writeHex(ostream, *step.landed);
+    } else {
+      ostream << "null";
+    }
+    ostream << ",\"run\":" << step.run << ",\"limitingDimension\":";
+    if (step.limitingDimension) {
+      ostream << *step.limitingDimension;
+    } else {
+      ostream << "null";
+    }
+    ostream << ",\"cacheSkips\":" << step.cacheSkips << "}";
+  }
+  ostream << "]}" << std::endl;
+}
+
+void zkd::writeBinary(std::ostream& ostream, QueryTrace const& trace) {
+  ostream.write(magic, sizeof(magic));
+  ostream.put(char(version));
+  writeVarint(ostream, trace.dimensions);
+  writeBytes(ostream, trace.min);
+  writeBytes(ostream, trace.max);
+  for (auto v : {trace.stats.seeks, trace.stats.nexts, trace.stats.keysExamined, trace.stats.keysReturned}) {
+    writeVarint(ostream, v);
+  }
+
+  writeVarint(ostream, trace.steps.size());
+  for (auto const& step : trace.steps) {
+    std::uint8_t flags = 0;
+    if (step.landed) {
+      flags |= LANDED;
+    }
+    if (step.limitingDimension) {
+      flags |= LIMITING_DIMENSION;
+    }
+    ostream.put(char(flags));
+    writeBytes(ostream, step.target);
+    if (step.landed) {
+      auto const& landed = *step.landed;
+      auto shared = std::size_t(
+          std::mismatch(landed.begin(), landed.begin() + std::min(landed.size(), step.target.size()), step.target.begin())
+              .first -
+          landed.begin());
+      writeVarint(ostream, shared);
+      writeBytes(ostream, byte_string_view{landed}.substr(shared));
+    }
+    writeVarint(ostream, step.run);
+    if (step.limitingDimension) {
+      writeVarint(ostream, *step.limitingDimension);
+    }
+    writeVarint(ostream, step.cacheSkips);
+  }
+}
+
+auto zkd::readBinary(std::istream& istream) -> std::optional<QueryTrace> {
+  if (istream.peek() == std::istream::traits_type::eof()) {
+    return std::nullopt;
+  }
+  char header[sizeof(magic)];
+  istream.read(header, sizeof(header));
+  if (istream.gcount() != sizeof(header) || !std::equal(header, header + sizeof(header), magic)) {
+    throw std::invalid_argument("not a query trace");
+  }
+  if (readByte(istream) != version) {
+    throw std::invalid_argument("unsupported query trace version");
+  }
+
+  QueryTrace trace;
+  trace.dimensions = readVarint(istream);
+  trace.min = readBytes(istream);
+  trace.max = readBytes(istream);
+  trace.stats.queries = 1;
+  trace.stats.seeks = readVarint(istream);
+  trace.stats.nexts = readVarint(istream);
+  trace.stats.keysExamined = readVarint(istream);
+  trace.stats.keysReturned = readVarint(istream);
+
+  auto const steps = readVarint(istream);
+  for (std::uint64_t i = 0; i < steps; ++i) {
+    TraceStep step;
+    auto const flags = readByte(istream);
+    step.target = readBytes(istream);
+    if (flags & LANDED) {
+      auto const shared = readVarint(istream);
+      if (shared > step.target.size()) {
+        throw std::invalid_argument("malformed step in query trace");
+      }
+      byte_string landed{byte_string_view{step.target}.substr(0, shared)};
+      landed += readBytes(istream);
+      step.landed = std::move(landed);
+    }
+    step.run = readVarint(istream);
+    if (flags & LIMITING_DIMENSION) {
+      step.limitingDimension = readVarint(istream);
+    }
+    step.cacheSkips = readVarint(istream);
+    trace.steps.push_back(std::move(step));
+  }
+  return trace;
+}
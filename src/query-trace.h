@@ -0,0 +1,51 @@
+#ifndef ZKD_TREE_QUERY_TRACE_H
+#define ZKD_TREE_QUERY_TRACE_H
+
+#include <cstddef>
+#include <iosfwd>
+#include <optional>
+#include <vector>
+
+#include "library.h"
+#include "query-stats.h"
+
+namespace zkd {
+
+// One seek of a box query and the keys it produced.
+struct TraceStep {
+  byte_string target;
+  std::optional<byte_string> landed; // key the seek landed on, std::nullopt at the end of the data
+  std::size_t run = 0;               // keys inside of the box, starting at `landed`
+  // dimension that left the box and led to this target, see limitingDimension;
+  // std::nullopt for the first seek and the end of a cached empty interval
+  std::optional<std::size_t> limitingDimension;
+  std::size_t cacheSkips = 0; // cached empty intervals skipped before this seek
+};
+
+struct QueryTrace {
+  byte_string min;
+  byte_string max;
+  std::size_t dimensions = 0;
+  std::vector<TraceStep> steps;
+  QueryStats stats;
+};
+
+/*
+ * JSON object with the box, the stats and one object per step, keys as hex
+ * strings. Meant for ad-hoc inspection and plotting.
+ */
+void writeJson(std::ostream& ostream, QueryTrace const& trace);
+
+/*
+ * Compact binary encoding for collecting many traces: varints, and landed
+ * keys stored relative to their seek target, with which they usually share a
+ * long prefix. Traces can be appended to the same stream and read back one
+ * after another.
+ */
+void writeBinary(std::ostream& ostream, QueryTrace const& trace);
+// std::nullopt at the end of the stream, throws std::invalid_argument on malformed input
+auto readBinary(std::istream& istream) -> std::optional<QueryTrace>;
+
+} // namespace zkd
+
+#endif //ZKD_TREE_QUERY_TRACE_H
@@ -0,0 +1,69 @@
+#include "rectangle-index.h"
+
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+
+using namespace zkd;
+
+namespace {
+void checkRectangle(std::vector<byte_string> const& min, std::vector<byte_string> const& max) {
+  if (min.empty() || min.size() != max.size()) {
+    throw std::invalid_argument("rectangle corners must have the same number of dimensions");
+  }
+  for (std::size_t d = 0; d < min.size(); ++d) {
+    if (min[d].size() != min[0].size() || max[d].size() != min[0].size()) {
+      throw std::invalid_argument("rectangle coordinates must be of equal size");
+    }
+    if (max[d] < min[d]) {
+      throw std::invalid_argument("rectangle min corner must not be greater than its max corner");
+    }
+  }
+}
+} // namespace
+
+auto zkd::encodeRectangle(std::vector<byte_string> const& min, std::vector<byte_string> const& max) -> byte_string {
+  checkRectangle(min, max);
+  std::vector<byte_string> coords = min;
+  coords.insert(coords.end(), max.begin(), max.end());
+  return interleave(coords);
+}
+
+auto zkd::decodeRectangle(byte_string_view key, std::size_t dimensions)
+  -> std::pair<std::vector<byte_string>, std::vector<byte_string>> {
+  auto coords = transpose(key, 2 * dimensions);
+  std::vector<byte_string> max(std::make_move_iterator(coords.begin() + dimensions),
+                               std::make_move_iterator(coords.end()));
+  coords.resize(dimensions);
+  return {std::move(coords), std::move(max)};
+}
+
+auto zkd::makeRectangleQuery(RectangleRelation relation, std::vector<byte_string> const& min,
+                             std::vector<byte_string> const& max, std::size_t coordinateSize) -> Box {
+  checkRectangle(min, max);
+  auto const dims = min.size();
+  // bounds of the min corners in the first half, of the max corners in the second
+  std::vector<std::optional<byte_string>> lower(2 * dims), upper(2 * dims);
+  for (std::size_t d = 0; d < dims; ++d) {
+    switch (relation) {
+      case RectangleRelation::INTERSECTS:
+        // r.min <= q.max and r.max >= q.min
+        upper[d] = max[d];
+        lower[dims + d] = min[d];
+        break;
+      case RectangleRelation::WITHIN:
+        // q.min <= r.min and r.max <= q.max, and r.min <= r.max tightens the rest
+        lower[d] = min[d];
+        upper[d] = max[d];
+        lower[dims + d] = min[d];
+        upper[dims + d] = max[d];
+        break;
+      case RectangleRelation::CONTAINS:
+        // r.min <= q.min and r.max >= q.max
+        upper[d] = min[d];
+        lower[dims + d] = max[d];
+        break;
+    }
+  }
+  return makeBox(lower, upper, coordinateSize);
+}
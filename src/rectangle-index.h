@@ -0,0 +1,41 @@
+#ifndef ZKD_TREE_RECTANGLE_INDEX_H
+#define ZKD_TREE_RECTANGLE_INDEX_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "library.h"
+
+namespace zkd {
+
+/*
+ * Rectangles of D dimensions are stored as points of 2D dimensions: the
+ * coordinates of the min corner, followed by those of the max corner,
+ * interleaved round robin. Queries for rectangles in some relation to a query
+ * rectangle become boxes on this doubled space, some of them bounded on one
+ * side only, so they run as regular box queries over 2D dimensions.
+ */
+
+// throws std::invalid_argument unless all coordinates are of equal size and min <= max
+auto encodeRectangle(std::vector<byte_string> const& min, std::vector<byte_string> const& max) -> byte_string;
+// the min and max corners of a rectangle of `dimensions` dimensions
+auto decodeRectangle(byte_string_view key, std::size_t dimensions)
+  -> std::pair<std::vector<byte_string>, std::vector<byte_string>>;
+
+enum class RectangleRelation {
+  INTERSECTS, // shares at least a point with the query rectangle
+  WITHIN,     // lies completely inside of the query rectangle
+  CONTAINS    // contains the query rectangle, e.g. a point
+};
+
+/*
+ * The box over the doubled space for the stored rectangles in `relation` to
+ * the query rectangle [min, max], for findAllInBox with 2D dimensions.
+ */
+auto makeRectangleQuery(RectangleRelation relation, std::vector<byte_string> const& min,
+                        std::vector<byte_string> const& max, std::size_t coordinateSize) -> Box;
+
+} // namespace zkd
+
+#endif //ZKD_TREE_RECTANGLE_INDEX_H
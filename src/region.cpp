@@ -0,0 +1,201 @@
+#include "region.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+#include "box-cursor.h"
+
+using namespace zkd;
+
+namespace {
+// whether the segment from a to b touches the box [x0, x1] x [y0, y1], by Liang-Barsky clipping
+auto segmentTouchesBox(std::pair<double, double> a, std::pair<double, double> b, double x0, double y0, double x1,
+                       double y1) -> bool {
+  auto const dx = b.first - a.first, dy = b.second - a.second;
+  double t0 = 0, t1 = 1;
+  for (auto [p, q] : {std::pair{-dx, a.first - x0}, std::pair{dx, x1 - a.first}, std::pair{-dy, a.second - y0},
+                      std::pair{dy, y1 - a.second}}) {
+    if (p == 0) {
+      if (q < 0) {
+        return false;
+      }
+      continue;
+    }
+    auto const r = q / p;
+    if (p < 0) {
+      t0 = std::max(t0, r);
+    } else {
+      t1 = std::min(t1, r);
+    }
+    if (t0 > t1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct region_cell {
+  byte_string lo;
+  unsigned bits;
+  CellRelation relation;
+};
+
+auto relateCell(Region const& region, byte_string_view lo, unsigned bits, InterleaveSchedule const* schedule)
+  -> CellRelation {
+  auto const dims = region.dimensions();
+  return region.relate(regionCoordinates(lo, dims, schedule),
+                       regionCoordinates(cellUpperBound(lo, bits), dims, schedule));
+}
+
+// whether the cells merge into a single interval
+auto continues(region_cell const& a, region_cell const& b) -> bool {
+  auto const next = keySuccessor(cellUpperBound(a.lo, a.bits));
+  return (a.relation == CellRelation::CONTAINED) == (b.relation == CellRelation::CONTAINED) && next == b.lo;
+}
+
+auto countRuns(std::vector<region_cell> const& cells) -> std::size_t {
+  std::size_t runs = 0;
+  for (std::size_t i = 0; i < cells.size(); ++i) {
+    if (i == 0 || !continues(cells[i - 1], cells[i])) {
+      runs += 1;
+    }
+  }
+  return runs;
+}
+} // namespace
+
+zkd::Ball::Ball(std::vector<double> center, double radius) : _center(std::move(center)), _radius(radius) {
+  if (_center.empty() || !(radius >= 0)) {
+    throw std::invalid_argument("a ball needs a center and a non-negative radius");
+  }
+}
+
+auto zkd::Ball::relate(std::vector<double> const& min, std::vector<double> const& max) const -> CellRelation {
+  double nearest = 0, farthest = 0;
+  for (std::size_t d = 0; d < _center.size(); ++d) {
+    auto const c = _center[d];
+    auto const near = std::clamp(c, min[d], max[d]) - c;
+    auto const far = std::max(c - min[d], max[d] - c);
+    nearest += near * near;
+    farthest += far * far;
+  }
+  auto const r2 = _radius * _radius;
+  if (nearest > r2) {
+    return CellRelation::DISJOINT;
+  }
+  return farthest <= r2 ? CellRelation::CONTAINED : CellRelation::PARTIAL;
+}
+
+auto zkd::Ball::contains(std::vector<double> const& point) const -> bool {
+  double distance = 0;
+  for (std::size_t d = 0; d < _center.size(); ++d) {
+    distance += (point[d] - _center[d]) * (point[d] - _center[d]);
+  }
+  return distance <= _radius * _radius;
+}
+
+zkd::Polygon::Polygon(std::vector<std::pair<double, double>> vertices) : _vertices(std::move(vertices)) {
+  if (_vertices.size() < 3) {
+    throw std::invalid_argument("a polygon needs at least three vertices");
+  }
+}
+
+auto zkd::Polygon::relate(std::vector<double> const& min, std::vector<double> const& max) const -> CellRelation {
+  for (std::size_t i = 0; i < _vertices.size(); ++i) {
+    auto const& a = _vertices[i];
+    auto const& b = _vertices[(i + 1) % _vertices.size()];
+    if (segmentTouchesBox(a, b, min[0], min[1], max[0], max[1])) {
+      return CellRelation::PARTIAL;
+    }
+  }
+  // the border doesn't cross the box, so it is inside or outside as a whole
+  return contains(min[0], min[1]) ? CellRelation::CONTAINED : CellRelation::DISJOINT;
+}
+
+auto zkd::Polygon::contains(std::vector<double> const& point) const -> bool {
+  return contains(point[0], point[1]);
+}
+
+auto zkd::Polygon::contains(double x, double y) const -> bool {
+  bool inside = false;
+  for (std::size_t i = 0, j = _vertices.size() - 1; i < _vertices.size(); j = i++) {
+    auto const [xi, yi] = _vertices[i];
+    auto const [xj, yj] = _vertices[j];
+    if (segmentTouchesBox(_vertices[j], _vertices[i], x, y, x, y)) {
+      return true; // on the border
+    }
+    if ((yi > y) != (yj > y) && x < (xj - xi) * (y - yi) / (yj - yi) + xi) {
+      inside = !inside;
+    }
+  }
+  return inside;
+}
+
+auto zkd::regionCoordinates(byte_string_view key, std::size_t dimensions, InterleaveSchedule const* schedule)
+  -> std::vector<double> {
+  std::vector<std::uint64_t> coords(dimensions, 0);
+  auto const bits = schedule != nullptr ? std::min(schedule->bits(), 8 * key.size()) : 8 * key.size();
+  for (std::size_t bit = 0; bit < bits; ++bit) {
+    auto& c = coords[schedule != nullptr ? schedule->dimension(bit) : bit % dimensions];
+    c = (c << 1) | std::uint64_t((key[bit / 8] & std::byte(0x80u >> (bit % 8))) != std::byte{0});
+  }
+  return std::vector<double>(coords.begin(), coords.end());
+}
+
+auto zkd::coverRegion(Region const& region, std::size_t keySize, InterleaveSchedule const* schedule,
+                      std::size_t maxIntervals) -> std::vector<RegionInterval> {
+  if (schedule != nullptr && schedule->dimensions() != region.dimensions()) {
+    throw std::invalid_argument("region does not match the interleave schedule");
+  }
+  auto const maxBits = unsigned(schedule != nullptr ? std::min(schedule->bits(), 8 * keySize) : 8 * keySize);
+
+  std::vector<region_cell> cells;
+  {
+    auto root = byte_string(keySize, std::byte{0});
+    auto const relation = relateCell(region, root, 0, schedule);
+    if (relation != CellRelation::DISJOINT) {
+      cells.push_back({std::move(root), 0, relation});
+    }
+  }
+
+  // refine the border cells one bit at a time
+  for (unsigned bits = 0; bits < maxBits; ++bits) {
+    if (std::all_of(cells.begin(), cells.end(), [](auto const& c) { return c.relation == CellRelation::CONTAINED; })) {
+      break;
+    }
+    std::vector<region_cell> refined;
+    for (auto const& cell : cells) {
+      if (cell.relation == CellRelation::CONTAINED) {
+        refined.push_back(cell);
+        continue;
+      }
+      for (bool one : {false, true}) {
+        auto child = cell.lo;
+        if (one) {
+          child[bits / 8] |= std::byte(0x80u >> (bits % 8));
+        }
+        auto const relation = relateCell(region, child, bits + 1, schedule);
+        if (relation != CellRelation::DISJOINT) {
+          refined.push_back({std::move(child), bits + 1, relation});
+        }
+      }
+    }
+    if (countRuns(refined) > maxIntervals && bits > 0) {
+      break;
+    }
+    cells = std::move(refined);
+  }
+
+  std::vector<RegionInterval> intervals;
+  for (std::size_t i = 0; i < cells.size(); ++i) {
+    auto hi = cellUpperBound(cells[i].lo, cells[i].bits);
+    if (i > 0 && continues(cells[i - 1], cells[i])) {
+      intervals.back().interval.hi = std::move(hi);
+    } else {
+      intervals.push_back({{cells[i].lo, std::move(hi)}, cells[i].relation == CellRelation::CONTAINED});
+    }
+  }
+  return intervals;
+}
@@ -0,0 +1,78 @@
+#ifndef ZKD_TREE_REGION_H
+#define ZKD_TREE_REGION_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "interleave-schedule.h"
+#include "library.h"
+
+namespace zkd {
+
+/*
+ * A region of the key space that is not a box. Its coordinates are the
+ * coordinates of the keys as unsigned integers, e.g. the cells of a
+ * QuantizingCodec, so shapes in values are scaled by the caller.
+ */
+class Region {
+ public:
+  virtual ~Region() = default;
+
+  virtual auto dimensions() const noexcept -> std::size_t = 0;
+  // how the box [min, max] relates to the region; PARTIAL is always safe
+  virtual auto relate(std::vector<double> const& min, std::vector<double> const& max) const -> CellRelation = 0;
+  virtual auto contains(std::vector<double> const& point) const -> bool = 0;
+};
+
+// all points within `radius` of `center`, by euclidean distance
+class Ball final : public Region {
+ public:
+  Ball(std::vector<double> center, double radius);
+
+  auto dimensions() const noexcept -> std::size_t override { return _center.size(); }
+  auto relate(std::vector<double> const& min, std::vector<double> const& max) const -> CellRelation override;
+  auto contains(std::vector<double> const& point) const -> bool override;
+
+ private:
+  std::vector<double> _center;
+  double _radius;
+};
+
+// a simple polygon in two dimensions, closed implicitly; its border belongs to it
+class Polygon final : public Region {
+ public:
+  // throws std::invalid_argument for less than three vertices
+  explicit Polygon(std::vector<std::pair<double, double>> vertices);
+
+  auto dimensions() const noexcept -> std::size_t override { return 2; }
+  auto relate(std::vector<double> const& min, std::vector<double> const& max) const -> CellRelation override;
+  auto contains(std::vector<double> const& point) const -> bool override;
+
+ private:
+  auto contains(double x, double y) const -> bool;
+
+  std::vector<std::pair<double, double>> _vertices;
+};
+
+// the coordinates of a key as integers, interleaved round robin or with `schedule`
+auto regionCoordinates(byte_string_view key, std::size_t dimensions, InterleaveSchedule const* schedule)
+  -> std::vector<double>;
+
+struct RegionInterval {
+  ZInterval interval;
+  bool exact = false; // only holds keys inside of the region
+};
+
+/*
+ * Covers the region with disjoint Z-intervals of keys of `keySize` bytes, in
+ * Z-order, like coverBox: cells on the border of the region are split as long
+ * as the cover needs no more than `maxIntervals` intervals. Intervals of cells
+ * completely inside of the region are exact.
+ */
+auto coverRegion(Region const& region, std::size_t keySize, InterleaveSchedule const* schedule,
+                 std::size_t maxIntervals) -> std::vector<RegionInterval>;
+
+} // namespace zkd
+
+#endif //ZKD_TREE_REGION_H
@@ -0,0 +1,86 @@
+#include "result-batch.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace zkd;
+
+zkd::ResultBatch::ResultBatch(std::size_t dimensions, std::size_t capacity, InterleaveSchedule const* schedule)
+    : _capacity(capacity), _widths(dimensions, 0), _columns(dimensions) {
+  if (dimensions == 0 || capacity == 0) {
+    throw std::invalid_argument("result batches need at least one dimension and a capacity");
+  }
+  if (schedule != nullptr) {
+    if (schedule->dimensions() != dimensions) {
+      throw std::invalid_argument("interleave schedule does not match the dimensions of the result batch");
+    }
+    _schedule = std::make_shared<InterleaveSchedule const>(*schedule);
+  }
+  _valueOffsets.reserve(capacity + 1);
+  _valueOffsets.push_back(0);
+}
+
+void zkd::ResultBatch::add(byte_string_view key, byte_string_view value) {
+  if (full()) {
+    throw std::logic_error("result batch is full");
+  }
+  auto const dims = dimensions();
+  if (_keySize == 0) {
+    // the column widths follow from the first key
+    _keySize = key.size();
+    std::vector<std::size_t> bits(dims, 0);
+    auto const keyBits = 8 * key.size();
+    auto const total = _schedule ? std::min(keyBits, _schedule->bits()) : keyBits;
+    for (std::size_t bit = 0; bit < total; ++bit) {
+      bits[_schedule ? _schedule->dimension(bit) : bit % dims] += 1;
+    }
+    for (std::size_t dim = 0; dim < dims; ++dim) {
+      _widths[dim] = (bits[dim] + 7) / 8;
+      _columns[dim].reserve(_capacity * _widths[dim]);
+    }
+    _keys.reserve(_capacity * _keySize);
+  } else if (key.size() != _keySize) {
+    throw std::invalid_argument("keys of a result batch must be of equal size");
+  }
+
+  for (std::size_t dim = 0; dim < dims; ++dim) {
+    _columns[dim].resize((_size + 1) * _widths[dim], std::byte{0});
+  }
+  auto const keyBits = 8 * key.size();
+  auto const total = _schedule ? std::min(keyBits, _schedule->bits()) : keyBits;
+  for (std::size_t bit = 0; bit < total; ++bit) {
+    if ((key[bit / 8] & std::byte(0x80u >> (bit % 8))) == std::byte{0}) {
+      continue;
+    }
+    auto const dim = _schedule ? _schedule->dimension(bit) : bit % dims;
+    auto const step = _schedule ? _schedule->step(bit) : bit / dims;
+    _columns[dim][_size * _widths[dim] + step / 8] |= std::byte(0x80u >> (step % 8));
+  }
+
+  _keys.append(key);
+  _values.append(value);
+  _valueOffsets.push_back(_values.size());
+  _size += 1;
+}
+
+void zkd::ResultBatch::clear() noexcept {
+  for (auto& column : _columns) {
+    column.clear();
+  }
+  _keys.clear();
+  _values.clear();
+  _valueOffsets.resize(1);
+  _size = 0;
+}
+
+auto zkd::ResultBatch::key(std::size_t i) const noexcept -> byte_string_view {
+  return byte_string_view{_keys}.substr(i * _keySize, _keySize);
+}
+
+auto zkd::ResultBatch::value(std::size_t i) const noexcept -> byte_string_view {
+  return byte_string_view{_values}.substr(_valueOffsets[i], _valueOffsets[i + 1] - _valueOffsets[i]);
+}
+
+auto zkd::ResultBatch::coordinate(std::size_t dim, std::size_t i) const noexcept -> byte_string_view {
+  return byte_string_view{_columns[dim]}.substr(i * _widths[dim], _widths[dim]);
+}
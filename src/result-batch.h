@@ -0,0 +1,72 @@
+#ifndef ZKD_TREE_RESULT_BATCH_H
+#define ZKD_TREE_RESULT_BATCH_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "interleave-schedule.h"
+#include "library.h"
+
+namespace zkd {
+
+/*
+ * Results of a box query in columns: the coordinates of every dimension back
+ * to back in one array, next to the keys and values. Keys are transposed as
+ * they are added, with the interleave schedule if there is one. All keys of a
+ * batch must be of the same size; the columns are `coordinateSize(dim)` bytes
+ * wide, i.e. what transpose returns for them.
+ *
+ * clear keeps the buffers, so a batch reused for a whole query allocates only
+ * while it grows to its capacity.
+ */
+class ResultBatch {
+ public:
+  // throws std::invalid_argument for zero dimensions or capacity, or a schedule of other dimensions
+  ResultBatch(std::size_t dimensions, std::size_t capacity, InterleaveSchedule const* schedule = nullptr);
+
+  auto dimensions() const noexcept -> std::size_t { return _columns.size(); }
+  auto capacity() const noexcept -> std::size_t { return _capacity; }
+  auto size() const noexcept -> std::size_t { return _size; }
+  auto empty() const noexcept -> bool { return _size == 0; }
+  auto full() const noexcept -> bool { return _size >= _capacity; }
+
+  // throws std::logic_error if full, std::invalid_argument if the key size differs from the previous keys
+  void add(byte_string_view key, byte_string_view value);
+  void clear() noexcept;
+
+  auto key(std::size_t i) const noexcept -> byte_string_view;
+  auto value(std::size_t i) const noexcept -> byte_string_view;
+
+  auto coordinateSize(std::size_t dim) const noexcept -> std::size_t { return _widths[dim]; }
+  auto coordinate(std::size_t dim, std::size_t i) const noexcept -> byte_string_view;
+  // size() coordinates of coordinateSize(dim) bytes
+  auto column(std::size_t dim) const noexcept -> byte_string_view { return _columns[dim]; }
+
+  // decodes a column with from_byte_string_fixed_length, reusing `out`
+  template<typename T>
+  void decodeColumn(std::size_t dim, std::vector<T>& out) const {
+    out.resize(_size);
+    for (std::size_t i = 0; i < _size; ++i) {
+      out[i] = from_byte_string_fixed_length<T>(coordinate(dim, i));
+    }
+  }
+
+ private:
+  std::size_t _capacity;
+  std::size_t _size = 0;
+  std::shared_ptr<InterleaveSchedule const> _schedule;
+  std::size_t _keySize = 0; // of all keys, 0 until the first one is added
+  std::vector<std::size_t> _widths;
+  std::vector<byte_string> _columns;
+  byte_string _keys;
+  byte_string _values;
+  std::vector<std::size_t> _valueOffsets;
+};
+
+using BatchCallback = std::function<void(ResultBatch const& batch)>;
+
+} // namespace zkd
+
+#endif //ZKD_TREE_RESULT_BATCH_H
@@ -1,15 +1,89 @@
 #include "rocksdb-handle.h"
 
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <rocksdb/write_batch.h>
+
+#include "prefix-summary.h"
+
+static const std::string summaryFamilyName = "zkd-summaries";
+static const std::string metadataFamilyName = "zkd-metadata";
+static const std::string layoutKey = "layout";
+
+// "hilbert", "z-order", or "z-order:" followed by the schedule
+static auto formatLayout(zkd::Curve curve, std::optional<zkd::InterleaveSchedule> const &schedule) -> std::string {
+  std::stringstream ss;
+  ss << curve;
+  if (schedule.has_value()) {
+    ss << ":" << *schedule;
+  }
+  return ss.str();
+}
+
+static void parseLayout(std::string const &layout, zkd::Curve &curve, std::optional<zkd::InterleaveSchedule> &schedule) {
+  auto const colon = layout.find(':');
+  auto const name = layout.substr(0, colon);
+  if (name == "hilbert") {
+    curve = zkd::Curve::HILBERT;
+  } else if (name == "z-order") {
+    curve = zkd::Curve::Z_ORDER;
+  } else {
+    throw std::runtime_error("unknown curve " + name + " stored in the database");
+  }
+  schedule.reset();
+  if (colon != std::string::npos) {
+    schedule = zkd::parseInterleaveSchedule(std::string_view{layout}.substr(colon + 1));
+  }
+}
+
 std::shared_ptr<RocksDBHandle> OpenRocksDB(std::string const &dbname) {
+  return OpenRocksDB(dbname, RocksDBOptions{});
+}
+
+std::shared_ptr<RocksDBHandle> OpenRocksDB(std::string const &dbname, RocksDBOptions const &options) {
+  auto summaryPrefixBits = options.summaryPrefixBits;
+  std::sort(summaryPrefixBits.begin(), summaryPrefixBits.end());
+  summaryPrefixBits.erase(std::unique(summaryPrefixBits.begin(), summaryPrefixBits.end()), summaryPrefixBits.end());
+  auto const checkLayout = [&](zkd::Curve curve, std::optional<zkd::InterleaveSchedule> const &schedule) {
+    if (!summaryPrefixBits.empty() && curve != zkd::Curve::Z_ORDER) {
+      throw std::invalid_argument("prefix summaries require Z-order keys");
+    }
+    if (schedule.has_value() && (curve != zkd::Curve::Z_ORDER || !summaryPrefixBits.empty())) {
+      throw std::invalid_argument("interleave schedules require Z-order keys without summaries");
+    }
+  };
+  if (!options.useStoredLayout) {
+    checkLayout(options.curve, options.schedule);
+  }
+  if (options.timeToLive.has_value() && !summaryPrefixBits.empty()) {
+    // compactions can't update the counts of the keys they drop
+    throw std::invalid_argument("time to live is not supported with summaries");
+  }
+  if (options.timeToLive.has_value() && options.useStoredLayout) {
+    // the compaction filter decodes keys with the layout it is given before the database is opened
+    throw std::invalid_argument("time to live needs the curve and schedule in the options");
+  }
+
   rocksdb::DB *ptr;
   rocksdb::DBOptions opts;
   opts.create_if_missing = true;
   opts.create_missing_column_families = true;
 
   rocksdb::ColumnFamilyOptions defaultFamily;
+  if (options.timeToLive.has_value()) {
+    defaultFamily.compaction_filter_factory =
+      zkd::makeTimeToLiveFilterFactory(*options.timeToLive, options.curve, options.schedule);
+  }
 
   std::vector<rocksdb::ColumnFamilyDescriptor> families;
   families.emplace_back(rocksdb::kDefaultColumnFamilyName, defaultFamily);
+  families.emplace_back(metadataFamilyName, rocksdb::ColumnFamilyOptions{});
+  if (!summaryPrefixBits.empty()) {
+    rocksdb::ColumnFamilyOptions summaryFamily;
+    summaryFamily.merge_operator = zkd::makeCountMergeOperator();
+    families.emplace_back(summaryFamilyName, summaryFamily);
+  }
 
   std::vector<rocksdb::ColumnFamilyHandle *> handles;
 
@@ -21,5 +95,135 @@ std::shared_ptr<RocksDBHandle> OpenRocksDB(std::string const &dbname) {
   std::unique_ptr<rocksdb::DB> db_ptr{ptr};
   std::unique_ptr<rocksdb::ColumnFamilyHandle> defs_ptr{handles[0]};
 
-  return std::make_shared<RocksDBHandle>(std::move(db_ptr), std::move(defs_ptr));
+  auto handle = std::make_shared<RocksDBHandle>(std::move(db_ptr), std::move(defs_ptr));
+  auto metadata = std::unique_ptr<rocksdb::ColumnFamilyHandle>{handles[1]};
+  if (!summaryPrefixBits.empty()) {
+    handle->summaries.reset(handles[2]);
+  }
+
+  // the layout of the first open is kept, so keys are never read with another one
+  auto curve = options.curve;
+  auto schedule = options.schedule;
+  std::string stored;
+  status = handle->db->Get({}, metadata.get(), layoutKey, &stored);
+  if (status.IsNotFound()) {
+    status = handle->db->Put({}, metadata.get(), layoutKey, formatLayout(curve, schedule));
+  } else if (status.ok()) {
+    if (options.useStoredLayout) {
+      parseLayout(stored, curve, schedule);
+      try {
+        checkLayout(curve, schedule);
+      } catch (std::invalid_argument const &) {
+        // summaries can't exist with this layout, so this open created them; every later one would have to list them
+        if (handle->summaries != nullptr) {
+          handle->db->DropColumnFamily(handle->summaries.get());
+        }
+        throw;
+      }
+    } else if (stored != formatLayout(curve, schedule)) {
+      throw std::invalid_argument("database was created with the layout " + stored + ", not " + formatLayout(curve, schedule));
+    }
+  }
+  if (!status.ok()) {
+    throw std::runtime_error(status.ToString());
+  }
+
+  handle->summaryPrefixBits = std::move(summaryPrefixBits);
+  handle->curve = curve;
+  handle->readaheadSize = options.readaheadSize;
+  handle->asyncIo = options.asyncIo;
+  if (schedule.has_value()) {
+    handle->schedule = std::make_shared<zkd::InterleaveSchedule const>(*schedule);
+  }
+  return handle;
+}
+
+bool HasSummaries(std::string const &dbname) {
+  std::vector<std::string> names;
+  auto status = rocksdb::DB::ListColumnFamilies(rocksdb::DBOptions{}, dbname, &names);
+  return status.ok() && std::find(names.begin(), names.end(), summaryFamilyName) != names.end();
+}
+
+static auto sliceFromView(zkd::byte_string_view str) -> rocksdb::Slice {
+  return rocksdb::Slice(reinterpret_cast<char const *>(str.data()), str.size());
+}
+
+// Returns NotFound if the key does not exist.
+static auto keyExists(RocksDBHandle &rocks, zkd::byte_string_view key) -> rocksdb::Status {
+  std::string value;
+  return rocks.db->Get({}, rocks.default_.get(), sliceFromView(key), &value);
+}
+
+// Histograms read coordinates from round robin Z-order keys.
+static void updateHistograms(RocksDBHandle &rocks, zkd::byte_string_view key, std::int64_t delta) {
+  if (rocks.schedule != nullptr) {
+    rocks.histograms->add(zkd::interleave(zkd::transpose(key, *rocks.schedule)), delta);
+  } else if (rocks.curve == zkd::Curve::Z_ORDER) {
+    rocks.histograms->add(key, delta);
+  } else {
+    rocks.histograms->add(zkd::interleave(zkd::decodeKey(rocks.curve, key, rocks.histograms->dimensions())), delta);
+  }
+}
+
+// Whether PutKey and DeleteKey need to know if the key exists.
+static auto tracksKeys(RocksDBHandle const &rocks) -> bool {
+  return rocks.summaries != nullptr || rocks.histograms != nullptr;
+}
+
+auto PutKey(RocksDBHandle &rocks, zkd::byte_string_view key, zkd::byte_string_view value) -> rocksdb::Status {
+  rocksdb::WriteBatch batch;
+  batch.Put(rocks.default_.get(), sliceFromView(key), sliceFromView(value));
+
+  bool inserted = false;
+  std::unique_lock<std::mutex> guard;
+  if (tracksKeys(rocks)) {
+    guard = std::unique_lock(rocks.writeMutex);
+    auto s = keyExists(rocks, key);
+    if (s.IsNotFound()) {
+      inserted = true;
+      if (rocks.summaries != nullptr) {
+        zkd::updateSummaries(rocks, batch, key, 1);
+      }
+    } else if (!s.ok()) {
+      return s;
+    }
+  }
+
+  auto s = rocks.db->Write({}, &batch);
+  if (s.ok()) {
+    if (inserted && rocks.histograms != nullptr) {
+      updateHistograms(rocks, key, 1);
+    }
+    if (rocks.emptyIntervals != nullptr) {
+      // only after the write is visible, see EmptyIntervalCache
+      rocks.emptyIntervals->invalidate(key);
+    }
+  }
+  return s;
+}
+
+auto DeleteKey(RocksDBHandle &rocks, zkd::byte_string_view key) -> rocksdb::Status {
+  // deleting keys never invalidates an empty interval
+  rocksdb::WriteBatch batch;
+  batch.Delete(rocks.default_.get(), sliceFromView(key));
+
+  std::unique_lock<std::mutex> guard;
+  if (tracksKeys(rocks)) {
+    guard = std::unique_lock(rocks.writeMutex);
+    auto s = keyExists(rocks, key);
+    if (s.IsNotFound()) {
+      return rocksdb::Status::OK();
+    } else if (!s.ok()) {
+      return s;
+    }
+    if (rocks.summaries != nullptr) {
+      zkd::updateSummaries(rocks, batch, key, -1);
+    }
+  }
+
+  auto s = rocks.db->Write({}, &batch);
+  if (s.ok() && guard.owns_lock() && rocks.histograms != nullptr) {
+    updateHistograms(rocks, key, -1);
+  }
+  return s;
 }
@@ -1,8 +1,43 @@
 #ifndef ZKD_TREE_ROCKSDB_HANDLE_H
 #define ZKD_TREE_ROCKSDB_HANDLE_H
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 #include <rocksdb/db.h>
 
+#include "box-result-cache.h"
+#include "dimension-histograms.h"
+#include "empty-interval-cache.h"
+#include "hilbert-curve.h"
+#include "library.h"
+#include "query-stats.h"
+#include "time-to-live.h"
+
+namespace zkd {
+class DeltaBuffer;
+}
+
+struct RocksDBOptions {
+  // Prefix lengths (in bits of the interleaved key) for which the number of
+  // keys per cell is maintained, see prefix-summary.h. Empty disables summaries.
+  std::vector<unsigned> summaryPrefixBits;
+  // How keys are encoded, see encodeKey. Summaries are only supported for Z-order.
+  zkd::Curve curve = zkd::Curve::Z_ORDER;
+  // How Z-order keys are interleaved, round robin if not set. Box corners must
+  // be interleaved with the same schedule. Not supported with summaries.
+  std::optional<zkd::InterleaveSchedule> schedule;
+  // passed to the iterators of box queries, see rocksdb::ReadOptions; async_io needs RocksDB 7.1 or newer
+  std::size_t readaheadSize = 0;
+  bool asyncIo = false;
+  // drops expired keys in compactions, see time-to-live.h. Not supported with summaries.
+  std::optional<zkd::TimeToLive> timeToLive;
+  // The curve and schedule are stored with the database when it is created, and
+  // opening it with others throws std::invalid_argument. If set, the stored
+  // ones are taken instead of `curve` and `schedule`; not with timeToLive.
+  bool useStoredLayout = false;
+};
+
 struct RocksDBHandle {
   RocksDBHandle(std::unique_ptr<rocksdb::DB> db,
                 std::unique_ptr<rocksdb::ColumnFamilyHandle> def)
@@ -10,8 +45,40 @@ struct RocksDBHandle {
 
   std::unique_ptr<rocksdb::DB> db;
   std::unique_ptr<rocksdb::ColumnFamilyHandle> default_;
+  // nullptr if summaries are disabled
+  std::unique_ptr<rocksdb::ColumnFamilyHandle> summaries;
+  std::vector<unsigned> summaryPrefixBits;
+  zkd::Curve curve = zkd::Curve::Z_ORDER;
+  // nullptr for round robin
+  std::shared_ptr<zkd::InterleaveSchedule const> schedule;
+  std::size_t readaheadSize = 0;
+  bool asyncIo = false;
+  // serializes the read-modify-write cycles of PutKey and DeleteKey if summaries or histograms are enabled
+  std::mutex writeMutex;
+
+  // optional, counts inserted and deleted keys for the query planner
+  std::shared_ptr<zkd::DimensionHistograms> histograms;
+
+  // optional, consulted by box queries and invalidated by PutKey
+  std::shared_ptr<zkd::EmptyIntervalCache> emptyIntervals;
+  // optional, validated against the latest sequence number on every lookup
+  std::shared_ptr<zkd::BoxResultCache> resultCache;
+
+  // optional, takes the writes of putBuffered and deleteBuffered and is merged into box queries, see delta-buffer.h
+  std::shared_ptr<zkd::DeltaBuffer> deltaBuffer;
+
+  // optional, collects the QueryStats of all box queries and profiles a sample of them
+  std::shared_ptr<zkd::QueryStatsSampler> queryStats;
 };
 
 std::shared_ptr<RocksDBHandle> OpenRocksDB(std::string const &dbname);
+std::shared_ptr<RocksDBHandle> OpenRocksDB(std::string const &dbname, RocksDBOptions const &options);
+// Whether the database at dbname has prefix summaries. RocksDB refuses to open it without
+// listing all of its column families, so it must then be opened with summaryPrefixBits.
+bool HasSummaries(std::string const &dbname);
+
+// Write a key and keep the caches and summaries attached to the handle up to date.
+auto PutKey(RocksDBHandle &rocks, zkd::byte_string_view key, zkd::byte_string_view value) -> rocksdb::Status;
+auto DeleteKey(RocksDBHandle &rocks, zkd::byte_string_view key) -> rocksdb::Status;
 
 #endif //ZKD_TREE_ROCKSDB_HANDLE_H
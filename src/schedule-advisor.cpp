@@ -0,0 +1,97 @@
+#include "schedule-advisor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+using namespace zkd;
+
+namespace {
+// the leading bits of the coordinate, at most 64 of them, missing bits filled with `fill`
+auto leadingWord(byte_string_view coord, std::uint64_t fill) -> std::uint64_t {
+  std::uint64_t v = 0;
+  for (std::size_t i = 0; i < 8; ++i) {
+    v = (v << 8) | (i < coord.size() ? std::to_integer<std::uint64_t>(coord[i]) : fill);
+  }
+  return v;
+}
+
+// log2 of the domain size divided by the extent of [min, max]
+auto resolution(byte_string_view min, byte_string_view max) -> double {
+  auto const lo = leadingWord(min, 0);
+  auto const hi = leadingWord(max, 0xff);
+  if (hi <= lo) {
+    return 64.0;
+  }
+  return std::clamp(64.0 - std::log2(double(hi - lo) + 1.0), 0.0, 64.0);
+}
+} // namespace
+
+auto zkd::readQueryLog(std::istream& istream) -> std::vector<QueryTrace> {
+  std::vector<QueryTrace> log;
+  while (auto trace = readBinary(istream)) {
+    log.push_back(std::move(trace.value()));
+  }
+  return log;
+}
+
+auto zkd::queryResolution(std::vector<QueryTrace> const& log, std::size_t dimensions) -> std::vector<double> {
+  std::vector<double> result(dimensions, 0.0);
+  if (log.empty()) {
+    return result;
+  }
+  for (auto const& trace : log) {
+    if (trace.dimensions != dimensions) {
+      throw std::invalid_argument("query log mixes boxes of different dimensions");
+    }
+    auto const min = transpose(trace.min, dimensions);
+    auto const max = transpose(trace.max, dimensions);
+    for (std::size_t dim = 0; dim < dimensions; ++dim) {
+      result[dim] += resolution(min[dim], max[dim]);
+    }
+  }
+  for (auto& r : result) {
+    r /= double(log.size());
+  }
+  return result;
+}
+
+auto zkd::deriveInterleaveSchedule(std::vector<double> const& resolution, std::vector<unsigned> const& budgets)
+  -> InterleaveSchedule {
+  if (resolution.size() != budgets.size() || budgets.empty()) {
+    throw std::invalid_argument("need a resolution and a budget for every dimension");
+  }
+  std::size_t bits = 0;
+  for (auto b : budgets) {
+    if (b == 0) {
+      throw std::invalid_argument("every dimension needs at least one bit");
+    }
+    bits += b;
+  }
+
+  std::vector<unsigned> taken(budgets.size(), 0);
+  std::vector<std::uint16_t> order;
+  order.reserve(bits);
+  while (order.size() < bits) {
+    std::size_t best = budgets.size();
+    for (std::size_t dim = 0; dim < budgets.size(); ++dim) {
+      if (taken[dim] == budgets[dim]) {
+        continue;
+      }
+      // most resolution left first, round robin among equals
+      if (best == budgets.size() || resolution[dim] - taken[dim] > resolution[best] - taken[best] ||
+          (resolution[dim] - taken[dim] == resolution[best] - taken[best] && taken[dim] < taken[best])) {
+        best = dim;
+      }
+    }
+    order.push_back(std::uint16_t(best));
+    taken[best] += 1;
+  }
+  return InterleaveSchedule(std::move(order));
+}
+
+auto zkd::deriveInterleaveSchedule(std::vector<QueryTrace> const& log, std::vector<unsigned> const& budgets)
+  -> InterleaveSchedule {
+  return deriveInterleaveSchedule(queryResolution(log, budgets.size()), budgets);
+}
@@ -0,0 +1,42 @@
+#ifndef ZKD_TREE_SCHEDULE_ADVISOR_H
+#define ZKD_TREE_SCHEDULE_ADVISOR_H
+
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+#include "interleave-schedule.h"
+#include "library.h"
+#include "query-trace.h"
+
+namespace zkd {
+
+/*
+ * Reads a query log, the binary traces of traceBoxQuery appended to one
+ * stream, e.g. by `zkd_index_tool <db> explain <min> <max> binary >> log`.
+ */
+auto readQueryLog(std::istream& istream) -> std::vector<QueryTrace>;
+
+/*
+ * Mean resolution of the queries per dimension: the number of leading bits of
+ * a coordinate that are needed to tell whether it is inside of a query, i.e.
+ * log2 of the domain size divided by the query's extent. An unbounded dimension
+ * has a resolution of 0. The boxes of the log must be interleaved round robin.
+ */
+auto queryResolution(std::vector<QueryTrace> const& log, std::size_t dimensions) -> std::vector<double>;
+
+/*
+ * Schedule with `budgets[dim]` bits per dimension that spends the leading bits
+ * of the key on the dimensions the queries restrict most: every bit goes to the
+ * dimension with the most resolution left, so a dimension queried with 6 bits
+ * more resolution than the others gets its first 6 bits before round robin
+ * starts. That keeps the boxes of the log in few, long Z-intervals.
+ */
+auto deriveInterleaveSchedule(std::vector<double> const& resolution, std::vector<unsigned> const& budgets)
+  -> InterleaveSchedule;
+auto deriveInterleaveSchedule(std::vector<QueryTrace> const& log, std::vector<unsigned> const& budgets)
+  -> InterleaveSchedule;
+
+} // namespace zkd
+
+#endif //ZKD_TREE_SCHEDULE_ADVISOR_H
@@ -0,0 +1,244 @@
+#ifndef ZKD_TREE_SCHEMA_H
+#define ZKD_TREE_SCHEMA_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#include "library.h"
+
+namespace zkd {
+
+namespace schema_detail {
+template<std::size_t size>
+void storeBigEndian(std::uint64_t v, std::byte* out) noexcept {
+  for (std::size_t i = 0; i < size; ++i) {
+    out[i] = std::byte(v >> (8 * (size - 1 - i)));
+  }
+}
+
+template<std::size_t size>
+auto loadBigEndian(std::byte const* in) noexcept -> std::uint64_t {
+  std::uint64_t v = 0;
+  for (std::size_t i = 0; i < size; ++i) {
+    v = (v << 8) | std::to_integer<std::uint64_t>(in[i]);
+  }
+  return v;
+}
+
+// IEEE 754 bits in an order that matches the values: negative numbers inverted, positive ones with the sign set
+template<typename Float, typename Bits>
+auto orderedBits(Float v) noexcept -> Bits {
+  Bits bits;
+  std::memcpy(&bits, &v, sizeof(bits));
+  constexpr auto sign = Bits{1} << (8 * sizeof(Bits) - 1);
+  return (bits & sign) ? ~bits : bits | sign;
+}
+
+template<typename Float, typename Bits>
+auto fromOrderedBits(Bits bits) noexcept -> Float {
+  constexpr auto sign = Bits{1} << (8 * sizeof(Bits) - 1);
+  bits = (bits & sign) ? bits & ~sign : ~bits;
+  Float v;
+  std::memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+} // namespace schema_detail
+
+/*
+ * Codecs for the dimensions of a Schema. Each one writes a value as `size`
+ * bytes whose bytewise order is the order of the values.
+ */
+struct UInt64 {
+  using value_type = std::uint64_t;
+  static constexpr std::size_t size = 8;
+
+  static void encode(value_type v, std::byte* out) noexcept { schema_detail::storeBigEndian<size>(v, out); }
+  static auto decode(std::byte const* in) noexcept -> value_type { return schema_detail::loadBigEndian<size>(in); }
+};
+
+// two's complement with the sign bit flipped
+struct Int64 {
+  using value_type = std::int64_t;
+  static constexpr std::size_t size = 8;
+  static constexpr auto sign = std::uint64_t{1} << 63;
+
+  static void encode(value_type v, std::byte* out) noexcept {
+    schema_detail::storeBigEndian<size>(std::uint64_t(v) ^ sign, out);
+  }
+  static auto decode(std::byte const* in) noexcept -> value_type {
+    return value_type(schema_detail::loadBigEndian<size>(in) ^ sign);
+  }
+};
+
+// exact, unlike to_byte_string_fixed_length<double>; -0.0 sorts before 0.0, NaNs at the ends
+struct Double {
+  using value_type = double;
+  static constexpr std::size_t size = 8;
+
+  static void encode(value_type v, std::byte* out) noexcept {
+    schema_detail::storeBigEndian<size>(schema_detail::orderedBits<double, std::uint64_t>(v), out);
+  }
+  static auto decode(std::byte const* in) noexcept -> value_type {
+    return schema_detail::fromOrderedBits<double, std::uint64_t>(schema_detail::loadBigEndian<size>(in));
+  }
+};
+
+struct Float {
+  using value_type = float;
+  static constexpr std::size_t size = 4;
+
+  static void encode(value_type v, std::byte* out) noexcept {
+    schema_detail::storeBigEndian<size>(schema_detail::orderedBits<float, std::uint32_t>(v), out);
+  }
+  static auto decode(std::byte const* in) noexcept -> value_type {
+    return schema_detail::fromOrderedBits<float, std::uint32_t>(
+      std::uint32_t(schema_detail::loadBigEndian<size>(in)));
+  }
+};
+
+// microseconds since the epoch, like Int64
+struct Timestamp {
+  using value_type = std::chrono::time_point<std::chrono::system_clock, std::chrono::microseconds>;
+  static constexpr std::size_t size = 8;
+
+  static void encode(value_type v, std::byte* out) noexcept { Int64::encode(v.time_since_epoch().count(), out); }
+  static auto decode(std::byte const* in) noexcept -> value_type {
+    return value_type(std::chrono::microseconds(Int64::decode(in)));
+  }
+};
+
+/*
+ * An index over points with one typed value per dimension, e.g.
+ * `Schema<Double, Int64, Timestamp, Float>`. Keys are the round robin
+ * interleaving of the encoded coordinates, shorter ones padded with zeros like
+ * in interleave, so they work with findAllInBox and the other kernels. Encoding
+ * and decoding are generated per schema and work on fixed size arrays, without
+ * per-coordinate strings or a runtime dispatch on the type.
+ */
+template<typename... Codecs>
+class Schema {
+ public:
+  static_assert(sizeof...(Codecs) > 0, "a schema needs at least one dimension");
+
+  using point = std::tuple<typename Codecs::value_type...>;
+  // std::nullopt is unbounded, see makeBox
+  using bounds = std::tuple<std::optional<typename Codecs::value_type>...>;
+
+  static constexpr std::size_t dimensions = sizeof...(Codecs);
+  static constexpr std::size_t coordinateSize = std::max({Codecs::size...});
+  static constexpr std::size_t keySize = dimensions * coordinateSize;
+
+  struct Key : std::array<std::byte, keySize> {
+    operator byte_string_view() const noexcept { return byte_string_view{this->data(), this->size()}; }
+  };
+
+  static auto encode(point const& p) noexcept -> Key {
+    return interleaveCoordinates(encodeCoordinates(p, std::index_sequence_for<Codecs...>{}));
+  }
+
+  // throws std::invalid_argument if the key is not keySize bytes long
+  static auto decode(byte_string_view key) -> point {
+    if (key.size() != keySize) {
+      throw std::invalid_argument("key does not match the schema");
+    }
+    return decodeCoordinates(transposeKey(key), std::index_sequence_for<Codecs...>{});
+  }
+
+  static auto makeBox(point const& min, point const& max) -> Box {
+    Box box;
+    box.min = byte_string{byte_string_view{encode(min)}};
+    box.max = byte_string{byte_string_view{encode(max)}};
+    box.mask.resize(dimensions);
+    return box;
+  }
+
+  static auto makeBox(bounds const& min, bounds const& max) -> Box {
+    Box box;
+    box.mask.resize(dimensions);
+    box.min = boundCorner(min, box.mask, &DimensionBounds::min, std::byte{0}, std::index_sequence_for<Codecs...>{});
+    box.max = boundCorner(max, box.mask, &DimensionBounds::max, std::byte{0xff}, std::index_sequence_for<Codecs...>{});
+    return box;
+  }
+
+  // whether min <= p <= max in every dimension, compared as values
+  static auto contains(point const& min, point const& max, point const& p) noexcept -> bool {
+    return containsImpl(min, max, p, std::index_sequence_for<Codecs...>{});
+  }
+
+ private:
+  using coordinates = std::array<std::array<std::byte, coordinateSize>, dimensions>;
+
+  template<std::size_t... I>
+  static auto encodeCoordinates(point const& p, std::index_sequence<I...>) noexcept -> coordinates {
+    coordinates coords{};
+    (Codecs::encode(std::get<I>(p), coords[I].data()), ...);
+    return coords;
+  }
+
+  template<std::size_t... I>
+  static auto decodeCoordinates(coordinates const& coords, std::index_sequence<I...>) noexcept -> point {
+    return point{Codecs::decode(coords[I].data())...};
+  }
+
+  static auto interleaveCoordinates(coordinates const& coords) noexcept -> Key {
+    Key key{};
+    std::size_t out = 0;
+    for (std::size_t byte = 0; byte < coordinateSize; ++byte) {
+      for (unsigned bit = 8; bit > 0; --bit) {
+        for (std::size_t dim = 0; dim < dimensions; ++dim, ++out) {
+          auto const value = (std::to_integer<unsigned>(coords[dim][byte]) >> (bit - 1)) & 1u;
+          key[out / 8] |= std::byte(value << (7 - out % 8));
+        }
+      }
+    }
+    return key;
+  }
+
+  static auto transposeKey(byte_string_view key) noexcept -> coordinates {
+    coordinates coords{};
+    std::size_t in = 0;
+    for (std::size_t byte = 0; byte < coordinateSize; ++byte) {
+      for (unsigned bit = 8; bit > 0; --bit) {
+        for (std::size_t dim = 0; dim < dimensions; ++dim, ++in) {
+          auto const value = (std::to_integer<unsigned>(key[in / 8]) >> (7 - in % 8)) & 1u;
+          coords[dim][byte] |= std::byte(value << (bit - 1));
+        }
+      }
+    }
+    return coords;
+  }
+
+  template<std::size_t... I>
+  static auto boundCorner(bounds const& b, BoxMask& mask, bool DimensionBounds::*side, std::byte fill,
+                          std::index_sequence<I...>) -> byte_string {
+    coordinates coords{};
+    auto const set = [&](auto codec, auto const& value, std::size_t dim) {
+      mask[dim].*side = value.has_value();
+      if (value) {
+        decltype(codec)::encode(*value, coords[dim].data());
+      } else {
+        coords[dim].fill(fill);
+      }
+    };
+    (set(Codecs{}, std::get<I>(b), I), ...);
+    return byte_string{byte_string_view{interleaveCoordinates(coords)}};
+  }
+
+  template<std::size_t... I>
+  static auto containsImpl(point const& min, point const& max, point const& p, std::index_sequence<I...>) noexcept
+    -> bool {
+    return ((std::get<I>(min) <= std::get<I>(p) && std::get<I>(p) <= std::get<I>(max)) && ...);
+  }
+};
+
+} // namespace zkd
+
+#endif //ZKD_TREE_SCHEMA_H
@@ -0,0 +1,363 @@
+#include "snapshot-file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "delta-buffer.h"
+
+using namespace zkd;
+
+namespace {
+constexpr char magic[8] = {'Z', 'K', 'D', 'S', 'N', 'A', 'P', '\0'};
+constexpr std::uint64_t version = 1;
+
+// offsets of the header words
+enum header : std::size_t {
+  VERSION = 8,
+  DIMENSIONS = 16,
+  KEY_SIZE = 24,
+  COUNT = 32,
+  STRIDE = 40,
+  KEYS = 48,
+  OFFSETS = 56,
+  INDEX = 64,
+  VALUES = 72,
+  CODECS_LENGTH = 80,
+  SCHEDULE_LENGTH = 88,
+  HEADER_SIZE = 96
+};
+
+auto align(std::size_t offset) -> std::size_t {
+  return (offset + 7) & ~std::size_t{7};
+}
+
+auto viewFromSlice(rocksdb::Slice slice) -> byte_string_view {
+  return byte_string_view{reinterpret_cast<std::byte const*>(slice.data()), slice.size()};
+}
+
+auto sliceFromView(byte_string_view view) -> rocksdb::Slice {
+  return rocksdb::Slice(reinterpret_cast<char const*>(view.data()), view.size());
+}
+
+class file_writer {
+ public:
+  explicit file_writer(std::string const& path) : _out(path, std::ios::binary | std::ios::trunc) {
+    if (!_out) {
+      throw std::runtime_error("cannot create snapshot file " + path);
+    }
+  }
+
+  void bytes(void const* data, std::size_t size) {
+    _out.write(static_cast<char const*>(data), std::streamsize(size));
+    _position += size;
+  }
+  void bytes(byte_string_view view) { bytes(view.data(), view.size()); }
+  void word(std::uint64_t v) {
+    unsigned char buffer[8];
+    for (std::size_t i = 0; i < 8; ++i) {
+      buffer[i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+    bytes(buffer, sizeof(buffer));
+  }
+  void padTo(std::size_t offset) {
+    static constexpr char zeros[8] = {};
+    if (offset < _position || offset - _position > sizeof(zeros)) {
+      throw std::logic_error("snapshot sections out of order");
+    }
+    bytes(zeros, offset - _position);
+  }
+
+  auto position() const noexcept -> std::size_t { return _position; }
+
+  void close() {
+    _out.close();
+    if (!_out) {
+      throw std::runtime_error("writing the snapshot file failed");
+    }
+  }
+
+ private:
+  std::ofstream _out;
+  std::size_t _position = 0;
+};
+
+// all keys of one RocksDB snapshot and of the delta buffer before it, any number of times
+class snapshot_scan {
+ public:
+  explicit snapshot_scan(RocksDBHandle& rocks)
+      : _rocks(rocks), _buffered(snapshotDeltaBuffer(rocks)), _snapshot(rocks.db->GetSnapshot()) {}
+  ~snapshot_scan() { _rocks.db->ReleaseSnapshot(_snapshot); }
+
+  snapshot_scan(snapshot_scan const&) = delete;
+  snapshot_scan& operator=(snapshot_scan const&) = delete;
+
+  template<typename F>
+  void forEach(F&& f) {
+    rocksdb::ReadOptions options;
+    options.snapshot = _snapshot;
+    options.fill_cache = false;
+    auto iter = newMergedIterator(_rocks, options, _buffered);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      f(viewFromSlice(iter->key()), viewFromSlice(iter->value()));
+    }
+    auto s = iter->status();
+    if (!s.ok()) {
+      throw std::runtime_error(s.ToString());
+    }
+  }
+
+ private:
+  RocksDBHandle& _rocks;
+  DeltaBuffer::runs _buffered;
+  rocksdb::Snapshot const* _snapshot;
+};
+
+class snapshot_iterator final : public rocksdb::Iterator {
+ public:
+  explicit snapshot_iterator(SnapshotReader const& snapshot) : _snapshot(snapshot), _pos(snapshot.size()) {}
+
+  bool Valid() const override { return _pos < _snapshot.size(); }
+  void SeekToFirst() override { _pos = 0; }
+  void SeekToLast() override { _pos = _snapshot.size() == 0 ? 0 : _snapshot.size() - 1; }
+  void Seek(rocksdb::Slice const& target) override { _pos = _snapshot.lowerBound(viewFromSlice(target)); }
+  void SeekForPrev(rocksdb::Slice const& target) override {
+    auto const t = viewFromSlice(target);
+    _pos = _snapshot.lowerBound(t);
+    if (_pos == _snapshot.size() || _snapshot.key(_pos) != t) {
+      Prev();
+    }
+  }
+  void Next() override { ++_pos; }
+  void Prev() override { _pos = _pos == 0 ? _snapshot.size() : _pos - 1; }
+  rocksdb::Slice key() const override { return sliceFromView(_snapshot.key(_pos)); }
+  rocksdb::Slice value() const override { return sliceFromView(_snapshot.value(_pos)); }
+  rocksdb::Status status() const override { return rocksdb::Status::OK(); }
+
+ private:
+  SnapshotReader const& _snapshot;
+  std::size_t _pos;
+};
+} // namespace
+
+auto zkd::exportSnapshot(RocksDBHandle& rocks, std::string const& path, SnapshotOptions const& options) -> std::size_t {
+  if (rocks.curve != Curve::Z_ORDER) {
+    throw std::invalid_argument("snapshots require Z-order keys");
+  }
+  if (options.indexStride == 0) {
+    throw std::invalid_argument("snapshot index stride must be greater than zero");
+  }
+  std::string scheduleText;
+  if (rocks.schedule != nullptr) {
+    std::stringstream ss;
+    ss << *rocks.schedule;
+    scheduleText = ss.str();
+  }
+
+  snapshot_scan scan(rocks);
+  std::size_t count = 0;
+  std::optional<std::size_t> keySize;
+  scan.forEach([&](byte_string_view key, byte_string_view) {
+    if (keySize && *keySize != key.size()) {
+      throw std::invalid_argument("snapshots require keys of equal length");
+    }
+    keySize = key.size();
+    count += 1;
+  });
+
+  auto const stride = options.indexStride;
+  auto const keysOffset = align(HEADER_SIZE + options.codecs.size() + scheduleText.size());
+  auto const offsetsOffset = align(keysOffset + count * keySize.value_or(0));
+  auto const indexOffset = offsetsOffset + 8 * (count + 1);
+  auto const valuesOffset = align(indexOffset + (count + stride - 1) / stride * keySize.value_or(0));
+
+  auto const tmp = path + ".tmp";
+  file_writer out(tmp);
+  out.bytes(magic, sizeof(magic));
+  for (std::uint64_t w : {version, std::uint64_t(options.dimensions), std::uint64_t(keySize.value_or(0)),
+                          std::uint64_t(count), std::uint64_t(stride), std::uint64_t(keysOffset),
+                          std::uint64_t(offsetsOffset), std::uint64_t(indexOffset), std::uint64_t(valuesOffset),
+                          std::uint64_t(options.codecs.size()), std::uint64_t(scheduleText.size())}) {
+    out.word(w);
+  }
+  out.bytes(options.codecs.data(), options.codecs.size());
+  out.bytes(scheduleText.data(), scheduleText.size());
+  out.padTo(keysOffset);
+
+  std::vector<byte_string> index;
+  std::size_t i = 0;
+  scan.forEach([&](byte_string_view key, byte_string_view) {
+    if (i++ % stride == 0) {
+      index.emplace_back(key);
+    }
+    out.bytes(key);
+  });
+  out.padTo(offsetsOffset);
+
+  std::uint64_t offset = 0;
+  scan.forEach([&](byte_string_view, byte_string_view value) {
+    out.word(offset);
+    offset += value.size();
+  });
+  out.word(offset);
+  for (auto const& key : index) {
+    out.bytes(key);
+  }
+  out.padTo(valuesOffset);
+
+  scan.forEach([&](byte_string_view, byte_string_view value) { out.bytes(value); });
+  out.close();
+
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    throw std::runtime_error("cannot rename snapshot file to " + path);
+  }
+  return count;
+}
+
+zkd::SnapshotReader::SnapshotReader(std::string const& path) {
+  auto const fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("cannot open snapshot file " + path);
+  }
+  struct stat st {};
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::runtime_error("cannot stat snapshot file " + path);
+  }
+  _length = std::size_t(st.st_size);
+  if (_length < HEADER_SIZE) {
+    ::close(fd);
+    throw std::invalid_argument("not a snapshot file: " + path);
+  }
+  auto* mapped = ::mmap(nullptr, _length, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    throw std::runtime_error("cannot map snapshot file " + path);
+  }
+  _data = static_cast<std::byte const*>(mapped);
+
+  try {
+    if (std::memcmp(_data, magic, sizeof(magic)) != 0) {
+      throw std::invalid_argument("not a snapshot file: " + path);
+    }
+    if (word(VERSION) != version) {
+      throw std::invalid_argument("unsupported snapshot version");
+    }
+    _dimensions = word(DIMENSIONS);
+    _keySize = word(KEY_SIZE);
+    _count = word(COUNT);
+    _stride = word(STRIDE);
+    auto const keys = word(KEYS), offsets = word(OFFSETS), index = word(INDEX), values = word(VALUES);
+    auto const codecsLength = word(CODECS_LENGTH), scheduleLength = word(SCHEDULE_LENGTH);
+    // all sizes are checked without overflowing, a malformed header may hold any numbers
+    auto const malformed = [] { return std::invalid_argument("malformed snapshot file"); };
+    auto const within = [](std::uint64_t begin, std::uint64_t size, std::uint64_t end) {
+      return begin <= end && size <= end - begin;
+    };
+    auto const product = [&](std::uint64_t a, std::uint64_t b) {
+      if (a != 0 && b > std::numeric_limits<std::uint64_t>::max() / a) {
+        throw malformed();
+      }
+      return a * b;
+    };
+    if (_stride == 0 || _count == std::numeric_limits<std::uint64_t>::max()) {
+      throw malformed();
+    }
+    auto const indexKeys = _count / _stride + (_count % _stride != 0 ? 1 : 0);
+    if (!within(HEADER_SIZE, codecsLength, keys) || !within(HEADER_SIZE + codecsLength, scheduleLength, keys) ||
+        !within(keys, product(_count, _keySize), offsets) || !within(offsets, product(8, _count + 1), index) ||
+        !within(index, product(indexKeys, _keySize), values) || values > _length) {
+      throw malformed();
+    }
+    _keys = _data + keys;
+    _offsets = _data + offsets;
+    _index = _data + index;
+    _values = _data + values;
+    // value offsets are checked by value(i), reading them all here would take time for every key
+    _valuesSize = _length - values;
+    _codecs = std::string_view{reinterpret_cast<char const*>(_data + HEADER_SIZE), codecsLength};
+    if (scheduleLength > 0) {
+      _schedule = parseInterleaveSchedule(
+        std::string_view{reinterpret_cast<char const*>(_data + HEADER_SIZE + codecsLength), scheduleLength});
+    }
+  } catch (...) {
+    ::munmap(const_cast<std::byte*>(_data), _length);
+    throw;
+  }
+}
+
+zkd::SnapshotReader::~SnapshotReader() {
+  ::munmap(const_cast<std::byte*>(_data), _length);
+}
+
+auto zkd::SnapshotReader::word(std::size_t offset) const noexcept -> std::uint64_t {
+  std::uint64_t v = 0;
+  for (std::size_t i = 8; i > 0; --i) {
+    v = (v << 8) | std::to_integer<std::uint64_t>(_data[offset + i - 1]);
+  }
+  return v;
+}
+
+auto zkd::SnapshotReader::key(std::size_t i) const noexcept -> byte_string_view {
+  return byte_string_view{_keys + i * _keySize, _keySize};
+}
+
+auto zkd::SnapshotReader::value(std::size_t i) const -> byte_string_view {
+  auto const offsets = std::size_t(_offsets - _data);
+  auto const begin = word(offsets + 8 * i);
+  auto const end = word(offsets + 8 * (i + 1));
+  if (begin > end || end > _valuesSize) {
+    throw std::invalid_argument("malformed snapshot file");
+  }
+  return byte_string_view{_values + begin, end - begin};
+}
+
+auto zkd::SnapshotReader::lowerBound(byte_string_view target) const noexcept -> std::size_t {
+  // the first block whose first key is greater than the target, in the sparse index
+  std::size_t lo = 0, hi = (_count + _stride - 1) / _stride;
+  while (lo < hi) {
+    auto const mid = lo + (hi - lo) / 2;
+    if (byte_string_view{_index + mid * _keySize, _keySize} <= target) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  // the result is in the block before, or the first key of that block
+  std::size_t first = lo == 0 ? 0 : (lo - 1) * _stride;
+  std::size_t last = std::min(lo * _stride, _count);
+  while (first < last) {
+    auto const mid = first + (last - first) / 2;
+    if (key(mid) < target) {
+      first = mid + 1;
+    } else {
+      last = mid;
+    }
+  }
+  return first;
+}
+
+auto zkd::SnapshotReader::newIterator() const -> std::unique_ptr<rocksdb::Iterator> {
+  return std::make_unique<snapshot_iterator>(*this);
+}
+
+auto zkd::findAllInBox(SnapshotReader const& snapshot, Box const& box, BoxQueryCallback const& callback) -> std::size_t {
+  QueryStats stats;
+  return findAllInBox(snapshot, box, callback, stats);
+}
+
+auto zkd::findAllInBox(SnapshotReader const& snapshot, Box const& box, BoxQueryCallback const& callback,
+                       QueryStats& stats) -> std::size_t {
+  auto iter = snapshot.newIterator();
+  return findAllInBox(*iter, box, snapshot.schedule(), callback, stats);
+}
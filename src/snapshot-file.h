@@ -0,0 +1,104 @@
+#ifndef ZKD_TREE_SNAPSHOT_FILE_H
+#define ZKD_TREE_SNAPSHOT_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <rocksdb/iterator.h>
+
+#include "box-query.h"
+#include "interleave-schedule.h"
+#include "library.h"
+#include "query-stats.h"
+#include "rocksdb-handle.h"
+
+namespace zkd {
+
+struct SnapshotOptions {
+  std::size_t dimensions = 0;
+  // free form description of the coordinate encodings, e.g. "double,double,double,double"
+  std::string codecs;
+  // every n-th key goes into the sparse top-level index
+  std::size_t indexStride = 64;
+};
+
+/*
+ * Writes all keys of the handle, as of one RocksDB snapshot with the delta
+ * buffer merged in, into a read-only file for SnapshotReader:
+ *
+ *   header   magic, version, dimensions, key size, count, index stride,
+ *            section offsets, codecs and interleave schedule
+ *   keys     count keys of equal length, sorted
+ *   offsets  count + 1 offsets of the values
+ *   index    every stride-th key, so a lookup touches few pages of the keys
+ *   values
+ *
+ * Numbers are 64 bit little endian, sections are 8 byte aligned. The file is
+ * written next to `path` and renamed. Requires Z-order keys of equal length,
+ * throws std::invalid_argument otherwise. Returns the number of keys.
+ */
+auto exportSnapshot(RocksDBHandle& rocks, std::string const& path, SnapshotOptions const& options) -> std::size_t;
+
+/*
+ * A snapshot file mapped into memory. Keys and values are views into the
+ * mapping, which lives as long as the reader; the pages are shared with other
+ * processes reading the same file.
+ */
+class SnapshotReader {
+ public:
+  // throws std::runtime_error if the file can't be mapped, std::invalid_argument if its header is malformed;
+  // only reads the header, so it takes the same time for any number of keys
+  explicit SnapshotReader(std::string const& path);
+  ~SnapshotReader();
+
+  SnapshotReader(SnapshotReader const&) = delete;
+  SnapshotReader& operator=(SnapshotReader const&) = delete;
+
+  auto dimensions() const noexcept -> std::size_t { return _dimensions; }
+  auto codecs() const noexcept -> std::string_view { return _codecs; }
+  // nullptr for round robin
+  auto schedule() const noexcept -> InterleaveSchedule const* { return _schedule ? &*_schedule : nullptr; }
+
+  auto size() const noexcept -> std::size_t { return _count; }
+  auto keySize() const noexcept -> std::size_t { return _keySize; }
+  auto key(std::size_t i) const noexcept -> byte_string_view;
+  // throws std::invalid_argument if the value offsets of the file are malformed
+  auto value(std::size_t i) const -> byte_string_view;
+
+  // index of the first key not less than `target`, size() if there is none
+  auto lowerBound(byte_string_view target) const noexcept -> std::size_t;
+
+  // iterates over the keys like a RocksDB iterator, so box queries run unchanged
+  auto newIterator() const -> std::unique_ptr<rocksdb::Iterator>;
+
+ private:
+  auto word(std::size_t offset) const noexcept -> std::uint64_t;
+
+  std::byte const* _data = nullptr;
+  std::size_t _length = 0;
+
+  std::size_t _dimensions = 0;
+  std::size_t _keySize = 0;
+  std::size_t _count = 0;
+  std::size_t _stride = 0;
+  std::byte const* _keys = nullptr;
+  std::byte const* _offsets = nullptr;
+  std::byte const* _index = nullptr;
+  std::byte const* _values = nullptr;
+  std::size_t _valuesSize = 0;
+  std::string_view _codecs;
+  std::optional<InterleaveSchedule> _schedule;
+};
+
+// findAllInBox over the snapshot, with its interleave schedule
+auto findAllInBox(SnapshotReader const& snapshot, Box const& box, BoxQueryCallback const& callback) -> std::size_t;
+auto findAllInBox(SnapshotReader const& snapshot, Box const& box, BoxQueryCallback const& callback, QueryStats& stats)
+  -> std::size_t;
+
+} // namespace zkd
+
+#endif //ZKD_TREE_SNAPSHOT_FILE_H
@@ -0,0 +1,264 @@
+#include "spatial-join.h"
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+
+#include "delta-buffer.h"
+
+using namespace zkd;
+
+namespace {
+auto viewFromSlice(rocksdb::Slice slice) -> byte_string_view {
+  return byte_string_view{reinterpret_cast<std::byte const*>(slice.data()), slice.size()};
+}
+
+auto sliceFromView(byte_string_view view) -> rocksdb::Slice {
+  return rocksdb::Slice(reinterpret_cast<char const*>(view.data()), view.size());
+}
+
+auto testBit(byte_string_view key, std::size_t bit) noexcept -> bool {
+  return (key[bit / 8] & std::byte(0x80u >> (bit % 8))) != std::byte{0};
+}
+
+// the coordinates of a round robin key as integers
+void transposeInto(byte_string_view key, std::size_t dimensions, std::vector<std::uint64_t>& coords) {
+  coords.assign(dimensions, 0);
+  for (std::size_t bit = 0; bit < 8 * key.size(); ++bit) {
+    auto& c = coords[bit % dimensions];
+    c = (c << 1) | std::uint64_t(testBit(key, bit));
+  }
+}
+
+struct entry {
+  byte_string key;
+  byte_string value;
+  std::vector<std::uint64_t> coords;
+};
+
+using entries = std::shared_ptr<std::vector<entry> const>;
+
+// a Z-prefix cell of one side, with its keys once they are known to be few
+struct join_cell {
+  byte_string lo;
+  unsigned bits = 0;
+  std::vector<std::uint64_t> min, max; // bounding box
+  entries keys;
+  bool big = false; // holds more than leafSize keys
+};
+
+class join_side {
+ public:
+  join_side(rocksdb::Iterator& iter, std::size_t keySize, std::size_t dimensions, QueryStats& stats)
+      : _iter(iter), _keySize(keySize), _dimensions(dimensions), _stats(stats) {}
+
+  // up to `limit` keys of the cell
+  auto load(join_cell const& cell, std::size_t limit) -> std::vector<entry> {
+    auto const hi = cellUpperBound(cell.lo, cell.bits);
+    std::vector<entry> result;
+    _iter.Seek(sliceFromView(cell.lo));
+    _stats.seeks += 1;
+    for (; _iter.Valid() && result.size() < limit; _iter.Next()) {
+      auto const key = viewFromSlice(_iter.key());
+      _stats.keysExamined += 1;
+      if (key.size() != _keySize) {
+        throw std::invalid_argument("spatial joins require keys of equal length");
+      }
+      if (key > byte_string_view{hi}) {
+        break;
+      }
+      entry e{byte_string{key}, byte_string{viewFromSlice(_iter.value())}, {}};
+      transposeInto(key, _dimensions, e.coords);
+      result.push_back(std::move(e));
+      _stats.nexts += 1;
+    }
+    auto s = _iter.status();
+    if (!s.ok()) {
+      throw std::runtime_error(s.ToString());
+    }
+    return result;
+  }
+
+ private:
+  rocksdb::Iterator& _iter;
+  std::size_t _keySize;
+  std::size_t _dimensions;
+  QueryStats& _stats;
+};
+
+class join_executor {
+ public:
+  join_executor(join_side& left, join_side& right, std::size_t dimensions, JoinOptions const& options,
+                JoinCallback const& callback, QueryStats& stats)
+      : _left(left), _right(right), _dimensions(dimensions), _options(options), _callback(callback), _stats(stats) {}
+
+  auto makeCell(byte_string lo, unsigned bits) const -> join_cell {
+    join_cell cell;
+    transposeInto(lo, _dimensions, cell.min);
+    transposeInto(cellUpperBound(lo, bits), _dimensions, cell.max);
+    cell.lo = std::move(lo);
+    cell.bits = bits;
+    return cell;
+  }
+
+  void join(join_cell a, join_cell b) {
+    if (!near(a, b) || !fetch(_left, a) || !fetch(_right, b)) {
+      return;
+    }
+    if (!a.big && !b.big) {
+      return joinPairwise(*a.keys, *b.keys);
+    }
+    // split the side with more keys, the larger cell if both are big
+    if (a.big && (!b.big || a.bits <= b.bits)) {
+      for (auto& child : split(a)) {
+        join(std::move(child), b);
+      }
+    } else {
+      for (auto& child : split(b)) {
+        join(a, std::move(child));
+      }
+    }
+  }
+
+  auto pairs() const noexcept -> std::size_t { return _pairs; }
+
+ private:
+  // whether the bounding boxes are within the distance
+  auto near(join_cell const& a, join_cell const& b) const noexcept -> bool {
+    for (std::size_t d = 0; d < _dimensions; ++d) {
+      auto const eps = _options.distance[d];
+      if (a.min[d] > b.max[d] && a.min[d] - b.max[d] > eps) {
+        return false;
+      }
+      if (b.min[d] > a.max[d] && b.min[d] - a.max[d] > eps) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // reads the keys of a cell not seen yet, false if it is empty
+  auto fetch(join_side& side, join_cell& cell) -> bool {
+    if (cell.big) {
+      return true;
+    }
+    if (!cell.keys) {
+      auto keys = side.load(cell, _options.leafSize + 1);
+      if (keys.size() > _options.leafSize) {
+        cell.big = true;
+        return true;
+      }
+      cell.keys = std::make_shared<std::vector<entry> const>(std::move(keys));
+    }
+    return !cell.keys->empty();
+  }
+
+  // the two halves of the cell, with its keys if they are known
+  auto split(join_cell const& cell) const -> std::array<join_cell, 2> {
+    auto hiLo = cell.lo;
+    hiLo[cell.bits / 8] |= std::byte(0x80u >> (cell.bits % 8));
+    std::array<join_cell, 2> children = {makeCell(cell.lo, cell.bits + 1), makeCell(std::move(hiLo), cell.bits + 1)};
+    if (cell.keys) {
+      std::vector<entry> halves[2];
+      for (auto const& e : *cell.keys) {
+        halves[testBit(e.key, cell.bits)].push_back(e);
+      }
+      for (int i = 0; i < 2; ++i) {
+        children[i].keys = std::make_shared<std::vector<entry> const>(std::move(halves[i]));
+      }
+    }
+    return children;
+  }
+
+  void joinPairwise(std::vector<entry> const& as, std::vector<entry> const& bs) {
+    for (auto const& a : as) {
+      for (auto const& b : bs) {
+        if (matches(a, b)) {
+          _callback(a.key, a.value, b.key, b.value);
+          _pairs += 1;
+          _stats.keysReturned += 1;
+        }
+      }
+    }
+  }
+
+  auto matches(entry const& a, entry const& b) const -> bool {
+    for (std::size_t d = 0; d < _dimensions; ++d) {
+      auto const diff = a.coords[d] > b.coords[d] ? a.coords[d] - b.coords[d] : b.coords[d] - a.coords[d];
+      if (diff > _options.distance[d]) {
+        return false;
+      }
+    }
+    return !_options.filter || _options.filter(a.key, b.key);
+  }
+
+  join_side& _left;
+  join_side& _right;
+  std::size_t _dimensions;
+  JoinOptions const& _options;
+  JoinCallback const& _callback;
+  QueryStats& _stats;
+  std::size_t _pairs = 0;
+};
+
+auto firstKeySize(rocksdb::Iterator& iter, QueryStats& stats) -> std::optional<std::size_t> {
+  iter.SeekToFirst();
+  stats.seeks += 1;
+  if (!iter.Valid()) {
+    auto s = iter.status();
+    if (!s.ok()) {
+      throw std::runtime_error(s.ToString());
+    }
+    return std::nullopt;
+  }
+  return iter.key().size();
+}
+} // namespace
+
+auto zkd::spatialJoin(rocksdb::Iterator& left, rocksdb::Iterator& right, std::size_t dimensions,
+                      JoinOptions const& options, JoinCallback const& callback, QueryStats& stats) -> std::size_t {
+  if (dimensions == 0 || options.distance.size() != dimensions) {
+    throw std::invalid_argument("join distance does not match the dimensions");
+  }
+  if (options.leafSize == 0) {
+    throw std::invalid_argument("join leaf size must be greater than zero");
+  }
+  stats.queries += 1;
+  auto const leftSize = firstKeySize(left, stats);
+  auto const rightSize = firstKeySize(right, stats);
+  if (!leftSize || !rightSize) {
+    return 0;
+  }
+  if (*leftSize != *rightSize) {
+    throw std::invalid_argument("spatial joins require keys of equal length");
+  }
+  if ((8 * *leftSize + dimensions - 1) / dimensions > 64) {
+    throw std::invalid_argument("spatial joins require coordinates of at most 64 bits");
+  }
+
+  join_side l(left, *leftSize, dimensions, stats);
+  join_side r(right, *rightSize, dimensions, stats);
+  join_executor executor(l, r, dimensions, options, callback, stats);
+  auto root = executor.makeCell(byte_string(*leftSize, std::byte{0}), 0);
+  executor.join(root, root);
+  return executor.pairs();
+}
+
+auto zkd::spatialJoin(RocksDBHandle& left, RocksDBHandle& right, std::size_t dimensions, JoinOptions const& options,
+                      JoinCallback const& callback) -> std::size_t {
+  QueryStats stats;
+  return spatialJoin(left, right, dimensions, options, callback, stats);
+}
+
+auto zkd::spatialJoin(RocksDBHandle& left, RocksDBHandle& right, std::size_t dimensions, JoinOptions const& options,
+                      JoinCallback const& callback, QueryStats& stats) -> std::size_t {
+  for (auto const* rocks : {&left, &right}) {
+    if (rocks->curve != Curve::Z_ORDER || rocks->schedule != nullptr) {
+      throw std::invalid_argument("spatial joins require round robin Z-order keys");
+    }
+  }
+  auto leftIter = newMergedIterator(left, rocksdb::ReadOptions{});
+  auto rightIter = newMergedIterator(right, rocksdb::ReadOptions{});
+  return spatialJoin(*leftIter, *rightIter, dimensions, options, callback, stats);
+}
@@ -0,0 +1,62 @@
+#ifndef ZKD_TREE_SPATIAL_JOIN_H
+#define ZKD_TREE_SPATIAL_JOIN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <rocksdb/iterator.h>
+
+#include "library.h"
+#include "query-stats.h"
+#include "rocksdb-handle.h"
+
+namespace zkd {
+
+using JoinCallback = std::function<void(byte_string_view leftKey, byte_string_view leftValue, byte_string_view rightKey,
+                                        byte_string_view rightValue)>;
+// an exact predicate on the pairs within the distance, e.g. a euclidean one
+using JoinFilter = std::function<bool(byte_string_view leftKey, byte_string_view rightKey)>;
+
+struct JoinOptions {
+  /*
+   * A pair matches if its coordinates differ by no more than this in every
+   * dimension. Coordinates are the unsigned integers transpose returns; for
+   * encodings that don't preserve distances, like doubles, choose a distance
+   * that covers the window and refine it with `filter`.
+   */
+  std::vector<std::uint64_t> distance;
+  JoinFilter filter;
+  // cells with at most this many keys on both sides are joined pairwise
+  std::size_t leafSize = 32;
+};
+
+/*
+ * Joins two streams of round robin Z-order keys of equal length, e.g. two
+ * indexes or an index and a KeyBlockRun, in one descent over both instead of
+ * one box query per key. Both streams are split into Z-prefix cells at once, and
+ * a pair of cells is dropped as soon as their bounding boxes are further apart
+ * than the distance, or one of them is empty. Reading a cell takes one seek and
+ * at most leafSize + 1 keys; cells with up to leafSize keys are split in memory.
+ * The children of larger cells are not kept, so a cell is read again for every
+ * cell of the other side it is paired with. That is a few reads per cell for
+ * distances below the cell size, and more for larger distances. Coordinates
+ * must fit into 64 bits.
+ *
+ * Calls `callback` for every matching pair, grouped by cells rather than
+ * sorted. Returns the number of pairs; `stats` counts the seeks and keys read
+ * on both sides, and the pairs as keys returned. Throws std::invalid_argument
+ * for keys of different lengths.
+ */
+auto spatialJoin(rocksdb::Iterator& left, rocksdb::Iterator& right, std::size_t dimensions, JoinOptions const& options,
+                 JoinCallback const& callback, QueryStats& stats) -> std::size_t;
+// the same over two handles with round robin Z-order keys, with their delta buffers merged in
+auto spatialJoin(RocksDBHandle& left, RocksDBHandle& right, std::size_t dimensions, JoinOptions const& options,
+                 JoinCallback const& callback) -> std::size_t;
+auto spatialJoin(RocksDBHandle& left, RocksDBHandle& right, std::size_t dimensions, JoinOptions const& options,
+                 JoinCallback const& callback, QueryStats& stats) -> std::size_t;
+
+} // namespace zkd
+
+#endif //ZKD_TREE_SPATIAL_JOIN_H
@@ -0,0 +1,168 @@
+#include "subscription-index.h"
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+
+using namespace zkd;
+
+namespace {
+struct box_cell {
+  byte_string lo;
+  unsigned bits;
+  CellRelation relation;
+};
+
+// the first `bits` bits of the key, in as many bytes as needed
+void truncatePrefix(byte_string_view key, unsigned bits, byte_string& prefix) {
+  prefix.assign(key.substr(0, (bits + 7) / 8));
+  if (bits % 8 != 0) {
+    prefix.back() &= std::byte(0xffu << (8 - bits % 8));
+  }
+}
+
+// splits the box into at most `maxCells` Z-prefix cells, refining the cells on its border first
+auto decompose(Box const& box, std::size_t keySize, std::size_t maxCells) -> std::vector<box_cell> {
+  auto const dims = box.dimensions();
+  std::vector<box_cell> cells;
+  {
+    auto root = byte_string(keySize, std::byte{0});
+    auto const relation = relateCellToBox(root, 0, box.min, box.max, dims);
+    if (relation == CellRelation::DISJOINT) {
+      return cells;
+    }
+    cells.push_back({std::move(root), 0, relation});
+  }
+
+  for (unsigned bits = 0; bits < 8 * keySize; ++bits) {
+    std::vector<box_cell> refined;
+    bool partial = false;
+    for (auto const& cell : cells) {
+      if (cell.relation == CellRelation::CONTAINED) {
+        refined.push_back(cell);
+        continue;
+      }
+      partial = true;
+      for (bool one : {false, true}) {
+        auto child = cell.lo;
+        if (one) {
+          child[bits / 8] |= std::byte(0x80u >> (bits % 8));
+        }
+        auto const relation = relateCellToBox(child, bits + 1, box.min, box.max, dims);
+        if (relation != CellRelation::DISJOINT) {
+          refined.push_back({std::move(child), bits + 1, relation});
+        }
+      }
+    }
+    if (!partial || refined.size() > maxCells) {
+      break;
+    }
+    cells = std::move(refined);
+  }
+  return cells;
+}
+} // namespace
+
+auto zkd::SubscriptionIndex::prefix_hash::operator()(byte_string const& v) const noexcept -> std::size_t {
+  return std::hash<std::string_view>()(std::string_view{reinterpret_cast<char const*>(v.data()), v.size()});
+}
+
+zkd::SubscriptionIndex::SubscriptionIndex(std::size_t dimensions, std::size_t keySize, SubscriptionIndexOptions options)
+    : _dimensions(dimensions), _keySize(keySize), _options(options) {
+  if (dimensions == 0 || keySize == 0 || options.maxCellsPerBox == 0) {
+    throw std::invalid_argument("subscription index needs dimensions, a key size and cells per box");
+  }
+}
+
+auto zkd::SubscriptionIndex::subscribe(Box box) -> SubscriptionId {
+  if (box.dimensions() != _dimensions || box.min.size() != _keySize || box.max.size() != _keySize) {
+    throw std::invalid_argument("box does not match the subscription index");
+  }
+  // the cells only depend on the box, so they are computed outside of the lock
+  auto const cells = decompose(box, _keySize, _options.maxCellsPerBox);
+
+  subscription sub{std::move(box), {}};
+  sub.cells.reserve(cells.size());
+  for (auto const& cell : cells) {
+    byte_string prefix;
+    truncatePrefix(cell.lo, cell.bits, prefix);
+    sub.cells.emplace_back(cell.bits, std::move(prefix));
+  }
+
+  std::unique_lock guard(_mutex);
+  auto const id = _nextId++;
+  for (std::size_t i = 0; i < cells.size(); ++i) {
+    auto const& [bits, prefix] = sub.cells[i];
+    _levels[bits][prefix].push_back({id, cells[i].relation == CellRelation::CONTAINED});
+  }
+  _cells += cells.size();
+  _subscriptions.emplace(id, std::move(sub));
+  return id;
+}
+
+auto zkd::SubscriptionIndex::unsubscribe(SubscriptionId id) -> bool {
+  std::unique_lock guard(_mutex);
+  auto it = _subscriptions.find(id);
+  if (it == _subscriptions.end()) {
+    return false;
+  }
+  for (auto const& [bits, prefix] : it->second.cells) {
+    auto level = _levels.find(bits);
+    auto entries = level->second.find(prefix);
+    auto& list = entries->second;
+    list.erase(std::remove_if(list.begin(), list.end(), [&](auto const& e) { return e.id == id; }), list.end());
+    if (list.empty()) {
+      level->second.erase(entries);
+      if (level->second.empty()) {
+        _levels.erase(level);
+      }
+    }
+  }
+  _cells -= it->second.cells.size();
+  _subscriptions.erase(it);
+  return true;
+}
+
+void zkd::SubscriptionIndex::match(byte_string_view key, SubscriptionCallback const& callback) const {
+  if (key.size() != _keySize) {
+    throw std::invalid_argument("key does not match the subscription index");
+  }
+  byte_string prefix;
+  prefix.reserve(_keySize);
+
+  std::shared_lock guard(_mutex);
+  for (auto const& [bits, cells] : _levels) {
+    truncatePrefix(key, bits, prefix);
+    auto it = cells.find(prefix);
+    if (it == cells.end()) {
+      continue;
+    }
+    // cells of one box are disjoint, so every box is reported at most once
+    for (auto const& entry : it->second) {
+      if (!entry.exact) {
+        auto const& box = _subscriptions.at(entry.id).box;
+        if (!testInBox(key, box.min, box.max, box.mask)) {
+          continue;
+        }
+      }
+      callback(entry.id);
+    }
+  }
+}
+
+auto zkd::SubscriptionIndex::match(byte_string_view key) const -> std::vector<SubscriptionId> {
+  std::vector<SubscriptionId> result;
+  match(key, [&](SubscriptionId id) { result.push_back(id); });
+  return result;
+}
+
+auto zkd::SubscriptionIndex::size() const -> std::size_t {
+  std::shared_lock guard(_mutex);
+  return _subscriptions.size();
+}
+
+auto zkd::SubscriptionIndex::cells() const -> std::size_t {
+  std::shared_lock guard(_mutex);
+  return _cells;
+}
@@ -0,0 +1,80 @@
+#ifndef ZKD_TREE_SUBSCRIPTION_INDEX_H
+#define ZKD_TREE_SUBSCRIPTION_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "library.h"
+
+namespace zkd {
+
+using SubscriptionId = std::uint64_t;
+using SubscriptionCallback = std::function<void(SubscriptionId id)>;
+
+struct SubscriptionIndexOptions {
+  // a box is split into at most this many Z-prefix cells
+  std::size_t maxCellsPerBox = 16;
+};
+
+/*
+ * Standing box queries: finds the registered boxes containing a new key
+ * without testing each of them. Every box is decomposed into Z-prefix cells,
+ * like coverBox, and each cell is filed under its prefix. A key then looks up
+ * its own prefixes of the lengths in use, one hash lookup each, and only the
+ * boxes of cells on their border are tested with testInBox.
+ *
+ * Keys are round robin Z-order keys of `keySize` bytes. Registration, removal
+ * and matching may be called concurrently; matching takes a shared lock only.
+ */
+class SubscriptionIndex {
+ public:
+  SubscriptionIndex(std::size_t dimensions, std::size_t keySize, SubscriptionIndexOptions options = {});
+
+  // throws std::invalid_argument if the box does not fit the index
+  auto subscribe(Box box) -> SubscriptionId;
+  // returns false if there is no such subscription
+  auto unsubscribe(SubscriptionId id) -> bool;
+
+  // calls `callback` once for every box containing `key`, in no particular order;
+  // it must not subscribe or unsubscribe
+  void match(byte_string_view key, SubscriptionCallback const& callback) const;
+  auto match(byte_string_view key) const -> std::vector<SubscriptionId>;
+
+  auto size() const -> std::size_t;
+  auto cells() const -> std::size_t;
+
+ private:
+  struct cell_entry {
+    SubscriptionId id;
+    bool exact; // the cell is contained in the box
+  };
+  struct subscription {
+    Box box;
+    std::vector<std::pair<unsigned, byte_string>> cells; // prefix length and prefix
+  };
+  struct prefix_hash {
+    auto operator()(byte_string const& v) const noexcept -> std::size_t;
+  };
+  // the cells of one prefix length, by their prefix of whole bytes
+  using level = std::unordered_map<byte_string, std::vector<cell_entry>, prefix_hash>;
+
+  std::size_t const _dimensions;
+  std::size_t const _keySize;
+  SubscriptionIndexOptions const _options;
+
+  mutable std::shared_mutex _mutex;
+  SubscriptionId _nextId = 1;
+  std::unordered_map<SubscriptionId, subscription> _subscriptions;
+  std::map<unsigned, level> _levels;
+  std::size_t _cells = 0;
+};
+
+} // namespace zkd
+
+#endif //ZKD_TREE_SUBSCRIPTION_INDEX_H
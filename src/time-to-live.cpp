@@ -0,0 +1,104 @@
+#include "time-to-live.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace zkd;
+
+namespace {
+auto viewFromSlice(rocksdb::Slice slice) -> byte_string_view {
+  return byte_string_view{reinterpret_cast<std::byte const*>(slice.data()), slice.size()};
+}
+
+auto decodeUnsigned(byte_string_view coordinate) -> std::uint64_t {
+  if (coordinate.size() > 8) {
+    throw std::invalid_argument("time coordinate is longer than 8 bytes");
+  }
+  std::uint64_t result = 0;
+  for (auto b : coordinate) {
+    result = (result << 8) | std::to_integer<std::uint64_t>(b);
+  }
+  return result;
+}
+
+auto secondsSinceEpoch() -> std::uint64_t {
+  auto const now = std::chrono::system_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::seconds>(now).count();
+}
+
+class TimeToLiveFilter final : public rocksdb::CompactionFilter {
+ public:
+  TimeToLiveFilter(std::shared_ptr<TimeToLive const> ttl, Curve curve,
+                   std::shared_ptr<InterleaveSchedule const> schedule, std::optional<std::uint64_t> cutoff)
+      : _ttl(std::move(ttl)), _curve(curve), _schedule(std::move(schedule)), _cutoff(cutoff) {}
+
+  bool Filter(int, rocksdb::Slice const& key, rocksdb::Slice const&, std::string*, bool*) const override {
+    if (!_cutoff) {
+      return false;
+    }
+    try {
+      return keyTime(*_ttl, _curve, _schedule.get(), viewFromSlice(key)) < *_cutoff;
+    } catch (std::exception const&) {
+      // keys that don't decode are kept, a compaction must not fail
+      return false;
+    }
+  }
+
+  const char* Name() const override { return "zkd.TimeToLiveFilter"; }
+
+ private:
+  std::shared_ptr<TimeToLive const> _ttl;
+  Curve _curve;
+  std::shared_ptr<InterleaveSchedule const> _schedule;
+  std::optional<std::uint64_t> _cutoff; // nothing expires before the retention has passed once
+};
+
+class TimeToLiveFilterFactory final : public rocksdb::CompactionFilterFactory {
+ public:
+  TimeToLiveFilterFactory(std::shared_ptr<TimeToLive const> ttl, Curve curve,
+                          std::shared_ptr<InterleaveSchedule const> schedule)
+      : _ttl(std::move(ttl)), _curve(curve), _schedule(std::move(schedule)) {}
+
+  std::unique_ptr<rocksdb::CompactionFilter> CreateCompactionFilter(
+    rocksdb::CompactionFilter::Context const&) override {
+    auto const now = _ttl->now ? _ttl->now() : secondsSinceEpoch();
+    auto const cutoff = now >= _ttl->retention ? std::optional{now - _ttl->retention} : std::nullopt;
+    return std::make_unique<TimeToLiveFilter>(_ttl, _curve, _schedule, cutoff);
+  }
+
+  const char* Name() const override { return "zkd.TimeToLiveFilterFactory"; }
+
+ private:
+  std::shared_ptr<TimeToLive const> _ttl;
+  Curve _curve;
+  std::shared_ptr<InterleaveSchedule const> _schedule;
+};
+} // namespace
+
+auto zkd::keyTime(TimeToLive const& ttl, Curve curve, InterleaveSchedule const* schedule, byte_string_view key)
+  -> std::uint64_t {
+  byte_string coordinate;
+  if (schedule != nullptr) {
+    coordinate = transpose(key, *schedule).at(ttl.timeDimension);
+  } else if (curve == Curve::Z_ORDER) {
+    coordinate = transpose(key, ttl.dimensions).at(ttl.timeDimension);
+  } else {
+    coordinate = decodeKey(curve, key, ttl.dimensions).at(ttl.timeDimension);
+  }
+  return ttl.decodeTime ? ttl.decodeTime(coordinate) : decodeUnsigned(coordinate);
+}
+
+auto zkd::makeTimeToLiveFilterFactory(TimeToLive ttl, Curve curve, std::optional<InterleaveSchedule> schedule)
+  -> std::shared_ptr<rocksdb::CompactionFilterFactory> {
+  if (ttl.dimensions == 0 || ttl.timeDimension >= ttl.dimensions) {
+    throw std::invalid_argument("time dimension is out of range");
+  }
+  if (schedule.has_value() && schedule->dimensions() != ttl.dimensions) {
+    throw std::invalid_argument("interleave schedule does not match the dimensions of the time to live");
+  }
+  auto shared = schedule.has_value() ? std::make_shared<InterleaveSchedule const>(*schedule) : nullptr;
+  return std::make_shared<TimeToLiveFilterFactory>(std::make_shared<TimeToLive const>(std::move(ttl)), curve,
+                                                   std::move(shared));
+}
@@ -0,0 +1,48 @@
+#ifndef ZKD_TREE_TIME_TO_LIVE_H
+#define ZKD_TREE_TIME_TO_LIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+
+#include <rocksdb/compaction_filter.h>
+
+#include "hilbert-curve.h"
+#include "interleave-schedule.h"
+#include "library.h"
+
+namespace zkd {
+
+/*
+ * Expiry of keys by a time dimension, see RocksDBOptions::timeToLive. Keys
+ * whose time is more than `retention` before `now()` are dropped by the
+ * compactions of the default column family, without writing tombstones.
+ *
+ * Expired keys stay visible to queries until a compaction reaches them, so
+ * queries that must not see them bound the time dimension, too. Dropped keys
+ * are not counted by DimensionHistograms, and results in a BoxResultCache may
+ * still hold them: compactions don't change the sequence number.
+ */
+struct TimeToLive {
+  std::size_t dimensions = 0;
+  std::size_t timeDimension = 0;
+  std::uint64_t retention = 0; // in the unit of decodeTime
+  // the time of the transposed coordinate; an unsigned big endian integer of up to 8 bytes if not set
+  std::function<std::uint64_t(byte_string_view coordinate)> decodeTime;
+  // seconds since the epoch if not set
+  std::function<std::uint64_t()> now;
+};
+
+// the time coordinate of a key, as the compaction filter decodes it
+auto keyTime(TimeToLive const& ttl, Curve curve, InterleaveSchedule const* schedule, byte_string_view key)
+  -> std::uint64_t;
+
+// a filter factory that takes the current time once per compaction
+auto makeTimeToLiveFilterFactory(TimeToLive ttl, Curve curve, std::optional<InterleaveSchedule> schedule)
+  -> std::shared_ptr<rocksdb::CompactionFilterFactory>;
+
+} // namespace zkd
+
+#endif //ZKD_TREE_TIME_TO_LIVE_H
@@ -0,0 +1,375 @@
+#include "workload.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+#include "box-query.h"
+#include "delta-buffer.h"
+
+using namespace zkd;
+
+namespace {
+constexpr std::size_t zipfBuckets = 1024;
+constexpr double domain = PointGenerator::highest - PointGenerator::lowest;
+
+auto clampToDomain(double v) -> double {
+  return std::clamp(v, PointGenerator::lowest, std::nextafter(PointGenerator::highest, PointGenerator::lowest));
+}
+
+auto encodePoint(Curve curve, std::vector<double> const& point) -> byte_string {
+  std::vector<byte_string> coords;
+  coords.reserve(point.size());
+  for (auto v : point) {
+    coords.push_back(to_byte_string_fixed_length(v));
+  }
+  return encodeKey(curve, coords);
+}
+
+void checkCurve(RocksDBHandle const& rocks, WorkloadOptions const& options) {
+  if (rocks.curve != options.curve) {
+    throw std::invalid_argument("workload curve does not match the database");
+  }
+}
+
+struct WorkloadQuery {
+  std::size_t selectivityClass;
+  Box box;
+};
+
+auto makeQueries(WorkloadOptions const& options) -> std::vector<WorkloadQuery> {
+  std::mt19937_64 rng{options.seed + 2};
+  std::uniform_int_distribution<std::size_t> classes{0, options.selectivities.size() - 1};
+  std::uniform_int_distribution<std::size_t> indexes{0, std::max<std::size_t>(options.points, 1) - 1};
+
+  std::vector<std::size_t> selectivityClasses(options.queries);
+  std::vector<std::pair<std::size_t, std::size_t>> centerIndexes; // point index, query
+  centerIndexes.reserve(options.queries);
+  for (std::size_t i = 0; i < options.queries; ++i) {
+    selectivityClasses[i] = classes(rng);
+    centerIndexes.emplace_back(indexes(rng), i);
+  }
+  std::sort(centerIndexes.begin(), centerIndexes.end());
+
+  // the centers are loaded points: replay the generator of loadWorkload, whose points depend on their predecessors
+  std::vector<std::vector<double>> centers(options.queries);
+  PointGenerator generator(options, options.seed);
+  std::size_t index = 0;
+  std::vector<double> point;
+  for (auto const& [pointIndex, query] : centerIndexes) {
+    for (; index <= pointIndex; ++index) {
+      point = generator.next(index);
+    }
+    centers[query] = point;
+  }
+
+  std::vector<WorkloadQuery> queries;
+  queries.reserve(options.queries);
+  for (std::size_t i = 0; i < options.queries; ++i) {
+    auto const c = selectivityClasses[i];
+    auto const halfSide = domain * std::pow(options.selectivities[c], 1.0 / double(options.dimensions)) / 2;
+
+    std::vector<std::optional<byte_string>> min, max;
+    for (auto v : centers[i]) {
+      min.emplace_back(to_byte_string_fixed_length(clampToDomain(v - halfSide)));
+      max.emplace_back(to_byte_string_fixed_length(clampToDomain(v + halfSide)));
+    }
+    queries.push_back(WorkloadQuery{c, makeBox(min, max, sizeof(double))});
+  }
+  return queries;
+}
+
+struct QueryResult {
+  std::size_t selectivityClass;
+  double micros;
+  QueryStats stats;
+};
+
+// nearest rank percentiles, `latencies` must be sorted
+auto summarize(std::vector<double> const& latencies) -> LatencySummary {
+  LatencySummary summary;
+  if (latencies.empty()) {
+    return summary;
+  }
+  auto const rank = [&](double p) {
+    auto idx = std::size_t(std::ceil(p * double(latencies.size())));
+    return latencies[std::clamp<std::size_t>(idx, 1, latencies.size()) - 1];
+  };
+  summary.mean = std::accumulate(latencies.begin(), latencies.end(), 0.0) / double(latencies.size());
+  summary.p50 = rank(0.5);
+  summary.p99 = rank(0.99);
+  summary.p999 = rank(0.999);
+  summary.max = latencies.back();
+  return summary;
+}
+
+void checkDimensions(RocksDBHandle& rocks, std::size_t dimensions) {
+  auto iter = newMergedIterator(rocks, rocksdb::ReadOptions{});
+  iter->SeekToFirst();
+  auto s = iter->status();
+  if (!s.ok()) {
+    throw std::runtime_error(s.ToString());
+  }
+  if (iter->Valid() && iter->key().size() != dimensions * sizeof(double)) {
+    throw std::invalid_argument("database was not loaded with " + std::to_string(dimensions) + " dimensions");
+  }
+}
+
+void writeStats(std::ostream& ostream, QueryStats const& stats, std::size_t queries) {
+  auto const perQuery = [&](std::size_t v) { return queries > 0 ? double(v) / double(queries) : 0.0; };
+  ostream << "{\"seeks\":" << perQuery(stats.seeks) << ",\"nexts\":" << perQuery(stats.nexts)
+          << ",\"keysExamined\":" << perQuery(stats.keysExamined) << ",\"results\":" << perQuery(stats.keysReturned)
+          << ",\"falsePositives\":" << perQuery(stats.falsePositives());
+  if (stats.profiledQueries > 0) {
+    // averaged over the profiled queries only
+    auto const profiled = double(stats.profiledQueries);
+    auto const micros = [&](std::chrono::nanoseconds t) { return double(t.count()) / 1000 / profiled; };
+    auto const& phases = stats.phases;
+    auto const& storage = stats.storage;
+    ostream << ",\"profiledQueries\":" << stats.profiledQueries;
+    ostream << ",\"phasesMicros\":{\"cacheLookup\":" << micros(phases.cacheLookup) << ",\"seek\":" << micros(phases.seek)
+            << ",\"next\":" << micros(phases.next) << ",\"compare\":" << micros(phases.compare)
+            << ",\"nextZValue\":" << micros(phases.nextZValue) << ",\"callback\":" << micros(phases.callback) << "}";
+    ostream << ",\"storage\":{\"blockReads\":" << double(storage.blockReads) / profiled
+            << ",\"blockReadBytes\":" << double(storage.blockReadBytes) / profiled
+            << ",\"blockCacheHits\":" << double(storage.blockCacheHits) / profiled
+            << ",\"internalKeysSkipped\":" << double(storage.internalKeysSkipped) / profiled
+            << ",\"internalDeletesSkipped\":" << double(storage.internalDeletesSkipped) / profiled
+            << ",\"bytesRead\":" << double(storage.bytesRead) / profiled
+            << ",\"blockReadMicros\":" << micros(storage.blockReadTime) << "}";
+  }
+  ostream << "}";
+}
+
+void writeLatency(std::ostream& ostream, LatencySummary const& latency) {
+  ostream << "{\"mean\":" << latency.mean << ",\"p50\":" << latency.p50 << ",\"p99\":" << latency.p99
+          << ",\"p999\":" << latency.p999 << ",\"max\":" << latency.max << "}";
+}
+} // namespace
+
+std::ostream& zkd::operator<<(std::ostream& ostream, KeyDistribution distribution) {
+  switch (distribution) {
+    case KeyDistribution::UNIFORM:
+      return ostream << "uniform";
+    case KeyDistribution::CLUSTERED:
+      return ostream << "clustered";
+    case KeyDistribution::ZIPF:
+      return ostream << "zipf";
+    case KeyDistribution::TIME_SERIES:
+      return ostream << "time-series";
+  }
+  return ostream;
+}
+
+auto zkd::parseKeyDistribution(std::string_view name) -> KeyDistribution {
+  if (name == "uniform") {
+    return KeyDistribution::UNIFORM;
+  } else if (name == "clustered") {
+    return KeyDistribution::CLUSTERED;
+  } else if (name == "zipf") {
+    return KeyDistribution::ZIPF;
+  } else if (name == "time-series") {
+    return KeyDistribution::TIME_SERIES;
+  }
+  throw std::invalid_argument("unknown key distribution " + std::string{name});
+}
+
+zkd::PointGenerator::PointGenerator(WorkloadOptions const& options, std::uint64_t seed)
+    : _options(options), _rng(seed) {
+  if (options.dimensions == 0) {
+    throw std::invalid_argument("workload needs at least one dimension");
+  }
+
+  // the clusters and hot ranges depend on the workload seed only, so points and queries agree on them
+  std::mt19937_64 layout{options.seed};
+  std::uniform_real_distribution<double> centers{0.8 * PointGenerator::lowest, 0.8 * PointGenerator::highest};
+  for (std::size_t i = 0; i < std::max<std::size_t>(options.clusters, 1) * options.dimensions; ++i) {
+    _centers.push_back(centers(layout));
+  }
+
+  double sum = 0.0;
+  for (std::size_t rank = 1; rank <= zipfBuckets; ++rank) {
+    sum += 1.0 / std::pow(double(rank), options.zipfExponent);
+    _zipfCdf.push_back(sum);
+  }
+  for (auto& p : _zipfCdf) {
+    p /= sum;
+  }
+  for (std::size_t dim = 0; dim < options.dimensions; ++dim) {
+    std::vector<std::size_t> buckets(zipfBuckets);
+    std::iota(buckets.begin(), buckets.end(), 0);
+    std::shuffle(buckets.begin(), buckets.end(), layout);
+    _zipfRank.insert(_zipfRank.end(), buckets.begin(), buckets.end());
+  }
+
+  _walk.assign(options.dimensions, 0.0);
+}
+
+auto zkd::PointGenerator::next(std::size_t index) -> std::vector<double> {
+  std::uniform_int_distribution<std::size_t> clusters{0, std::max<std::size_t>(_options.clusters, 1) - 1};
+  _cluster = clusters(_rng);
+
+  std::vector<double> point;
+  point.reserve(_options.dimensions);
+  for (std::size_t dim = 0; dim < _options.dimensions; ++dim) {
+    point.push_back(clampToDomain(draw(dim, index)));
+  }
+  return point;
+}
+
+auto zkd::PointGenerator::draw(std::size_t dim, std::size_t index) -> double {
+  std::uniform_real_distribution<double> unit{0.0, 1.0};
+  switch (_options.distribution) {
+    case KeyDistribution::UNIFORM:
+      return lowest + domain * unit(_rng);
+    case KeyDistribution::CLUSTERED: {
+      std::normal_distribution<double> spread{_centers[_cluster * _options.dimensions + dim], domain / 40};
+      return spread(_rng);
+    }
+    case KeyDistribution::ZIPF: {
+      auto rank = std::size_t(std::lower_bound(_zipfCdf.begin(), _zipfCdf.end(), unit(_rng)) - _zipfCdf.begin());
+      auto bucket = _zipfRank[dim * zipfBuckets + std::min(rank, zipfBuckets - 1)];
+      return lowest + domain * (double(bucket) + unit(_rng)) / zipfBuckets;
+    }
+    case KeyDistribution::TIME_SERIES: {
+      if (dim == 0) {
+        return lowest + domain * double(index) / double(std::max<std::size_t>(_options.points, 1));
+      }
+      std::normal_distribution<double> step{0.0, domain / 400};
+      _walk[dim] = clampToDomain(_walk[dim] + step(_rng));
+      return _walk[dim];
+    }
+  }
+  throw std::logic_error{"unknown key distribution"};
+}
+
+auto zkd::loadWorkload(RocksDBHandle& rocks, WorkloadOptions const& options) -> std::size_t {
+  checkCurve(rocks, options);
+  PointGenerator generator(options, options.seed);
+  for (std::size_t i = 0; i < options.points; ++i) {
+    auto key = encodePoint(options.curve, generator.next(i));
+    auto value = to_byte_string_fixed_length(uint64_t(i));
+    auto s = PutKey(rocks, key, value);
+    if (!s.ok()) {
+      throw std::runtime_error(s.ToString());
+    }
+  }
+  return options.points;
+}
+
+auto zkd::runWorkload(RocksDBHandle& rocks, WorkloadOptions const& options) -> WorkloadReport {
+  if (options.selectivities.empty()) {
+    throw std::invalid_argument("workload needs at least one selectivity");
+  }
+  checkCurve(rocks, options);
+  checkDimensions(rocks, options.dimensions);
+
+  auto const queries = makeQueries(options);
+
+  struct restore_sampler {
+    RocksDBHandle& rocks;
+    std::shared_ptr<QueryStatsSampler> previous;
+    ~restore_sampler() { rocks.queryStats = std::move(previous); }
+  } restore{rocks, rocks.queryStats};
+  if (options.profileInterval > 0) {
+    rocks.queryStats = std::make_shared<QueryStatsSampler>(options.profileInterval);
+  }
+
+  std::vector<std::vector<QueryResult>> results(std::max<std::size_t>(options.threads, 1));
+  std::atomic<std::size_t> nextQuery{0};
+
+  auto const client = [&](std::vector<QueryResult>& out) {
+    while (true) {
+      auto const i = nextQuery.fetch_add(1, std::memory_order_relaxed);
+      if (i >= queries.size()) {
+        return;
+      }
+      QueryResult result{queries[i].selectivityClass, 0.0, {}};
+      auto start = std::chrono::steady_clock::now();
+      findAllInBox(rocks, queries[i].box, [](byte_string_view, byte_string_view) {}, result.stats);
+      auto end = std::chrono::steady_clock::now();
+      result.micros = std::chrono::duration<double, std::micro>(end - start).count();
+      out.push_back(result);
+    }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    std::vector<std::thread> threads;
+    for (std::size_t t = 1; t < results.size(); ++t) {
+      threads.emplace_back(client, std::ref(results[t]));
+    }
+    client(results[0]);
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  WorkloadReport report;
+  report.options = options;
+  report.seconds = std::chrono::duration<double>(end - start).count();
+  report.queriesPerSecond = report.seconds > 0 ? double(queries.size()) / report.seconds : 0.0;
+
+  std::vector<double> all;
+  std::vector<std::vector<double>> perClass(options.selectivities.size());
+  report.classes.resize(options.selectivities.size());
+  for (std::size_t c = 0; c < options.selectivities.size(); ++c) {
+    report.classes[c].selectivity = options.selectivities[c];
+  }
+  for (auto const& thread : results) {
+    for (auto const& result : thread) {
+      auto& cls = report.classes[result.selectivityClass];
+      cls.queries += 1;
+      cls.stats += result.stats;
+      report.stats += result.stats;
+      perClass[result.selectivityClass].push_back(result.micros);
+      all.push_back(result.micros);
+    }
+  }
+
+  std::sort(all.begin(), all.end());
+  report.latency = summarize(all);
+  for (std::size_t c = 0; c < report.classes.size(); ++c) {
+    auto& cls = report.classes[c];
+    std::sort(perClass[c].begin(), perClass[c].end());
+    cls.latency = summarize(perClass[c]);
+    if (cls.queries > 0 && options.points > 0) {
+      cls.observedSelectivity = double(cls.stats.keysReturned) / double(cls.queries) / double(options.points);
+    }
+  }
+  return report;
+}
+
+void zkd::writeJson(std::ostream& ostream, WorkloadReport const& report) {
+  auto const& options = report.options;
+  ostream << "{\"workload\":{\"dimensions\":" << options.dimensions << ",\"points\":" << options.points
+          << ",\"distribution\":\"" << options.distribution << "\",\"curve\":\"" << options.curve
+          << "\",\"queries\":" << options.queries << ",\"threads\":" << options.threads
+          << ",\"profileInterval\":" << options.profileInterval << ",\"seed\":" << options.seed << "}";
+  ostream << ",\"seconds\":" << report.seconds << ",\"queriesPerSecond\":" << report.queriesPerSecond;
+  ostream << ",\"latencyMicros\":";
+  writeLatency(ostream, report.latency);
+  ostream << ",\"perQuery\":";
+  writeStats(ostream, report.stats, options.queries);
+  ostream << ",\"classes\":[";
+  for (std::size_t c = 0; c < report.classes.size(); ++c) {
+    auto const& cls = report.classes[c];
+    if (c > 0) {
+      ostream << ",";
+    }
+    ostream << "{\"selectivity\":" << cls.selectivity << ",\"observedSelectivity\":" << cls.observedSelectivity
+            << ",\"queries\":" << cls.queries << ",\"latencyMicros\":";
+    writeLatency(ostream, cls.latency);
+    ostream << ",\"perQuery\":";
+    writeStats(ostream, cls.stats, cls.queries);
+    ostream << "}";
+  }
+  ostream << "]}" << std::endl;
+}
@@ -0,0 +1,114 @@
+#ifndef ZKD_TREE_WORKLOAD_H
+#define ZKD_TREE_WORKLOAD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "hilbert-curve.h"
+#include "library.h"
+#include "query-stats.h"
+#include "rocksdb-handle.h"
+
+namespace zkd {
+
+enum class KeyDistribution {
+  UNIFORM,
+  CLUSTERED,   // gaussian clusters around random centers
+  ZIPF,        // per dimension, a few hot ranges get most of the points
+  TIME_SERIES  // the first dimension increases with every point, the others are random walks
+};
+
+std::ostream& operator<<(std::ostream& ostream, KeyDistribution distribution);
+auto parseKeyDistribution(std::string_view name) -> KeyDistribution;
+
+/*
+ * Points are doubles in [-100, 100) per dimension, stored with
+ * to_byte_string_fixed_length<double> and the point's number as value.
+ */
+struct WorkloadOptions {
+  std::size_t dimensions = 4;
+  std::size_t points = 1000000;
+  KeyDistribution distribution = KeyDistribution::UNIFORM;
+  std::size_t clusters = 16;
+  double zipfExponent = 1.1;
+  // must match the curve of the handle
+  Curve curve = Curve::Z_ORDER;
+
+  // Every query is a cube covering one of these fractions of the domain,
+  // centered at one of the loaded points.
+  std::vector<double> selectivities = {1e-5, 1e-4, 1e-3, 1e-2};
+  std::size_t queries = 1000;
+  std::size_t threads = 4;
+  // profile every n-th query, see QueryStatsSampler; 0 disables profiling
+  std::uint32_t profileInterval = 0;
+
+  std::uint64_t seed = 1;
+};
+
+class PointGenerator {
+ public:
+  explicit PointGenerator(WorkloadOptions const& options, std::uint64_t seed);
+
+  // the `index`-th of `options.points` points; only the time series depends on it
+  auto next(std::size_t index) -> std::vector<double>;
+
+  static constexpr double lowest = -100.0;
+  static constexpr double highest = 100.0;
+
+ private:
+  auto draw(std::size_t dim, std::size_t index) -> double;
+
+  WorkloadOptions _options;
+  std::mt19937_64 _rng;
+  std::vector<double> _centers;       // clusters x dimensions
+  std::vector<double> _zipfCdf;       // over the buckets, by rank
+  std::vector<std::size_t> _zipfRank; // dimensions x buckets, bucket of each rank
+  std::vector<double> _walk;          // current position of the random walks
+  std::size_t _cluster = 0;
+};
+
+// Writes the points of the workload with PutKey. Returns the number of points written.
+auto loadWorkload(RocksDBHandle& rocks, WorkloadOptions const& options) -> std::size_t;
+
+struct LatencySummary {
+  double mean = 0.0; // microseconds
+  double p50 = 0.0;
+  double p99 = 0.0;
+  double p999 = 0.0;
+  double max = 0.0;
+};
+
+struct WorkloadClassReport {
+  double selectivity = 0.0; // requested
+  std::size_t queries = 0;
+  double observedSelectivity = 0.0; // results relative to the number of points
+  LatencySummary latency;
+  QueryStats stats; // sum over all queries of the class
+};
+
+struct WorkloadReport {
+  WorkloadOptions options;
+  double seconds = 0.0;
+  double queriesPerSecond = 0.0;
+  LatencySummary latency;
+  QueryStats stats;
+  std::vector<WorkloadClassReport> classes; // in the order of options.selectivities
+};
+
+/*
+ * Runs `options.queries` box queries from `options.threads` threads, each
+ * query picking a selectivity from the mix at random. The database must have
+ * been loaded with the same dimensions. With a profile interval, the handle's
+ * QueryStatsSampler is replaced for the duration of the run.
+ */
+auto runWorkload(RocksDBHandle& rocks, WorkloadOptions const& options) -> WorkloadReport;
+
+void writeJson(std::ostream& ostream, WorkloadReport const& report);
+
+} // namespace zkd
+
+#endif //ZKD_TREE_WORKLOAD_H
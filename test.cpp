@@ -1,41 +1,31 @@
+#include <array>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
 #include <string>
-#include <unordered_set>
+#include <vector>
 
+#include "src/box-query.h"
+#include "src/key-blocks.h"
 #include "src/library.h"
+#include "src/prefix-summary.h"
+#include "src/query-planner.h"
+#include "src/result-batch.h"
 #include "src/rocksdb-handle.h"
+#include "src/schedule-advisor.h"
+#include "src/snapshot-file.h"
+#include "src/workload.h"
 
 #include <random>
 
 using namespace zkd;
 
 
-static auto sliceFromString(byte_string const& str) -> rocksdb::Slice {
-  return rocksdb::Slice(reinterpret_cast<char const*>(str.c_str()), str.size());
-}
-
 using point = std::array<double, 4>;
 
-template<>
-struct std::hash<byte_string> {
-  std::size_t operator()(byte_string const& v) const noexcept {
-    return std::hash<std::string_view>()(std::string_view{reinterpret_cast<const char*>(v.data()), v.size()});
-  }
-};
-
-template<typename T>
-struct std::hash<std::array<T, 4>> {
-  std::size_t operator()(std::array<T, 4> const& v) const noexcept {
-    std::size_t hash = 0;
-    for (auto const& s : v) {
-      hash = 33 * hash + std::hash<T>()(s);
-    }
-    return hash;
-  }
-};
-
 std::ostream& operator<<(std::ostream& os, point const& v) {
   os << "[ ";
   for (auto const& s : v) {
@@ -45,129 +35,119 @@ std::ostream& operator<<(std::ostream& os, point const& v) {
 }
 
 
-void fillRocksdb(std::shared_ptr<RocksDBHandle> const& rocks) {
-  std::random_device rd;  //Will be used to obtain a seed for the random number engine
-  std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
-  std::uniform_real_distribution<> distrib(-100.0, 100.0);
-
-  for (std::size_t i = 0; i < 1000000; i++) {
-    std::vector<byte_string> coords;
-
-    for (std::size_t j = 0; j < 4; j++) {
-      coords.push_back(to_byte_string_fixed_length<double>(distrib(gen)));
-    }
-
-
-    auto key = interleave(coords);
-    if (i % 10000 == 9999) {
-      std::cout << "wrote 10000 entries" << std::endl;
-      std::cout << key << std::endl;
-    }
-
-    auto value = to_byte_string_fixed_length(i);
-    auto s = rocks->db->Put({},
-                            sliceFromString(key),
-                            sliceFromString(value));
-    if (!s.ok()) {
-      std::cerr << "insert failed: " << s.ToString() << std::endl;
-      return;
+// --dims 4 --points 1000000 --distribution uniform --curve z-order --selectivities 0.0001,0.01 --queries 1000 --threads 4 --profile 100 --seed 1
+static auto parseWorkloadOptions(int argc, char* argv[]) -> WorkloadOptions {
+  WorkloadOptions options;
+  for (int i = 0; i + 1 < argc; i += 2) {
+    std::string_view name = argv[i];
+    char const* value = argv[i + 1];
+    if (name == "--dims") {
+      options.dimensions = std::stoul(value);
+    } else if (name == "--points") {
+      options.points = std::stoul(value);
+    } else if (name == "--distribution") {
+      options.distribution = parseKeyDistribution(value);
+    } else if (name == "--clusters") {
+      options.clusters = std::stoul(value);
+    } else if (name == "--zipf") {
+      options.zipfExponent = std::stod(value);
+    } else if (name == "--selectivities") {
+      options.selectivities.clear();
+      std::stringstream ss(value);
+      std::string item;
+      while (std::getline(ss, item, ',')) {
+        options.selectivities.push_back(std::stod(item));
+      }
+    } else if (name == "--queries") {
+      options.queries = std::stoul(value);
+    } else if (name == "--threads") {
+      options.threads = std::stoul(value);
+    } else if (name == "--curve") {
+      options.curve = std::string_view{value} == "hilbert" ? Curve::HILBERT : Curve::Z_ORDER;
+    } else if (name == "--profile") {
+      options.profileInterval = std::stoul(value);
+    } else if (name == "--seed") {
+      options.seed = std::stoull(value);
+    } else {
+      throw std::invalid_argument("unknown workload option " + std::string{name});
     }
   }
-
-  auto s = rocks->db->SyncWAL();
-  if (!s.ok()) {
-    std::cerr << "sync failed: " << s.ToString() << std::endl;
+  if (argc % 2 != 0) {
+    throw std::invalid_argument("missing value for workload option " + std::string{argv[argc - 1]});
   }
+  return options;
 }
 
-static auto viewFromSlice(rocksdb::Slice slice) -> byte_string_view {
-  return byte_string_view{reinterpret_cast<std::byte const*>(slice.data()), slice.size()};
-}
-
-auto findAllInBox(std::shared_ptr<RocksDBHandle> const& rocks, std::vector<byte_string> const& min, std::vector<byte_string> const& max)
-  -> std::pair<std::unordered_set<point>, std::size_t> {
+// query results in columns, in key order
+struct points {
+  std::array<std::vector<double>, 4> columns;
 
-  auto min_s = interleave(min);
-  auto max_s = interleave(max);
+  auto size() const noexcept -> std::size_t { return columns[0].size(); }
+  auto operator[](std::size_t i) const noexcept -> point {
+    return {columns[0][i], columns[1][i], columns[2][i], columns[3][i]};
+  }
+  auto operator==(points const& other) const noexcept -> bool { return columns == other.columns; }
 
-  auto iter = std::unique_ptr<rocksdb::Iterator>{rocks->db->NewIterator(rocksdb::ReadOptions{})};
+  void append(ResultBatch const& batch) {
+    std::vector<double> column;
+    for (std::size_t d = 0; d < 4; ++d) {
+      batch.decodeColumn(d, column);
+      columns[d].insert(columns[d].end(), column.begin(), column.end());
+    }
+  }
+};
 
-  byte_string cur = min_s;
+constexpr std::size_t batchSize = 1024;
 
-  std::unordered_set<point> res;
-  std::size_t num_seeks = 0;
+auto findAllInBox(std::shared_ptr<RocksDBHandle> const& rocks, Box const& box)
+  -> std::pair<points, std::size_t> {
 
-  while (true) {
-    //std::cout << "Seeking to " << cur << std::endl;
-    iter->Seek(sliceFromString(cur));
-    num_seeks += 1;
-    auto s = iter->status();
-    if (!s.ok()) {
-      std::cerr << s.ToString() << std::endl;
-      return {};
-    }
-    if (!iter->Valid()) {
-      break;
-    }
+  points res;
+  auto num_seeks = zkd::findAllInBoxBatched(*rocks, box, batchSize, [&](ResultBatch const& batch) {
+    res.append(batch);
+  });
 
-    while (true) {
-      auto key = viewFromSlice(iter->key());
-      if (!testInBox(key, min_s, max_s, 4)) {
-        cur = key;
-        break;
-      }
+  return std::make_pair(std::move(res), num_seeks);
+}
 
-      auto value = transpose(byte_string{key}, 4);
 
-      //std::cout << value[0] << " " << value[1] << " " << value[2] << " " << value[3] << std::endl;
-      res.insert({from_byte_string_fixed_length<double>(value[0]),
-          from_byte_string_fixed_length<double>(value[1]),
-                 from_byte_string_fixed_length<double>(value[2]),
-                 from_byte_string_fixed_length<double>(value[3])});
-      iter->Next();
-    }
+auto findAllInBoxSlow(std::shared_ptr<RocksDBHandle> const& rocks, Box const& box)
+  -> points {
 
-    auto cmp = compareWithBox(cur, min_s, max_s, 4);
+  points res;
+  ResultBatch batch(4, batchSize);
 
-    auto next = getNextZValue(cur, min_s, max_s, cmp);
-    if (!next) {
-      break;
+  zkd::findAllInBoxSlow(*rocks, box, [&](byte_string_view key, byte_string_view value) {
+    batch.add(key, value);
+    if (batch.full()) {
+      res.append(batch);
+      batch.clear();
     }
+  });
+  res.append(batch);
 
-    cur = next.value();
-  }
-
-  return std::make_pair(res, num_seeks);
+  return res;
 }
 
 
-auto findAllInBoxSlow(std::shared_ptr<RocksDBHandle> const& rocks, std::vector<byte_string> const& min, std::vector<byte_string> const& max)
-  -> std::unordered_set<point> {
-
-  auto min_s = interleave(min);
-  auto max_s = interleave(max);
-  std::unordered_set<point> res;
-
-  auto iter = std::unique_ptr<rocksdb::Iterator>{rocks->db->NewIterator(rocksdb::ReadOptions{})};
-  iter->SeekToFirst();
-  while (true) {
-    if (!iter->Valid()) {
-      break;
-    }
-    auto key = viewFromSlice(iter->key());
-    if (testInBox(key, min_s, max_s, 4)) {
-      auto value = transpose(byte_string{key}, 4);
-      res.insert({from_byte_string_fixed_length<double>(value[0]),
-          from_byte_string_fixed_length<double>(value[1]),
-                 from_byte_string_fixed_length<double>(value[2]),
-                 from_byte_string_fixed_length<double>(value[3])});
+// "*" leaves a dimension unbounded
+static auto parseCoords(char const* str) -> std::vector<std::optional<byte_string>> {
+  std::vector<std::optional<byte_string>> coords;
+  std::stringstream ss(str);
+  for (size_t i = 0; i < 4; i++) {
+    std::string token;
+    ss >> token;
+    if (token == "*") {
+      coords.emplace_back(std::nullopt);
+    } else {
+      coords.emplace_back(to_byte_string_fixed_length(std::stod(token)));
     }
-    iter->Next();
   }
+  return coords;
+}
 
-
-
-  return res;
+static auto parseBox(char const* min, char const* max) -> Box {
+  return makeBox(parseCoords(min), parseCoords(max), sizeof(double));
 }
 
 
@@ -177,58 +157,211 @@ int main(int argc, char* argv[]) {
 
   if (argc < 3) {
     std::cerr << "bad parameter, expecting" << argv[0] << " path "
-              << "(fill|find)" << std::endl;
+              << "(fill|bench|find|explain|count|summarize|plan|schedule|export|snapshot-find|blocks|first|sample)" << std::endl;
     return EXIT_FAILURE;
   }
 
-  auto db = OpenRocksDB(argv[1]);
+  if (argv[2] == "schedule"sv) {
+    // here, the path is a query log written by explain ... binary
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+      std::cerr << "cannot open query log " << argv[1] << std::endl;
+      return EXIT_FAILURE;
+    }
+    auto log = readQueryLog(in);
+    if (log.empty()) {
+      std::cerr << "query log is empty" << std::endl;
+      return EXIT_FAILURE;
+    }
+    auto const dimensions = log.front().dimensions;
+    auto const bits = argc > 3 ? unsigned(std::stoul(argv[3])) : unsigned(8 * sizeof(double));
+    auto resolution = queryResolution(log, dimensions);
+    std::cerr << log.size() << " queries, resolution in bits:";
+    for (auto r : resolution) {
+      std::cerr << " " << r;
+    }
+    std::cerr << std::endl;
+    std::cout << deriveInterleaveSchedule(resolution, std::vector<unsigned>(dimensions, bits)) << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  if (argv[2] == "snapshot-find"sv) {
+    // here, the path is a file written by export
+    if (argc != 5) {
+      std::cerr << "missing min and max in from \"a b c d\", * for unbounded " << std::endl;
+      return EXIT_FAILURE;
+    }
+    auto start = std::chrono::steady_clock::now();
+    SnapshotReader snapshot(argv[1]);
+    auto opened = std::chrono::steady_clock::now();
+    std::size_t found = 0;
+    auto num_seeks = findAllInBox(snapshot, parseBox(argv[3], argv[4]), [&](byte_string_view, byte_string_view) { ++found; });
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "opened " << snapshot.size() << " keys (" << snapshot.codecs() << ") in " << std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(opened - start).count() << "ms" << std::endl;
+    std::cout << "found " << found << " with " << num_seeks << " seeks in " << std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(end - opened).count() << "ms" << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  if (argv[2] == "fill"sv || argv[2] == "bench"sv) {
+    auto options = parseWorkloadOptions(argc - 3, argv + 3);
+    // summaries make every write read the key first, so they are only kept up to date
+    // once summarize created them
+    auto db = OpenRocksDB(argv[1], HasSummaries(argv[1]) ? RocksDBOptions{{8, 16, 24}, options.curve} : RocksDBOptions{{}, options.curve});
+    if (argv[2] == "bench"sv) {
+      writeJson(std::cout, runWorkload(*db, options));
+      return EXIT_SUCCESS;
+    }
 
-  if (argv[2] == "fill"sv) {
-    fillRocksdb(db);
-  } else if (argv[2] == "find"sv) {
+    auto start = std::chrono::steady_clock::now();
+    auto points = loadWorkload(*db, options);
+    auto s = db->db->SyncWAL();
+    if (!s.ok()) {
+      std::cerr << "sync failed: " << s.ToString() << std::endl;
+      return EXIT_FAILURE;
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "wrote " << points << " points (" << options.distribution << ", " << options.curve << ") in " << std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(end - start).count() << "ms" << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  // 2, 4 and 6 bits per dimension; count scans the box if summarize never ran
+  RocksDBOptions dbOptions;
+  if (argv[2] == "summarize"sv || HasSummaries(argv[1])) {
+    dbOptions.summaryPrefixBits = {8, 16, 24};
+  }
+  // the curve fill was run with
+  dbOptions.useStoredLayout = true;
+  auto db = OpenRocksDB(argv[1], dbOptions);
+
+  if (argv[2] == "summarize"sv) {
+    rebuildSummaries(*db);
+  } else if (argv[2] == "export"sv) {
+    if (argc != 4) {
+      std::cerr << "missing snapshot file" << std::endl;
+      return EXIT_FAILURE;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto count = exportSnapshot(*db, argv[3], SnapshotOptions{4, "double,double,double,double"});
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "exported " << count << " keys in " << std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(end - start).count() << "ms" << std::endl;
+  } else if (argv[2] == "count"sv) {
     if (argc != 5) {
-      std::cerr << "missing min and max in from \"a b c d\" " << std::endl;
+      std::cerr << "missing min and max in from \"a b c d\", * for unbounded " << std::endl;
       return EXIT_FAILURE;
     }
 
-    std::vector<byte_string> min, max;
+    auto box = parseBox(argv[3], argv[4]);
 
-    {
-      std::stringstream ss(argv[3]);
-      for (size_t i = 0; i < 4; i++) {
-        double v;
-        ss >> v;
-        min.emplace_back(to_byte_string_fixed_length(v));
-      }
+    auto start = std::chrono::steady_clock::now();
+    auto result = countInBox(*db, box.min, box.max, 4);
+    auto end = std::chrono::steady_clock::now();
+    std::cout << result << " in " << std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(end - start).count() << "ms" << std::endl;
+  } else if (argv[2] == "blocks"sv) {
+    if (argc != 5) {
+      std::cerr << "missing min and max in from \"a b c d\", * for unbounded " << std::endl;
+      return EXIT_FAILURE;
     }
-    {
-      std::stringstream ss(argv[4]);
-      for (size_t i = 0; i < 4; i++) {
-        double v;
-        ss >> v;
-        max.emplace_back(to_byte_string_fixed_length(v));
+
+    auto box = parseBox(argv[3], argv[4]);
+
+    auto start = std::chrono::steady_clock::now();
+    auto run = buildKeyBlocks(*db);
+    auto built = std::chrono::steady_clock::now();
+    QueryStats stats;
+    std::size_t found = 0;
+    findAllInBox(run, box, [&](byte_string_view, byte_string_view) { ++found; }, stats);
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "loaded " << run.size() << " keys into " << run.blocks() << " blocks, " << run.memoryUsage() << " of " << run.rawSize() << " bytes, in " << std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(built - start).count() << "ms" << std::endl;
+    std::cout << "found " << found << ", decoding " << stats.storage.blockReads << " blocks, in " << std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(end - built).count() << "ms" << std::endl;
+  } else if (argv[2] == "first"sv || argv[2] == "sample"sv) {
+    if (argc != 6) {
+      std::cerr << "missing min and max in from \"a b c d\", * for unbounded, and the number of points" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    auto box = parseBox(argv[3], argv[4]);
+    auto const n = std::stoul(argv[5]);
+
+    auto start = std::chrono::steady_clock::now();
+    QueryStats stats;
+    points res;
+    ResultBatch batch(4, batchSize);
+    auto const collect = [&](byte_string_view key, byte_string_view value) {
+      batch.add(key, value);
+      if (batch.full()) {
+        res.append(batch);
+        batch.clear();
       }
+    };
+    auto num_seeks = argv[2] == "first"sv ? findFirstInBox(*db, box, n, collect, stats)
+                                          : sampleInBox(*db, box, n, collect, stats);
+    res.append(batch);
+    auto end = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < res.size(); ++i) {
+      std::cout << res[i] << std::endl;
+    }
+    std::cout << res.size() << " points with " << num_seeks << " seeks in " << std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(end - start).count() << "ms" << std::endl;
+  } else if (argv[2] == "plan"sv) {
+    if (argc != 5) {
+      std::cerr << "missing min and max in from \"a b c d\", * for unbounded " << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    auto box = parseBox(argv[3], argv[4]);
+    auto const& min_s = box.min;
+    auto const& max_s = box.max;
+
+    db->histograms = std::make_shared<DimensionHistograms>(4);
+    rebuildHistograms(*db);
+
+    auto plan = planBoxQuery(*db, min_s, max_s, 4);
+    std::cout << plan << std::endl;
+
+    std::size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto num_seeks = executeBoxQuery(*db, plan, min_s, max_s, 4, [&](byte_string_view, byte_string_view) { ++found; });
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "found " << found << " with " << num_seeks << " seeks in " << std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(end - start).count() << "ms" << std::endl;
+  } else if (argv[2] == "explain"sv) {
+    if (argc != 5 && argc != 6) {
+      std::cerr << "missing min and max in from \"a b c d\", * for unbounded, optionally json or binary" << std::endl;
+      return EXIT_FAILURE;
     }
 
+    auto box = parseBox(argv[3], argv[4]);
+    auto trace = traceBoxQuery(*db, box, [](byte_string_view, byte_string_view) {});
+    if (argc == 6 && argv[5] == "binary"sv) {
+      writeBinary(std::cout, trace);
+    } else {
+      writeJson(std::cout, trace);
+    }
+  } else if (argv[2] == "find"sv) {
+    if (argc != 5) {
+      std::cerr << "missing min and max in from \"a b c d\", * for unbounded " << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    auto box = parseBox(argv[3], argv[4]);
 
-    std::unordered_set<point> res_zkd, res_linear;
+    points res_zkd, res_linear;
     std::size_t num_seeks;
 
-    {
-      std::cout << "starting zkd search" << std::endl;
+    db->emptyIntervals = std::make_shared<EmptyIntervalCache>(1u << 16);
+    for (auto const* run : {"cold", "warm"}) {
+      std::cout << "starting zkd search (" << run << " empty interval cache)" << std::endl;
       auto start = std::chrono::steady_clock::now();
-      std::tie(res_zkd, num_seeks) = findAllInBox(db, min, max);
+      std::tie(res_zkd, num_seeks) = findAllInBox(db, box);
       auto end = std::chrono::steady_clock::now();
       std::cout << "done " <<  std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(end - start).count() << "ms" << std::endl;
-      for (auto const& p : res_zkd) {
-        std::cout << p << std::endl;
-      }
-      std::cout << "seeks = " << num_seeks << std::endl;
+      std::cout << "seeks = " << num_seeks << ", cached empty intervals = " << db->emptyIntervals->size() << std::endl;
+    }
+    for (std::size_t i = 0; i < res_zkd.size(); ++i) {
+      std::cout << res_zkd[i] << std::endl;
     }
     {
       std::cout << "starting linear search" << std::endl;
       auto start = std::chrono::steady_clock::now();
-      res_linear = findAllInBoxSlow(db, min, max);
+      res_linear = findAllInBoxSlow(db, box);
       auto end = std::chrono::steady_clock::now();
       std::cout << "done " << std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(end - start).count() << "ms" << std::endl;
       //for (auto const& p : res_linear) {
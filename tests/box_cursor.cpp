@@ -0,0 +1,108 @@
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-cursor.h"
+#include "box-query.h"
+#include "hilbert-curve.h"
+#include "library.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+namespace {
+auto randomPoints(std::size_t count) -> std::vector<std::vector<byte_string>> {
+  std::mt19937 gen(37);
+  std::uniform_int_distribution<unsigned> coord(0, 255);
+  std::vector<std::vector<byte_string>> points;
+  for (std::size_t i = 0; i < count; ++i) {
+    points.push_back({{std::byte(coord(gen))}, {std::byte(coord(gen))}});
+  }
+  return points;
+}
+
+// all keys of the box and the seeks of all pages, with the cursor passed through its token
+auto readPages(RocksDBHandle& rocks, Box const& box, std::size_t pageSize, std::size_t& pages, std::size_t& seeks)
+  -> std::vector<byte_string> {
+  std::vector<byte_string> keys;
+  auto const collect = [&](byte_string_view key, byte_string_view) { keys.emplace_back(key); };
+  QueryStats stats;
+  auto cursor = findPageInBox(rocks, box, pageSize, collect, stats);
+  pages = 1;
+  seeks = stats.seeks;
+  while (cursor) {
+    auto const token = serializeBoxCursor(*cursor);
+    stats = QueryStats{};
+    cursor = findPageInBox(rocks, parseBoxCursor(token), pageSize, collect, stats);
+    pages += 1;
+    seeks += stats.seeks;
+  }
+  return keys;
+}
+} // namespace
+
+TEST(boxCursor, token_round_trip) {
+  BoxCursor cursor{makeBox({"00000001"_bs, std::nullopt, "00000011"_bs}, {std::nullopt, "00001111"_bs, "11111110"_bs}, 1),
+                   "000000010000001000000011"_bs};
+  auto const parsed = parseBoxCursor(serializeBoxCursor(cursor));
+  EXPECT_EQ(parsed.box.min, cursor.box.min);
+  EXPECT_EQ(parsed.box.max, cursor.box.max);
+  ASSERT_EQ(parsed.box.dimensions(), 3);
+  for (std::size_t d = 0; d < 3; ++d) {
+    EXPECT_EQ(parsed.box.mask[d].min, cursor.box.mask[d].min);
+    EXPECT_EQ(parsed.box.mask[d].max, cursor.box.mask[d].max);
+  }
+  EXPECT_EQ(parsed.last, cursor.last);
+
+  auto token = serializeBoxCursor(cursor);
+  EXPECT_THROW(parseBoxCursor(token.substr(0, token.size() - 1)), std::invalid_argument);
+  EXPECT_THROW(parseBoxCursor(token + "0"_bs), std::invalid_argument);
+  token[0] = std::byte{7};
+  EXPECT_THROW(parseBoxCursor(token), std::invalid_argument);
+  EXPECT_THROW(parseBoxCursor({}), std::invalid_argument);
+}
+
+TEST(boxCursor, key_successor) {
+  EXPECT_EQ(keySuccessor("0000000111111111"_bs), "0000001000000000"_bs);
+  EXPECT_EQ(keySuccessor("00000000"_bs), "00000001"_bs);
+  EXPECT_EQ(keySuccessor("1111111111111111"_bs), std::nullopt);
+}
+
+TEST(boxCursor, pages_cover_the_box) {
+  TemporaryDB db;
+  for (auto const& p : randomPoints(4000)) {
+    ASSERT_TRUE(PutKey(*db.rocks, interleave(p), {}).ok());
+  }
+  auto const box = makeBox({"00010000"_bs, std::nullopt}, {"11000000"_bs, "10000000"_bs}, 1);
+  std::vector<byte_string> expected;
+  QueryStats all;
+  findAllInBox(*db.rocks, box, [&](byte_string_view key, byte_string_view) { expected.emplace_back(key); }, all);
+  ASSERT_GT(expected.size(), 1000);
+
+  std::size_t pages, seeks;
+  EXPECT_EQ(readPages(*db.rocks, box, 50, pages, seeks), expected);
+  EXPECT_EQ(pages, expected.size() / 50 + 1);
+  // a page does not repeat the seeks of the pages before it, resuming costs at most one
+  EXPECT_LE(seeks, all.seeks + pages);
+
+  // the last page ends the box exactly
+  EXPECT_EQ(readPages(*db.rocks, box, expected.size(), pages, seeks), expected);
+  EXPECT_EQ(pages, 2);
+  EXPECT_THROW(findPageInBox(*db.rocks, box, 0, [](byte_string_view, byte_string_view) {}), std::invalid_argument);
+}
+
+TEST(boxCursor, pages_on_the_hilbert_curve) {
+  TemporaryDB db(RocksDBOptions{{}, Curve::HILBERT});
+  for (auto const& p : randomPoints(2000)) {
+    ASSERT_TRUE(PutKey(*db.rocks, hilbertEncode(p), {}).ok());
+  }
+  auto const box = makeBox({"00100000"_bs, "00010000"_bs}, {"10100000"_bs, "11110000"_bs}, 1);
+  std::vector<byte_string> expected;
+  findAllInBox(*db.rocks, box, [&](byte_string_view key, byte_string_view) { expected.emplace_back(key); });
+  ASSERT_GT(expected.size(), 100);
+
+  std::size_t pages, seeks;
+  EXPECT_EQ(readPages(*db.rocks, box, 37, pages, seeks), expected);
+}
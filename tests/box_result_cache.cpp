@@ -0,0 +1,88 @@
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "box-result-cache.h"
+#include "library.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+TEST(boxResultCache, hit_and_stale) {
+  BoxResultCache cache(1024);
+  auto const min = "00000000"_bs;
+  auto const max = "00001111"_bs;
+
+  EXPECT_EQ(cache.lookup(min, max, 2, 1), nullptr);
+  cache.insert(min, max, 2, 1, {{"00000001"_bs, "1"_bs}});
+
+  auto hit = cache.lookup(min, max, 2, 1);
+  ASSERT_NE(hit, nullptr);
+  ASSERT_EQ(hit->size(), 1);
+  EXPECT_EQ(hit->front().first, "00000001"_bs);
+
+  // same bounds, different dimensions
+  EXPECT_EQ(cache.lookup(min, max, 1, 1), nullptr);
+  // the database has changed since
+  EXPECT_EQ(cache.lookup(min, max, 2, 2), nullptr);
+
+  auto stats = cache.stats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 3);
+  EXPECT_EQ(stats.stale, 1);
+  EXPECT_EQ(stats.entries, 0);
+  EXPECT_EQ(stats.bytes, 0);
+}
+
+TEST(boxResultCache, lru_eviction) {
+  BoxResultCache cache(512);
+  auto const value = byte_string(64, 0_b);
+  for (uint8_t i = 0; i < 16; i++) {
+    auto const bound = byte_string{std::byte{i}};
+    cache.insert(bound, bound, 1, 1, {{bound, value}});
+    // keep the first entry warm
+    EXPECT_NE(cache.lookup("0"_bs, "0"_bs, 1, 1), nullptr);
+    EXPECT_LE(cache.stats().bytes, cache.capacity());
+  }
+
+  EXPECT_GT(cache.stats().evictions, 0);
+  EXPECT_EQ(cache.lookup("00000001"_bs, "00000001"_bs, 1, 1), nullptr);
+  EXPECT_NE(cache.lookup("00001111"_bs, "00001111"_bs, 1, 1), nullptr);
+
+  cache.insert("00010000"_bs, "00010000"_bs, 1, 1, {{"00010000"_bs, byte_string(1024, 0_b)}});
+  EXPECT_EQ(cache.stats().rejected, 1);
+}
+
+TEST(boxResultCache, box_query) {
+  TemporaryDB db;
+  db.rocks->resultCache = std::make_shared<BoxResultCache>(1u << 20);
+
+  for (uint8_t x = 0; x < 16; x++) {
+    ASSERT_TRUE(PutKey(*db.rocks, interleave({{std::byte{x}}, {std::byte{x}}}), "1"_bs).ok());
+  }
+
+  auto const min = interleave({{2_b}, {0_b}});
+  auto const max = interleave({{9_b}, {9_b}});
+  auto query = [&] {
+    std::vector<byte_string> result;
+    auto seeks = findAllInBox(*db.rocks, min, max, 2, [&](byte_string_view key, byte_string_view) {
+      result.emplace_back(key);
+    });
+    return std::pair{result, seeks};
+  };
+
+  auto const [first, firstSeeks] = query();
+  EXPECT_EQ(first.size(), 8);
+  EXPECT_GT(firstSeeks, 0);
+
+  auto const [second, secondSeeks] = query();
+  EXPECT_EQ(second, first);
+  EXPECT_EQ(secondSeeks, 0);
+  EXPECT_EQ(db.rocks->resultCache->stats().hits, 1);
+
+  ASSERT_TRUE(PutKey(*db.rocks, interleave({{3_b}, {4_b}}), "1"_bs).ok());
+  auto const [third, thirdSeeks] = query();
+  EXPECT_EQ(third.size(), 9);
+  EXPECT_GT(thirdSeeks, 0);
+}
@@ -0,0 +1,238 @@
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "box-result-cache.h"
+#include "delta-buffer.h"
+#include "key-blocks.h"
+#include "library.h"
+#include "prefix-summary.h"
+#include "snapshot-file.h"
+#include "spatial-join.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+namespace {
+using model = std::map<byte_string, byte_string>;
+
+auto randomKey(std::mt19937& gen) -> byte_string {
+  std::uniform_int_distribution<unsigned> coord(0, 63);
+  return interleave({{std::byte(coord(gen))}, {std::byte(coord(gen))}});
+}
+
+// random buffered writes, flushed now and then
+void randomWrites(RocksDBHandle& rocks, model& expected, std::size_t count, unsigned seed) {
+  std::mt19937 gen(seed);
+  for (std::size_t i = 0; i < count; ++i) {
+    auto const key = randomKey(gen);
+    if (gen() % 3 == 0) {
+      ASSERT_TRUE(deleteBuffered(rocks, key).ok());
+      expected.erase(key);
+    } else {
+      auto const value = byte_string{std::byte(i & 0xffu)};
+      ASSERT_TRUE(putBuffered(rocks, key, value).ok());
+      expected[key] = value;
+    }
+    if (i % 500 == 499) {
+      ASSERT_TRUE(flushDeltaBuffer(rocks).ok());
+    }
+  }
+}
+
+auto inBox(model const& keys, Box const& box) -> model {
+  model result;
+  for (auto const& [key, value] : keys) {
+    if (testInBox(key, box.min, box.max, box.mask)) {
+      result.emplace(key, value);
+    }
+  }
+  return result;
+}
+
+auto query(RocksDBHandle& rocks, Box const& box) -> model {
+  model result;
+  findAllInBox(rocks, box, [&](byte_string_view key, byte_string_view value) { result.emplace(key, value); });
+  return result;
+}
+} // namespace
+
+TEST(deltaBuffer, merged_iterator) {
+  TemporaryDB db;
+  db.rocks->deltaBuffer = std::make_shared<DeltaBuffer>(DeltaBufferOptions{0});
+  model expected;
+  randomWrites(*db.rocks, expected, 1700, 83);
+  ASSERT_FALSE(db.rocks->deltaBuffer->empty());
+
+  auto iter = newMergedIterator(*db.rocks, rocksdb::ReadOptions{});
+  std::vector<byte_string> forward, backward;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    auto const key = byte_string{reinterpret_cast<std::byte const*>(iter->key().data()), iter->key().size()};
+    ASSERT_EQ(expected.count(key), 1);
+    forward.push_back(key);
+  }
+  for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+    backward.emplace_back(reinterpret_cast<std::byte const*>(iter->key().data()), iter->key().size());
+  }
+  EXPECT_EQ(forward.size(), expected.size());
+  EXPECT_EQ(std::vector<byte_string>(backward.rbegin(), backward.rend()), forward);
+
+  // turning around in the middle
+  std::mt19937 gen(89);
+  for (int i = 0; i < 200; ++i) {
+    auto const target = randomKey(gen);
+    iter->Seek(rocksdb::Slice(reinterpret_cast<char const*>(target.data()), target.size()));
+    auto it = expected.lower_bound(target);
+    if (it == expected.end()) {
+      EXPECT_FALSE(iter->Valid());
+      continue;
+    }
+    iter->Next();
+    iter->Prev();
+    ASSERT_TRUE(iter->Valid());
+    EXPECT_EQ(iter->key().ToString(), std::string(reinterpret_cast<char const*>(it->first.data()), it->first.size()));
+    iter->Prev();
+    if (it == expected.begin()) {
+      EXPECT_FALSE(iter->Valid());
+    } else {
+      ASSERT_TRUE(iter->Valid());
+      auto const& prev = std::prev(it)->first;
+      EXPECT_EQ(iter->key().ToString(), std::string(reinterpret_cast<char const*>(prev.data()), prev.size()));
+    }
+  }
+}
+
+TEST(deltaBuffer, reads_between_writes_freeze_few_runs) {
+  TemporaryDB db;
+  db.rocks->deltaBuffer = std::make_shared<DeltaBuffer>(DeltaBufferOptions{0});
+  auto const box = makeBox({{{std::byte(10)}}, {{std::byte(5)}}}, {{{std::byte(40)}}, {{std::byte(50)}}}, 1);
+  model expected;
+  std::mt19937 gen(89);
+  auto const before = db.rocks->deltaBuffer->snapshot();
+  for (std::size_t i = 0; i < 1000; ++i) {
+    auto const key = randomKey(gen);
+    auto const value = byte_string{std::byte(i & 0xffu)};
+    ASSERT_TRUE(putBuffered(*db.rocks, key, value).ok());
+    expected[key] = value;
+    if (i % 10 == 0) {
+      EXPECT_EQ(query(*db.rocks, box), inBox(expected, box));
+    }
+    // each new run absorbs the ones that are at most twice its size
+    EXPECT_LE(db.rocks->deltaBuffer->snapshot().size(), 12);
+  }
+  EXPECT_TRUE(before.empty());
+  EXPECT_EQ(query(*db.rocks, box), inBox(expected, box));
+  ASSERT_TRUE(flushDeltaBuffer(*db.rocks).ok());
+  EXPECT_TRUE(db.rocks->deltaBuffer->empty());
+  EXPECT_EQ(query(*db.rocks, box), inBox(expected, box));
+}
+
+TEST(deltaBuffer, box_queries_read_buffered_writes) {
+  TemporaryDB db;
+  db.rocks->deltaBuffer = std::make_shared<DeltaBuffer>(DeltaBufferOptions{0});
+  db.rocks->resultCache = std::make_shared<BoxResultCache>(1 << 20);
+  auto const box = makeBox({{{std::byte(10)}}, {{std::byte(5)}}}, {{{std::byte(40)}}, {{std::byte(50)}}}, 1);
+  model expected;
+  for (unsigned seed = 97; seed < 100; ++seed) {
+    randomWrites(*db.rocks, expected, 700, seed);
+    EXPECT_EQ(query(*db.rocks, box), inBox(expected, box));
+    ASSERT_TRUE(flushDeltaBuffer(*db.rocks).ok());
+    EXPECT_TRUE(db.rocks->deltaBuffer->empty());
+    EXPECT_EQ(query(*db.rocks, box), inBox(expected, box));
+    // from the cache, then shadowed by a buffered delete
+    EXPECT_EQ(query(*db.rocks, box), inBox(expected, box));
+    if (auto const in = inBox(expected, box); !in.empty()) {
+      ASSERT_TRUE(deleteBuffered(*db.rocks, in.begin()->first).ok());
+      expected.erase(in.begin()->first);
+      EXPECT_EQ(query(*db.rocks, box), inBox(expected, box));
+    }
+  }
+  EXPECT_GT(db.rocks->resultCache->stats().hits, 0);
+}
+
+TEST(deltaBuffer, other_readers_see_buffered_writes) {
+  TemporaryDB db{RocksDBOptions{{4, 8}}};
+  db.rocks->deltaBuffer = std::make_shared<DeltaBuffer>(DeltaBufferOptions{0});
+  model expected;
+  randomWrites(*db.rocks, expected, 1200, 101);
+  ASSERT_FALSE(db.rocks->deltaBuffer->empty());
+
+  EXPECT_EQ(buildKeyBlocks(*db.rocks).size(), expected.size());
+
+  auto const path = std::filesystem::temp_directory_path() / ("zkd-delta-" + std::to_string(std::random_device{}()));
+  EXPECT_EQ(exportSnapshot(*db.rocks, path.string(), SnapshotOptions{2, "uint8,uint8"}), expected.size());
+  EXPECT_EQ(SnapshotReader(path.string()).size(), expected.size());
+  std::filesystem::remove(path);
+
+  // every key joins with itself
+  TemporaryDB other;
+  EXPECT_EQ(spatialJoin(*db.rocks, *other.rocks, 2, JoinOptions{{0, 0}}, [](auto, auto, auto, auto) {}), 0);
+  EXPECT_EQ(spatialJoin(*db.rocks, *db.rocks, 2, JoinOptions{{0, 0}}, [](auto, auto, auto, auto) {}), expected.size());
+
+  // the summaries only know about flushed keys, so counting flushes the buffer
+  auto const box = makeBox({{{std::byte(10)}}, {{std::byte(5)}}}, {{{std::byte(40)}}, {{std::byte(50)}}}, 1);
+  EXPECT_EQ(countInBox(*db.rocks, box.min, box.max, 2).count, inBox(expected, box).size());
+  EXPECT_TRUE(db.rocks->deltaBuffer->empty());
+}
+
+TEST(deltaBuffer, flush_threshold) {
+  TemporaryDB db;
+  db.rocks->deltaBuffer = std::make_shared<DeltaBuffer>(DeltaBufferOptions{100});
+  for (int i = 0; i < 99; ++i) {
+    ASSERT_TRUE(putBuffered(*db.rocks, interleave({{std::byte(i)}, {std::byte(i)}}), {}).ok());
+  }
+  EXPECT_EQ(db.rocks->deltaBuffer->size(), 99);
+
+  // nothing reached the database yet
+  auto raw = std::unique_ptr<rocksdb::Iterator>{db.rocks->db->NewIterator({}, db.rocks->default_.get())};
+  raw->SeekToFirst();
+  EXPECT_FALSE(raw->Valid());
+
+  ASSERT_TRUE(putBuffered(*db.rocks, interleave({{std::byte(99)}, {std::byte(99)}}), {}).ok());
+  EXPECT_TRUE(db.rocks->deltaBuffer->empty());
+  raw.reset(db.rocks->db->NewIterator({}, db.rocks->default_.get()));
+  std::size_t count = 0;
+  for (raw->SeekToFirst(); raw->Valid(); raw->Next()) {
+    count += 1;
+  }
+  EXPECT_EQ(count, 100);
+}
+
+TEST(deltaBuffer, needs_a_buffer) {
+  TemporaryDB db;
+  EXPECT_THROW(putBuffered(*db.rocks, interleave({{std::byte(1)}, {std::byte(1)}}), {}), std::logic_error);
+  EXPECT_TRUE(flushDeltaBuffer(*db.rocks).ok());
+}
+
+TEST(deltaBuffer, concurrent_flushes_lose_no_keys) {
+  TemporaryDB db;
+  db.rocks->deltaBuffer = std::make_shared<DeltaBuffer>(DeltaBufferOptions{64});
+  auto const all = std::optional<byte_string>{};
+  auto const box = makeBox({all, all}, {all, all}, 2);
+
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    for (unsigned i = 0; i < 4000; ++i) {
+      auto const key = interleave({{std::byte(i >> 8), std::byte(i & 0xffu)}, {std::byte(0), std::byte(i % 7)}});
+      EXPECT_TRUE(putBuffered(*db.rocks, key, {}).ok());
+    }
+    done = true;
+  });
+
+  // keys are only added, so every query sees at least as many as the one before
+  std::size_t last = 0;
+  do {
+    auto const count = query(*db.rocks, box).size();
+    EXPECT_GE(count, last);
+    last = count;
+  } while (!done);
+  writer.join();
+  EXPECT_EQ(query(*db.rocks, box).size(), 4000);
+}
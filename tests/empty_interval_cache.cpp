@@ -0,0 +1,115 @@
+#include <set>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "empty-interval-cache.h"
+#include "library.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+TEST(emptyIntervalCache, lookup) {
+  EmptyIntervalCache cache(16);
+  cache.insert("00010000"_bs, "00100000"_bs, cache.epoch());
+
+  EXPECT_FALSE(cache.lookup("00001111"_bs).has_value());
+  EXPECT_FALSE(cache.lookup("00100000"_bs).has_value());
+
+  auto hit = cache.lookup("00011000"_bs);
+  ASSERT_TRUE(hit.has_value());
+  EXPECT_EQ(hit->begin, "00010000"_bs);
+  EXPECT_EQ(hit->end, "00100000"_bs);
+
+  cache.insert("01000000"_bs, std::nullopt, cache.epoch());
+  hit = cache.lookup("11111111"_bs);
+  ASSERT_TRUE(hit.has_value());
+  EXPECT_FALSE(hit->end.has_value());
+}
+
+TEST(emptyIntervalCache, merge_overlapping) {
+  EmptyIntervalCache cache(16);
+  cache.insert("00010000"_bs, "00100000"_bs, cache.epoch());
+  cache.insert("00100000"_bs, "00110000"_bs, cache.epoch());
+  cache.insert("00001000"_bs, "00011000"_bs, cache.epoch());
+
+  EXPECT_EQ(cache.size(), 1);
+  auto hit = cache.lookup("00101000"_bs);
+  ASSERT_TRUE(hit.has_value());
+  EXPECT_EQ(hit->begin, "00001000"_bs);
+  EXPECT_EQ(hit->end, "00110000"_bs);
+}
+
+TEST(emptyIntervalCache, invalidate_trims_interval) {
+  EmptyIntervalCache cache(16);
+  cache.insert("00010000"_bs, "00100000"_bs, cache.epoch());
+  cache.invalidate("00011000"_bs);
+
+  EXPECT_FALSE(cache.lookup("00011000"_bs).has_value());
+  auto hit = cache.lookup("00010100"_bs);
+  ASSERT_TRUE(hit.has_value());
+  EXPECT_EQ(hit->end, "00011000"_bs);
+
+  cache.invalidate("00010000"_bs);
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(emptyIntervalCache, stale_epoch_is_ignored) {
+  EmptyIntervalCache cache(16);
+  auto const epoch = cache.epoch();
+  cache.invalidate("00011000"_bs);
+  cache.insert("00010000"_bs, "00100000"_bs, epoch);
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(emptyIntervalCache, bounded) {
+  EmptyIntervalCache cache(4);
+  for (unsigned i = 0; i < 32; i += 2) {
+    cache.insert(byte_string{std::byte(i)}, byte_string{std::byte(i + 1)}, cache.epoch());
+    EXPECT_LE(cache.size(), 4);
+  }
+  // the oldest intervals are evicted first
+  EXPECT_FALSE(cache.lookup(byte_string{std::byte{0}}).has_value());
+  EXPECT_TRUE(cache.lookup(byte_string{std::byte{30}}).has_value());
+}
+
+TEST(emptyIntervalCache, box_query_skips_known_gaps) {
+  TemporaryDB db;
+  db.rocks->emptyIntervals = std::make_shared<EmptyIntervalCache>(1024);
+
+  auto const value = "0"_bs;
+  for (uint8_t x = 0; x < 16; x += 3) {
+    for (uint8_t y = 0; y < 16; y += 5) {
+      ASSERT_TRUE(PutKey(*db.rocks, interleave({{std::byte{x}}, {std::byte{y}}}), value).ok());
+    }
+  }
+
+  auto const min = interleave({{std::byte{2}}, {std::byte{1}}});
+  auto const max = interleave({{std::byte{10}}, {std::byte{12}}});
+
+  auto query = [&] {
+    std::set<byte_string> result;
+    auto seeks = findAllInBox(*db.rocks, min, max, 2, [&](byte_string_view key, byte_string_view) {
+      result.emplace(key);
+    });
+    return std::pair{result, seeks};
+  };
+
+  std::set<byte_string> expected;
+  findAllInBoxSlow(*db.rocks, min, max, 2, [&](byte_string_view key, byte_string_view) {
+    expected.emplace(key);
+  });
+
+  auto const [cold, coldSeeks] = query();
+  auto const [warm, warmSeeks] = query();
+  EXPECT_EQ(cold, expected);
+  EXPECT_EQ(warm, expected);
+  EXPECT_LT(warmSeeks, coldSeeks);
+
+  // a write into a cached gap has to be visible to the next query
+  auto const inserted = interleave({{std::byte{4}}, {std::byte{4}}});
+  ASSERT_TRUE(PutKey(*db.rocks, inserted, value).ok());
+  expected.insert(inserted);
+  EXPECT_EQ(query().first, expected);
+}
@@ -0,0 +1,188 @@
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "hilbert-curve.h"
+#include "library.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+static auto indexKey(uint64_t index, std::size_t bytes) -> byte_string {
+  byte_string key;
+  for (std::size_t i = bytes; i > 0; --i) {
+    key.push_back(std::byte(index >> (8 * (i - 1))));
+  }
+  return key;
+}
+
+TEST(hilbertCurve, roundtrip) {
+  std::mt19937_64 gen(3);
+  for (std::size_t dims : {1, 2, 3, 5, 16}) {
+    for (std::size_t bytes : {1, 2, 8}) {
+      for (int i = 0; i < 100; ++i) {
+        std::vector<byte_string> coords;
+        for (std::size_t d = 0; d < dims; ++d) {
+          coords.push_back(indexKey(gen(), bytes));
+        }
+        auto key = hilbertEncode(coords);
+        ASSERT_EQ(key.size(), dims * bytes);
+        EXPECT_EQ(hilbertDecode(key, dims), coords);
+      }
+    }
+  }
+}
+
+TEST(hilbertCurve, consecutive_keys_are_neighbours) {
+  for (std::size_t dims : {2, 3}) {
+    auto const count = dims == 2 ? 1u << 16 : 1u << 18;
+    auto prev = hilbertDecode(indexKey(0, dims), dims);
+    for (uint64_t i = 1; i < count; ++i) {
+      auto cur = hilbertDecode(indexKey(i, dims), dims);
+      unsigned distance = 0;
+      for (std::size_t d = 0; d < dims; ++d) {
+        distance += std::abs(std::to_integer<int>(cur[d][0]) - std::to_integer<int>(prev[d][0]));
+      }
+      ASSERT_EQ(distance, 1) << "dims=" << dims << ", index=" << i;
+      prev = std::move(cur);
+    }
+  }
+}
+
+TEST(hilbertCurve, rejects_bad_coordinates) {
+  EXPECT_THROW(hilbertEncode({}), std::invalid_argument);
+  EXPECT_THROW(hilbertEncode({"00000001"_bs, "0000000100000001"_bs}), std::invalid_argument);
+  EXPECT_THROW(hilbertEncode({byte_string(9, std::byte{0})}), std::invalid_argument);
+}
+
+TEST(hilbertBox, rejects_too_many_dimensions) {
+  auto const corner = [](std::size_t dimensions, std::byte b) {
+    return interleave(std::vector<byte_string>(dimensions, byte_string{b}));
+  };
+  EXPECT_NO_THROW(HilbertBox(corner(16, std::byte{0}), corner(16, std::byte{9}), 16));
+  EXPECT_THROW(HilbertBox(corner(17, std::byte{0}), corner(17, std::byte{9}), 17), std::invalid_argument);
+}
+
+TEST(hilbertBox, next_matches_linear_search) {
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<unsigned> coord(0, 255);
+
+  for (int q = 0; q < 10; ++q) {
+    auto a = coord(gen), b = coord(gen), c = coord(gen), d = coord(gen);
+    auto const min = interleave({{std::byte(std::min(a, b))}, {std::byte(std::min(c, d))}});
+    auto const max = interleave({{std::byte(std::max(a, b))}, {std::byte(std::max(c, d))}});
+    HilbertBox const box(min, max, 2);
+
+    // for every index, the next index inside of the box, by scanning backwards
+    std::vector<std::optional<uint64_t>> expected(1u << 16);
+    std::optional<uint64_t> next;
+    for (uint64_t i = expected.size(); i > 0; --i) {
+      auto key = indexKey(i - 1, 2);
+      if (testInBox(interleave(hilbertDecode(key, 2)), min, max, 2)) {
+        next = i - 1;
+      }
+      EXPECT_EQ(box.contains(key), next == i - 1);
+      expected[i - 1] = next;
+    }
+
+    for (int k = 0; k < 200; ++k) {
+      auto const i = gen() % expected.size();
+      auto result = box.next(indexKey(i, 2));
+      if (expected[i]) {
+        ASSERT_TRUE(result.has_value());
+        EXPECT_EQ(*result, indexKey(*expected[i], 2)) << "q=" << q << ", index=" << i;
+      } else {
+        EXPECT_FALSE(result.has_value());
+      }
+    }
+    EXPECT_EQ(box.first(), expected[0] ? std::optional{indexKey(*expected[0], 2)} : std::nullopt);
+  }
+}
+
+TEST(hilbertCurve, find_all_in_box) {
+  TemporaryDB hilbert(RocksDBOptions{{}, Curve::HILBERT});
+  TemporaryDB zorder;
+  std::mt19937 gen(5);
+  std::uniform_int_distribution<unsigned> coord(0, 255);
+
+  std::set<std::pair<unsigned, unsigned>> points;
+  for (int i = 0; i < 3000; ++i) {
+    points.emplace(coord(gen), coord(gen));
+  }
+  for (auto [x, y] : points) {
+    std::vector<byte_string> coords = {{std::byte(x)}, {std::byte(y)}};
+    ASSERT_TRUE(PutKey(*hilbert.rocks, hilbertEncode(coords), {}).ok());
+    ASSERT_TRUE(PutKey(*zorder.rocks, interleave(coords), {}).ok());
+  }
+
+  std::size_t hilbertSeeks = 0, zorderSeeks = 0;
+  for (int q = 0; q < 50; ++q) {
+    auto a = coord(gen), b = coord(gen), c = coord(gen), d = coord(gen);
+    auto const box = makeBox({byte_string{std::byte(std::min(a, b))}, byte_string{std::byte(std::min(c, d))}},
+                             {byte_string{std::byte(std::max(a, b))}, byte_string{std::byte(std::max(c, d))}}, 1);
+
+    std::set<std::pair<unsigned, unsigned>> expected;
+    for (auto [x, y] : points) {
+      if (std::min(a, b) <= x && x <= std::max(a, b) && std::min(c, d) <= y && y <= std::max(c, d)) {
+        expected.emplace(x, y);
+      }
+    }
+
+    std::set<std::pair<unsigned, unsigned>> found;
+    byte_string last;
+    hilbertSeeks += findAllInBox(*hilbert.rocks, box, [&](byte_string_view key, byte_string_view) {
+      EXPECT_LT(last, key);
+      last = byte_string{key};
+      auto coords = hilbertDecode(key, 2);
+      found.emplace(std::to_integer<unsigned>(coords[0][0]), std::to_integer<unsigned>(coords[1][0]));
+    });
+    EXPECT_EQ(found, expected);
+    zorderSeeks += findAllInBox(*zorder.rocks, box, [](byte_string_view, byte_string_view) {});
+
+    std::size_t slow = 0;
+    findAllInBoxSlow(*hilbert.rocks, box, [&](byte_string_view, byte_string_view) { ++slow; });
+    EXPECT_EQ(slow, expected.size());
+  }
+  // the Hilbert curve leaves and re-enters the boxes less often
+  EXPECT_LT(hilbertSeeks, zorderSeeks);
+}
+
+TEST(hilbertCurve, summaries_require_z_order) {
+  EXPECT_THROW(TemporaryDB(RocksDBOptions{{8}, Curve::HILBERT}), std::invalid_argument);
+}
+
+TEST(hilbertCurve, curve_is_stored_with_the_database) {
+  TemporaryDB db(RocksDBOptions{{}, Curve::HILBERT});
+  db.rocks.reset();
+  EXPECT_THROW(OpenRocksDB(db.path.string()), std::invalid_argument);
+
+  RocksDBOptions stored;
+  stored.useStoredLayout = true;
+  db.rocks = OpenRocksDB(db.path.string(), stored);
+  EXPECT_EQ(db.rocks->curve, Curve::HILBERT);
+  db.rocks.reset();
+
+  // summaries don't work with the stored curve, and aren't left behind
+  stored.summaryPrefixBits = {8};
+  EXPECT_THROW(OpenRocksDB(db.path.string(), stored), std::invalid_argument);
+  EXPECT_FALSE(HasSummaries(db.path.string()));
+  db.rocks = OpenRocksDB(db.path.string(), RocksDBOptions{{}, Curve::HILBERT});
+}
+
+TEST(hilbertCurve, schedule_is_stored_with_the_database) {
+  RocksDBOptions options;
+  options.schedule = parseInterleaveSchedule("0 0 1 0 1 1");
+  TemporaryDB db(options);
+  db.rocks.reset();
+  EXPECT_THROW(OpenRocksDB(db.path.string()), std::invalid_argument);
+
+  RocksDBOptions stored;
+  stored.useStoredLayout = true;
+  db.rocks = OpenRocksDB(db.path.string(), stored);
+  ASSERT_NE(db.rocks->schedule, nullptr);
+  EXPECT_EQ(*db.rocks->schedule, *options.schedule);
+}
@@ -0,0 +1,196 @@
+#include <random>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "interleave-schedule.h"
+#include "library.h"
+#include "schedule-advisor.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+static auto keyOf(uint64_t index, std::size_t bytes) -> byte_string {
+  byte_string key;
+  for (std::size_t i = bytes; i > 0; --i) {
+    key.push_back(std::byte(index >> (8 * (i - 1))));
+  }
+  return key;
+}
+
+TEST(interleaveSchedule, parse_and_print) {
+  auto schedule = parseInterleaveSchedule("0 0 1 0 2 1");
+  EXPECT_EQ(schedule.dimensions(), 3);
+  EXPECT_EQ(schedule.bits(), 6);
+  EXPECT_EQ(schedule.budget(0), 3);
+  EXPECT_EQ(schedule.budget(1), 2);
+  EXPECT_EQ(schedule.budget(2), 1);
+  EXPECT_EQ(schedule.step(3), 2);
+  EXPECT_EQ(schedule.position(1, 1), 5);
+  EXPECT_EQ(schedule.position(2, 1), InterleaveSchedule::npos);
+
+  std::stringstream ss;
+  ss << schedule;
+  EXPECT_EQ(ss.str(), "0 0 1 0 2 1");
+  EXPECT_EQ(parseInterleaveSchedule(ss.str()), schedule);
+
+  EXPECT_THROW(parseInterleaveSchedule(""), std::invalid_argument);
+  EXPECT_THROW(parseInterleaveSchedule("0 2"), std::invalid_argument);
+  EXPECT_THROW(parseInterleaveSchedule("0 x"), std::invalid_argument);
+}
+
+TEST(interleaveSchedule, round_robin_matches_interleave) {
+  std::mt19937_64 gen(7);
+  auto const schedule = InterleaveSchedule::roundRobin(3, 16);
+  for (int i = 0; i < 200; ++i) {
+    std::vector<byte_string> point, lo, hi;
+    for (std::size_t d = 0; d < 3; ++d) {
+      point.push_back(keyOf(gen(), 2));
+      auto a = gen() & 0xffff, b = gen() & 0xffff;
+      lo.push_back(keyOf(std::min(a, b), 2));
+      hi.push_back(keyOf(std::max(a, b), 2));
+    }
+    auto const cur = interleave(point);
+    auto const min = interleave(lo);
+    auto const max = interleave(hi);
+    ASSERT_EQ(interleave(point, schedule), cur);
+    ASSERT_EQ(transpose(cur, schedule), point);
+
+    auto expected = compareWithBox(cur, min, max, 3);
+    auto actual = compareWithBox(cur, min, max, schedule);
+    for (std::size_t d = 0; d < 3; ++d) {
+      EXPECT_EQ(actual[d].flag, expected[d].flag);
+      EXPECT_EQ(actual[d].outStep, expected[d].outStep);
+    }
+    if (!testInBox(cur, min, max, 3)) {
+      EXPECT_EQ(limitingDimension(actual, schedule), limitingDimension(expected));
+      // interleave drops trailing zero bytes of truncated coordinates, the schedule keeps the key length
+      auto next = getNextZValue(cur, min, max, expected);
+      if (next) {
+        next->resize(cur.size(), std::byte{0});
+      }
+      EXPECT_EQ(getNextZValue(cur, min, max, actual, schedule), next);
+    }
+  }
+}
+
+TEST(interleaveSchedule, next_matches_linear_search) {
+  // 8 bits of the first dimension, the leading 4 bits of the second one
+  auto const schedule = parseInterleaveSchedule("0 0 0 1 0 1 0 1 1 0 0 0");
+  std::mt19937 gen(13);
+  std::uniform_int_distribution<unsigned> coord(0, 255);
+
+  for (int q = 0; q < 20; ++q) {
+    auto a = coord(gen), b = coord(gen), c = coord(gen), d = coord(gen);
+    auto const box = makeBox({byte_string{std::byte(std::min(a, b))}, byte_string{std::byte(std::min(c, d))}},
+                             {byte_string{std::byte(std::max(a, b))}, byte_string{std::byte(std::max(c, d))}}, 1,
+                             schedule);
+    ASSERT_EQ(box.min.size(), 2);
+
+    // the key of every point of the grid, the second coordinate truncated to 4 bits
+    std::vector<std::optional<byte_string>> next(1u << 12);
+    std::optional<byte_string> following;
+    for (auto i = next.size(); i > 0; --i) {
+      auto const key = keyOf((i - 1) << 4, 2);
+      auto const coords = transpose(key, schedule);
+      auto const x = std::to_integer<unsigned>(coords[0][0]);
+      auto const y = std::to_integer<unsigned>(coords[1][0]);
+      bool const inside = std::min(a, b) <= x && x <= std::max(a, b) && (std::min(c, d) & 0xf0) <= y &&
+                          y <= (std::max(c, d) & 0xf0);
+      ASSERT_EQ(testInBox(key, box.min, box.max, schedule), inside) << "q=" << q << ", key=" << key;
+      next[i - 1] = following;
+      if (inside) {
+        following = key;
+      }
+    }
+
+    for (std::size_t i = 0; i < next.size(); ++i) {
+      auto const key = keyOf(i << 4, 2);
+      auto cmp = compareWithBox(key, box.min, box.max, schedule);
+      if (testInBox(key, box.min, box.max, schedule)) {
+        continue;
+      }
+      EXPECT_EQ(getNextZValue(key, box.min, box.max, cmp, schedule), next[i]) << "q=" << q << ", key=" << key;
+    }
+  }
+}
+
+TEST(interleaveSchedule, find_all_in_box) {
+  // narrow queries in the first dimension, the leading bits of which go first
+  auto const schedule = deriveInterleaveSchedule(std::vector<double>{6.0, 0.0}, {8, 8});
+  EXPECT_EQ(schedule.order(), parseInterleaveSchedule("0 0 0 0 0 0 1 0 1 0 1 1 1 1 1 1").order());
+
+  RocksDBOptions options;
+  options.schedule = schedule;
+  TemporaryDB scheduled(options);
+  TemporaryDB roundRobin;
+  std::mt19937 gen(17);
+  std::uniform_int_distribution<unsigned> coord(0, 255);
+
+  std::set<std::pair<unsigned, unsigned>> points;
+  for (int i = 0; i < 3000; ++i) {
+    points.emplace(coord(gen), coord(gen));
+  }
+  for (auto [x, y] : points) {
+    std::vector<byte_string> coords = {{std::byte(x)}, {std::byte(y)}};
+    ASSERT_TRUE(PutKey(*scheduled.rocks, interleave(coords, schedule), {}).ok());
+    ASSERT_TRUE(PutKey(*roundRobin.rocks, interleave(coords), {}).ok());
+  }
+
+  std::size_t scheduledSeeks = 0, roundRobinSeeks = 0;
+  for (int q = 0; q < 50; ++q) {
+    auto const x = coord(gen) & 0xfc;
+    std::vector<std::optional<byte_string>> min = {byte_string{std::byte(x)}, std::nullopt};
+    std::vector<std::optional<byte_string>> max = {byte_string{std::byte(x + 3)}, std::nullopt};
+
+    std::set<std::pair<unsigned, unsigned>> expected;
+    for (auto [px, py] : points) {
+      if (x <= px && px <= x + 3) {
+        expected.emplace(px, py);
+      }
+    }
+
+    std::set<std::pair<unsigned, unsigned>> found;
+    scheduledSeeks += findAllInBox(*scheduled.rocks, makeBox(min, max, 1, schedule), [&](byte_string_view key, byte_string_view) {
+      auto coords = transpose(key, schedule);
+      found.emplace(std::to_integer<unsigned>(coords[0][0]), std::to_integer<unsigned>(coords[1][0]));
+    });
+    EXPECT_EQ(found, expected);
+    roundRobinSeeks += findAllInBox(*roundRobin.rocks, makeBox(min, max, 1), [](byte_string_view, byte_string_view) {});
+  }
+  EXPECT_LT(scheduledSeeks, roundRobinSeeks);
+}
+
+TEST(interleaveSchedule, derive_from_query_log) {
+  std::stringstream log;
+  for (unsigned x : {0x10, 0x80, 0xe0}) {
+    QueryTrace trace;
+    trace.dimensions = 2;
+    // 1/8 of the first dimension, all of the second one
+    trace.min = interleave({keyOf(x << 8, 2), keyOf(0, 2)});
+    trace.max = interleave({keyOf(((x + 0x20) << 8) - 1, 2), keyOf(0xffff, 2)});
+    writeBinary(log, trace);
+  }
+
+  auto const queries = readQueryLog(log);
+  ASSERT_EQ(queries.size(), 3);
+  auto const resolution = queryResolution(queries, 2);
+  EXPECT_NEAR(resolution[0], 3.0, 1e-6);
+  EXPECT_NEAR(resolution[1], 0.0, 1e-6);
+
+  EXPECT_EQ(deriveInterleaveSchedule(queries, {4, 4}), parseInterleaveSchedule("0 0 0 1 0 1 1 1"));
+  EXPECT_EQ(deriveInterleaveSchedule(std::vector<double>{0.0, 0.0}, {2, 2}), InterleaveSchedule::roundRobin(2, 2));
+}
+
+TEST(interleaveSchedule, requires_plain_z_order) {
+  RocksDBOptions options;
+  options.schedule = InterleaveSchedule::roundRobin(2, 8);
+  options.curve = Curve::HILBERT;
+  EXPECT_THROW(TemporaryDB{options}, std::invalid_argument);
+  options.curve = Curve::Z_ORDER;
+  options.summaryPrefixBits = {8};
+  EXPECT_THROW(TemporaryDB{options}, std::invalid_argument);
+}
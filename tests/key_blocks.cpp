@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "key-blocks.h"
+#include "library.h"
+#include "random-points.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+namespace {
+void fillPoints(RocksDBHandle& rocks, std::size_t count) {
+  fillRandomPoints(rocks, count, 31, [](std::size_t i) { return byte_string(i % 3, std::byte(i)); });
+}
+
+auto keyOf(rocksdb::Iterator const& iter) -> byte_string {
+  return byte_string(reinterpret_cast<std::byte const*>(iter.key().data()), iter.key().size());
+}
+} // namespace
+
+TEST(keyBlocks, iterates_in_both_directions) {
+  KeyBlockRun::Builder builder(KeyBlockOptions{3});
+  std::vector<byte_string> keys;
+  for (unsigned i = 0; i < 10; ++i) {
+    keys.push_back(byte_string{std::byte{0x12}, std::byte{0x34}, std::byte(i * 2)});
+    builder.add(keys.back(), byte_string(i, std::byte{7}));
+  }
+  auto run = std::move(builder).finish();
+  EXPECT_EQ(run.size(), 10);
+  EXPECT_EQ(run.blocks(), 4);
+  EXPECT_EQ(run.firstKey(1), byte_string_view{keys[3]});
+
+  auto iter = run.newIterator();
+  std::size_t i = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++i) {
+    ASSERT_EQ(keyOf(*iter), keys[i]);
+    EXPECT_EQ(iter->value().size(), i);
+  }
+  EXPECT_EQ(i, keys.size());
+  for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+    ASSERT_EQ(keyOf(*iter), keys[--i]);
+  }
+  EXPECT_EQ(i, 0);
+
+  // between keys 4 and 5, and across a block boundary between 5 and 6
+  for (auto [k, next] : {std::pair{4, 5}, std::pair{5, 6}}) {
+    auto target = keys[k];
+    target.push_back(std::byte{0});
+    iter->Seek(rocksdb::Slice(reinterpret_cast<char const*>(target.data()), target.size()));
+    ASSERT_TRUE(iter->Valid());
+    EXPECT_EQ(keyOf(*iter), keys[next]);
+    iter->SeekForPrev(rocksdb::Slice(reinterpret_cast<char const*>(target.data()), target.size()));
+    ASSERT_TRUE(iter->Valid());
+    EXPECT_EQ(keyOf(*iter), keys[k]);
+  }
+  iter->Seek("\xff");
+  EXPECT_FALSE(iter->Valid());
+  iter->SeekForPrev("\x01");
+  EXPECT_FALSE(iter->Valid());
+}
+
+TEST(keyBlocks, rejects_unsorted_keys) {
+  KeyBlockRun::Builder builder;
+  builder.add("0001"_bs, {});
+  EXPECT_THROW(builder.add("0001"_bs, {}), std::invalid_argument);
+  EXPECT_THROW(builder.add("0000"_bs, {}), std::invalid_argument);
+  EXPECT_THROW(KeyBlockRun::Builder{KeyBlockOptions{0}}, std::invalid_argument);
+}
+
+TEST(keyBlocks, shares_prefixes_of_neighbouring_keys) {
+  // four 64 bit coordinates of 20 significant bits
+  std::mt19937_64 gen(12);
+  std::uniform_int_distribution<uint64_t> coord(0, (1u << 20) - 1);
+  std::vector<byte_string> keys;
+  for (int i = 0; i < 10000; ++i) {
+    keys.push_back(interleave({to_byte_string_fixed_length(coord(gen)), to_byte_string_fixed_length(coord(gen)),
+                               to_byte_string_fixed_length(coord(gen)), to_byte_string_fixed_length(coord(gen))}));
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  KeyBlockRun::Builder builder;
+  for (auto const& key : keys) {
+    builder.add(key, {});
+  }
+  auto run = std::move(builder).finish();
+  EXPECT_EQ(run.rawSize(), keys.size() * 32);
+  EXPECT_LT(run.memoryUsage(), run.rawSize() / 2);
+}
+
+TEST(keyBlocks, box_queries_match_the_database) {
+  TemporaryDB db;
+  fillPoints(*db.rocks, 5000);
+  auto const run = buildKeyBlocks(*db.rocks);
+
+  std::mt19937 gen(8);
+  for (int q = 0; q < 30; ++q) {
+    auto const box = randomBox(gen);
+    results expected, actual;
+    auto const expectedSeeks = findAllInBox(*db.rocks, box, collect(expected));
+    QueryStats stats;
+    auto const seeks = findAllInBox(run, box, collect(actual), stats);
+    EXPECT_EQ(actual, expected) << "q=" << q;
+    EXPECT_EQ(seeks, expectedSeeks);
+    EXPECT_GT(stats.storage.blockReads, 0);
+  }
+}
+
+TEST(keyBlocks, decodes_only_candidate_blocks) {
+  TemporaryDB db;
+  fillPoints(*db.rocks, 5000);
+  auto const run = buildKeyBlocks(*db.rocks);
+
+  auto const box = makeBox({byte_string{std::byte{10}}, byte_string{std::byte{10}}, byte_string{std::byte{10}}},
+                           {byte_string{std::byte{30}}, byte_string{std::byte{30}}, byte_string{std::byte{30}}}, 1);
+  results expected, actual;
+  findAllInBox(*db.rocks, box, collect(expected));
+  QueryStats stats;
+  findAllInBox(run, box, collect(actual), stats);
+  EXPECT_EQ(actual, expected);
+  EXPECT_LT(stats.storage.blockReads, run.blocks() / 10);
+}
@@ -0,0 +1,73 @@
+#include <random>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "library.h"
+#include "prefix-summary.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+TEST(prefixSummary, summary_key) {
+  EXPECT_EQ(summaryKey("10110111'11111111"_bs, 0), "00000000'00000000"_bs);
+  EXPECT_EQ(summaryKey("10110111'11111111"_bs, 3), "00000000'00000011'10100000"_bs);
+  EXPECT_EQ(summaryKey("10110111'11111111"_bs, 8), "00000000'00001000'10110111"_bs);
+  EXPECT_EQ(summaryKey("10110111'11111111"_bs, 10), "00000000'00001010'10110111'11000000"_bs);
+}
+
+static auto countSlow(RocksDBHandle& rocks, byte_string_view min, byte_string_view max) -> std::uint64_t {
+  std::uint64_t count = 0;
+  findAllInBoxSlow(rocks, min, max, 2, [&](byte_string_view, byte_string_view) { ++count; });
+  return count;
+}
+
+TEST(prefixSummary, count_in_box) {
+  TemporaryDB db(RocksDBOptions{{8, 4, 12, 8}});
+  ASSERT_EQ(db.rocks->summaryPrefixBits, (std::vector<unsigned>{4, 8, 12}));
+
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<unsigned> distrib(0, 255);
+  std::vector<byte_string> keys;
+  for (std::size_t i = 0; i < 2000; i++) {
+    keys.push_back(interleave({{std::byte(distrib(gen))}, {std::byte(distrib(gen))}}));
+    ASSERT_TRUE(PutKey(*db.rocks, keys.back(), "1"_bs).ok());
+  }
+  // neither overwriting nor deleting twice may skew the counts
+  for (std::size_t i = 0; i < 500; i++) {
+    ASSERT_TRUE(PutKey(*db.rocks, keys[i], "10"_bs).ok());
+    ASSERT_TRUE(DeleteKey(*db.rocks, keys[i + 500]).ok());
+    ASSERT_TRUE(DeleteKey(*db.rocks, keys[i + 500]).ok());
+  }
+
+  auto check = [&] {
+    for (std::size_t i = 0; i < 50; i++) {
+      auto a = distrib(gen), b = distrib(gen), c = distrib(gen), d = distrib(gen);
+      auto const min = interleave({{std::byte(std::min(a, b))}, {std::byte(std::min(c, d))}});
+      auto const max = interleave({{std::byte(std::max(a, b))}, {std::byte(std::max(c, d))}});
+      auto const result = countInBox(*db.rocks, min, max, 2);
+      EXPECT_EQ(result.count, countSlow(*db.rocks, min, max)) << result;
+    }
+  };
+  check();
+  rebuildSummaries(*db.rocks);
+  check();
+
+  // a large box is mostly answered from the summaries
+  auto const min = interleave({{3_b}, {3_b}});
+  auto const max = interleave({{250_b}, {250_b}});
+  auto const result = countInBox(*db.rocks, min, max, 2);
+  EXPECT_EQ(result.count, countSlow(*db.rocks, min, max));
+  EXPECT_LT(result.keysScanned, result.count / 4) << result;
+}
+
+TEST(prefixSummary, count_without_summaries) {
+  TemporaryDB db;
+  for (uint8_t x = 0; x < 16; x++) {
+    ASSERT_TRUE(PutKey(*db.rocks, interleave({{std::byte{x}}, {std::byte{x}}}), "1"_bs).ok());
+  }
+  auto const result = countInBox(*db.rocks, interleave({{2_b}, {0_b}}), interleave({{9_b}, {9_b}}), 2);
+  EXPECT_EQ(result.count, 8);
+  EXPECT_EQ(result.summaryCells, 0);
+}
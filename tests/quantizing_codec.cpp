@@ -0,0 +1,174 @@
+#include <cmath>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "library.h"
+#include "quantizing-codec.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+TEST(quantizingCodec, key_size) {
+  QuantizingCodec codec({{-100.0, 100.0, 20}, {-100.0, 100.0, 20}, {0.0, 1.0, 20}, {0.0, 1.0, 20}});
+  EXPECT_EQ(codec.keySize(), 10);
+  EXPECT_EQ(codec.encodeKey({1.0, -2.0, 0.5, 0.25}).size(), 10);
+
+  QuantizingCodec odd({{0.0, 1.0, 3}, {0.0, 1.0, 10}});
+  EXPECT_EQ(odd.schedule(), parseInterleaveSchedule("0 1 0 1 0 1 1 1 1 1 1 1 1"));
+  EXPECT_EQ(odd.keySize(), 2);
+}
+
+TEST(quantizingCodec, quantize_is_monotonic_and_clamped) {
+  QuantizingCodec codec({{-1.0, 1.0, 8}});
+  EXPECT_EQ(codec.quantize(0, -1.0), 0);
+  EXPECT_EQ(codec.quantize(0, -5.0), 0);
+  EXPECT_EQ(codec.quantize(0, 0.0), 128);
+  EXPECT_EQ(codec.quantize(0, 1.0), 255);
+  EXPECT_EQ(codec.quantize(0, 7.0), 255);
+  EXPECT_THROW(codec.quantize(0, std::nan("")), std::invalid_argument);
+
+  std::mt19937_64 gen(3);
+  std::uniform_real_distribution<double> value(-1.2, 1.2);
+  for (int i = 0; i < 1000; ++i) {
+    auto a = value(gen), b = value(gen);
+    if (a > b) {
+      std::swap(a, b);
+    }
+    EXPECT_LE(codec.quantize(0, a), codec.quantize(0, b));
+  }
+
+  EXPECT_THROW(QuantizingCodec({{0.0, 1.0, 0}}), std::invalid_argument);
+  EXPECT_THROW(QuantizingCodec({{1.0, 1.0, 8}}), std::invalid_argument);
+}
+
+TEST(quantizingCodec, roundtrip) {
+  QuantizingCodec codec({{-100.0, 100.0, 20}, {0.0, 1e6, 12}, {-1.0, 1.0, 64}});
+  std::mt19937_64 gen(5);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  for (int i = 0; i < 1000; ++i) {
+    std::vector<double> point = {-100.0 + 200.0 * unit(gen), 1e6 * unit(gen), -1.0 + 2.0 * unit(gen)};
+    auto const key = codec.encodeKey(point);
+    auto const decoded = codec.decodeKey(key);
+    for (std::size_t dim = 0; dim < point.size(); ++dim) {
+      auto const& d = codec.dimension(dim);
+      EXPECT_NEAR(decoded[dim], point[dim], (d.max - d.min) / std::ldexp(1.0, int(d.bits)));
+    }
+
+    byte_string const payload{std::byte(i), std::byte(i >> 8)};
+    auto const value = codec.encodeValue(point, payload);
+    auto const fine = codec.decodeValue(key, value);
+    for (std::size_t dim = 0; dim < point.size(); ++dim) {
+      auto const& d = codec.dimension(dim);
+      EXPECT_NEAR(fine[dim], point[dim], (d.max - d.min) / std::ldexp(1.0, int(d.bits + d.residualBits)));
+    }
+    EXPECT_EQ(codec.payload(value), byte_string_view{payload});
+  }
+}
+
+TEST(quantizingCodec, residuals_are_compact) {
+  QuantizingCodec codec({{-100.0, 100.0, 20}, {-100.0, 100.0, 20}, {0.0, 1.0, 20}, {0.0, 1.0, 20}});
+  EXPECT_EQ(codec.residualSize(), 6);
+  EXPECT_EQ(codec.encodeValue({1.0, -2.0, 0.5, 0.25}, {}).size(), 6);
+
+  // no more than 64 bits per fine cell
+  QuantizingCodec wide({{0.0, 1.0, 60, 12}, {0.0, 1.0, 64}});
+  EXPECT_EQ(wide.dimension(0).residualBits, 4);
+  EXPECT_EQ(wide.dimension(1).residualBits, 0);
+  EXPECT_EQ(wide.residualSize(), 1);
+}
+
+TEST(quantizingCodec, exact_dimensions_keep_the_values) {
+  QuantizingCodec codec({{0.0, 1.0, 6, 20, true}, {0.0, 1.0, 6, 20}});
+  EXPECT_EQ(codec.dimension(0).residualBits, 0);
+  EXPECT_EQ(codec.residualSize(), 11);
+
+  std::vector<double> const point = {1.0 / 3.0, 0.5};
+  auto const key = codec.encodeKey(point);
+  auto const value = codec.encodeValue(point, "1"_bs);
+  EXPECT_EQ(codec.decodeValue(key, value)[0], point[0]);
+  EXPECT_EQ(codec.fineCells(key, value)[0], codec.quantize(0, point[0]));
+  EXPECT_EQ(codec.payload(value), byte_string_view{"1"_bs});
+
+  // -0.0 is not below 0.0
+  auto const zero = std::vector<double>{-0.0, 0.5};
+  EXPECT_TRUE(codec.makeBox({0.0, std::nullopt}, {1.0, std::nullopt})
+                .matches(codec.encodeKey(zero), codec.encodeValue(zero, {})));
+}
+
+namespace {
+/*
+ * Box queries over points drawn from [low, high) in every dimension, compared
+ * with a scan of the points. Points within `tolerance` of a bound, but outside
+ * of the box, may be returned.
+ */
+void checkBoxQueries(QuantizingCodec const& codec, double low, double high, double tolerance) {
+  RocksDBOptions options;
+  options.schedule = codec.schedule();
+  TemporaryDB db(options);
+
+  std::mt19937_64 gen(9);
+  std::uniform_real_distribution<double> coordinate(low, high), bound(-0.1, 1.1);
+  std::vector<std::vector<double>> points;
+  for (std::size_t i = 0; i < 5000; ++i) {
+    points.push_back({coordinate(gen), coordinate(gen), coordinate(gen)});
+    auto key = codec.encodeKey(points.back());
+    // make the key unique, points may share cells
+    key += to_byte_string_fixed_length<uint64_t>(i);
+    ASSERT_TRUE(PutKey(*db.rocks, key, codec.encodeValue(points.back(), to_byte_string_fixed_length<uint64_t>(i))).ok());
+  }
+
+  for (int q = 0; q < 30; ++q) {
+    std::vector<std::optional<double>> min, max;
+    for (std::size_t dim = 0; dim < 3; ++dim) {
+      auto a = bound(gen), b = bound(gen);
+      min.emplace_back(std::min(a, b));
+      max.emplace_back(std::max(a, b));
+    }
+    if (q % 5 == 0) {
+      min[q % 3] = std::nullopt;
+    }
+
+    std::set<std::uint64_t> expected, border;
+    for (std::size_t i = 0; i < points.size(); ++i) {
+      bool inside = true, near = true;
+      for (std::size_t dim = 0; dim < 3; ++dim) {
+        auto const v = points[i][dim];
+        inside = inside && (!min[dim] || *min[dim] <= v) && (!max[dim] || v <= *max[dim]);
+        near = near && (!min[dim] || *min[dim] - tolerance <= v) && (!max[dim] || v <= *max[dim] + tolerance);
+      }
+      if (inside) {
+        expected.insert(i);
+      } else if (near && tolerance > 0) {
+        border.insert(i);
+      }
+    }
+
+    std::set<std::uint64_t> found;
+    QueryStats stats;
+    findAllInBox(*db.rocks, codec.makeBox(min, max), [&](byte_string_view, byte_string_view value) {
+      found.insert(from_byte_string_fixed_length<uint64_t>(codec.payload(value)));
+    }, stats);
+    for (auto i : border) {
+      found.erase(i);
+    }
+    EXPECT_EQ(found, expected) << "q=" << q;
+    EXPECT_GE(stats.keysReturned, found.size());
+  }
+}
+} // namespace
+
+TEST(quantizingCodec, find_all_in_box_is_exact) {
+  // 6 bits per dimension, so most query borders cut through cells; points and bounds may be outside of the range
+  QuantizingCodec codec({{0.0, 1.0, 6, 0, true}, {0.0, 1.0, 6, 0, true}, {0.0, 1.0, 6, 0, true}});
+  checkBoxQueries(codec, -0.1, 1.1, 0.0);
+}
+
+TEST(quantizingCodec, find_all_in_box_is_approximate) {
+  // points outside of the range would share the outermost fine cells, so they are drawn from it
+  QuantizingCodec codec({{0.0, 1.0, 6, 20}, {0.0, 1.0, 6, 20}, {0.0, 1.0, 6, 20}});
+  checkBoxQueries(codec, 0.0, 1.0, std::ldexp(1.2, -26));
+}
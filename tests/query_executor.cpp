@@ -0,0 +1,91 @@
+#include <atomic>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "library.h"
+#include "query-executor.h"
+#include "random-points.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+namespace {
+void fillPoints(RocksDBHandle& rocks, std::size_t count) {
+  fillRandomPoints(rocks, count, 23, [](std::size_t i) { return to_byte_string_fixed_length<uint64_t>(i); });
+}
+
+auto serial(RocksDBHandle& rocks, Box const& box) -> std::vector<byte_string> {
+  std::vector<byte_string> keys;
+  findAllInBox(rocks, box, [&](byte_string_view key, byte_string_view) { keys.emplace_back(key); });
+  return keys;
+}
+} // namespace
+
+TEST(queryExecutor, concurrent_queries) {
+  TemporaryDB db;
+  fillPoints(*db.rocks, 5000);
+
+  QueryExecutor executor(2);
+  std::mt19937 gen(1);
+  std::vector<Box> boxes;
+  std::vector<std::vector<byte_string>> results(16);
+  std::vector<std::future<std::size_t>> futures;
+  for (std::size_t q = 0; q < results.size(); ++q) {
+    boxes.push_back(randomBox(gen));
+    futures.push_back(executor.findAllInBox(db.rocks, boxes.back(), [&results, q](byte_string_view key, byte_string_view) {
+      results[q].emplace_back(key);
+    }));
+  }
+  for (std::size_t q = 0; q < results.size(); ++q) {
+    futures[q].get();
+    EXPECT_EQ(results[q], serial(*db.rocks, boxes[q])) << "q=" << q;
+  }
+}
+
+TEST(queryExecutor, pipelined_matches_serial) {
+  RocksDBOptions options;
+  options.readaheadSize = 1 << 20;
+  options.asyncIo = true;
+  TemporaryDB db(options);
+  fillPoints(*db.rocks, 5000);
+
+  QueryExecutor executor(1);
+  std::mt19937 gen(2);
+  for (int q = 0; q < 20; ++q) {
+    auto const box = randomBox(gen);
+    std::vector<byte_string> keys;
+    std::size_t values = 0;
+    QueryStats stats;
+    auto seeks = executor.findAllInBoxPipelined(*db.rocks, box, [&](byte_string_view key, byte_string_view value) {
+      keys.emplace_back(key);
+      values += value.size() == sizeof(uint64_t);
+    }, stats, PipelineOptions{7, 2});
+    EXPECT_EQ(keys, serial(*db.rocks, box));
+    EXPECT_EQ(values, keys.size());
+    EXPECT_EQ(stats.seeks, seeks);
+    EXPECT_EQ(stats.keysReturned, keys.size());
+  }
+}
+
+TEST(queryExecutor, pipeline_stops_when_the_consumer_throws) {
+  TemporaryDB db;
+  fillPoints(*db.rocks, 5000);
+  auto const everything = makeBox({std::nullopt, std::nullopt, std::nullopt}, {std::nullopt, std::nullopt, std::nullopt}, 1);
+
+  QueryExecutor executor(1);
+  std::size_t seen = 0;
+  EXPECT_THROW(executor.findAllInBoxPipelined(*db.rocks, everything, [&](byte_string_view, byte_string_view) {
+    if (++seen == 10) {
+      throw std::runtime_error("enough");
+    }
+  }, PipelineOptions{4, 1}), std::runtime_error);
+  EXPECT_EQ(seen, 10);
+
+  // the pool is free again
+  EXPECT_EQ(executor.submit([] { return 42; }).get(), 42);
+}
@@ -0,0 +1,110 @@
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "dimension-histograms.h"
+#include "library.h"
+#include "query-planner.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+static auto inIntervals(std::vector<ZInterval> const& intervals, byte_string_view key) -> bool {
+  return std::any_of(intervals.begin(), intervals.end(), [&](auto const& it) {
+    return !(key < it.lo) && !(it.hi < key);
+  });
+}
+
+TEST(coverBox, covers_box) {
+  auto const min = interleave({{3_b}, {17_b}});
+  auto const max = interleave({{200_b}, {99_b}});
+
+  for (std::size_t maxIntervals : {1, 4, 16, 64, 100000}) {
+    auto const cover = coverBox(min, max, 2, 16, maxIntervals);
+    EXPECT_LE(cover.intervals.size(), std::max<std::size_t>(maxIntervals, 2));
+    for (std::size_t i = 1; i < cover.intervals.size(); ++i) {
+      EXPECT_LT(cover.intervals[i - 1].hi, cover.intervals[i].lo);
+    }
+
+    for (unsigned x = 0; x < 256; x += 3) {
+      for (unsigned y = 0; y < 256; y += 5) {
+        auto const key = interleave({{std::byte(x)}, {std::byte(y)}});
+        auto const inBox = testInBox(key, min, max, 2);
+        if (inBox) {
+          EXPECT_TRUE(inIntervals(cover.intervals, key)) << "x=" << x << ", y=" << y;
+        } else if (cover.exact) {
+          EXPECT_FALSE(inIntervals(cover.intervals, key)) << "x=" << x << ", y=" << y;
+        }
+      }
+    }
+  }
+
+  EXPECT_TRUE(coverBox(min, max, 2, 16, 100000).exact);
+}
+
+TEST(dimensionHistograms, selectivity) {
+  DimensionHistograms histograms(2, 4);
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<unsigned> distrib(0, 255);
+  for (std::size_t i = 0; i < 10000; i++) {
+    histograms.add(interleave({{std::byte(distrib(gen))}, {std::byte(distrib(gen) / 4)}}));
+  }
+  EXPECT_EQ(histograms.total(), 10000);
+
+  // x is uniform in [0, 255], y in [0, 63]
+  auto const s = histograms.selectivity(interleave({{0_b}, {0_b}}), interleave({{127_b}, {31_b}}));
+  EXPECT_NEAR(s, 0.25, 0.03);
+  EXPECT_EQ(histograms.selectivity(interleave({{0_b}, {64_b}}), interleave({{255_b}, {255_b}})), 0.0);
+
+  EXPECT_THROW(DimensionHistograms(2, 64), std::invalid_argument);
+  EXPECT_THROW(DimensionHistograms(0, 4), std::invalid_argument);
+}
+
+TEST(queryPlanner, chooses_and_executes) {
+  TemporaryDB db;
+  db.rocks->histograms = std::make_shared<DimensionHistograms>(2, 8);
+
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<unsigned> distrib(0, 255);
+  for (std::size_t i = 0; i < 4000; i++) {
+    auto key = interleave({{std::byte(distrib(gen))}, {std::byte(distrib(gen))}});
+    ASSERT_TRUE(PutKey(*db.rocks, key, "1"_bs).ok());
+  }
+
+  auto run = [&](byte_string_view min, byte_string_view max) {
+    auto const plan = planBoxQuery(*db.rocks, min, max, 2);
+    std::set<byte_string> result, expected;
+    executeBoxQuery(*db.rocks, plan, min, max, 2, [&](byte_string_view key, byte_string_view) {
+      result.emplace(key);
+    });
+    findAllInBoxSlow(*db.rocks, min, max, 2, [&](byte_string_view key, byte_string_view) {
+      expected.emplace(key);
+    });
+    EXPECT_EQ(result, expected) << plan;
+    return plan;
+  };
+
+  auto const small = run(interleave({{10_b}, {10_b}}), interleave({{20_b}, {20_b}}));
+  EXPECT_NE(small.strategy, BoxQueryStrategy::LINEAR_SCAN) << small;
+
+  auto const everything = run(interleave({{0_b}, {0_b}}), interleave({{255_b}, {255_b}}));
+  EXPECT_NEAR(everything.estimatedResults, 4000, 200) << everything;
+
+  auto const almostEverything = run(interleave({{1_b}, {1_b}}), interleave({{254_b}, {254_b}}));
+  EXPECT_NE(almostEverything.strategy, BoxQueryStrategy::Z_SEEK_SCAN) << almostEverything;
+
+  for (auto strategy : {BoxQueryStrategy::Z_SEEK_SCAN, BoxQueryStrategy::INTERVAL_SCAN, BoxQueryStrategy::LINEAR_SCAN}) {
+    auto const min = interleave({{40_b}, {7_b}});
+    auto const max = interleave({{90_b}, {130_b}});
+    auto plan = planBoxQuery(*db.rocks, min, max, 2);
+    plan.strategy = strategy;
+    std::size_t count = 0, expected = 0;
+    executeBoxQuery(*db.rocks, plan, min, max, 2, [&](byte_string_view, byte_string_view) { ++count; });
+    findAllInBoxSlow(*db.rocks, min, max, 2, [&](byte_string_view, byte_string_view) { ++expected; });
+    EXPECT_EQ(count, expected) << strategy;
+  }
+}
@@ -0,0 +1,99 @@
+#include <sstream>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "library.h"
+#include "query-stats.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+static void fillGrid(RocksDBHandle& rocks) {
+  for (unsigned x = 0; x < 16; ++x) {
+    for (unsigned y = 0; y < 16; ++y) {
+      ASSERT_TRUE(PutKey(rocks, interleave({{std::byte(x)}, {std::byte(y)}}), {}).ok());
+    }
+  }
+}
+
+TEST(queryStats, counts_box_query_work) {
+  TemporaryDB tmp;
+  fillGrid(*tmp.rocks);
+
+  auto const min = interleave({{3_b}, {5_b}});
+  auto const max = interleave({{9_b}, {6_b}});
+  QueryStats stats;
+  std::size_t found = 0;
+  auto seeks = findAllInBox(*tmp.rocks, min, max, 2, [&](byte_string_view, byte_string_view) { ++found; }, stats);
+
+  EXPECT_EQ(found, 7 * 2);
+  EXPECT_EQ(stats.queries, 1);
+  EXPECT_EQ(stats.seeks, seeks);
+  EXPECT_EQ(stats.keysReturned, found);
+  EXPECT_GE(stats.keysExamined, stats.keysReturned);
+  // every key is either reached by a seek or by a Next
+  EXPECT_LE(stats.keysExamined, stats.seeks + stats.nexts);
+
+  // stats accumulate over queries
+  findAllInBox(*tmp.rocks, min, max, 2, [](byte_string_view, byte_string_view) {}, stats);
+  EXPECT_EQ(stats.keysReturned, 2 * found);
+  EXPECT_EQ(stats.queries, 2);
+  // nothing is profiled without a sampler
+  EXPECT_EQ(stats.profiledQueries, 0);
+  EXPECT_EQ(stats.phases.seek.count(), 0);
+}
+
+TEST(queryStats, sampler_profiles_every_nth_query) {
+  TemporaryDB tmp;
+  fillGrid(*tmp.rocks);
+  tmp.rocks->queryStats = std::make_shared<QueryStatsSampler>(3);
+
+  auto const min = interleave({{3_b}, {5_b}});
+  auto const max = interleave({{9_b}, {6_b}});
+  QueryStats stats;
+  for (int i = 0; i < 7; ++i) {
+    findAllInBox(*tmp.rocks, min, max, 2, [](byte_string_view, byte_string_view) {}, stats);
+  }
+  // queries without QueryStats are recorded, too
+  findAllInBox(*tmp.rocks, min, max, 2, [](byte_string_view, byte_string_view) {});
+
+  EXPECT_EQ(stats.queries, 7);
+  EXPECT_EQ(stats.profiledQueries, 3); // queries 0, 3 and 6
+  EXPECT_GT(stats.phases.seek.count(), 0);
+  EXPECT_GT(stats.phases.compare.count(), 0);
+
+  auto totals = tmp.rocks->queryStats->totals();
+  EXPECT_EQ(totals.queries, 8);
+  EXPECT_EQ(totals.keysReturned, 8 * 14);
+  EXPECT_EQ(totals.profiledQueries, 3);
+
+  tmp.rocks->queryStats->reset();
+  EXPECT_EQ(tmp.rocks->queryStats->totals().queries, 0);
+}
+
+TEST(queryStats, sampler_interval_zero_never_profiles) {
+  QueryStatsSampler sampler(0);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_FALSE(sampler.sample());
+  }
+  QueryStatsSampler always(1);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(always.sample());
+  }
+}
+
+TEST(queryStats, print) {
+  QueryStats stats;
+  stats.queries = 2;
+  stats.keysExamined = 5;
+  stats.keysReturned = 3;
+  EXPECT_EQ(stats.falsePositives(), 2);
+
+  std::stringstream ss;
+  ss << stats;
+  EXPECT_EQ(ss.str(), "QueryStats{queries=2, seeks=0, nexts=0, keysExamined=5, keysReturned=3}");
+}
+
+
@@ -0,0 +1,98 @@
+#include <sstream>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "library.h"
+#include "query-trace.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+static auto traceGrid(RocksDBHandle& rocks) -> QueryTrace {
+  for (unsigned x = 0; x < 16; ++x) {
+    for (unsigned y = 0; y < 16; ++y) {
+      EXPECT_TRUE(PutKey(rocks, interleave({{std::byte(x)}, {std::byte(y)}}), {}).ok());
+    }
+  }
+  auto const min = interleave({{3_b}, {5_b}});
+  auto const max = interleave({{9_b}, {6_b}});
+  return traceBoxQuery(rocks, min, max, 2, [](byte_string_view, byte_string_view) {});
+}
+
+TEST(queryTrace, records_seeks) {
+  TemporaryDB tmp;
+  auto const trace = traceGrid(*tmp.rocks);
+
+  EXPECT_EQ(trace.dimensions, 2);
+  EXPECT_EQ(trace.stats.keysReturned, 7 * 2);
+  ASSERT_EQ(trace.steps.size(), trace.stats.seeks);
+  ASSERT_FALSE(trace.steps.empty());
+
+  EXPECT_EQ(trace.steps.front().target, trace.min);
+  EXPECT_FALSE(trace.steps.front().limitingDimension.has_value());
+
+  std::size_t run = 0;
+  for (std::size_t i = 0; i < trace.steps.size(); ++i) {
+    auto const& step = trace.steps[i];
+    run += step.run;
+    if (step.landed) {
+      EXPECT_LE(step.target, *step.landed);
+      EXPECT_EQ(step.run > 0, testInBox(*step.landed, trace.min, trace.max, 2));
+    }
+    if (i > 0) {
+      ASSERT_TRUE(step.limitingDimension.has_value());
+      EXPECT_LT(*step.limitingDimension, 2);
+      EXPECT_LT(trace.steps[i - 1].target, step.target);
+    }
+  }
+  EXPECT_EQ(run, trace.stats.keysReturned);
+}
+
+TEST(queryTrace, binary_roundtrip) {
+  TemporaryDB tmp;
+  auto const trace = traceGrid(*tmp.rocks);
+
+  std::stringstream ss;
+  writeBinary(ss, trace);
+  writeBinary(ss, trace);
+
+  for (int i = 0; i < 2; ++i) {
+    auto read = readBinary(ss);
+    ASSERT_TRUE(read.has_value());
+    EXPECT_EQ(read->min, trace.min);
+    EXPECT_EQ(read->max, trace.max);
+    EXPECT_EQ(read->dimensions, trace.dimensions);
+    EXPECT_EQ(read->stats.seeks, trace.stats.seeks);
+    EXPECT_EQ(read->stats.keysReturned, trace.stats.keysReturned);
+    ASSERT_EQ(read->steps.size(), trace.steps.size());
+    for (std::size_t s = 0; s < trace.steps.size(); ++s) {
+      EXPECT_EQ(read->steps[s].target, trace.steps[s].target);
+      EXPECT_EQ(read->steps[s].landed, trace.steps[s].landed);
+      EXPECT_EQ(read->steps[s].run, trace.steps[s].run);
+      EXPECT_EQ(read->steps[s].limitingDimension, trace.steps[s].limitingDimension);
+      EXPECT_EQ(read->steps[s].cacheSkips, trace.steps[s].cacheSkips);
+    }
+  }
+  EXPECT_FALSE(readBinary(ss).has_value());
+
+  std::stringstream garbage("not a trace");
+  EXPECT_THROW(readBinary(garbage), std::invalid_argument);
+}
+
+TEST(queryTrace, json) {
+  QueryTrace trace;
+  trace.min = "00000001"_bs;
+  trace.max = "11111111"_bs;
+  trace.dimensions = 1;
+  trace.steps.push_back(TraceStep{trace.min, "00001010"_bs, 3, std::nullopt, 0});
+  trace.steps.push_back(TraceStep{"00100000"_bs, std::nullopt, 0, 0, 1});
+
+  std::stringstream ss;
+  writeJson(ss, trace);
+  EXPECT_EQ(ss.str(),
+            "{\"dimensions\":1,\"min\":\"01\",\"max\":\"ff\",\"seeks\":0,\"nexts\":0,\"keysExamined\":0,"
+            "\"keysReturned\":0,\"steps\":[{\"target\":\"01\",\"landed\":\"0a\",\"run\":3,\"limitingDimension\":null,"
+            "\"cacheSkips\":0},{\"target\":\"20\",\"landed\":null,\"run\":0,\"limitingDimension\":0,\"cacheSkips\":1}]}\n");
+}
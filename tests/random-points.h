@@ -0,0 +1,45 @@
+#ifndef ZKD_TREE_RANDOM_POINTS_H
+#define ZKD_TREE_RANDOM_POINTS_H
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "library.h"
+#include "rocksdb-handle.h"
+
+// Random three dimensional points of one byte per coordinate, with the value of the i-th point.
+inline void fillRandomPoints(RocksDBHandle& rocks, std::size_t count, unsigned seed,
+                             std::function<zkd::byte_string(std::size_t)> const& value) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<unsigned> coord(0, 255);
+  for (std::size_t i = 0; i < count; ++i) {
+    auto key = zkd::interleave({{std::byte(coord(gen))}, {std::byte(coord(gen))}, {std::byte(coord(gen))}});
+    ASSERT_TRUE(PutKey(rocks, key, value(i)).ok());
+  }
+}
+
+// A random box over the points of fillRandomPoints.
+inline auto randomBox(std::mt19937& gen) -> zkd::Box {
+  std::uniform_int_distribution<unsigned> coord(0, 255);
+  std::vector<std::optional<zkd::byte_string>> min, max;
+  for (int d = 0; d < 3; ++d) {
+    auto a = coord(gen), b = coord(gen);
+    min.emplace_back(zkd::byte_string{std::byte(std::min(a, b))});
+    max.emplace_back(zkd::byte_string{std::byte(std::max(a, b))});
+  }
+  return zkd::makeBox(min, max, 1);
+}
+
+using results = std::vector<std::pair<zkd::byte_string, zkd::byte_string>>;
+
+inline auto collect(results& out) -> zkd::BoxQueryCallback {
+  return [&out](zkd::byte_string_view key, zkd::byte_string_view value) { out.emplace_back(key, value); };
+}
+
+#endif //ZKD_TREE_RANDOM_POINTS_H
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "library.h"
+#include "rectangle-index.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+namespace {
+struct rectangle {
+  unsigned x0, y0, x1, y1;
+
+  auto min() const -> std::vector<byte_string> { return {{std::byte(x0)}, {std::byte(y0)}}; }
+  auto max() const -> std::vector<byte_string> { return {{std::byte(x1)}, {std::byte(y1)}}; }
+};
+
+auto randomRectangle(std::mt19937& gen, unsigned maxSize) -> rectangle {
+  std::uniform_int_distribution<unsigned> coord(0, 255 - maxSize);
+  std::uniform_int_distribution<unsigned> size(0, maxSize);
+  auto const x = coord(gen), y = coord(gen);
+  return {x, y, x + size(gen), y + size(gen)};
+}
+
+auto related(RectangleRelation relation, rectangle const& r, rectangle const& q) -> bool {
+  switch (relation) {
+    case RectangleRelation::INTERSECTS:
+      return r.x0 <= q.x1 && q.x0 <= r.x1 && r.y0 <= q.y1 && q.y0 <= r.y1;
+    case RectangleRelation::WITHIN:
+      return q.x0 <= r.x0 && r.x1 <= q.x1 && q.y0 <= r.y0 && r.y1 <= q.y1;
+    case RectangleRelation::CONTAINS:
+      return r.x0 <= q.x0 && q.x1 <= r.x1 && r.y0 <= q.y0 && q.y1 <= r.y1;
+  }
+  return false;
+}
+} // namespace
+
+TEST(rectangleIndex, encode_and_decode) {
+  rectangle const r{3, 200, 17, 201};
+  auto const key = encodeRectangle(r.min(), r.max());
+  EXPECT_EQ(key, interleave({{3_b}, {200_b}, {17_b}, {201_b}}));
+  auto const [min, max] = decodeRectangle(key, 2);
+  EXPECT_EQ(min, r.min());
+  EXPECT_EQ(max, r.max());
+
+  EXPECT_THROW(encodeRectangle(r.max(), r.min()), std::invalid_argument);
+  EXPECT_THROW(encodeRectangle({{1_b}}, r.max()), std::invalid_argument);
+  EXPECT_THROW(encodeRectangle({{1_b}, {1_b, 1_b}}, {{2_b}, {2_b, 2_b}}), std::invalid_argument);
+}
+
+TEST(rectangleIndex, queries_match_a_scan) {
+  std::mt19937 gen(47);
+  TemporaryDB db;
+  std::vector<rectangle> rectangles;
+  for (int i = 0; i < 2000; ++i) {
+    auto const r = randomRectangle(gen, 40);
+    rectangles.push_back(r);
+    ASSERT_TRUE(PutKey(*db.rocks, encodeRectangle(r.min(), r.max()), {}).ok());
+  }
+
+  for (auto relation : {RectangleRelation::INTERSECTS, RectangleRelation::WITHIN, RectangleRelation::CONTAINS}) {
+    for (int q = 0; q < 20; ++q) {
+      // points for CONTAINS, i.e. stabbing queries, larger rectangles otherwise
+      auto const query = randomRectangle(gen, relation == RectangleRelation::CONTAINS ? 0 : 80);
+      std::vector<byte_string> expected, found;
+      for (auto const& r : rectangles) {
+        if (related(relation, r, query)) {
+          expected.push_back(encodeRectangle(r.min(), r.max()));
+        }
+      }
+      std::sort(expected.begin(), expected.end());
+      expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+
+      auto const box = makeRectangleQuery(relation, query.min(), query.max(), 1);
+      ASSERT_EQ(box.dimensions(), 4);
+      findAllInBox(*db.rocks, box, [&](byte_string_view key, byte_string_view) { found.emplace_back(key); });
+      EXPECT_EQ(found, expected) << int(relation) << " " << q;
+    }
+  }
+}
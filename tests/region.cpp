@@ -0,0 +1,139 @@
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "library.h"
+#include "quantizing-codec.h"
+#include "region.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+namespace {
+struct grid {
+  TemporaryDB db;
+
+  explicit grid(std::size_t count) {
+    std::mt19937 gen(53);
+    std::uniform_int_distribution<unsigned> coord(0, 255);
+    for (std::size_t i = 0; i < count; ++i) {
+      unsigned const x = coord(gen), y = coord(gen);
+      EXPECT_TRUE(PutKey(*db.rocks, interleave({{std::byte(x)}, {std::byte(y)}}), {}).ok());
+    }
+  }
+
+  auto all(Region const& region) -> std::vector<byte_string> {
+    std::vector<byte_string> keys;
+    findAllInBoxSlow(*db.rocks, makeBox({std::nullopt, std::nullopt}, {std::nullopt, std::nullopt}, 1),
+                     [&](byte_string_view key, byte_string_view) {
+                       if (region.contains(regionCoordinates(key, 2, nullptr))) {
+                         keys.emplace_back(key);
+                       }
+                     });
+    return keys;
+  }
+};
+
+auto collect(std::vector<byte_string>& out) -> BoxQueryCallback {
+  return [&out](byte_string_view key, byte_string_view) { out.emplace_back(key); };
+}
+} // namespace
+
+TEST(region, ball) {
+  Ball const ball({10, 10}, 5);
+  EXPECT_TRUE(ball.contains({13, 14}));
+  EXPECT_FALSE(ball.contains({14, 14}));
+  EXPECT_EQ(ball.relate({9, 9}, {11, 11}), CellRelation::CONTAINED);
+  EXPECT_EQ(ball.relate({0, 0}, {20, 20}), CellRelation::PARTIAL);
+  EXPECT_EQ(ball.relate({14, 14}, {20, 20}), CellRelation::DISJOINT);
+  EXPECT_THROW(Ball({1}, -1), std::invalid_argument);
+}
+
+TEST(region, polygon) {
+  // a triangle with a concave notch on its right
+  Polygon const polygon({{0, 0}, {10, 0}, {5, 5}, {10, 10}, {0, 10}});
+  EXPECT_TRUE(polygon.contains({2, 2}));
+  EXPECT_TRUE(polygon.contains({0, 5}));  // on the border
+  EXPECT_TRUE(polygon.contains({10, 0})); // a vertex
+  EXPECT_FALSE(polygon.contains({8, 5}));
+  EXPECT_EQ(polygon.relate({1, 1}, {3, 8}), CellRelation::CONTAINED);
+  EXPECT_EQ(polygon.relate({7, 4}, {9, 6}), CellRelation::DISJOINT);
+  EXPECT_EQ(polygon.relate({4, 4}, {6, 6}), CellRelation::PARTIAL);
+  // surrounds the whole polygon
+  EXPECT_EQ(polygon.relate({-1, -1}, {11, 11}), CellRelation::PARTIAL);
+  EXPECT_THROW(Polygon({{0, 0}, {1, 1}}), std::invalid_argument);
+}
+
+TEST(region, cover_is_exact_inside) {
+  Ball const ball({100, 100}, 40);
+  auto const intervals = coverRegion(ball, 2, nullptr, 64);
+  ASSERT_FALSE(intervals.empty());
+  EXPECT_LE(intervals.size(), 64);
+  for (std::size_t i = 0; i < intervals.size(); ++i) {
+    if (i > 0) {
+      EXPECT_LT(intervals[i - 1].interval.hi, intervals[i].interval.lo);
+    }
+    if (intervals[i].exact) {
+      EXPECT_TRUE(ball.contains(regionCoordinates(intervals[i].interval.lo, 2, nullptr)));
+      EXPECT_TRUE(ball.contains(regionCoordinates(intervals[i].interval.hi, 2, nullptr)));
+    }
+  }
+}
+
+TEST(region, ball_query) {
+  grid g(5000);
+  Ball const ball({120, 80}, 37);
+  for (std::size_t maxIntervals : {1, 16, 256}) {
+    std::vector<byte_string> found;
+    findAllInRegion(*g.db.rocks, ball, 2, maxIntervals, collect(found));
+    EXPECT_EQ(found, g.all(ball)) << maxIntervals;
+  }
+}
+
+TEST(region, thin_polygon_examines_few_keys) {
+  grid g(20000);
+  // a thin diagonal band through the whole space
+  Polygon const band({{0, 0}, {8, 0}, {255, 247}, {255, 255}, {247, 255}, {0, 8}});
+  std::vector<byte_string> found;
+  QueryStats stats;
+  findAllInRegion(*g.db.rocks, band, 2, 256, collect(found), stats);
+  auto const expected = g.all(band);
+  EXPECT_EQ(found, expected);
+
+  // its bounding box is everything
+  QueryStats boxStats;
+  findAllInBox(*g.db.rocks, makeBox({"00000000"_bs, "00000000"_bs}, {"11111111"_bs, "11111111"_bs}, 1),
+               [](byte_string_view, byte_string_view) {}, boxStats);
+  EXPECT_LT(stats.keysExamined, 2 * expected.size());
+  EXPECT_LT(stats.keysExamined * 5, boxStats.keysExamined);
+}
+
+TEST(region, quantized_coordinates) {
+  QuantizingCodec codec({{0.0, 1.0, 10}, {0.0, 1.0, 6}});
+  RocksDBOptions options;
+  options.schedule = codec.schedule();
+  TemporaryDB db(options);
+  std::mt19937_64 gen(59);
+  std::uniform_real_distribution<double> value(0.0, 1.0);
+  for (int i = 0; i < 2000; ++i) {
+    ASSERT_TRUE(PutKey(*db.rocks, codec.encodeKey({value(gen), value(gen)}), {}).ok());
+  }
+
+  // the cells around (0.5, 0.5) of 10 and 6 bits
+  Polygon const diamond({{512 - 200, 32}, {512, 32 - 12}, {512 + 200, 32}, {512, 32 + 12}});
+  std::vector<byte_string> found, expected;
+  findAllInRegion(*db.rocks, diamond, codec.keySize(), 64, collect(found));
+  findAllInBoxSlow(*db.rocks, makeBox({std::nullopt, std::nullopt}, {std::nullopt, std::nullopt}, 2, codec.schedule()),
+                   [&](byte_string_view key, byte_string_view) {
+                     auto const cells = regionCoordinates(key, 2, &codec.schedule());
+                     EXPECT_EQ(cells[0], codec.quantize(0, codec.decodeKey(key)[0]));
+                     if (diamond.contains(cells)) {
+                       expected.emplace_back(key);
+                     }
+                   });
+  EXPECT_EQ(found, expected);
+  EXPECT_FALSE(expected.empty());
+}
@@ -0,0 +1,97 @@
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "library.h"
+#include "result-batch.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+TEST(resultBatch, transposes_keys_into_columns) {
+  ResultBatch batch(3, 4);
+  std::vector<std::vector<byte_string>> points = {
+    {"00010010"_bs, "11110000"_bs, "10101010"_bs},
+    {"11111111"_bs, "00000000"_bs, "01010101"_bs},
+  };
+  for (auto const& p : points) {
+    batch.add(interleave(p), "0101"_bs);
+  }
+  ASSERT_EQ(batch.size(), 2);
+  for (std::size_t d = 0; d < 3; ++d) {
+    EXPECT_EQ(batch.coordinateSize(d), 1);
+    EXPECT_EQ(batch.column(d).size(), 2);
+    for (std::size_t i = 0; i < 2; ++i) {
+      EXPECT_EQ(batch.coordinate(d, i), byte_string_view{points[i][d]});
+    }
+  }
+  EXPECT_EQ(batch.key(1), byte_string_view{interleave(points[1])});
+  EXPECT_EQ(batch.value(0), byte_string_view{"0101"_bs});
+}
+
+TEST(resultBatch, follows_the_interleave_schedule) {
+  auto const schedule = InterleaveSchedule::roundRobin({64, 8});
+  ResultBatch batch(2, 8, &schedule);
+  std::vector<byte_string> const point = {to_byte_string_fixed_length<uint64_t>(0xdeadbeef), "11001010"_bs};
+  batch.add(interleave(point, schedule), {});
+  batch.add(interleave({to_byte_string_fixed_length<uint64_t>(42), "00000001"_bs}, schedule), {});
+  EXPECT_EQ(batch.coordinateSize(0), 8);
+  EXPECT_EQ(batch.coordinateSize(1), 1);
+  EXPECT_EQ(batch.coordinate(0, 0), byte_string_view{point[0]});
+  EXPECT_EQ(batch.coordinate(1, 0), byte_string_view{point[1]});
+
+  std::vector<uint64_t> column;
+  batch.decodeColumn(0, column);
+  EXPECT_EQ(column, (std::vector<uint64_t>{0xdeadbeef, 42}));
+}
+
+TEST(resultBatch, reuses_its_buffers) {
+  ResultBatch batch(2, 2);
+  batch.add("0000000011111111"_bs, "01"_bs);
+  batch.add("0000001011111111"_bs, {});
+  EXPECT_TRUE(batch.full());
+  EXPECT_THROW(batch.add("0000001111111111"_bs, {}), std::logic_error);
+  batch.clear();
+  EXPECT_TRUE(batch.empty());
+  batch.add("1111111100000000"_bs, {});
+  EXPECT_EQ(batch.size(), 1);
+  EXPECT_EQ(batch.coordinate(0, 0), byte_string_view{"11110000"_bs});
+  EXPECT_EQ(batch.value(0), byte_string_view{});
+  EXPECT_THROW(batch.add("11111111"_bs, {}), std::invalid_argument);
+  EXPECT_THROW(ResultBatch(0, 2), std::invalid_argument);
+}
+
+TEST(resultBatch, batched_box_query_matches_callbacks) {
+  TemporaryDB db;
+  std::mt19937 gen(17);
+  std::uniform_int_distribution<unsigned> coord(0, 255);
+  for (int i = 0; i < 3000; ++i) {
+    auto key = interleave({{std::byte(coord(gen))}, {std::byte(coord(gen))}, {std::byte(coord(gen))}});
+    ASSERT_TRUE(PutKey(*db.rocks, key, to_byte_string_fixed_length<uint32_t>(i)).ok());
+  }
+  auto const box = makeBox({"00010000"_bs, std::nullopt, "00100000"_bs}, {"10000000"_bs, std::nullopt, "11000000"_bs}, 1);
+
+  std::vector<byte_string> keys;
+  auto const expectedSeeks = findAllInBox(*db.rocks, box, [&](byte_string_view key, byte_string_view) { keys.emplace_back(key); });
+  ASSERT_GT(keys.size(), 100);
+
+  std::vector<byte_string> batched;
+  std::size_t batches = 0;
+  auto const seeks = findAllInBoxBatched(*db.rocks, box, 64, [&](ResultBatch const& batch) {
+    batches += 1;
+    EXPECT_LE(batch.size(), 64);
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+      batched.emplace_back(batch.key(i));
+      auto const coords = transpose(batch.key(i), 3);
+      for (std::size_t d = 0; d < 3; ++d) {
+        EXPECT_EQ(batch.coordinate(d, i), byte_string_view{coords[d]});
+      }
+    }
+  });
+  EXPECT_EQ(batched, keys);
+  EXPECT_EQ(seeks, expectedSeeks);
+  EXPECT_EQ(batches, (keys.size() + 63) / 64);
+}
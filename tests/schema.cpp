@@ -0,0 +1,117 @@
+#include <cmath>
+#include <limits>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "library.h"
+#include "schema.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+namespace {
+using Events = Schema<Double, Int64, Timestamp, Float>;
+
+template<typename Codec>
+auto encoded(typename Codec::value_type v) -> byte_string {
+  byte_string result(Codec::size, std::byte{0});
+  Codec::encode(v, result.data());
+  return result;
+}
+
+auto randomEvent(std::mt19937_64& gen) -> Events::point {
+  std::uniform_real_distribution<double> real(-1000.0, 1000.0);
+  std::uniform_int_distribution<std::int64_t> integer(-1000, 1000);
+  std::uniform_int_distribution<std::int64_t> micros(0, 1'000'000);
+  return {real(gen), integer(gen), Timestamp::value_type(std::chrono::microseconds(micros(gen))), float(real(gen))};
+}
+} // namespace
+
+TEST(schema, codecs_preserve_order) {
+  std::vector<double> doubles = {-std::numeric_limits<double>::infinity(), -1e300, -1.5, -1e-300, -0.0, 0.0,
+                                 1e-300, 2.0, 1e300, std::numeric_limits<double>::infinity()};
+  for (std::size_t i = 0; i + 1 < doubles.size(); ++i) {
+    EXPECT_LT(encoded<Double>(doubles[i]), encoded<Double>(doubles[i + 1])) << doubles[i];
+  }
+  std::vector<std::int64_t> ints = {std::numeric_limits<std::int64_t>::min(), -2, -1, 0, 1, std::numeric_limits<std::int64_t>::max()};
+  for (std::size_t i = 0; i + 1 < ints.size(); ++i) {
+    EXPECT_LT(encoded<Int64>(ints[i]), encoded<Int64>(ints[i + 1])) << ints[i];
+  }
+
+  std::mt19937_64 gen(1);
+  std::uniform_real_distribution<float> real(-1e6f, 1e6f);
+  for (int i = 0; i < 1000; ++i) {
+    auto a = real(gen), b = real(gen);
+    EXPECT_EQ(a < b, encoded<Float>(a) < encoded<Float>(b));
+    EXPECT_EQ(Float::decode(encoded<Float>(a).data()), a);
+    EXPECT_EQ(Double::decode(encoded<Double>(double(a) * 1e-7).data()), double(a) * 1e-7);
+  }
+  EXPECT_EQ(UInt64::decode(encoded<UInt64>(42).data()), 42u);
+  EXPECT_EQ(encoded<UInt64>(42), to_byte_string_fixed_length<uint64_t>(42));
+}
+
+TEST(schema, keys_match_interleave) {
+  static_assert(Events::dimensions == 4);
+  static_assert(Events::keySize == 32);
+
+  std::mt19937_64 gen(2);
+  for (int i = 0; i < 200; ++i) {
+    auto const p = randomEvent(gen);
+    auto const key = Events::encode(p);
+    auto const expected = interleave({encoded<Double>(std::get<0>(p)), encoded<Int64>(std::get<1>(p)),
+                                      encoded<Timestamp>(std::get<2>(p)), encoded<Float>(std::get<3>(p))});
+    ASSERT_EQ(byte_string_view{key}, byte_string_view{expected});
+    EXPECT_EQ(Events::decode(key), p);
+  }
+  EXPECT_THROW(Events::decode(byte_string(31, std::byte{0})), std::invalid_argument);
+}
+
+TEST(schema, make_box_matches_make_box) {
+  Events::bounds min = {-1.0, std::nullopt, Timestamp::value_type(std::chrono::microseconds(5)), std::nullopt};
+  Events::bounds max = {std::nullopt, 7, std::nullopt, 2.5f};
+  auto const box = Events::makeBox(min, max);
+  auto const expected = makeBox({encoded<Double>(-1.0), std::nullopt, encoded<Timestamp>(*std::get<2>(min)), std::nullopt},
+                                {std::nullopt, encoded<Int64>(7), std::nullopt, encoded<Float>(2.5f)}, 8);
+  EXPECT_EQ(box.min, expected.min);
+  EXPECT_EQ(box.max, expected.max);
+  ASSERT_EQ(box.mask.size(), 4);
+  for (std::size_t dim = 0; dim < 4; ++dim) {
+    EXPECT_EQ(box.mask[dim].min, expected.mask[dim].min);
+    EXPECT_EQ(box.mask[dim].max, expected.mask[dim].max);
+  }
+}
+
+TEST(schema, find_all_in_box) {
+  TemporaryDB db;
+  std::mt19937_64 gen(3);
+  std::vector<Events::point> points;
+  for (int i = 0; i < 3000; ++i) {
+    points.push_back(randomEvent(gen));
+    ASSERT_TRUE(PutKey(*db.rocks, Events::encode(points.back()), {}).ok());
+  }
+
+  for (int q = 0; q < 20; ++q) {
+    auto a = randomEvent(gen), b = randomEvent(gen);
+    Events::point const min = {std::min(std::get<0>(a), std::get<0>(b)), std::min(std::get<1>(a), std::get<1>(b)),
+                               std::min(std::get<2>(a), std::get<2>(b)), std::min(std::get<3>(a), std::get<3>(b))};
+    Events::point const max = {std::max(std::get<0>(a), std::get<0>(b)), std::max(std::get<1>(a), std::get<1>(b)),
+                               std::max(std::get<2>(a), std::get<2>(b)), std::max(std::get<3>(a), std::get<3>(b))};
+
+    std::set<Events::point> expected;
+    for (auto const& p : points) {
+      if (Events::contains(min, max, p)) {
+        expected.insert(p);
+      }
+    }
+
+    std::set<Events::point> found;
+    findAllInBox(*db.rocks, Events::makeBox(min, max), [&](byte_string_view key, byte_string_view) {
+      found.insert(Events::decode(key));
+    });
+    EXPECT_EQ(found, expected) << "q=" << q;
+  }
+}
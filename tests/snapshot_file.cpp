@@ -0,0 +1,182 @@
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "library.h"
+#include "quantizing-codec.h"
+#include "snapshot-file.h"
+#include "random-points.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+namespace {
+void fillPoints(RocksDBHandle& rocks, std::size_t count) {
+  // values of varying length
+  fillRandomPoints(rocks, count, 29, [](std::size_t i) { return byte_string(i % 5, std::byte(i)); });
+}
+
+struct TemporaryFile {
+  TemporaryFile() : path(std::filesystem::temp_directory_path() / ("zkd-snapshot-" + std::to_string(std::random_device{}()))) {}
+  ~TemporaryFile() { std::filesystem::remove(path); }
+
+  std::filesystem::path path;
+};
+
+} // namespace
+
+TEST(snapshotFile, export_and_read) {
+  TemporaryDB db;
+  fillPoints(*db.rocks, 2000);
+  TemporaryFile file;
+  auto const count = exportSnapshot(*db.rocks, file.path.string(), SnapshotOptions{3, "uint8,uint8,uint8", 7});
+
+  SnapshotReader snapshot(file.path.string());
+  EXPECT_EQ(snapshot.size(), count);
+  EXPECT_EQ(snapshot.dimensions(), 3);
+  EXPECT_EQ(snapshot.codecs(), "uint8,uint8,uint8");
+  EXPECT_EQ(snapshot.keySize(), 3);
+  EXPECT_EQ(snapshot.schedule(), nullptr);
+
+  results expected;
+  findAllInBoxSlow(*db.rocks, makeBox({std::nullopt, std::nullopt, std::nullopt}, {std::nullopt, std::nullopt, std::nullopt}, 1),
+                   collect(expected));
+  ASSERT_EQ(expected.size(), count);
+  auto iter = snapshot.newIterator();
+  std::size_t i = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++i) {
+    EXPECT_EQ(byte_string(reinterpret_cast<std::byte const*>(iter->key().data()), iter->key().size()), expected[i].first);
+    EXPECT_EQ(snapshot.value(i), byte_string_view{expected[i].second});
+  }
+  EXPECT_EQ(i, count);
+
+  // every key is found, and the keys between them land on the next one
+  for (std::size_t k = 0; k < count; ++k) {
+    ASSERT_EQ(snapshot.lowerBound(expected[k].first), k);
+    auto before = expected[k].first;
+    before.push_back(std::byte{0});
+    ASSERT_EQ(snapshot.lowerBound(before), k + 1);
+  }
+
+  iter->SeekToLast();
+  ASSERT_TRUE(iter->Valid());
+  auto const target = rocksdb::Slice(reinterpret_cast<char const*>(expected[1000].first.data()), 2);
+  iter->SeekForPrev(target);
+  ASSERT_TRUE(iter->Valid());
+  EXPECT_LE(iter->key().compare(target), 0);
+  iter->Next();
+  ASSERT_TRUE(iter->Valid());
+  EXPECT_GT(iter->key().compare(target), 0);
+}
+
+TEST(snapshotFile, box_queries_match_the_database) {
+  TemporaryDB db;
+  fillPoints(*db.rocks, 5000);
+  TemporaryFile file;
+  exportSnapshot(*db.rocks, file.path.string(), SnapshotOptions{3, "uint8,uint8,uint8", 16});
+  SnapshotReader snapshot(file.path.string());
+
+  std::mt19937 gen(4);
+  for (int q = 0; q < 30; ++q) {
+    auto const box = randomBox(gen);
+    results expected, actual;
+    auto const expectedSeeks = findAllInBox(*db.rocks, box, collect(expected));
+    QueryStats stats;
+    auto const seeks = findAllInBox(snapshot, box, collect(actual), stats);
+    EXPECT_EQ(actual, expected) << "q=" << q;
+    EXPECT_EQ(seeks, expectedSeeks);
+    EXPECT_EQ(stats.keysReturned, expected.size());
+  }
+}
+
+TEST(snapshotFile, keeps_the_interleave_schedule) {
+  QuantizingCodec codec({{0.0, 1.0, 10}, {0.0, 1.0, 6}});
+  RocksDBOptions options;
+  options.schedule = codec.schedule();
+  TemporaryDB db(options);
+  std::mt19937_64 gen(6);
+  std::uniform_real_distribution<double> value(0.0, 1.0);
+  for (int i = 0; i < 500; ++i) {
+    std::vector<double> point = {value(gen), value(gen)};
+    ASSERT_TRUE(PutKey(*db.rocks, codec.encodeKey(point), codec.encodeValue(point, {})).ok());
+  }
+  TemporaryFile file;
+  exportSnapshot(*db.rocks, file.path.string(), SnapshotOptions{2, "quantized"});
+  SnapshotReader snapshot(file.path.string());
+  ASSERT_NE(snapshot.schedule(), nullptr);
+  EXPECT_EQ(*snapshot.schedule(), codec.schedule());
+
+  auto const box = codec.makeBox({0.2, 0.1}, {0.6, 0.5});
+  results expected, actual;
+  findAllInBox(*db.rocks, box.box, collect(expected));
+  findAllInBox(snapshot, box.box, collect(actual));
+  EXPECT_EQ(actual, expected);
+  EXPECT_FALSE(actual.empty());
+}
+
+TEST(snapshotFile, rejects_bad_input) {
+  TemporaryDB db;
+  ASSERT_TRUE(PutKey(*db.rocks, "00000001"_bs, {}).ok());
+  ASSERT_TRUE(PutKey(*db.rocks, "0000000100000001"_bs, {}).ok());
+  TemporaryFile file;
+  EXPECT_THROW(exportSnapshot(*db.rocks, file.path.string(), SnapshotOptions{1}), std::invalid_argument);
+
+  std::ofstream(file.path, std::ios::binary) << std::string(200, 'x');
+  EXPECT_THROW(SnapshotReader{file.path.string()}, std::invalid_argument);
+  EXPECT_THROW(SnapshotReader{(file.path / "missing").string()}, std::runtime_error);
+}
+
+TEST(snapshotFile, rejects_malformed_sections) {
+  TemporaryDB db;
+  fillPoints(*db.rocks, 100);
+  TemporaryFile file;
+  exportSnapshot(*db.rocks, file.path.string(), SnapshotOptions{3});
+  std::string valid;
+  {
+    std::ifstream in(file.path, std::ios::binary);
+    valid.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  auto const word = [&](std::size_t offset) {
+    std::uint64_t v = 0;
+    for (std::size_t i = 8; i > 0; --i) {
+      v = (v << 8) | std::uint8_t(valid[offset + i - 1]);
+    }
+    return v;
+  };
+  auto const patch = [&](std::size_t offset, std::uint64_t v) {
+    auto patched = valid;
+    for (std::size_t i = 0; i < 8; ++i) {
+      patched[offset + i] = char(v >> (8 * i));
+    }
+    std::ofstream(file.path, std::ios::binary | std::ios::trunc) << patched;
+  };
+  auto const rejects = [&](std::size_t offset, std::uint64_t v) {
+    patch(offset, v);
+    EXPECT_THROW(SnapshotReader{file.path.string()}, std::invalid_argument) << offset << " " << v;
+  };
+
+  // value offsets are only checked by the values that use them, opening stays O(1)
+  auto const offsets = word(56);
+  patch(offsets + 8 * 10, 0);
+  {
+    SnapshotReader snapshot(file.path.string());
+    EXPECT_NO_THROW(snapshot.value(8));
+    EXPECT_THROW(snapshot.value(9), std::invalid_argument);
+    EXPECT_NO_THROW(snapshot.value(10));
+  }
+  patch(offsets + 8 * 100, valid.size());
+  {
+    SnapshotReader snapshot(file.path.string());
+    EXPECT_THROW(snapshot.value(99), std::invalid_argument);
+  }
+  // sizes that overflow: count, key size and the sections
+  rejects(32, ~std::uint64_t{0});
+  rejects(32, std::uint64_t{1} << 61);
+  rejects(24, std::uint64_t{1} << 62);
+  rejects(80, ~std::uint64_t{0} - 50);
+}
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "key-blocks.h"
+#include "library.h"
+#include "spatial-join.h"
+#include "temporary-db.h"
+
+using namespace zkd;
+
+namespace {
+using point = std::pair<unsigned, unsigned>;
+
+auto randomPoints(std::mt19937& gen, std::size_t count) -> std::vector<point> {
+  std::uniform_int_distribution<unsigned> coord(0, 255);
+  std::vector<point> points;
+  for (std::size_t i = 0; i < count; ++i) {
+    points.emplace_back(coord(gen), coord(gen));
+  }
+  std::sort(points.begin(), points.end());
+  points.erase(std::unique(points.begin(), points.end()), points.end());
+  return points;
+}
+
+auto keyOf(point p) -> byte_string {
+  return interleave({{std::byte(p.first)}, {std::byte(p.second)}});
+}
+
+auto pointOf(byte_string_view key) -> point {
+  auto const coords = transpose(key, 2);
+  return {std::to_integer<unsigned>(coords[0][0]), std::to_integer<unsigned>(coords[1][0])};
+}
+
+auto distance(unsigned a, unsigned b) -> unsigned {
+  return a > b ? a - b : b - a;
+}
+
+auto nestedLoop(std::vector<point> const& left, std::vector<point> const& right, unsigned dx, unsigned dy)
+  -> std::vector<std::pair<point, point>> {
+  std::vector<std::pair<point, point>> result;
+  for (auto a : left) {
+    for (auto b : right) {
+      if (distance(a.first, b.first) <= dx && distance(a.second, b.second) <= dy) {
+        result.emplace_back(a, b);
+      }
+    }
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+struct collect {
+  std::vector<std::pair<point, point>> pairs;
+
+  auto callback() -> JoinCallback {
+    return [this](byte_string_view a, byte_string_view, byte_string_view b, byte_string_view) {
+      pairs.emplace_back(pointOf(a), pointOf(b));
+    };
+  }
+  auto sorted() -> std::vector<std::pair<point, point>> {
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
+  }
+};
+} // namespace
+
+TEST(spatialJoin, matches_a_nested_loop) {
+  std::mt19937 gen(41);
+  auto const left = randomPoints(gen, 300);
+  auto const right = randomPoints(gen, 3000);
+  TemporaryDB a, b;
+  for (auto p : left) {
+    ASSERT_TRUE(PutKey(*a.rocks, keyOf(p), "a"_bss).ok());
+  }
+  for (auto p : right) {
+    ASSERT_TRUE(PutKey(*b.rocks, keyOf(p), {}).ok());
+  }
+
+  for (auto [dx, dy] : {std::pair{0u, 0u}, std::pair{3u, 5u}, std::pair{20u, 1u}}) {
+    collect result;
+    QueryStats stats;
+    auto const pairs = spatialJoin(*a.rocks, *b.rocks, 2, JoinOptions{{dx, dy}}, result.callback(), stats);
+    auto const expected = nestedLoop(left, right, dx, dy);
+    EXPECT_EQ(result.sorted(), expected) << dx << " " << dy;
+    EXPECT_EQ(pairs, expected.size());
+    EXPECT_EQ(stats.keysReturned, expected.size());
+    // fewer seeks than a box query per point on the left
+    QueryStats boxQueries;
+    for (auto p : left) {
+      auto const bound = [](unsigned c, int delta) {
+        return byte_string{std::byte(std::clamp(int(c) + delta, 0, 255))};
+      };
+      auto const box = makeBox({bound(p.first, -int(dx)), bound(p.second, -int(dy))},
+                               {bound(p.first, int(dx)), bound(p.second, int(dy))}, 1);
+      findAllInBox(*b.rocks, box, [](byte_string_view, byte_string_view) {}, boxQueries);
+    }
+    EXPECT_LT(stats.seeks, boxQueries.seeks);
+  }
+}
+
+TEST(spatialJoin, filters_and_joins_in_memory_runs) {
+  std::mt19937 gen(43);
+  auto const left = randomPoints(gen, 500);
+  auto const right = randomPoints(gen, 800);
+  TemporaryDB a;
+  KeyBlockRun::Builder builder;
+  for (auto p : left) {
+    ASSERT_TRUE(PutKey(*a.rocks, keyOf(p), {}).ok());
+  }
+  std::vector<byte_string> keys;
+  std::transform(right.begin(), right.end(), std::back_inserter(keys), keyOf);
+  std::sort(keys.begin(), keys.end());
+  for (auto const& key : keys) {
+    builder.add(key, {});
+  }
+  auto const run = std::move(builder).finish();
+
+  // euclidean distance of at most 6
+  JoinOptions options{{6, 6}};
+  options.filter = [](byte_string_view a, byte_string_view b) {
+    auto const [ax, ay] = pointOf(a);
+    auto const [bx, by] = pointOf(b);
+    return distance(ax, bx) * distance(ax, bx) + distance(ay, by) * distance(ay, by) <= 36;
+  };
+  auto leftIter = std::unique_ptr<rocksdb::Iterator>{a.rocks->db->NewIterator({}, a.rocks->default_.get())};
+  auto rightIter = run.newIterator();
+  collect result;
+  QueryStats stats;
+  spatialJoin(*leftIter, *rightIter, 2, options, result.callback(), stats);
+
+  auto expected = nestedLoop(left, right, 6, 6);
+  expected.erase(std::remove_if(expected.begin(), expected.end(), [](auto const& pair) {
+    auto const [a, b] = pair;
+    return distance(a.first, b.first) * distance(a.first, b.first) +
+             distance(a.second, b.second) * distance(a.second, b.second) > 36;
+  }), expected.end());
+  EXPECT_EQ(result.sorted(), expected);
+  EXPECT_FALSE(expected.empty());
+}
+
+TEST(spatialJoin, rejects_bad_input) {
+  TemporaryDB a, b;
+  ASSERT_TRUE(PutKey(*a.rocks, "0000000100000001"_bs, {}).ok());
+  ASSERT_TRUE(PutKey(*b.rocks, "00000001"_bs, {}).ok());
+  auto const ignore = [](byte_string_view, byte_string_view, byte_string_view, byte_string_view) {};
+  EXPECT_THROW(spatialJoin(*a.rocks, *b.rocks, 2, JoinOptions{{1, 1}}, ignore), std::invalid_argument);
+  EXPECT_THROW(spatialJoin(*a.rocks, *a.rocks, 2, JoinOptions{{1}}, ignore), std::invalid_argument);
+  EXPECT_EQ(spatialJoin(*a.rocks, *a.rocks, 2, JoinOptions{{0, 0}}, ignore), 1);
+
+  TemporaryDB empty;
+  EXPECT_EQ(spatialJoin(*a.rocks, *empty.rocks, 2, JoinOptions{{9, 9}}, ignore), 0);
+}
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest.h>
+
+#include "library.h"
+#include "subscription-index.h"
+
+using namespace zkd;
+
+namespace {
+auto coordinate(unsigned v) -> byte_string {
+  return byte_string{std::byte(v >> 8), std::byte(v & 0xffu)};
+}
+
+auto randomBoxes(std::size_t count, unsigned seed) -> std::vector<Box> {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<unsigned> coord(0, 65535), extent(0, 4000);
+  std::vector<Box> boxes;
+  for (std::size_t i = 0; i < count; ++i) {
+    std::vector<std::optional<byte_string>> min, max;
+    for (int d = 0; d < 2; ++d) {
+      auto const lo = coord(gen);
+      min.emplace_back(coordinate(lo));
+      max.emplace_back(coordinate(std::min(65535u, lo + extent(gen))));
+    }
+    boxes.push_back(makeBox(min, max, 2));
+  }
+  return boxes;
+}
+
+auto randomKey(std::mt19937& gen) -> byte_string {
+  std::uniform_int_distribution<unsigned> coord(0, 65535);
+  return interleave({coordinate(coord(gen)), coordinate(coord(gen))});
+}
+
+auto sorted(std::vector<SubscriptionId> ids) -> std::vector<SubscriptionId> {
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+} // namespace
+
+TEST(subscriptionIndex, matches_like_test_in_box) {
+  SubscriptionIndex index(2, 4);
+  auto const boxes = randomBoxes(2000, 61);
+  std::vector<SubscriptionId> ids;
+  for (auto const& box : boxes) {
+    ids.push_back(index.subscribe(box));
+  }
+  EXPECT_EQ(index.size(), boxes.size());
+  EXPECT_LE(index.cells(), 16 * boxes.size());
+
+  std::mt19937 gen(67);
+  std::size_t hits = 0;
+  for (int i = 0; i < 2000; ++i) {
+    // a corner of a box, to hit some of them
+    auto const key = i % 2 == 0 ? randomKey(gen) : boxes[i % boxes.size()].max;
+    std::vector<SubscriptionId> expected;
+    for (std::size_t b = 0; b < boxes.size(); ++b) {
+      if (testInBox(key, boxes[b].min, boxes[b].max, 2)) {
+        expected.push_back(ids[b]);
+      }
+    }
+    auto const found = index.match(key);
+    EXPECT_EQ(found.size(), expected.size()); // no duplicates
+    EXPECT_EQ(sorted(found), expected);
+    hits += found.size();
+  }
+  EXPECT_GE(hits, 1000);
+}
+
+TEST(subscriptionIndex, unbounded_box) {
+  SubscriptionIndex index(2, 4);
+  auto const id = index.subscribe(makeBox({coordinate(100), std::nullopt}, {coordinate(200), std::nullopt}, 2));
+  EXPECT_EQ(index.match(interleave({coordinate(150), coordinate(0)})), std::vector<SubscriptionId>{id});
+  EXPECT_EQ(index.match(interleave({coordinate(150), coordinate(65535)})), std::vector<SubscriptionId>{id});
+  EXPECT_TRUE(index.match(interleave({coordinate(201), coordinate(7)})).empty());
+}
+
+TEST(subscriptionIndex, unsubscribe) {
+  SubscriptionIndex index(2, 4);
+  auto const box = makeBox({coordinate(10), coordinate(10)}, {coordinate(20), coordinate(20)}, 2);
+  auto const a = index.subscribe(box);
+  auto const b = index.subscribe(box);
+  auto const key = interleave({coordinate(15), coordinate(12)});
+  EXPECT_EQ(sorted(index.match(key)), (std::vector<SubscriptionId>{a, b}));
+
+  EXPECT_TRUE(index.unsubscribe(a));
+  EXPECT_FALSE(index.unsubscribe(a));
+  EXPECT_EQ(index.match(key), std::vector<SubscriptionId>{b});
+  EXPECT_TRUE(index.unsubscribe(b));
+  EXPECT_TRUE(index.match(key).empty());
+  EXPECT_EQ(index.size(), 0);
+  EXPECT_EQ(index.cells(), 0);
+}
+
+TEST(subscriptionIndex, invalid_arguments) {
+  EXPECT_THROW(SubscriptionIndex(0, 4), std::invalid_argument);
+  SubscriptionIndex index(2, 4);
+  EXPECT_THROW(index.subscribe(makeBox({coordinate(1)}, {coordinate(2)}, 2)), std::invalid_argument);
+  EXPECT_THROW(index.match(coordinate(1)), std::invalid_argument);
+}
+
+TEST(subscriptionIndex, concurrent_subscriptions) {
+  SubscriptionIndex index(2, 4);
+  auto const stable = randomBoxes(200, 71);
+  std::vector<SubscriptionId> stableIds;
+  for (auto const& box : stable) {
+    stableIds.push_back(index.subscribe(box));
+  }
+
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    auto const churn = randomBoxes(500, 73);
+    for (int round = 0; round < 4; ++round) {
+      std::vector<SubscriptionId> ids;
+      for (auto const& box : churn) {
+        ids.push_back(index.subscribe(box));
+      }
+      for (auto id : ids) {
+        index.unsubscribe(id);
+      }
+    }
+    done = true;
+  });
+
+  std::mt19937 gen(79);
+  do {
+    for (int i = 0; i < 100; ++i) {
+      auto const& box = stable[i % stable.size()];
+      auto const found = index.match(box.min);
+      // the stable boxes are always found, whatever the writer does
+      EXPECT_NE(std::find(found.begin(), found.end(), stableIds[i % stable.size()]), found.end());
+      index.match(randomKey(gen));
+    }
+  } while (!done);
+  writer.join();
+  EXPECT_EQ(index.size(), stable.size());
+}
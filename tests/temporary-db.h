@@ -0,0 +1,32 @@
+#ifndef ZKD_TREE_TEMPORARY_DB_H
+#define ZKD_TREE_TEMPORARY_DB_H
+
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "rocksdb-handle.h"
+
+// A RocksDB instance in a fresh directory that is removed again on destruction.
+struct TemporaryDB {
+  explicit TemporaryDB(RocksDBOptions const& options = {}) : path(makePath()), rocks(OpenRocksDB(path.string(), options)) {}
+  ~TemporaryDB() {
+    rocks.reset();
+    std::filesystem::remove_all(path);
+  }
+
+  TemporaryDB(TemporaryDB const&) = delete;
+  TemporaryDB& operator=(TemporaryDB const&) = delete;
+
+  std::filesystem::path path;
+  std::shared_ptr<RocksDBHandle> rocks;
+
+ private:
+  static auto makePath() -> std::filesystem::path {
+    auto rd = std::random_device{};
+    return std::filesystem::temp_directory_path() / ("zkd-test-" + std::to_string(rd()) + std::to_string(rd()));
+  }
+};
+
+#endif //ZKD_TREE_TEMPORARY_DB_H
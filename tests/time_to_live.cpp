@@ -0,0 +1,93 @@
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "library.h"
+#include "rocksdb-handle.h"
+#include "temporary-db.h"
+#include "time-to-live.h"
+
+using namespace zkd;
+
+namespace {
+auto countKeys(RocksDBHandle& rocks) -> std::size_t {
+  std::size_t count = 0;
+  auto const all = std::optional<byte_string>{};
+  findAllInBoxSlow(rocks, makeBox({all, all}, {all, all}, 8), [&](byte_string_view, byte_string_view) { count += 1; });
+  return count;
+}
+
+void compact(RocksDBHandle& rocks) {
+  auto s = rocks.db->CompactRange(rocksdb::CompactRangeOptions{}, rocks.default_.get(), nullptr, nullptr);
+  ASSERT_TRUE(s.ok()) << s.ToString();
+}
+} // namespace
+
+TEST(timeToLive, compaction_drops_expired_keys) {
+  std::atomic<std::uint64_t> now{1000};
+  RocksDBOptions options;
+  options.timeToLive = TimeToLive{2, 1, 300, {}, [&] { return now.load(); }};
+  TemporaryDB db(options);
+
+  for (std::uint64_t t = 0; t < 1000; ++t) {
+    auto const key =
+      interleave({to_byte_string_fixed_length<std::uint64_t>(t * 7919 % 1000), to_byte_string_fixed_length(t)});
+    ASSERT_TRUE(PutKey(*db.rocks, key, {}).ok());
+  }
+  EXPECT_EQ(countKeys(*db.rocks), 1000);
+
+  compact(*db.rocks);
+  EXPECT_EQ(countKeys(*db.rocks), 300);
+  auto const any = std::optional<byte_string>{};
+  findAllInBoxSlow(*db.rocks, makeBox({any, any}, {any, any}, 8), [&](byte_string_view key, byte_string_view) {
+    EXPECT_GE(keyTime(*options.timeToLive, Curve::Z_ORDER, nullptr, key), 700);
+  });
+
+  now = 1100;
+  compact(*db.rocks);
+  EXPECT_EQ(countKeys(*db.rocks), 200);
+}
+
+TEST(timeToLive, nothing_expires_within_the_retention) {
+  RocksDBOptions options;
+  options.timeToLive = TimeToLive{2, 0, 500, {}, [] { return std::uint64_t{400}; }};
+  TemporaryDB db(options);
+  for (std::uint64_t t = 0; t < 10; ++t) {
+    auto const key = interleave({to_byte_string_fixed_length(t), to_byte_string_fixed_length(t)});
+    ASSERT_TRUE(PutKey(*db.rocks, key, {}).ok());
+  }
+  compact(*db.rocks);
+  EXPECT_EQ(countKeys(*db.rocks), 10);
+}
+
+TEST(timeToLive, key_time) {
+  auto const coords = std::vector<byte_string>{to_byte_string_fixed_length<std::uint64_t>(5),
+                                               to_byte_string_fixed_length<std::uint64_t>(123456789)};
+  TimeToLive ttl{2, 1, 0, {}, {}};
+  EXPECT_EQ(keyTime(ttl, Curve::Z_ORDER, nullptr, interleave(coords)), 123456789);
+  EXPECT_EQ(keyTime(ttl, Curve::HILBERT, nullptr, encodeKey(Curve::HILBERT, coords)), 123456789);
+  auto const schedule = InterleaveSchedule::roundRobin({32, 64});
+  EXPECT_EQ(keyTime(ttl, Curve::Z_ORDER, &schedule, interleave(coords, schedule)), 123456789);
+
+  // a custom decoding, e.g. of a QuantizingCodec cell
+  ttl.decodeTime = [](byte_string_view coordinate) { return std::to_integer<std::uint64_t>(coordinate.back()) * 2; };
+  EXPECT_EQ(keyTime(ttl, Curve::Z_ORDER, nullptr, interleave(coords)), 2 * (123456789 & 0xff));
+}
+
+TEST(timeToLive, invalid_options) {
+  RocksDBOptions options;
+  options.timeToLive = TimeToLive{2, 2, 10, {}, {}};
+  EXPECT_THROW(TemporaryDB{options}, std::invalid_argument);
+
+  options.timeToLive->timeDimension = 1;
+  options.summaryPrefixBits = {8};
+  EXPECT_THROW(TemporaryDB{options}, std::invalid_argument);
+
+  options.summaryPrefixBits.clear();
+  options.schedule = InterleaveSchedule::roundRobin(3, 8);
+  EXPECT_THROW(TemporaryDB{options}, std::invalid_argument);
+}
@@ -0,0 +1,89 @@
+#include <sstream>
+#include <vector>
+
+#include <gtest.h>
+
+#include "box-query.h"
+#include "library.h"
+#include "temporary-db.h"
+#include "workload.h"
+
+using namespace zkd;
+
+TEST(workload, generator_is_deterministic) {
+  for (auto distribution : {KeyDistribution::UNIFORM, KeyDistribution::CLUSTERED, KeyDistribution::ZIPF,
+                            KeyDistribution::TIME_SERIES}) {
+    WorkloadOptions options;
+    options.dimensions = 3;
+    options.points = 100;
+    options.distribution = distribution;
+
+    PointGenerator a(options, 5), b(options, 5);
+    for (std::size_t i = 0; i < options.points; ++i) {
+      auto p = a.next(i);
+      EXPECT_EQ(p, b.next(i));
+      ASSERT_EQ(p.size(), 3);
+      for (auto v : p) {
+        EXPECT_GE(v, PointGenerator::lowest);
+        EXPECT_LT(v, PointGenerator::highest);
+      }
+    }
+  }
+}
+
+TEST(workload, parse_distribution) {
+  EXPECT_EQ(parseKeyDistribution("zipf"), KeyDistribution::ZIPF);
+  EXPECT_EQ(parseKeyDistribution("time-series"), KeyDistribution::TIME_SERIES);
+  EXPECT_THROW(parseKeyDistribution("normal"), std::invalid_argument);
+}
+
+TEST(workload, run) {
+  TemporaryDB tmp;
+  WorkloadOptions options;
+  options.dimensions = 2;
+  options.points = 2000;
+  options.distribution = KeyDistribution::CLUSTERED;
+  options.selectivities = {0.001, 0.1};
+  options.queries = 50;
+  options.threads = 3;
+  options.profileInterval = 10;
+
+  EXPECT_EQ(loadWorkload(*tmp.rocks, options), options.points);
+  auto report = runWorkload(*tmp.rocks, options);
+
+  ASSERT_EQ(report.classes.size(), 2);
+  EXPECT_EQ(report.classes[0].queries + report.classes[1].queries, options.queries);
+  EXPECT_EQ(report.classes[0].stats.keysReturned + report.classes[1].stats.keysReturned, report.stats.keysReturned);
+  EXPECT_LE(report.latency.p50, report.latency.p99);
+  EXPECT_LE(report.latency.p99, report.latency.p999);
+  EXPECT_LE(report.latency.p999, report.latency.max);
+  EXPECT_GT(report.stats.keysReturned, 0);
+  EXPECT_EQ(report.stats.profiledQueries, 5);
+  EXPECT_EQ(tmp.rocks->queryStats, nullptr);
+
+  std::stringstream json;
+  writeJson(json, report);
+  EXPECT_NE(json.str().find("\"queriesPerSecond\":"), std::string::npos);
+  EXPECT_NE(json.str().find("\"falsePositives\":"), std::string::npos);
+  EXPECT_NE(json.str().find("\"phasesMicros\":"), std::string::npos);
+
+  // a database with different dimensions is rejected
+  options.dimensions = 3;
+  EXPECT_THROW(runWorkload(*tmp.rocks, options), std::invalid_argument);
+}
+
+TEST(workload, queries_are_centered_at_loaded_points) {
+  TemporaryDB tmp;
+  WorkloadOptions options;
+  options.dimensions = 3;
+  options.points = 3000;
+  options.distribution = KeyDistribution::TIME_SERIES;
+  options.selectivities = {1e-6};
+  options.queries = 40;
+  options.threads = 1;
+
+  loadWorkload(*tmp.rocks, options);
+  auto report = runWorkload(*tmp.rocks, options);
+  // every box contains at least its center, also in the random walk dimensions
+  EXPECT_GE(report.stats.keysReturned, options.queries);
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <array>
 #include <utility>
 #include <vector>
@@ -6,6 +7,9 @@
 
 #include "library.h"
 #include "rocksdb-handle.h"
+#include "box-query.h"
+#include "box-result-cache.h"
+#include "temporary-db.h"
 
 using namespace zkd;
 
@@ -249,6 +253,52 @@ TEST(compareBox, testFigure41_3) {
   EXPECT_EQ(res[1].outStep, CompareResult::max);
 }
 
+TEST(compareBox, d2_unbounded) {
+  // x in [2, 5], y in [2, oo)
+  auto const box = makeBox({"00000010"_bs, "00000010"_bs}, {"00000101"_bs, std::nullopt}, 1);
+  EXPECT_EQ(box.max, interleave({"00000101"_bs, "11111111"_bs}));
+  EXPECT_TRUE(box.mask[1].min);
+  EXPECT_FALSE(box.mask[1].max);
+
+  auto res = compareWithBox(interleave({"00000011"_bs, "11110000"_bs}), box.min, box.max, box.mask);
+  EXPECT_EQ(res[0].flag, 0);
+  EXPECT_EQ(res[1].flag, 0);
+  EXPECT_EQ(res[1].saveMin, 0);
+  EXPECT_EQ(res[1].saveMax, 0);
+
+  res = compareWithBox(interleave({"00000110"_bs, "00000001"_bs}), box.min, box.max, box.mask);
+  EXPECT_EQ(res[0].flag, 1);
+  EXPECT_EQ(res[0].outStep, 6);
+  EXPECT_EQ(res[1].flag, -1);
+  EXPECT_EQ(res[1].outStep, 6);
+}
+
+TEST(getNextZValue, unbounded_dimensions) {
+  // the masked comparison has to agree with the one against explicit extremes
+  auto const boxes = {
+    makeBox({"00000101"_bs, std::nullopt}, {"00101000"_bs, std::nullopt}, 1),
+    makeBox({std::nullopt, "00001010"_bs}, {"00101000"_bs, std::nullopt}, 1),
+    makeBox({"00010001"_bs, "00001010"_bs}, {std::nullopt, "00011000"_bs}, 1),
+  };
+
+  for (auto const& box : boxes) {
+    for (unsigned x = 0; x < 64; ++x) {
+      for (unsigned y = 0; y < 64; ++y) {
+        auto const input = interleave({{std::byte(x)}, {std::byte(y)}});
+        auto masked = compareWithBox(input, box.min, box.max, box.mask);
+        auto explicit_ = compareWithBox(input, box.min, box.max, 2);
+
+        auto const inBox = testInBox(input, box.min, box.max, 2);
+        ASSERT_EQ(inBox, testInBox(input, box.min, box.max, box.mask)) << "x=" << x << ", y=" << y;
+        if (!inBox) {
+          EXPECT_EQ(getNextZValue(input, box.min, box.max, masked), getNextZValue(input, box.min, box.max, explicit_))
+            << "x=" << x << ", y=" << y << ", masked=" << masked << ", explicit=" << explicit_;
+        }
+      }
+    }
+  }
+}
+
 TEST(rocksdb, convert_bytestring) {
   auto const data = {
     "00011100"_bs,
@@ -382,3 +432,95 @@ TEST(getNextZValue, testFigure41) {
     }
   }
 }
+
+TEST(rocksdb, find_unbounded_box) {
+  TemporaryDB db;
+  for (unsigned x = 0; x < 32; ++x) {
+    for (unsigned y = 0; y < 32; ++y) {
+      ASSERT_TRUE(PutKey(*db.rocks, interleave({{std::byte(x)}, {std::byte(y)}}), "1"_bs).ok());
+    }
+  }
+
+  // x >= 7, y unbounded
+  auto const box = makeBox({{{7_b}}, std::nullopt}, {std::nullopt, std::nullopt}, 1);
+  std::vector<byte_string> result, expected;
+  auto num_seeks = findAllInBox(*db.rocks, box, [&](byte_string_view key, byte_string_view) { result.emplace_back(key); });
+  findAllInBoxSlow(*db.rocks, box, [&](byte_string_view key, byte_string_view) { expected.emplace_back(key); });
+  EXPECT_EQ(result.size(), 25 * 32);
+  EXPECT_EQ(result, expected);
+  EXPECT_LT(num_seeks, 32);
+}
+
+TEST(rocksdb, find_first_in_box) {
+  TemporaryDB db;
+  for (unsigned x = 0; x < 32; ++x) {
+    for (unsigned y = 0; y < 32; ++y) {
+      ASSERT_TRUE(PutKey(*db.rocks, interleave({{std::byte(x)}, {std::byte(y)}}), "1"_bs).ok());
+    }
+  }
+  db.rocks->resultCache = std::make_shared<BoxResultCache>(1u << 20);
+
+  auto const box = makeBox({{{3_b}}, {{5_b}}}, {{{20_b}}, {{30_b}}}, 1);
+  std::vector<byte_string> first, all;
+  QueryStats stats;
+  findFirstInBox(*db.rocks, box, 10, [&](byte_string_view key, byte_string_view) { first.emplace_back(key); }, stats);
+  EXPECT_EQ(stats.keysReturned, 10);
+  EXPECT_EQ(stats.nexts, 9);
+
+  // the shortened result is not cached
+  findAllInBox(*db.rocks, box, [&](byte_string_view key, byte_string_view) { all.emplace_back(key); });
+  ASSERT_EQ(all.size(), 18 * 26);
+  EXPECT_EQ(first, std::vector<byte_string>(all.begin(), all.begin() + 10));
+
+  // served from the cache now, and still limited
+  std::size_t count = 0;
+  EXPECT_EQ(findFirstInBox(*db.rocks, box, 7, [&](byte_string_view, byte_string_view) { ++count; }), 0);
+  EXPECT_EQ(count, 7);
+  EXPECT_EQ(findFirstInBox(*db.rocks, box, 0, [&](byte_string_view, byte_string_view) { ++count; }), 0);
+  EXPECT_EQ(count, 7);
+}
+
+TEST(rocksdb, sample_in_box) {
+  TemporaryDB db;
+  for (unsigned x = 0; x < 64; ++x) {
+    for (unsigned y = 0; y < 64; ++y) {
+      ASSERT_TRUE(PutKey(*db.rocks, interleave({{std::byte(x)}, {std::byte(y)}}), "1"_bs).ok());
+    }
+  }
+
+  // 48 x 32 points
+  auto const box = makeBox({{{8_b}}, {{16_b}}}, {{{55_b}}, {{47_b}}}, 1);
+  std::vector<byte_string> sample;
+  QueryStats stats;
+  auto num_seeks = sampleInBox(*db.rocks, box, 100, [&](byte_string_view key, byte_string_view) {
+    sample.emplace_back(key);
+  }, stats);
+  // every stratum holds points of the dense grid
+  ASSERT_EQ(sample.size(), 100);
+  EXPECT_TRUE(std::is_sorted(sample.begin(), sample.end()));
+  EXPECT_EQ(std::adjacent_find(sample.begin(), sample.end()), sample.end());
+  EXPECT_LT(num_seeks, 300);
+  EXPECT_EQ(stats.keysReturned, 100);
+
+  // spread over the whole box
+  std::size_t left = 0, top = 0;
+  for (auto const& key : sample) {
+    ASSERT_TRUE(testInBox(key, box.min, box.max, 2));
+    auto const coords = transpose(key, 2);
+    left += std::to_integer<unsigned>(coords[0][0]) < 32;
+    top += std::to_integer<unsigned>(coords[1][0]) < 32;
+  }
+  EXPECT_GT(left, 35);
+  EXPECT_LT(left, 65);
+  EXPECT_GT(top, 35);
+  EXPECT_LT(top, 65);
+
+  // the 4 points of a mostly empty box share a stratum, which takes the share of the others
+  auto const corner = makeBox({{{62_b}}, {{62_b}}}, {std::nullopt, std::nullopt}, 1);
+  sample.clear();
+  sampleInBox(*db.rocks, corner, 50, [&](byte_string_view key, byte_string_view) { sample.emplace_back(key); });
+  ASSERT_EQ(sample.size(), 4);
+  EXPECT_EQ(sample[0], interleave({{62_b}, {62_b}}));
+  EXPECT_EQ(sample[3], interleave({{63_b}, {63_b}}));
+  EXPECT_TRUE(std::is_sorted(sample.begin(), sample.end()));
+}